@@ -0,0 +1,155 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// Minimal benchmark harness for graphics_bench.
+//
+// A benchmark is a function that receives a BenchState and loops while
+// state.keepRunning(). Only the loop is timed, so setup before it is free. The
+// harness grows the iteration count until one sample takes at least the
+// minimum time, then takes several samples and reports the median.
+//
+// A benchmark that also checks its result calls state.fail() when the check
+// doesn't hold; graphics_bench then reports it and exits with status 1.
+//
+//   BENCHMARK(Curve_evaluate){
+//       Curve<glm::vec3> curve = makeCurve();
+//       while(state.keepRunning()){
+//           doNotOptimize(curve.evaluate(0.5f));
+//       }
+//       state.items = 1;
+//   }
+
+struct BenchState {
+    long long iterations = 1;
+    // items processed per iteration (vertices, rays, channels, ...), reported as items/s
+    double items = 0.0;
+    std::string label;
+
+    bool keepRunning(){
+        if(remaining == iterations){
+            start = std::chrono::steady_clock::now();
+        }
+        if(remaining-- > 0){
+            return true;
+        }
+        end = std::chrono::steady_clock::now();
+        return false;
+    }
+
+    void reset(){
+        remaining = iterations;
+        start = end = std::chrono::steady_clock::time_point();
+    }
+
+    double seconds() const {
+        return std::chrono::duration<double>(end - start).count();
+    }
+
+    // the first message is kept, the benchmark runs many times
+    void fail(const std::string& message){
+        if(failure.empty()){
+            failure = message;
+        }
+    }
+
+    const std::string& getFailure() const { return failure; }
+
+private:
+    long long remaining = 0;
+    std::string failure;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point end;
+};
+
+struct BenchResult {
+    std::string name;
+    std::string label;
+    std::string failure;
+    long long iterations;
+    double nsPerIteration;
+    double itemsPerSecond;
+    std::vector<double> samples;
+};
+
+typedef void (*BenchFunction)(BenchState& state);
+
+class BenchRegistry {
+public:
+    static std::vector<std::pair<std::string, BenchFunction> >& get(){
+        static std::vector<std::pair<std::string, BenchFunction> > benchmarks;
+        return benchmarks;
+    }
+
+    static int add(const char* name, BenchFunction function){
+        get().push_back(std::make_pair(std::string(name), function));
+        return 0;
+    }
+};
+
+// keeps the compiler from discarding a computed value
+template<typename T>
+inline void doNotOptimize(const T& value){
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+// silences stdout for its lifetime, for code under test that logs on every call
+class BenchQuietStdout {
+public:
+    BenchQuietStdout(){
+        fflush(stdout);
+#ifdef _WIN32
+        saved = _dup(_fileno(stdout));
+        FILE* null = fopen("NUL", "w");
+        if(null){
+            _dup2(_fileno(null), _fileno(stdout));
+            fclose(null);
+        }
+#else
+        saved = dup(fileno(stdout));
+        FILE* null = fopen("/dev/null", "w");
+        if(null){
+            dup2(fileno(null), fileno(stdout));
+            fclose(null);
+        }
+#endif
+    }
+
+    ~BenchQuietStdout(){
+        fflush(stdout);
+        if(saved < 0){
+            return;
+        }
+#ifdef _WIN32
+        _dup2(saved, _fileno(stdout));
+        _close(saved);
+#else
+        dup2(saved, fileno(stdout));
+        close(saved);
+#endif
+    }
+
+private:
+    int saved;
+};
+
+#define BENCHMARK(name) \
+    static void bench_##name(BenchState& state); \
+    static int bench_registered_##name = BenchRegistry::add(#name, bench_##name); \
+    static void bench_##name(BenchState& state)
+
+#endif // BENCH_H
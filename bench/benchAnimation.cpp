@@ -0,0 +1,154 @@
+#include "bench.h"
+#include "fixtures.h"
+#include "../src/curve.h"
+#include "../src/utils/animData.h"
+#include "../src/utils/weightCurve.h"
+
+// Animation data parsing and playback: text and binary weight curves, and the
+// Curve evaluation used by Animator/FloatAnimator.
+
+static const int animationFrames = 1000;
+static const int animationChannels = 50;
+
+static const std::string& animationText(){
+    static std::string path = writeAnimationText(animationFrames, animationChannels);
+    return path;
+}
+
+BENCHMARK(AnimatorParser_parseAnimationData){
+    const std::string& path = animationText();
+    while(state.keepRunning()){
+        std::vector<std::vector<float> > data = AnimatorParser::parseAnimationData(path);
+        doNotOptimize(data[0][0]);
+    }
+    state.items = animationFrames;
+    state.label = "frames/s";
+}
+
+BENCHMARK(AnimatorParser_parseAnimationFrames){
+    const std::string& path = animationText();
+    while(state.keepRunning()){
+        std::vector<std::vector<float> > data = AnimatorParser::parseAnimationFrames(path);
+        doNotOptimize(data[0][0]);
+    }
+    state.items = animationFrames;
+    state.label = "frames/s";
+}
+
+BENCHMARK(WeightCurveStream_open){
+    static std::string binary = benchTempPath("animation.wcrv");
+    static bool converted = AnimatorParser::convertAnimationData(animationText(), binary);
+    while(state.keepRunning()){
+        WeightCurveStream stream;
+        stream.open(binary);
+        doNotOptimize(stream.getFrames(0, 1)[0]);
+    }
+    state.items = converted ? animationFrames : 0;
+    state.label = "frames/s";
+}
+
+BENCHMARK(WeightCurvePlayer_update_cubic){
+    static WeightCurveStream* stream = 0;
+    if(!stream){
+        stream = new WeightCurveStream();
+        stream->loadFrames(AnimatorParser::parseAnimationFrames(animationText()));
+    }
+    WeightCurvePlayer player(stream);
+    player.setCubic(true);
+    player.setLoop(true);
+    player.setPlaying(true);
+    while(state.keepRunning()){
+        player.update(1.0f / 60.0f);
+    }
+    doNotOptimize(player.getWeights()[0]);
+    state.items = animationChannels;
+    state.label = "channels/s";
+}
+
+static Curve<glm::vec3> pathCurve(int keys, bool cubic){
+    BenchRandom random(3);
+    Curve<glm::vec3> curve(cubic);
+    std::vector<glm::vec3> points(keys);
+    for(int i = 0; i < keys; i++){
+        points[i] = random.vec3(-10.0f, 10.0f);
+    }
+    curve.setKeys(points);
+    return curve;
+}
+
+BENCHMARK(Curve_vec3_evaluate_cubic){
+    Curve<glm::vec3> curve = pathCurve(16, true);
+    float u = 0.0f;
+    float segments = curve.getSegmentCount();
+    while(state.keepRunning()){
+        doNotOptimize(curve.evaluate(u));
+        u += 0.001f;
+        if(u > segments) u = 0.0f;
+    }
+    state.items = 1;
+}
+
+BENCHMARK(Curve_vec3_evaluateAtDistance){
+    Curve<glm::vec3> curve = pathCurve(16, true);
+    curve.buildArcLengthTable();
+    float length = curve.getLength();
+    float distance = 0.0f;
+    while(state.keepRunning()){
+        doNotOptimize(curve.evaluateAtDistance(distance));
+        distance += 0.01f;
+        if(distance > length) distance = 0.0f;
+    }
+    state.items = 1;
+}
+
+BENCHMARK(Curve_quat_evaluate_cubic){
+    BenchRandom random(5);
+    Curve<glm::quat> curve(true);
+    std::vector<glm::quat> keys(16);
+    for(int i = 0; i < keys.size(); i++){
+        keys[i] = glm::normalize(glm::quat(random.uniform(), random.uniform(), random.uniform(), random.uniform()));
+    }
+    curve.setKeys(keys);
+    float u = 0.0f;
+    while(state.keepRunning()){
+        doNotOptimize(curve.evaluate(u));
+        u += 0.001f;
+        if(u > 15.0f) u = 0.0f;
+    }
+    state.items = 1;
+}
+
+BENCHMARK(Curve_float_setKey){
+    Curve<float> curve(true);
+    std::vector<float> keys(64, 0.0f);
+    curve.setKeys(keys);
+    int key = 0;
+    while(state.keepRunning()){
+        curve.setKey(key, key * 0.5f);
+        key = (key + 1) & 63;
+    }
+    doNotOptimize(curve.evaluate(1.0f));
+    state.items = 1;
+}
+
+BENCHMARK(CurveSet_vec3_evaluate_100k){
+    const int curveCount = 100000;
+    static CurveSet<glm::vec3>* set = 0;
+    if(!set){
+        set = new CurveSet<glm::vec3>();
+        for(int i = 0; i < curveCount; i++){
+            set->add(pathCurve(4 + i % 5, true));
+        }
+    }
+    std::vector<float> u(curveCount);
+    std::vector<glm::vec3> out(curveCount);
+    for(int i = 0; i < curveCount; i++){
+        u[i] = (i % 97) / 97.0f * 3.0f;
+    }
+    while(state.keepRunning()){
+        set->evaluate(u.data(), out.data());
+    }
+    doNotOptimize(out[0]);
+    state.items = curveCount;
+    state.label = "curves/s";
+}
@@ -0,0 +1,142 @@
+#include "bench.h"
+#include "fixtures.h"
+#include "../src/utils/imageEncoder.h"
+#include <cmath>
+#include <cstdio>
+
+// The CPU side of FrameCapture: depth linearization, the EXR writer and PNG
+// encoding of 720p frames on the caller against the encoder's threads (what
+// moving it off the render thread buys depends on the cores). Linearization
+// is checked against the projected depths, then the EXR file layout and that
+// the encoder wrote every frame.
+
+static std::vector<unsigned char> makeFrame(int width, int height){
+    BenchRandom random(91);
+    std::vector<unsigned char> pixels((size_t)width * height * 3);
+    for(int y = 0; y < height; y++){
+        for(int x = 0; x < width; x++){
+            unsigned char* pixel = &pixels[((size_t)y * width + x) * 3];
+            pixel[0] = (unsigned char)(x * 255 / width);
+            pixel[1] = (unsigned char)(y * 255 / height);
+            pixel[2] = (unsigned char)random.uniform(0.0f, 32.0f);
+        }
+    }
+    return pixels;
+}
+
+// window depth of view distances spread from near to far, as the GL perspective projection stores it
+static std::vector<float> makeDepths(size_t count, const DepthProjection& projection, std::vector<float>& distances){
+    float n = projection.nearPlane;
+    float f = projection.farPlane;
+    distances.resize(count);
+    std::vector<float> depths(count);
+    for(size_t i = 0; i < count; i++){
+        float z = n * std::pow(f / n, (float)i / count);
+        float ndc = (f + n) / (f - n) - 2.0f * f * n / ((f - n) * z);
+        distances[i] = z;
+        depths[i] = 0.5f * ndc + 0.5f;
+    }
+    return depths;
+}
+
+BENCHMARK(Capture_linearizeDepth_1080p){
+    DepthProjection projection;
+    std::vector<float> distances;
+    std::vector<float> window = makeDepths(1920 * 1080, projection, distances);
+    std::vector<float> depths;
+    while(state.keepRunning()){
+        depths = window;
+        ImageEncoder::linearizeDepth(depths.data(), depths.size(), projection);
+    }
+    float worst = 0.0f;
+    for(size_t i = 0; i < depths.size(); i++){
+        worst = std::max(worst, std::fabs(depths[i] - distances[i]) / distances[i]);
+    }
+    char label[64];
+    snprintf(label, sizeof(label), "max relative error %.2g", worst);
+    state.items = depths.size();
+    state.label = label;
+    if(!(worst < 1e-3f)){
+        state.fail(std::string("linear depth off, ") + label);
+    }
+}
+
+// magic, a Z channel, the first offset past the table, the first block's y and size
+static bool checkExr(const std::string& path, int width, int height){
+    FILE* file = fopen(path.c_str(), "rb");
+    if(file == NULL){
+        return false;
+    }
+    std::vector<unsigned char> data;
+    unsigned char buffer[65536];
+    size_t read;
+    while((read = fread(buffer, 1, sizeof(buffer), file)) > 0){
+        data.insert(data.end(), buffer, buffer + read);
+    }
+    fclose(file);
+    size_t blockBytes = 8 + (size_t)width * 4;
+    if(data.size() < 8 || memcmp(data.data(), "\x76\x2f\x31\x01", 4) != 0){
+        return false;
+    }
+    // the header ends with an empty attribute name, right before the offsets
+    size_t headerEnd = data.size() - (size_t)height * (8 + blockBytes);
+    uint64_t first;
+    int32_t y, size;
+    memcpy(&first, &data[headerEnd], 8);
+    memcpy(&y, &data[first], 4);
+    memcpy(&size, &data[first + 4], 4);
+    const char* channels = "channels\0chlist";
+    bool hasZ = std::search(data.begin(), data.begin() + headerEnd, channels, channels + 15) != data.begin() + headerEnd;
+    return data[headerEnd - 1] == 0 && hasZ && first == headerEnd + (size_t)height * 8 && y == 0 && size == width * 4;
+}
+
+BENCHMARK(Capture_writeExrDepth_1080p){
+    std::string path = benchTempPath("depth.exr");
+    std::vector<float> depths(1920 * 1080, 12.5f);
+    bool ok = true;
+    while(state.keepRunning()){
+        ok = ImageEncoder::writeEXR(path, 1920, 1080, 1, depths.data(), true) && ok;
+    }
+    ok = ok && checkExr(path, 1920, 1080);
+    remove(path.c_str());
+    state.items = depths.size();
+    if(!ok){
+        state.fail("bad EXR layout");
+    }
+}
+
+BENCHMARK(Capture_png720p_8frames_caller){
+    std::vector<unsigned char> frame = makeFrame(1280, 720);
+    std::string path = benchTempPath("capture.png");
+    while(state.keepRunning()){
+        for(int i = 0; i < 8; i++){
+            stbi_write_png(path.c_str(), 1280, 720, 3, frame.data() + (size_t)719 * 1280 * 3, -1280 * 3);
+        }
+    }
+    remove(path.c_str());
+    state.items = 8;
+}
+
+BENCHMARK(Capture_png720p_8frames_encoder){
+    std::vector<unsigned char> frame = makeFrame(1280, 720);
+    ImageEncoder encoder;
+    std::string paths[8];
+    for(int i = 0; i < 8; i++){
+        paths[i] = benchTempPath("capture" + std::to_string(i) + ".png");
+    }
+    while(state.keepRunning()){
+        for(int i = 0; i < 8; i++){
+            std::vector<unsigned char> copy = frame;
+            encoder.submitColor(paths[i], 1280, 720, copy);
+        }
+        encoder.flush();
+    }
+    for(int i = 0; i < 8; i++){
+        remove(paths[i].c_str());
+    }
+    state.items = 8;
+    state.label = std::to_string(encoder.getThreadCount()) + " threads";
+    if(encoder.getFailed() > 0){
+        state.fail(std::to_string(encoder.getFailed()) + " frames failed to encode");
+    }
+}
@@ -0,0 +1,102 @@
+#include "bench.h"
+#include "fixtures.h"
+#include "../src/utils/cubemapLoader.h"
+#include "../src/utils/textureCooker.h"
+
+// Cubemap loading up to the upload for 2k and 4k skyboxes (six JPEG faces of
+// 2048^2 and 4096^2): the faces decoded one after the other as Cubemap used
+// to, decoded on a thread each, and a cooked BC1 container with its mips read
+// instead. Then an equirectangular HDR image projected to 1k faces. Labels
+// give the bytes the upload takes.
+
+static void decodeFaces(BenchState& state, int size, int numThreads){
+    std::string paths[6];
+    writeSkyFaces(size, paths);
+    CubemapImage image;
+    bool ok = true;
+    while(state.keepRunning()){
+        ok = CubemapLoader::decodeFaces(paths, image, numThreads) && ok;
+    }
+    state.items = 6.0 * size * size;
+    if(!ok){
+        state.fail("faces failed to decode");
+    }
+    state.label = std::to_string(image.pixels.size() / 1048576) + " MB RGBA8, mips on the GPU";
+}
+
+static void readCooked(BenchState& state, int size){
+    std::string paths[6];
+    writeSkyFaces(size, paths);
+    std::string path = benchTempPath("sky_" + std::to_string(size) + ".gtex");
+    CookedTexture texture;
+    if(!TextureCooker::read(path, texture)){
+        CubemapImage image;
+        CubemapLoader::decodeFaces(paths, image);
+        const unsigned char* faces[6];
+        for(int face = 0; face < 6; face++){
+            faces[face] = image.getFace(face);
+        }
+        TextureCooker::cookFaces(faces, 6, size, size, COOKED_BC1, false, texture);
+        TextureCooker::write(path, texture);
+    }
+    bool ok = true;
+    while(state.keepRunning()){
+        ok = TextureCooker::read(path, texture) && texture.faces == 6 && ok;
+    }
+    state.items = 6.0 * size * size;
+    if(!ok){
+        state.fail("cooked cubemap failed to read");
+    }
+    state.label = std::to_string(texture.getSize() / 1048576) + " MB BC1 with mips";
+}
+
+BENCHMARK(Cubemap_decodeFaces_2k_sequential){
+    decodeFaces(state, 2048, 1);
+}
+
+BENCHMARK(Cubemap_decodeFaces_2k_parallel){
+    decodeFaces(state, 2048, 6);
+}
+
+BENCHMARK(Cubemap_readCooked_2k){
+    readCooked(state, 2048);
+}
+
+BENCHMARK(Cubemap_decodeFaces_4k_sequential){
+    decodeFaces(state, 4096, 1);
+}
+
+BENCHMARK(Cubemap_decodeFaces_4k_parallel){
+    decodeFaces(state, 4096, 6);
+}
+
+BENCHMARK(Cubemap_readCooked_4k){
+    readCooked(state, 4096);
+}
+
+BENCHMARK(Cubemap_loadEquirectangular_1k){
+    std::string path = benchTempPath("sky_equirectangular.hdr");
+    const int width = 4096, height = 2048;
+    std::vector<float> rgb((size_t)width * height * 3);
+    for(int y = 0; y < height; y++){
+        for(int x = 0; x < width; x++){
+            float* p = &rgb[3 * ((size_t)y * width + x)];
+            float elevation = 1.0f - 2.0f * (y + 0.5f) / height;
+            float sun = std::pow(std::max(0.0f, std::cos(6.2831853f * x / width) * std::cos(3.14159265f * (elevation - 0.4f))), 400.0f);
+            p[0] = elevation > 0.0f ? 0.3f + 0.5f * elevation + 20.0f * sun : 0.2f;
+            p[1] = elevation > 0.0f ? 0.5f + 0.3f * elevation + 18.0f * sun : 0.15f;
+            p[2] = elevation > 0.0f ? 0.9f + 10.0f * sun : 0.1f;
+        }
+    }
+    stbi_write_hdr(path.c_str(), width, height, 3, rgb.data());
+    CubemapImage image;
+    bool ok = true;
+    while(state.keepRunning()){
+        ok = CubemapLoader::loadEquirectangular(path, 1024, image) && ok;
+    }
+    state.items = 6.0 * 1024 * 1024;
+    if(!ok){
+        state.fail("equirectangular image failed to load");
+    }
+    state.label = std::to_string(image.hdrPixels.size() * 2 / 1048576) + " MB RGB16F, mips on the GPU";
+}
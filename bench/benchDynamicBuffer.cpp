@@ -0,0 +1,179 @@
+#include "bench.h"
+#include "fixtures.h"
+#include "../src/utils/ringAllocator.h"
+#include <cstring>
+#include <map>
+
+// RingAllocator against a fake backend whose GPU finishes a frame a fixed
+// number of frames after the CPU submitted it, with blocking waits letting it
+// catch up. Frames allocate terrain sized blocks (a few MB in pieces), and
+// every allocation is checked against the ranges of frames the fake GPU has
+// not finished: none may overlap, and none may fail. Labels give the waits
+// and orphans, with the ring sized for three frames, undersized, and
+// undersized on an orphaning backend. Then writing a tessellation in place against into a pool copied
+// afterwards, the two RoamShader paths.
+
+class FakeRingBackend : public RingBackend {
+public:
+    FakeRingBackend(int gpuLatency, bool persistent, bool orphaning)
+        : gpuLatency(gpuLatency), persistent(persistent), orphaning(orphaning) {}
+
+    ~FakeRingBackend() { delete[] storage; }
+
+    unsigned char* create(size_t size) override {
+        storage = new unsigned char[size];
+        return persistent ? storage : nullptr;
+    }
+    unsigned char* mapRange(size_t offset, size_t size) override { return storage + offset; }
+    void unmapRange() override {}
+
+    RingFence insertFence() override {
+        fences[++lastFence] = cpuFrame;
+        return lastFence;
+    }
+    bool waitFence(RingFence fence, bool block) override {
+        long long frame = fences[fence];
+        if(block && gpuFrame < frame){
+            gpuFrame = frame;
+        }
+        return gpuFrame >= frame;
+    }
+    void deleteFence(RingFence fence) override { fences.erase(fence); }
+
+    bool canOrphan() const override { return orphaning; }
+    void orphan() override { generation++; }
+
+    // the CPU moves to the next frame, the GPU stays gpuLatency frames behind
+    void nextFrame() {
+        cpuFrame++;
+        gpuFrame = std::max(gpuFrame, cpuFrame - gpuLatency);
+    }
+
+    long long cpuFrame = 0;
+    long long gpuFrame = -1;    // the last frame the GPU finished
+    int generation = 0;         // storage orphaned so far
+
+private:
+    int gpuLatency;
+    bool persistent;
+    bool orphaning;
+    unsigned char* storage = nullptr;
+    std::map<RingFence, long long> fences;
+    RingFence lastFence = 0;
+};
+
+struct UsedRange {
+    long long frame;
+    int generation;
+    size_t begin, end;
+};
+
+static std::string runFrames(BenchState& state, size_t capacity, bool orphaning, int frames){
+    FakeRingBackend* backend = new FakeRingBackend(3, !orphaning, orphaning);
+    RingAllocator ring(backend, capacity);
+    BenchRandom random(17);
+    std::vector<UsedRange> used;
+    bool overlap = false;
+    int failed = 0;
+    for(int frame = 0; frame < frames; frame++){
+        int pieces = 1 + (int)random.uniform(0.0f, 4.0f);
+        for(int p = 0; p < pieces; p++){
+            size_t size = (size_t)random.uniform(64.0f * 1024.0f, 1024.0f * 1024.0f);
+            RingAllocation allocation = ring.allocate(size);
+            if(allocation.data == nullptr){
+                failed++;
+                continue;
+            }
+            memset(allocation.data, frame & 0xFF, 64);
+            ring.commit(allocation);
+            for(const UsedRange& range : used){
+                bool busy = range.frame > backend->gpuFrame || range.frame == backend->cpuFrame;
+                overlap = overlap || (busy && range.generation == backend->generation
+                                      && allocation.offset < range.end && range.begin < allocation.offset + size);
+            }
+            UsedRange range = { backend->cpuFrame, backend->generation, allocation.offset, allocation.offset + size };
+            used.push_back(range);
+        }
+        ring.endFrame();
+        backend->nextFrame();
+        // ranges of finished frames can't conflict any more
+        std::vector<UsedRange> busy;
+        for(const UsedRange& range : used){
+            if(range.frame > backend->gpuFrame) busy.push_back(range);
+        }
+        used.swap(busy);
+    }
+    if(overlap){
+        state.fail("allocation overlaps a range the GPU is using");
+    }
+    if(failed > 0){
+        state.fail(std::to_string(failed) + " allocations failed");
+    }
+    return std::to_string(ring.getWaits()) + " waits, " + std::to_string(ring.getOrphans()) + " orphans";
+}
+
+BENCHMARK(DynamicBuffer_ring_1000frames_32MB){
+    std::string label;
+    while(state.keepRunning()){
+        label = runFrames(state, 32 << 20, false, 1000);
+    }
+    state.items = 1000;
+    state.label = label;
+}
+
+BENCHMARK(DynamicBuffer_ring_1000frames_6MB){
+    std::string label;
+    while(state.keepRunning()){
+        label = runFrames(state, 6 << 20, false, 1000);
+    }
+    state.items = 1000;
+    state.label = label;
+}
+
+BENCHMARK(DynamicBuffer_ringOrphaning_1000frames_6MB){
+    std::string label;
+    while(state.keepRunning()){
+        label = runFrames(state, 6 << 20, true, 1000);
+    }
+    state.items = 1000;
+    state.label = label;
+}
+
+// 100k terrain triangles: positions, colours and normal texels
+static void writeTessellation(float* out, size_t leaves){
+    float* colors = out + 9 * leaves;
+    float* texels = out + 18 * leaves;
+    for(size_t i = 0; i < leaves; i++){
+        for(int v = 0; v < 9; v++){
+            out[i * 9 + v] = (float)(i + v);
+            colors[i * 9 + v] = 1.0f;
+        }
+        for(int t = 0; t < 6; t++){
+            texels[i * 6 + t] = (float)t;
+        }
+    }
+}
+
+BENCHMARK(DynamicBuffer_terrain100k_poolAndCopy){
+    const size_t leaves = 100000;
+    std::vector<float> pool(24 * leaves);
+    std::vector<float> buffer(24 * leaves);    // stands in for glBufferSubData's copy
+    while(state.keepRunning()){
+        writeTessellation(pool.data(), leaves);
+        memcpy(buffer.data(), pool.data(), pool.size() * sizeof(float));
+    }
+    doNotOptimize(buffer[0]);
+    state.items = leaves;
+}
+
+BENCHMARK(DynamicBuffer_terrain100k_inPlace){
+    const size_t leaves = 100000;
+    RingAllocator ring(new FakeRingBackend(3, true, false), 3 * 24 * leaves * sizeof(float) + 256);
+    while(state.keepRunning()){
+        RingAllocation allocation = ring.allocate(24 * leaves * sizeof(float));
+        writeTessellation((float*)allocation.data, leaves);
+        ring.commit(allocation);
+        ring.endFrame();
+    }
+    state.items = leaves;
+}
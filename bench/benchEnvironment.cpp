@@ -0,0 +1,158 @@
+#include "bench.h"
+#include "fixtures.h"
+#include "../src/utils/environmentLighting.h"
+
+// Image based lighting precomputation for a 256x256 per face sky: the whole
+// per cubemap precompute (what ImageBasedLighting pays once before caching),
+// its parts, reading the cache back and the BRDF LUT. The results are checked
+// against Monte Carlo integrals of the same quantities, within a tolerance a
+// little over what they reach:
+//   irradiance  SH9 against cosine weighted sampling of the source, for 64
+//               normals, mean error under 1%
+//   specular    each rough level against GGX weighted uniform sampling of the
+//               unfiltered source, for 32 directions per level, under 5%
+//   BRDF LUT    against uniform hemisphere sampling, over the LUT's range,
+//               under 0.03
+
+static const EnvironmentMap& skyMap(){
+    static EnvironmentMap map;
+    if(map.texels.empty()){
+        std::vector<unsigned char> faces[6];
+        makeSkyFaces(256, faces);
+        const unsigned char* pointers[6];
+        for(int face = 0; face < 6; face++){
+            pointers[face] = faces[face].data();
+        }
+        EnvironmentLighting::fromImages(pointers, 256, 3, map);
+    }
+    return map;
+}
+
+static std::vector<glm::vec3> testDirections(int count, unsigned int seed){
+    BenchRandom random(seed);
+    std::vector<glm::vec3> directions;
+    while((int)directions.size() < count){
+        glm::vec3 d = random.vec3();
+        if(glm::dot(d, d) <= 1.0f && glm::dot(d, d) > 1e-4f){
+            directions.push_back(glm::normalize(d));
+        }
+    }
+    return directions;
+}
+
+static float luminance(const glm::vec3& color){
+    return glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+}
+
+// mean relative luminance error of the SH irradiance
+static float irradianceError(const PrefilteredEnvironment& environment){
+    std::vector<glm::vec3> normals = testDirections(64, 61);
+    float error = 0.0f;
+    for(size_t i = 0; i < normals.size(); i++){
+        float reference = luminance(EnvironmentLighting::referenceIrradiance(skyMap(), normals[i], 1 << 15, i + 1));
+        error += std::abs(luminance(EnvironmentLighting::evaluateSH(environment.irradiance, normals[i])) - reference) / reference;
+    }
+    return error / normals.size();
+}
+
+// mean relative luminance error over the rough levels
+static float specularError(const PrefilteredEnvironment& environment){
+    std::vector<glm::vec3> directions = testDirections(32, 67);
+    int levelCount = environment.specular.size();
+    float error = 0.0f;
+    int count = 0;
+    for(int level = 1; level < levelCount; level++){
+        float roughness = (float)level / (levelCount - 1);
+        for(size_t i = 0; i < directions.size(); i++){
+            float reference = luminance(EnvironmentLighting::referencePrefiltered(skyMap(), directions[i], roughness, 1 << 16, i + 1));
+            error += std::abs(luminance(EnvironmentLighting::sample(environment.specular[level], directions[i])) - reference) / reference;
+            count++;
+        }
+    }
+    return error / count;
+}
+
+BENCHMARK(Environment_compute_256){
+    PrefilteredEnvironment environment;
+    while(state.keepRunning()){
+        EnvironmentLighting::compute(skyMap(), environment);
+    }
+    float irradiance = irradianceError(environment);
+    float specular = specularError(environment);
+    char label[96];
+    snprintf(label, sizeof(label), "per cubemap; irradiance error %.2f%%, specular error %.2f%%", 100.0f * irradiance, 100.0f * specular);
+    state.items = 1;
+    state.label = label;
+    if(!(irradiance < 0.01f && specular < 0.05f)){
+        state.fail(std::string("prefiltered environment off, ") + label);
+    }
+}
+
+BENCHMARK(Environment_compute_256_singleThread){
+    PrefilteredEnvironment environment;
+    while(state.keepRunning()){
+        EnvironmentLighting::compute(skyMap(), environment, 128, 5, 64, 1);
+    }
+    doNotOptimize(environment.irradiance[0].x);
+    state.items = 1;
+}
+
+BENCHMARK(Environment_projectIrradiance_256){
+    glm::vec3 coefficients[9];
+    while(state.keepRunning()){
+        EnvironmentLighting::projectIrradiance(skyMap(), coefficients);
+    }
+    doNotOptimize(coefficients[0].x);
+    state.items = 6 * 256 * 256;
+}
+
+BENCHMARK(Environment_prefilter_256){
+    std::vector<EnvironmentMap> chain, levels;
+    EnvironmentLighting::buildMipChain(skyMap(), chain);
+    while(state.keepRunning()){
+        EnvironmentLighting::prefilter(chain, 128, 5, 64, levels);
+    }
+    size_t texels = 0;
+    for(const EnvironmentMap& level : levels){
+        texels += 6 * level.size * level.size;
+    }
+    state.items = texels;
+}
+
+BENCHMARK(Environment_readCache_256){
+    std::string path = benchTempPath("environment_256.ibl");
+    PrefilteredEnvironment environment;
+    EnvironmentLighting::compute(skyMap(), environment);
+    EnvironmentLighting::write(path, 1, environment);
+    bool ok = true;
+    while(state.keepRunning()){
+        ok = EnvironmentLighting::read(path, 1, environment) && ok;
+    }
+    state.items = 1;
+    if(!ok){
+        state.fail("cache failed to read back");
+    }
+}
+
+BENCHMARK(Environment_integrateBRDF_128){
+    std::vector<glm::vec2> lut;
+    while(state.keepRunning()){
+        EnvironmentLighting::integrateBRDF(128, 512, lut);
+    }
+    // uniform sampling is too noisy for the sharpest lobes, so the check starts at roughness 0.25
+    float error = 0.0f;
+    for(int y = 32; y < 128; y += 24){
+        for(int x = 4; x < 128; x += 24){
+            glm::vec2 reference = EnvironmentLighting::referenceBRDF((x + 0.5f) / 128, (y + 0.5f) / 128, 1 << 20, x * 128 + y + 1);
+            glm::vec2 difference = glm::abs(lut[y * 128 + x] - reference);
+            error = std::max(error, std::max(difference.x, difference.y));
+        }
+    }
+    char label[64];
+    snprintf(label, sizeof(label), "max error %.4f", error);
+    state.items = 128 * 128;
+    state.label = label;
+    if(!(error < 0.03f)){
+        state.fail(std::string("BRDF LUT off, ") + label);
+    }
+}
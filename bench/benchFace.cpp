@@ -0,0 +1,265 @@
+#include "bench.h"
+#include "fixtures.h"
+#include "../src/blendShapeRig.h"
+#include "../src/blendShapeSolver.h"
+
+// The two halves of FaceManipulation's per-frame work without its GL mesh:
+// the weight solve (BlendShapeSolver) and the mesh update (BlendShapeRig).
+// The rig is sized after animation3's Mery face: assimp loads neutral.obj as
+// 28284 vertices (one per triangle corner), and the Mery targets keep deltas
+// for 15% of them at FaceManipulation's epsilon of 1e-5 (79% at the rig's
+// default, most of those being the OBJ files' rounding noise). 25 shapes. The
+// solver is swept from 1 to 200 manipulators, and its factorisation, kept up
+// to date by rank-one updates, must solve as a fresh LDLT of
+// B^T B + (alpha + u) I does.
+
+static const int faceVertices = 28284;
+static const int faceShapes = 25;
+static const float faceCoverage = 0.15f;
+static const float faceEpsilon = 1e-5f;
+
+static const BlendShapeRig& faceRig(bool quantize){
+    static BlendShapeRig* rigs[2] = { 0, 0 };
+    if(!rigs[quantize]){
+        std::vector<glm::vec3> base;
+        std::vector<unsigned int> indices;
+        makeGridMesh(168, base, indices);
+        base.resize(faceVertices);
+        std::vector<std::vector<glm::vec3> > targets;
+        makeBlendShapeTargets(base, faceShapes, faceCoverage, targets);
+
+        rigs[quantize] = new BlendShapeRig(base, quantize);
+        for(int i = 0; i < faceShapes; i++){
+            rigs[quantize]->addShape(targets[i], faceEpsilon);
+        }
+    }
+    return *rigs[quantize];
+}
+
+static std::vector<float> faceWeights(int seed){
+    BenchRandom random(seed);
+    std::vector<float> weights(faceShapes);
+    for(int i = 0; i < faceShapes; i++){
+        // typical expression: most shapes off, a few active
+        weights[i] = random.uniform() < 0.3f ? random.uniform() : 0.0f;
+    }
+    return weights;
+}
+
+static void evaluateFaces(BenchState& state, int faces){
+    const BlendShapeRig& rig = faceRig(false);
+    std::vector<std::vector<float> > weights(faces);
+    std::vector<std::vector<glm::vec4> > positions(faces);
+    std::vector<const float*> weightPointers(faces);
+    std::vector<glm::vec4*> positionPointers(faces);
+    for(int i = 0; i < faces; i++){
+        weights[i] = faceWeights(i + 1);
+        rig.initialisePositions(positions[i]);
+        weightPointers[i] = weights[i].data();
+        positionPointers[i] = positions[i].data();
+    }
+    while(state.keepRunning()){
+        rig.evaluateBatch(weightPointers, positionPointers);
+    }
+    doNotOptimize(positions[0][0]);
+    state.items = faces;
+    state.label = "faces/s";
+}
+
+BENCHMARK(BlendShapeRig_evaluate){
+    const BlendShapeRig& rig = faceRig(false);
+    std::vector<float> weights = faceWeights(1);
+    std::vector<glm::vec4> positions;
+    rig.initialisePositions(positions);
+    while(state.keepRunning()){
+        rig.evaluate(weights.data(), positions.data());
+    }
+    doNotOptimize(positions[0]);
+    state.items = faceVertices;
+}
+
+BENCHMARK(BlendShapeRig_evaluate_quantized){
+    const BlendShapeRig& rig = faceRig(true);
+    std::vector<float> weights = faceWeights(1);
+    std::vector<glm::vec4> positions;
+    rig.initialisePositions(positions);
+    while(state.keepRunning()){
+        rig.evaluate(weights.data(), positions.data());
+    }
+    doNotOptimize(positions[0]);
+    state.items = faceVertices;
+}
+
+BENCHMARK(BlendShapeRig_evaluateBatch_faces1){
+    evaluateFaces(state, 1);
+}
+
+BENCHMARK(BlendShapeRig_evaluateBatch_faces100){
+    evaluateFaces(state, 100);
+}
+
+BENCHMARK(BlendShapeRig_evaluateBatch_faces1000){
+    evaluateFaces(state, 1000);
+}
+
+BENCHMARK(BlendShapeRig_addShape){
+    std::vector<glm::vec3> base;
+    std::vector<unsigned int> indices;
+    makeGridMesh(168, base, indices);
+    base.resize(faceVertices);
+    std::vector<std::vector<glm::vec3> > targets;
+    makeBlendShapeTargets(base, 1, faceCoverage, targets);
+    while(state.keepRunning()){
+        BlendShapeRig rig(base);
+        doNotOptimize(rig.addShape(targets[0], faceEpsilon));
+    }
+    state.items = faceVertices;
+}
+
+// the solver's default regularisation, spelled out for the reference factorisation
+static const float solverAlpha = 0.1f;
+static const float solverU = 0.001f;
+
+// B: the shape deltas at the manipulated vertices, three rows per manipulator
+static Eigen::MatrixXf faceDeltas(int manipulators){
+    const BlendShapeRig& rig = faceRig(false);
+    Eigen::MatrixXf deltas(3 * manipulators, faceShapes);
+    for(int m = 0; m < manipulators; m++){
+        int vertex = (m * 997) % faceVertices;
+        for(int s = 0; s < faceShapes; s++){
+            glm::vec3 delta = rig.getDelta(s, vertex);
+            deltas(3 * m + 0, s) = delta.x;
+            deltas(3 * m + 1, s) = delta.y;
+            deltas(3 * m + 2, s) = delta.z;
+        }
+    }
+    return deltas;
+}
+
+static BlendShapeSolver faceSolver(int manipulators){
+    Eigen::MatrixXf deltas = faceDeltas(manipulators);
+    BlendShapeSolver solver(faceShapes, solverAlpha, solverU);
+    for(int m = 0; m < manipulators; m++){
+        solver.addManipulator(deltas.middleRows(3 * m, 3));
+    }
+    return solver;
+}
+
+// the factorisation built by rank-one updates against a fresh LDLT of B^T B + (alpha + u) I,
+// compared through a solve, relative error
+static float factorisationError(const BlendShapeSolver& solver, const Eigen::MatrixXf& deltas){
+    Eigen::MatrixXf a = deltas.transpose() * deltas;
+    a.diagonal().array() += solverAlpha + solverU;
+    Eigen::LDLT<Eigen::MatrixXf> fresh(a);
+    BenchRandom random(41);
+    Eigen::VectorXf m(deltas.rows());
+    Eigen::VectorXf w0(faceShapes);
+    for(int i = 0; i < m.size(); i++){
+        m[i] = random.uniform(-0.05f, 0.05f);
+    }
+    for(int i = 0; i < w0.size(); i++){
+        w0[i] = random.uniform();
+    }
+    Eigen::VectorXf reference = fresh.solve(deltas.transpose() * m + solverAlpha * w0);
+    return (solver.solve(m, w0) - reference).norm() / reference.norm();
+}
+
+// adding n manipulators one at a time (n rank-three updates), then a frame's solve
+static void solverSweep(BenchState& state, int manipulators){
+    Eigen::MatrixXf deltas = faceDeltas(manipulators);
+    BlendShapeSolver solver(faceShapes, solverAlpha, solverU);
+    while(state.keepRunning()){
+        solver.clearManipulators();
+        for(int m = 0; m < manipulators; m++){
+            solver.addManipulator(deltas.middleRows(3 * m, 3));
+        }
+    }
+    state.items = manipulators;
+
+    float error = factorisationError(solver, deltas);
+    char label[64];
+    snprintf(label, sizeof(label), "manipulators/s, %.2g from a fresh LDLT", error);
+    state.label = label;
+    if(!(error < 1e-3f)){
+        state.fail(std::string("rank-one updated factorisation off, ") + label);
+    }
+}
+
+static void solveSweep(BenchState& state, int manipulators){
+    BlendShapeSolver solver = faceSolver(manipulators);
+    Eigen::VectorXf m = Eigen::VectorXf::Constant(3 * manipulators, 0.01f);
+    Eigen::VectorXf w0 = Eigen::VectorXf::Zero(faceShapes);
+    while(state.keepRunning()){
+        Eigen::VectorXf w = solver.solve(m, w0);
+        doNotOptimize(w[0]);
+    }
+    state.items = 1;
+}
+
+BENCHMARK(BlendShapeSolver_addManipulators_1){
+    solverSweep(state, 1);
+}
+
+BENCHMARK(BlendShapeSolver_addManipulators_10){
+    solverSweep(state, 10);
+}
+
+BENCHMARK(BlendShapeSolver_addManipulators_50){
+    solverSweep(state, 50);
+}
+
+BENCHMARK(BlendShapeSolver_addManipulators_100){
+    solverSweep(state, 100);
+}
+
+BENCHMARK(BlendShapeSolver_addManipulators_200){
+    solverSweep(state, 200);
+}
+
+BENCHMARK(BlendShapeSolver_solve_1manipulator){
+    solveSweep(state, 1);
+}
+
+BENCHMARK(BlendShapeSolver_solve_10manipulators){
+    solveSweep(state, 10);
+}
+
+BENCHMARK(BlendShapeSolver_solve_50manipulators){
+    solveSweep(state, 50);
+}
+
+BENCHMARK(BlendShapeSolver_solve_100manipulators){
+    solveSweep(state, 100);
+}
+
+BENCHMARK(BlendShapeSolver_solve_200manipulators){
+    solveSweep(state, 200);
+}
+
+BENCHMARK(BlendShapeSolver_solve_4manipulators){
+    solveSweep(state, 4);
+}
+
+BENCHMARK(BlendShapeSolver_solveBoxConstrained_4manipulators){
+    BlendShapeSolver solver = faceSolver(4);
+    Eigen::VectorXf m = Eigen::VectorXf::Constant(12, 0.01f);
+    Eigen::VectorXf w0 = Eigen::VectorXf::Zero(faceShapes);
+    while(state.keepRunning()){
+        Eigen::VectorXf w = solver.solveBoxConstrained(m, w0);
+        doNotOptimize(w[0]);
+    }
+    state.items = 1;
+}
+
+BENCHMARK(BlendShapeSolver_addManipulator){
+    BlendShapeSolver solver = faceSolver(4);
+    Eigen::MatrixXf deltas = Eigen::MatrixXf::Random(3, faceShapes) * 0.01f;
+    while(state.keepRunning()){
+        // rank-three update of the cached factorisation
+        solver.addManipulator(deltas);
+        if(solver.getManipulatorCount() > 64){
+            solver.clearManipulators();
+        }
+    }
+    state.items = 1;
+}
@@ -0,0 +1,106 @@
+#include "bench.h"
+#include "fixtures.h"
+#include "../src/utils/lightClusters.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+
+// Clustered light assignment (16x9x24 clusters) for 1k point lights spread
+// through the view frustum of a 16:9, 45 degree, 0.1-1000 camera. The brute
+// force assignment checks every cluster gets the same lights from assign().
+
+static const int lightCount = 1000;
+
+static const std::vector<glm::vec4>& viewLights(){
+    static std::vector<glm::vec4> lights;
+    if(lights.empty()){
+        BenchRandom random(17);
+        for(int i = 0; i < lightCount; i++){
+            // mostly near the camera like a lit room, a few far away
+            float depth = random.uniform() < 0.8f ? random.uniform(1.0f, 60.0f) : random.uniform(60.0f, 900.0f);
+            float spread = depth * 0.4f;
+            glm::vec3 position(random.uniform(-spread * 1.8f, spread * 1.8f), random.uniform(-spread, spread), -depth);
+            lights.push_back(glm::vec4(position, random.uniform(2.0f, 10.0f)));
+        }
+    }
+    return lights;
+}
+
+static glm::mat4 benchProjection(){
+    return glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+}
+
+BENCHMARK(LightClusters_setProjection){
+    LightClusters clusters;
+    float fov = 45.0f;
+    while(state.keepRunning()){
+        // a changing projection, so the boxes are rebuilt every time
+        clusters.setProjection(glm::perspective(glm::radians(fov), 16.0f / 9.0f, 0.1f, 1000.0f));
+        fov = fov == 45.0f ? 46.0f : 45.0f;
+    }
+    state.items = clusters.getClusterCount();
+}
+
+BENCHMARK(LightClusters_assign_1k){
+    LightClusters clusters;
+    clusters.setProjection(benchProjection());
+    const std::vector<glm::vec4>& lights = viewLights();
+    while(state.keepRunning()){
+        clusters.assign(lights);
+    }
+    doNotOptimize(clusters.getIndices().size());
+    state.items = lights.size();
+    state.label = std::to_string(clusters.getIndices().size()) + " references";
+}
+
+BENCHMARK(LightClusters_assign_1k_singleThread){
+    LightClusters clusters;
+    clusters.setProjection(benchProjection());
+    const std::vector<glm::vec4>& lights = viewLights();
+    while(state.keepRunning()){
+        clusters.assign(lights, 1);
+    }
+    doNotOptimize(clusters.getIndices().size());
+    state.items = lights.size();
+}
+
+// every light against every cluster box, without the per slice prefilter
+BENCHMARK(LightClusters_assign_1k_bruteForce){
+    LightClusters clusters;
+    clusters.setProjection(benchProjection());
+    const std::vector<glm::vec4>& lights = viewLights();
+    int count = clusters.getClusterCount();
+    std::vector<glm::vec3> boxMin(count), boxMax(count);
+    for(int c = 0; c < count; c++){
+        clusters.getClusterBounds(c, boxMin[c], boxMax[c]);
+    }
+    std::vector<unsigned int> grid(2 * count);
+    std::vector<unsigned int> indices;
+    while(state.keepRunning()){
+        indices.clear();
+        for(int c = 0; c < count; c++){
+            grid[2 * c] = indices.size();
+            for(int i = 0; i < lights.size(); i++){
+                glm::vec3 centre(lights[i]);
+                glm::vec3 d = glm::max(glm::max(boxMin[c] - centre, centre - boxMax[c]), glm::vec3(0.0f));
+                if(glm::dot(d, d) <= lights[i].w * lights[i].w){
+                    indices.push_back(i);
+                }
+            }
+            grid[2 * c + 1] = indices.size() - grid[2 * c];
+        }
+    }
+    doNotOptimize(indices.size());
+    state.items = lights.size();
+
+    clusters.assign(lights);
+    int mismatched = 0;
+    for(int c = 0; c < count; c++){
+        const unsigned int* expected = &indices[0] + grid[2 * c];
+        const unsigned int* assigned = &clusters.getIndices()[0] + clusters.getGrid()[2 * c];
+        mismatched += grid[2 * c + 1] != clusters.getGrid()[2 * c + 1]
+                   || !std::equal(expected, expected + grid[2 * c + 1], assigned);
+    }
+    if(mismatched > 0){
+        state.fail(std::to_string(mismatched) + " clusters differ from assign()");
+    }
+}
@@ -0,0 +1,221 @@
+#include "bench.h"
+#include "fixtures.h"
+#include "../src/utils/coneStepMap.h"
+
+// Cone step map preprocessing and the parallax march it replaces. The build
+// benchmarks give the preprocessing time of a 512x512 and a 1024x1024 height
+// map; the first also checks the pruned build against the brute force
+// reference on small maps. The march benchmarks run texturedShader.frag's
+// linear march and its cone step march on the CPU for 4096 rays over a
+// 512x512 map (height scale 0.1, view elevations down to about 12 degrees),
+// labelled with texture fetches per ray and the mean error in texels against
+// a 4096 layer march. The cone step march has to get there in at most 60% of
+// the linear march's fetches and no less accurately; on the brick map's
+// per-texel noise the conservative cones it had before took 8.7 fetches to
+// the linear march's 9.2.
+
+static const float heightScale = 0.1f;
+
+static const std::vector<unsigned char>& depthImage(int size){
+    static std::vector<unsigned char> images[3];
+    std::vector<unsigned char>& image = images[size >= 1024 ? 2 : size >= 512 ? 1 : 0];
+    if(image.empty()){
+        makeDepthImage(size, image);
+    }
+    return image;
+}
+
+// bilinear, wrapping, channel of a map with the given channel count
+static float sampleMap(const std::vector<unsigned char>& map, int size, int channels, int channel, float u, float v){
+    float x = u * size - 0.5f;
+    float y = v * size - 0.5f;
+    float fx = std::floor(x), fy = std::floor(y);
+    float tx = x - fx, ty = y - fy;
+    int x0 = ((int)fx % size + size) % size, y0 = ((int)fy % size + size) % size;
+    int x1 = (x0 + 1) % size, y1 = (y0 + 1) % size;
+    float a = map[(x0 + (size_t)size * y0) * channels + channel] / 255.0f;
+    float b = map[(x1 + (size_t)size * y0) * channels + channel] / 255.0f;
+    float c = map[(x0 + (size_t)size * y1) * channels + channel] / 255.0f;
+    float d = map[(x1 + (size_t)size * y1) * channels + channel] / 255.0f;
+    return (a + (b - a) * tx) + ((c + (d - c) * tx) - (a + (b - a) * tx)) * ty;
+}
+
+struct ParallaxRay {
+    glm::vec2 texCoords;
+    glm::vec3 viewDir;  // tangent space, towards the eye
+};
+
+static std::vector<ParallaxRay> parallaxRays(){
+    BenchRandom random(59);
+    std::vector<ParallaxRay> rays(4096);
+    for(ParallaxRay& ray : rays){
+        ray.texCoords = glm::vec2(random.uniform(0.0f, 1.0f), random.uniform(0.0f, 1.0f));
+        float angle = random.uniform(0.0f, 6.2831853f);
+        float z = random.uniform(0.2f, 1.0f);
+        float r = std::sqrt(1.0f - z * z);
+        ray.viewDir = glm::vec3(r * std::cos(angle), r * std::sin(angle), z);
+    }
+    return rays;
+}
+
+// ParallaxMapping() of texturedShader.frag, or with a fixed layer count for the reference
+static glm::vec2 linearMarch(const std::vector<unsigned char>& depths, int size, const ParallaxRay& ray, int& fetches, float fixedLayers = 0.0f){
+    float numLayers = fixedLayers > 0.0f ? fixedLayers : 64.0f + (8.0f - 64.0f) * std::abs(ray.viewDir.z);
+    float layerDepth = 1.0f / numLayers;
+    float currentLayerDepth = 0.0f;
+    glm::vec2 P = glm::vec2(ray.viewDir) / ray.viewDir.z * heightScale;
+    glm::vec2 deltaTexCoords = P / numLayers;
+    glm::vec2 currentTexCoords = ray.texCoords;
+    float currentDepth = sampleMap(depths, size, 1, 0, currentTexCoords.x, currentTexCoords.y);
+    fetches++;
+    while(currentLayerDepth < currentDepth){
+        currentTexCoords -= deltaTexCoords;
+        currentDepth = sampleMap(depths, size, 1, 0, currentTexCoords.x, currentTexCoords.y);
+        fetches++;
+        currentLayerDepth += layerDepth;
+    }
+    glm::vec2 prevTexCoords = currentTexCoords + deltaTexCoords;
+    float afterDepth = currentDepth - currentLayerDepth;
+    float beforeDepth = sampleMap(depths, size, 1, 0, prevTexCoords.x, prevTexCoords.y) - currentLayerDepth + layerDepth;
+    fetches++;
+    float weight = afterDepth / (afterDepth - beforeDepth);
+    return prevTexCoords * weight + currentTexCoords * (1.0f - weight);
+}
+
+// ConeStepMapping() of texturedShader.frag
+static glm::vec2 coneMarch(const std::vector<unsigned char>& cones, int size, const ParallaxRay& ray, int& fetches){
+    glm::vec2 P = glm::vec2(ray.viewDir) / ray.viewDir.z * heightScale;
+    float rayRatio = glm::length(P);
+    float depth = 0.0f;
+    float previousDepth = 0.0f, previousGap = 1.0f;
+    float gap = 1.0f;
+    for(int i = 0; i <= 24; i++){
+        glm::vec2 texCoords = ray.texCoords - P * depth;
+        float coneDepth = sampleMap(cones, size, 2, 0, texCoords.x, texCoords.y);
+        float root = sampleMap(cones, size, 2, 1, texCoords.x, texCoords.y);
+        fetches++;
+        gap = coneDepth - depth;
+        if(gap < 0.002f || i == 24){
+            break;
+        }
+        previousDepth = depth;
+        previousGap = gap;
+        float ratio = root * root;
+        depth += ratio * gap / (rayRatio + ratio);
+    }
+    if(gap < 0.0f){
+        depth = previousDepth + (depth - previousDepth) * previousGap / (previousGap - gap);
+    } else {
+        depth += gap;
+    }
+    return ray.texCoords - P * depth;
+}
+
+// returns the mean error
+static double marchLabel(BenchState& state, const std::vector<glm::vec2>& results, int fetches, int maxFetches){
+    const std::vector<unsigned char>& depths = depthImage(512);
+    std::vector<ParallaxRay> rays = parallaxRays();
+    double error = 0.0;
+    int unused = 0;
+    for(size_t i = 0; i < rays.size(); i++){
+        glm::vec2 reference = linearMarch(depths, 512, rays[i], unused, 4096.0f);
+        error += glm::length(results[i] - reference) * 512.0f;
+    }
+    char label[96];
+    snprintf(label, sizeof(label), "%.1f fetches/ray (max %d), mean error %.2f texels", (double)fetches / rays.size(), maxFetches, error / rays.size());
+    state.items = rays.size();
+    state.label = label;
+    return error / rays.size();
+}
+
+static bool matchesReference(){
+    const int sizes[3][2] = { {16, 16}, {48, 40}, {64, 64} };
+    for(int s = 0; s < 3; s++){
+        int width = sizes[s][0], height = sizes[s][1];
+        std::vector<unsigned char> rgba;
+        makeTextureImage(std::max(width, height), rgba);
+        std::vector<unsigned char> heights((size_t)width * height * 4);
+        for(int y = 0; y < height; y++){
+            memcpy(&heights[(size_t)y * width * 4], &rgba[(size_t)y * std::max(width, height) * 4], width * 4);
+        }
+        std::vector<unsigned char> cones, reference;
+        ConeStepMap::build(heights.data(), width, height, 4, cones, 2);
+        ConeStepMap::buildReference(heights.data(), width, height, 4, reference);
+        if(cones != reference){
+            return false;
+        }
+    }
+    return true;
+}
+
+BENCHMARK(ConeStepMap_build_512){
+    const std::vector<unsigned char>& depths = depthImage(512);
+    std::vector<unsigned char> cones;
+    while(state.keepRunning()){
+        ConeStepMap::build(depths.data(), 512, 512, 1, cones);
+    }
+    state.items = 512 * 512;
+    if(!matchesReference()){
+        state.fail("pruned build differs from brute force");
+    }
+}
+
+BENCHMARK(ConeStepMap_build_1024){
+    const std::vector<unsigned char>& depths = depthImage(1024);
+    std::vector<unsigned char> cones;
+    while(state.keepRunning()){
+        ConeStepMap::build(depths.data(), 1024, 1024, 1, cones);
+    }
+    state.items = 1024 * 1024;
+}
+
+BENCHMARK(Parallax_linearMarch_512){
+    const std::vector<unsigned char>& depths = depthImage(512);
+    std::vector<ParallaxRay> rays = parallaxRays();
+    std::vector<glm::vec2> results(rays.size());
+    int fetches = 0, maxFetches = 0;
+    while(state.keepRunning()){
+        fetches = maxFetches = 0;
+        for(size_t i = 0; i < rays.size(); i++){
+            int rayFetches = 0;
+            results[i] = linearMarch(depths, 512, rays[i], rayFetches);
+            fetches += rayFetches;
+            maxFetches = std::max(maxFetches, rayFetches);
+        }
+    }
+    marchLabel(state, results, fetches, maxFetches);
+}
+
+BENCHMARK(Parallax_coneStepMarch_512){
+    std::vector<unsigned char> cones;
+    ConeStepMap::build(depthImage(512).data(), 512, 512, 1, cones);
+    std::vector<ParallaxRay> rays = parallaxRays();
+    std::vector<glm::vec2> results(rays.size());
+    int fetches = 0, maxFetches = 0;
+    while(state.keepRunning()){
+        fetches = maxFetches = 0;
+        for(size_t i = 0; i < rays.size(); i++){
+            int rayFetches = 0;
+            results[i] = coneMarch(cones, 512, rays[i], rayFetches);
+            fetches += rayFetches;
+            maxFetches = std::max(maxFetches, rayFetches);
+        }
+    }
+    double error = marchLabel(state, results, fetches, maxFetches);
+
+    const std::vector<unsigned char>& depths = depthImage(512);
+    int linearFetches = 0;
+    double linearError = 0.0;
+    for(size_t i = 0; i < rays.size(); i++){
+        int unused = 0;
+        glm::vec2 reference = linearMarch(depths, 512, rays[i], unused, 4096.0f);
+        linearError += glm::length(linearMarch(depths, 512, rays[i], linearFetches) - reference) * 512.0f;
+    }
+    linearError /= rays.size();
+    if(fetches > 0.6 * linearFetches){
+        state.fail("cone step march takes " + std::to_string(fetches) + " fetches to the linear march's " + std::to_string(linearFetches));
+    }
+    if(error > linearError){
+        state.fail("cone step march less accurate than the linear march");
+    }
+}
@@ -0,0 +1,246 @@
+#include "bench.h"
+#include "fixtures.h"
+#include "../src/resourceManager.h"
+#include "../src/utils/vertexBVH.h"
+#include "../src/utils/raycast.h"
+
+// Vertex picking and ray casting against a 257^2 vertex grid (131k
+// triangles), each compared with the brute force loop it replaced. The refits
+// follow the grid through a blendshape-sized deformation and must hit what a
+// tree built from scratch on the deformed grid hits.
+
+static const int gridSize = 256;
+
+struct PickingFixture {
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> indices;
+    VertexBVH vertices;
+    TriangleBVH triangles;
+    std::vector<Ray> rays;
+
+    PickingFixture(){
+        makeGridMesh(gridSize, positions, indices);
+        vertices.build(positions);
+        triangles.build(positions, indices);
+
+        // rays from above aimed at random points on the grid, like mouse picks
+        BenchRandom random(11);
+        for(int i = 0; i < 1024; i++){
+            glm::vec3 target(random.uniform(-5.0f, 5.0f), 0.0f, random.uniform(-5.0f, 5.0f));
+            glm::vec3 origin = target + glm::vec3(random.uniform(-2.0f, 2.0f), 8.0f, random.uniform(-2.0f, 2.0f));
+            rays.push_back(Ray(origin, glm::normalize(target - origin)));
+        }
+    }
+};
+
+static const PickingFixture& picking(){
+    static PickingFixture* fixture = new PickingFixture();
+    return *fixture;
+}
+
+BENCHMARK(VertexBVH_build){
+    const PickingFixture& fixture = picking();
+    while(state.keepRunning()){
+        VertexBVH bvh(fixture.positions);
+        doNotOptimize(bvh.size());
+    }
+    state.items = fixture.positions.size();
+}
+
+BENCHMARK(VertexBVH_nearestToRay){
+    const PickingFixture& fixture = picking();
+    int i = 0;
+    while(state.keepRunning()){
+        const Ray& ray = fixture.rays[i++ & 1023];
+        doNotOptimize(fixture.vertices.nearestToRay(ray.origin, ray.direction, 1.0f));
+    }
+    state.items = 1;
+    state.label = "picks/s";
+}
+
+BENCHMARK(VertexBVH_nearestToRay_bruteForce){
+    const PickingFixture& fixture = picking();
+    int i = 0;
+    while(state.keepRunning()){
+        const Ray& ray = fixture.rays[i++ & 1023];
+        float best = 1.0f;
+        int bestIndex = -1;
+        for(int v = 0; v < fixture.positions.size(); v++){
+            glm::vec3 d = fixture.positions[v] - ray.origin;
+            float t = std::max(0.0f, glm::dot(d, ray.direction));
+            float distance = glm::length(d - ray.direction * t);
+            if(distance < best){
+                best = distance;
+                bestIndex = v;
+            }
+        }
+        doNotOptimize(bestIndex);
+    }
+    state.items = 1;
+    state.label = "picks/s";
+}
+
+BENCHMARK(VertexBVH_nearestToPoints_1024){
+    const PickingFixture& fixture = picking();
+    std::vector<glm::vec3> points;
+    for(int i = 0; i < fixture.rays.size(); i++){
+        points.push_back(fixture.rays[i].at(8.0f));
+    }
+    std::vector<int> results;
+    while(state.keepRunning()){
+        fixture.vertices.nearestToPoints(points, 1.0f, results);
+    }
+    doNotOptimize(results[0]);
+    state.items = points.size();
+}
+
+BENCHMARK(TriangleBVH_build){
+    const PickingFixture& fixture = picking();
+    while(state.keepRunning()){
+        TriangleBVH bvh(fixture.positions, fixture.indices);
+        doNotOptimize(bvh.getTriangleCount());
+    }
+    state.items = fixture.indices.size() / 3;
+}
+
+BENCHMARK(TriangleBVH_intersect){
+    const PickingFixture& fixture = picking();
+    int i = 0;
+    while(state.keepRunning()){
+        RayHit hit;
+        doNotOptimize(fixture.triangles.intersect(fixture.rays[i++ & 1023], hit));
+    }
+    state.items = 1;
+    state.label = "rays/s";
+}
+
+// bumps of up to 0.3 across the grid, about what a face's blendshapes move
+static void deformGrid(const std::vector<glm::vec3>& positions, float phase, std::vector<glm::vec3>& deformed){
+    deformed.resize(positions.size());
+    for(int i = 0; i < positions.size(); i++){
+        glm::vec3 p = positions[i];
+        deformed[i] = p + glm::vec3(0.0f, 0.3f * std::sin(2.0f * p.x + phase) * std::cos(2.0f * p.z), 0.0f);
+    }
+}
+
+BENCHMARK(TriangleBVH_refit){
+    const PickingFixture& fixture = picking();
+    TriangleBVH bvh(fixture.positions, fixture.indices);
+    std::vector<glm::vec3> deformed[2];
+    deformGrid(fixture.positions, 0.0f, deformed[0]);
+    deformGrid(fixture.positions, 1.0f, deformed[1]);
+    int frame = 0;
+    while(state.keepRunning()){
+        bvh.refit(deformed[frame++ & 1]);
+    }
+    state.items = fixture.indices.size() / 3;
+
+    const std::vector<glm::vec3>& last = deformed[(frame - 1) & 1];
+    TriangleBVH rebuilt(last, fixture.indices);
+    int mismatches = 0;
+    for(int i = 0; i < fixture.rays.size(); i++){
+        RayHit refitHit, rebuiltHit;
+        bool refitFound = bvh.intersect(fixture.rays[i], refitHit);
+        bool rebuiltFound = rebuilt.intersect(fixture.rays[i], rebuiltHit);
+        if(refitFound != rebuiltFound || std::fabs(refitHit.distance - rebuiltHit.distance) > 1e-4f){
+            mismatches++;
+        }
+    }
+    if(mismatches > 0){
+        state.fail(std::to_string(mismatches) + " of 1024 rays hit the refit tree elsewhere than a rebuilt one");
+    }
+}
+
+BENCHMARK(TriangleBVH_intersect_refit){
+    const PickingFixture& fixture = picking();
+    std::vector<glm::vec3> deformed;
+    deformGrid(fixture.positions, 1.0f, deformed);
+    TriangleBVH bvh(fixture.positions, fixture.indices);
+    bvh.refit(deformed);
+    int i = 0;
+    while(state.keepRunning()){
+        RayHit hit;
+        doNotOptimize(bvh.intersect(fixture.rays[i++ & 1023], hit));
+    }
+    state.items = 1;
+    state.label = "rays/s";
+}
+
+BENCHMARK(VertexBVH_refit){
+    const PickingFixture& fixture = picking();
+    VertexBVH bvh(fixture.positions);
+    std::vector<glm::vec3> deformed[2];
+    deformGrid(fixture.positions, 0.0f, deformed[0]);
+    deformGrid(fixture.positions, 1.0f, deformed[1]);
+    int frame = 0;
+    while(state.keepRunning()){
+        bvh.refit(deformed[frame++ & 1]);
+    }
+    state.items = fixture.positions.size();
+
+    VertexBVH rebuilt(deformed[(frame - 1) & 1]);
+    int mismatches = 0;
+    for(int i = 0; i < fixture.rays.size(); i++){
+        const Ray& ray = fixture.rays[i];
+        if(bvh.nearestToRay(ray.origin, ray.direction, 1.0f) != rebuilt.nearestToRay(ray.origin, ray.direction, 1.0f)){
+            mismatches++;
+        }
+    }
+    if(mismatches > 0){
+        state.fail(std::to_string(mismatches) + " of 1024 picks differ between the refit tree and a rebuilt one");
+    }
+}
+
+BENCHMARK(SceneBVH_intersect_batch1024_16objects){
+    const PickingFixture& fixture = picking();
+    SceneBVH scene;
+    for(int i = 0; i < 16; i++){
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3((i % 4) * 12.0f - 18.0f, 0.0f, (i / 4) * 12.0f - 18.0f));
+        scene.add(&fixture.triangles, transform, i);
+    }
+    scene.build();
+    std::vector<RayHit> hits;
+    while(state.keepRunning()){
+        scene.intersect(fixture.rays, hits);
+    }
+    doNotOptimize(hits[0].distance);
+    state.items = fixture.rays.size();
+    state.label = "rays/s";
+}
+
+// ResourceManager's picking entry points, which walk every pickable object
+static void addPickableObjects(int count){
+    static int added = 0;
+    const PickingFixture& fixture = picking();
+    for(; added < count; added++){
+        GameObject* object = ResourceManager::loadGameObject();
+        object->setPosition(glm::vec3((added % 4) * 12.0f - 18.0f, 0.0f, (added / 4) * 12.0f - 18.0f));
+        ResourceManager::addGeometryInfo(object, fixture.positions, fixture.indices);
+    }
+}
+
+BENCHMARK(ResourceManager_checkRayVertexPick_16objects){
+    addPickableObjects(16);
+    const PickingFixture& fixture = picking();
+    int i = 0;
+    while(state.keepRunning()){
+        const Ray& ray = fixture.rays[i++ & 1023];
+        glm::vec3 vertex;
+        int vertexIndex;
+        doNotOptimize(ResourceManager::checkRayVertexPick(ray.origin, ray.direction, 1.0f, 100.0f, vertex, vertexIndex));
+    }
+    state.items = 1;
+    state.label = "picks/s";
+}
+
+BENCHMARK(ResourceManager_raycast_16objects){
+    addPickableObjects(16);
+    const PickingFixture& fixture = picking();
+    int i = 0;
+    while(state.keepRunning()){
+        RayHit hit;
+        doNotOptimize(ResourceManager::raycast(fixture.rays[i++ & 1023], hit));
+    }
+    state.items = 1;
+    state.label = "rays/s";
+}
@@ -0,0 +1,173 @@
+#include "bench.h"
+#include "../src/utils/renderGraph.h"
+#include <string>
+
+// Compiling the frame's render graph, done every frame by ResourceManager.
+// A synthetic frame of 60 passes in 16 chains over full screen transients: every
+// fourth chain feeds nothing and must be culled, and the chains run one after
+// another, so targets of equal format can alias. The order must respect every
+// read after write; labels say how many passes were culled and how many
+// physical targets back the transients. Then the frame ToonShader and
+// GlassShader build, and a cycle compile() must reject.
+
+static const int FRAME_WIDTH = 1920;
+static const int FRAME_HEIGHT = 1080;
+
+// chains of four passes: the first writes a target, the next two read the
+// previous one into their own, the last resolves onto the backbuffer
+static void buildSyntheticFrame(RenderGraph& graph, int chains){
+    static const unsigned int formats[3] = { 0x881A /* RGBA16F */, 0x8058 /* RGBA8 */, 0x8229 /* R8 */ };
+    graph.reset();
+    int backbuffer = graph.importResource("Backbuffer");
+    for(int c = 0; c < chains; c++){
+        bool unused = c % 4 == 3;
+        int previous = -1;
+        for(int p = 0; p < 3; p++){
+            int target = graph.createTarget("Target", RenderTargetDesc(FRAME_WIDTH, FRAME_HEIGHT, formats[(c + p) % 3]));
+            int pass = graph.addPass("Pass");
+            if(previous >= 0){
+                graph.read(pass, previous);
+            }
+            graph.write(pass, target);
+            previous = target;
+        }
+        if(!unused){
+            int pass = graph.addPass("Resolve");
+            graph.read(pass, previous);
+            graph.write(pass, backbuffer);
+        }
+    }
+}
+
+// every read comes after the last write that was added before it
+static bool respectsDependencies(const RenderGraph& graph){
+    std::vector<int> position(graph.getPassCount(), -1);
+    for(int i = 0; i < (int)graph.getOrder().size(); i++){
+        position[graph.getOrder()[i]] = i;
+    }
+    std::vector<int> lastWriter(graph.getResourceCount(), -1);
+    for(int p = 0; p < graph.getPassCount(); p++){
+        if(graph.isCulled(p)){
+            continue;
+        }
+        for(const RenderGraphAccess& access : graph.getAccesses(p)){
+            int writer = lastWriter[access.resource];
+            if(writer >= 0 && writer != p && position[writer] > position[p]){
+                return false;
+            }
+            if(access.write){
+                lastWriter[access.resource] = p;
+            }
+        }
+    }
+    return true;
+}
+
+static std::string check(BenchState& state, const RenderGraph& graph, bool compiled){
+    if(!compiled){
+        state.fail("compile() reported a cycle");
+        return "cycle reported";
+    }
+    if(!respectsDependencies(graph)){
+        state.fail("order breaks a read after write");
+    }
+    int culled = 0;
+    for(int p = 0; p < graph.getPassCount(); p++){
+        culled += graph.isCulled(p);
+    }
+    return std::to_string(culled) + "/" + std::to_string(graph.getPassCount()) + " culled, "
+        + std::to_string(graph.getPhysicalTargets().size()) + " targets for "
+        + std::to_string(graph.getUsedTargetCount()) + " transients";
+}
+
+BENCHMARK(RenderGraph_compile_60passes){
+    RenderGraph graph;
+    buildSyntheticFrame(graph, 16);
+    bool compiled = false;
+    while(state.keepRunning()){
+        compiled = graph.compile();
+    }
+    state.items = graph.getPassCount();
+    state.label = check(state, graph, compiled);
+}
+
+BENCHMARK(RenderGraph_buildAndCompile_60passes){
+    RenderGraph graph;
+    bool compiled = false;
+    while(state.keepRunning()){
+        buildSyntheticFrame(graph, 16);
+        compiled = graph.compile();
+    }
+    state.items = graph.getPassCount();
+    state.label = check(state, graph, compiled);
+}
+
+BENCHMARK(RenderGraph_toonAndGlassFrame){
+    // the passes of a forward frame with screen space toon outlines and
+    // weighted glass; toon normal and the OIT accumulation are both RGBA16F
+    RenderGraph graph;
+    bool compiled = false;
+    bool aliased = false;
+    while(state.keepRunning()){
+        graph.reset();
+        int backbuffer = graph.importResource("Backbuffer");
+        int shadowMap = graph.importResource("Shadow map");
+        int pass = graph.addPass("Shadows");
+        graph.write(pass, shadowMap, USAGE_DEPTH_ATTACHMENT);
+        int color = graph.createTarget("Toon colour", RenderTargetDesc(FRAME_WIDTH, FRAME_HEIGHT, 0x8058));
+        int normal = graph.createTarget("Toon normal", RenderTargetDesc(FRAME_WIDTH, FRAME_HEIGHT, 0x881A));
+        int depth = graph.createTarget("Toon depth", RenderTargetDesc(FRAME_WIDTH, FRAME_HEIGHT, 0x81A6));
+        pass = graph.addPass("Toon");
+        graph.read(pass, shadowMap);
+        graph.write(pass, color);
+        graph.write(pass, normal);
+        graph.write(pass, depth, USAGE_DEPTH_ATTACHMENT);
+        pass = graph.addPass("Screen space outline");
+        graph.read(pass, color);
+        graph.read(pass, normal);
+        graph.read(pass, depth);
+        graph.write(pass, backbuffer);
+        pass = graph.addPass("PBR");
+        graph.read(pass, shadowMap);
+        graph.write(pass, backbuffer);
+        int accumulation = graph.createTarget("OIT accumulation", RenderTargetDesc(FRAME_WIDTH, FRAME_HEIGHT, 0x881A));
+        int revealage = graph.createTarget("OIT revealage", RenderTargetDesc(FRAME_WIDTH, FRAME_HEIGHT, 0x8229));
+        int oitDepth = graph.createTarget("OIT depth", RenderTargetDesc(FRAME_WIDTH, FRAME_HEIGHT, 0x88F0));
+        pass = graph.addPass("Glass weighted");
+        graph.read(pass, backbuffer, USAGE_DEPTH_ATTACHMENT);
+        graph.write(pass, accumulation);
+        graph.write(pass, revealage);
+        graph.write(pass, oitDepth, USAGE_DEPTH_ATTACHMENT);
+        pass = graph.addPass("Glass weighted resolve");
+        graph.read(pass, accumulation);
+        graph.read(pass, revealage);
+        graph.write(pass, backbuffer);
+        compiled = graph.compile();
+        aliased = graph.getPhysical(normal) == graph.getPhysical(accumulation);
+    }
+    state.items = graph.getPassCount();
+    if(!aliased){
+        state.fail("OIT accumulation doesn't reuse toon normal");
+    }
+    state.label = check(state, graph, compiled);
+}
+
+BENCHMARK(RenderGraph_cycle){
+    // two passes ordered both ways, compile() must fail rather than drop one
+    RenderGraph graph;
+    bool compiled = true;
+    while(state.keepRunning()){
+        graph.reset();
+        int backbuffer = graph.importResource("Backbuffer");
+        int first = graph.addPass("First");
+        graph.write(first, backbuffer);
+        int second = graph.addPass("Second");
+        graph.write(second, backbuffer);
+        graph.addDependency(second, first);
+        compiled = graph.compile();
+    }
+    state.items = 2;
+    if(compiled){
+        state.fail("cycle not detected");
+    }
+}
@@ -0,0 +1,116 @@
+#include "bench.h"
+#include "fixtures.h"
+#include "../src/utils/programCache.h"
+#include <cstdio>
+
+// The CPU side of the program binary cache: keying the six tessellation
+// programs rendering2 builds (five stages, about 9 KB of GLSL each) and a
+// write and read of a binary the size drivers return for them. Startup cost
+// is what the key adds to every program, cache hit or not. The key must change
+// with one byte of source, a moved stage and the driver, and the reader must
+// reject other keys and truncated files.
+
+static std::vector<std::string> makeStages(int program){
+    static const int sizes[ProgramCache::stageCount] = { 444, 1467, 1168, 4152, 2139 };
+    BenchRandom random(31 + program);
+    std::vector<std::string> stages(ProgramCache::stageCount);
+    for(int stage = 0; stage < ProgramCache::stageCount; stage++){
+        std::string& source = stages[stage];
+        source = "#version 410 core\n";
+        while((int)source.size() < sizes[stage]){
+            source += "uniform vec4 value" + std::to_string((int)random.uniform(0.0f, 1000.0f)) + ";\n";
+        }
+    }
+    return stages;
+}
+
+static void getPointers(const std::vector<std::string>& stages, const char* sources[ProgramCache::stageCount]){
+    for(int stage = 0; stage < ProgramCache::stageCount; stage++){
+        sources[stage] = stages[stage].c_str();
+    }
+}
+
+BENCHMARK(ShaderCache_key_6tessPrograms){
+    const std::string driver = "Bench Renderer|4.1 Bench";
+    std::vector<std::vector<std::string> > programs;
+    for(int p = 0; p < 6; p++){
+        programs.push_back(makeStages(p));
+    }
+    uint64_t keys = 0;
+    while(state.keepRunning()){
+        for(const std::vector<std::string>& stages : programs){
+            const char* sources[ProgramCache::stageCount];
+            getPointers(stages, sources);
+            keys ^= ProgramCache::getKey(driver, sources);
+        }
+    }
+    doNotOptimize(keys);
+    state.items = 6;
+
+    const char* sources[ProgramCache::stageCount];
+    getPointers(programs[0], sources);
+    uint64_t key = ProgramCache::getKey(driver, sources);
+    std::string edited = programs[0][3];
+    edited[edited.size() / 2] ^= 1;
+    const char* editedSources[ProgramCache::stageCount];
+    getPointers(programs[0], editedSources);
+    editedSources[3] = edited.c_str();
+    // the geometry source moved to the tessellation control stage
+    const char* movedSources[ProgramCache::stageCount] = { sources[0], sources[1], nullptr, sources[2], sources[4] };
+    bool distinct = ProgramCache::getKey(driver, editedSources) != key
+                 && ProgramCache::getKey(driver, movedSources) != key
+                 && ProgramCache::getKey("Bench Renderer|4.6 Bench", sources) != key
+                 && ProgramCache::getKey(driver, sources) == key;
+    if(!distinct){
+        state.fail("key collision");
+    }
+}
+
+BENCHMARK(ShaderCache_writeRead_256KB){
+    std::string directory = benchTempPath("shader_cache");
+    ProgramCache::makeDirectory(directory);
+    std::vector<unsigned char> binary(256 * 1024);
+    BenchRandom random(5);
+    for(size_t i = 0; i < binary.size(); i++){
+        binary[i] = (unsigned char)random.uniform(0.0f, 256.0f);
+    }
+    uint64_t key = 0x1234abcd5678ef90ull;
+    std::string path = ProgramCache::getPath(directory, key);
+    bool roundtrip = true;
+    while(state.keepRunning()){
+        uint32_t format = 0;
+        std::vector<unsigned char> read;
+        roundtrip = ProgramCache::write(path, key, 0x8E21, binary)
+                 && ProgramCache::read(path, key, format, read)
+                 && format == 0x8E21 && read == binary && roundtrip;
+    }
+    state.items = 1;
+
+    uint32_t format;
+    std::vector<unsigned char> read;
+    bool otherKey = ProgramCache::read(path, key + 1, format, read);
+    // cut the binary short, as a full disk would
+    std::vector<unsigned char> bytes(binary.size() / 2);
+    FILE* file = fopen(path.c_str(), "rb");
+    if(file){
+        bytes.resize(fread(bytes.data(), 1, bytes.size(), file));
+        fclose(file);
+    }
+    file = fopen(path.c_str(), "wb");
+    if(file){
+        fwrite(bytes.data(), 1, bytes.size(), file);
+        fclose(file);
+    }
+    bool truncated = ProgramCache::read(path, key, format, read);
+    remove(path.c_str());
+    remove(directory.c_str());
+    if(!roundtrip){
+        state.fail("read doesn't return what was written");
+    }
+    if(otherKey){
+        state.fail("read a binary stored for another key");
+    }
+    if(truncated){
+        state.fail("read a truncated binary");
+    }
+}
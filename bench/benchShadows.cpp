@@ -0,0 +1,116 @@
+#include "bench.h"
+#include "fixtures.h"
+#include "../src/utils/shadowCascades.h"
+
+// Cascade fitting and per cascade caster culling for a 4 cascade, 1024 texel
+// directional light shadow with a 45 degree, 16:9, 0.1-1000 camera, checking
+// what the pass relies on: the cascade projections only move by whole texels
+// while the camera moves, and the culling keeps every caster a brute force
+// test of the box corners against the cascade keeps.
+
+static const int casterCount = 10000;
+static const glm::vec3 sunDirection = glm::normalize(glm::vec3(0.3f, -1.0f, 0.2f));
+
+static glm::mat4 benchCameraView(float offset){
+    glm::vec3 position(offset, 20.0f, 40.0f + offset * 0.5f);
+    return glm::lookAt(position, position + glm::vec3(0.2f, -0.3f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+static void casterBounds(std::vector<glm::vec3>& mins, std::vector<glm::vec3>& maxs){
+    BenchRandom random(31);
+    mins.resize(casterCount);
+    maxs.resize(casterCount);
+    for(int i = 0; i < casterCount; i++){
+        glm::vec3 centre(random.uniform(-500.0f, 500.0f), random.uniform(0.0f, 30.0f), random.uniform(-500.0f, 500.0f));
+        glm::vec3 extent(random.uniform(0.5f, 4.0f), random.uniform(0.5f, 8.0f), random.uniform(0.5f, 4.0f));
+        mins[i] = centre - extent;
+        maxs[i] = centre + extent;
+    }
+}
+
+static void fitCascades(ShadowCascades& cascades, float offset){
+    cascades.fit(benchCameraView(offset), 45.0f, 16.0f / 9.0f, 0.1f, 1000.0f, sunDirection, glm::vec3(-504.0f, -1.0f, -504.0f), glm::vec3(504.0f, 38.0f, 504.0f));
+}
+
+// true when every cascade's light space offset is a whole number of texels
+// away from where it was at offset 0 and its extent did not change
+static bool isTexelStable(){
+    ShadowCascades reference, moved;
+    fitCascades(reference, 0.0f);
+    for(int step = 1; step <= 64; step++){
+        fitCascades(moved, step * 0.013f);
+        for(int c = 0; c < reference.getCascadeCount(); c++){
+            const ShadowCascade& a = reference.getCascade(c);
+            const ShadowCascade& b = moved.getCascade(c);
+            if(a.texelSize != b.texelSize){
+                continue; // the slice sphere grew past a rounding step, a new size is fine
+            }
+            glm::vec2 texels = glm::vec2(b.boxMin - a.boxMin) / a.texelSize;
+            glm::vec2 error = glm::abs(texels - glm::round(texels));
+            if(error.x > 1e-2f || error.y > 1e-2f){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// corners of the box in the cascade's clip space against the unit cube
+static bool bruteForceVisible(const ShadowCascade& cascade, const glm::vec3& min, const glm::vec3& max){
+    glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+    for(int corner = 0; corner < 8; corner++){
+        glm::vec3 p((corner & 1) ? max.x : min.x, (corner & 2) ? max.y : min.y, (corner & 4) ? max.z : min.z);
+        glm::vec3 clip = glm::vec3(cascade.viewProjection * glm::vec4(p, 1.0f));
+        lo = glm::min(lo, clip);
+        hi = glm::max(hi, clip);
+    }
+    return glm::all(glm::lessThanEqual(lo, glm::vec3(1.0f + 1e-4f))) && glm::all(glm::greaterThanEqual(hi, glm::vec3(-1.0f - 1e-4f)));
+}
+
+BENCHMARK(ShadowCascades_fit){
+    ShadowCascades cascades;
+    float offset = 0.0f;
+    while(state.keepRunning()){
+        fitCascades(cascades, offset);
+        offset = offset == 0.0f ? 0.25f : 0.0f;
+    }
+    doNotOptimize(cascades.getCascade(0).viewProjection[0][0]);
+    state.items = cascades.getCascadeCount();
+    if(!isTexelStable()){
+        state.fail("cascades not texel snapped");
+    }
+}
+
+BENCHMARK(ShadowCascades_cullCasters_10k){
+    ShadowCascades cascades;
+    fitCascades(cascades, 0.0f);
+    std::vector<glm::vec3> mins, maxs;
+    casterBounds(mins, maxs);
+    std::vector<std::vector<int> > visible;
+    while(state.keepRunning()){
+        cascades.cullCasters(mins, maxs, visible);
+    }
+    doNotOptimize(visible[0].size());
+    state.items = casterCount;
+
+    // culling may keep a few extra boxes (the light space box of a box is
+    // conservative) but must never drop one the brute force test keeps
+    int drawn = 0;
+    bool conservative = true;
+    for(int c = 0; c < cascades.getCascadeCount(); c++){
+        std::vector<bool> kept(casterCount, false);
+        for(int i : visible[c]){
+            kept[i] = true;
+        }
+        for(int i = 0; i < casterCount; i++){
+            if(bruteForceVisible(cascades.getCascade(c), mins[i], maxs[i]) && !kept[i]){
+                conservative = false;
+            }
+        }
+        drawn += visible[c].size();
+    }
+    if(!conservative){
+        state.fail("culling missed casters the brute force test keeps");
+    }
+    state.label = std::to_string(drawn) + " draws";
+}
@@ -0,0 +1,226 @@
+#include "bench.h"
+#include "fixtures.h"
+#include "../src/model.h"
+#include "../src/IKSolver.h"
+
+// Entity transform propagation, bone palette and IK. Fixtures are built once
+// and shared by every sample. Entities are intentionally leaked: Entity and
+// Bone both delete their children, and ~Entity needs a parent.
+//
+// Skeleton import on Mixamo rigs, with assimp's FBX pivot nodes and with a
+// long tail for depth. There must be exactly one bone per skinned node, each
+// under its nearest skinned ancestor; labels give how many nodes the
+// recursive walk import used before visited (it walked a bone's children
+// twice, doubling with every bone level). findBone is timed on the table
+// against the tree search hand built rigs still use.
+
+static Bone* humanoid(int& boneCount){
+    static int count = 0;
+    static Bone* root = makeSkeleton(8, 4, 14, count);
+    boneCount = count;
+    return root;
+}
+
+BENCHMARK(Entity_setPosition_chain64){
+    static Bone* root = makeBoneChain(64);
+    float x = 0.0f;
+    while(state.keepRunning()){
+        // every call re-derives the world transform of the whole chain
+        root->setPosition(glm::vec3(x, 0.0f, 0.0f));
+        x += 0.001f;
+    }
+    doNotOptimize(root->getTransform());
+    state.items = 64;
+}
+
+BENCHMARK(Entity_setRotation_leaf){
+    static Bone* root = makeBoneChain(64);
+    static Entity* leaf = 0;
+    if(!leaf){
+        leaf = root;
+        while(!leaf->getChildren().empty()){
+            leaf = leaf->getChildren()[0];
+        }
+    }
+    float angle = 0.0f;
+    while(state.keepRunning()){
+        leaf->setRotation(glm::vec3(angle, 0.0f, 0.0f));
+        angle += 0.01f;
+    }
+    doNotOptimize(leaf->getTransform());
+    state.items = 1;
+}
+
+BENCHMARK(Entity_getWorldRotation){
+    static Bone* root = makeBoneChain(8);
+    Entity* entity = root->getChildren()[0];
+    while(state.keepRunning()){
+        doNotOptimize(entity->getWorldRotation());
+    }
+    state.items = 1;
+}
+
+BENCHMARK(Model_getBoneMatrices_humanoid64){
+    int boneCount;
+    Bone* root = humanoid(boneCount);
+    static Model model("humanoid", root, boneCount);
+    while(state.keepRunning()){
+        std::vector<glm::mat4> matrices = model.getBoneMatrices(root);
+        doNotOptimize(matrices[0]);
+    }
+    state.items = boneCount;
+    state.label = std::to_string(boneCount) + " bones";
+}
+
+BENCHMARK(IKSolver_solveIK_chain8_reachable){
+    static Bone* root = makeBoneChain(8);
+    static Entity* goal = new Entity();
+    IKSolver solver(root);
+    float angle = 0.0f;
+    while(state.keepRunning()){
+        // moving target inside the chain's reach, so FABRIK runs every call
+        goal->setPosition(glm::vec3(3.0f * std::cos(angle), 4.0f, 3.0f * std::sin(angle)));
+        solver.solveIK(goal);
+        angle += 0.05f;
+    }
+    doNotOptimize(root->getTransform());
+    state.items = 1;
+}
+
+BENCHMARK(IKSolver_solveIK_chain8_outOfReach){
+    static Bone* root = makeBoneChain(8);
+    static Entity* goal = new Entity();
+    IKSolver solver(root);
+    float angle = 0.0f;
+    while(state.keepRunning()){
+        goal->setPosition(glm::vec3(30.0f * std::cos(angle), 10.0f, 30.0f * std::sin(angle)));
+        solver.solveIK(goal);
+        angle += 0.05f;
+    }
+    doNotOptimize(root->getTransform());
+    state.items = 1;
+}
+
+// nodes the old Model::processSkeleton visited: every child once, then once more below a bone
+static double treeWalkVisits(const BenchRigNode* node, const std::map<std::string, BoneInfo>& bones){
+    double children = 0.0;
+    for(const BenchRigNode* child : node->children){
+        children += treeWalkVisits(child, bones);
+    }
+    return 1.0 + children + (bones.count(node->mName.C_Str()) ? children : 0.0);
+}
+
+// every skinned node has one row, parented to its nearest skinned ancestor
+static bool checkImport(const Skeleton& skeleton, const BenchRigNode* node, const std::map<std::string, BoneInfo>& bones, int parent, int& skinned){
+    std::map<std::string, BoneInfo>::const_iterator info = bones.find(node->mName.C_Str());
+    if(info != bones.end()){
+        skinned++;
+        int index = skeleton.findBone(info->first);
+        if(index < 0 || skeleton.getJoint(index).parent != parent || skeleton.getJoint(index).id != info->second.id){
+            return false;
+        }
+        parent = index;
+    }
+    for(const BenchRigNode* child : node->children){
+        if(!checkImport(skeleton, child, bones, parent, skinned)){
+            return false;
+        }
+    }
+    return true;
+}
+
+static void benchImport(BenchState& state, int tailLength, bool fbxPivots){
+    std::map<std::string, BoneInfo> bones;
+    BenchRigNode* root = makeMixamoRig(tailLength, fbxPivots, bones);
+    Skeleton skeleton;
+    while(state.keepRunning()){
+        skeleton.import(root, bones);
+    }
+    doNotOptimize(skeleton.getJoint(0));
+    state.items = skeleton.getBoneCount();
+
+    int skinned = 0;
+    bool valid = checkImport(skeleton, root, bones, -1, skinned) && skinned == skeleton.getBoneCount();
+    char visits[32];
+    snprintf(visits, sizeof(visits), "%.3g", treeWalkVisits(root, bones));
+    if(!valid){
+        state.fail("bones don't match the skinned nodes");
+    }
+    state.label = std::to_string(skeleton.getBoneCount()) + " bones, tree walk visited " + visits + " nodes";
+}
+
+BENCHMARK(Skeleton_import_mixamo65){
+    benchImport(state, 0, false);
+}
+
+BENCHMARK(Skeleton_import_mixamo65_fbxPivots){
+    benchImport(state, 0, true);
+}
+
+BENCHMARK(Skeleton_import_mixamo65_tail20){
+    benchImport(state, 20, true);
+}
+
+static Bone* mixamoViews(){
+    static std::map<std::string, BoneInfo> bones;
+    static Skeleton skeleton;
+    static Bone* root = 0;
+    if(!root){
+        skeleton.import(makeMixamoRig(0, true, bones), bones);
+        root = Bone::createViews(skeleton);
+    }
+    return root;
+}
+
+static Bone* findInTree(const std::string& name, Bone* bone){
+    if(bone->getName() == name){
+        return bone;
+    }
+    for(Bone* child : bone->getChildren()){
+        Bone* found = findInTree(name, child);
+        if(found){
+            return found;
+        }
+    }
+    return nullptr;
+}
+
+static std::vector<std::string> mixamoNames(){
+    std::vector<std::string> names;
+    const Skeleton& skeleton = *mixamoViews()->getSkeleton();
+    for(int i = 0; i < skeleton.getBoneCount(); i++){
+        names.push_back(skeleton.getName(i));
+    }
+    return names;
+}
+
+BENCHMARK(Model_findBone_mixamo65_table){
+    static Model model("mixamo", mixamoViews(), 65);
+    std::vector<std::string> names = mixamoNames();
+    int found = 0;
+    while(state.keepRunning()){
+        for(const std::string& name : names){
+            found += model.findBone(name) != nullptr;
+        }
+    }
+    doNotOptimize(found);
+    state.items = names.size();
+    Bone* leftArm = model.findBone("mixamorig_LeftArm");
+    bool subtree = leftArm && model.findBone("mixamorig_LeftHandIndex4", leftArm) && !model.findBone("mixamorig_RightHand", leftArm);
+    if(!subtree){
+        state.fail("lookup under LeftArm not limited to its subtree");
+    }
+}
+
+BENCHMARK(Model_findBone_mixamo65_treeSearch){
+    Bone* root = mixamoViews();
+    std::vector<std::string> names = mixamoNames();
+    int found = 0;
+    while(state.keepRunning()){
+        for(const std::string& name : names){
+            found += findInTree(name, root) != nullptr;
+        }
+    }
+    doNotOptimize(found);
+    state.items = names.size();
+}
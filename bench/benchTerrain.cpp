@@ -0,0 +1,197 @@
+#include "bench.h"
+#include "fixtures.h"
+#include "../demos/rendering3/terrain_patch.hpp"
+
+// Heightmap loading and normals, ROAM variance/tessellation on a 1025^2
+// synthetic terrain (the size of the rendering3 heightmap). Normals are also
+// timed on 4097^2 and 16385^2 maps (the latter takes 4.3 GB with its normals,
+// so both only run with --large), and checked against the scalar reference on a non-square map split into
+// bands for four threads.
+
+static const int terrainSize = 1025;
+
+static Heightmap* sharedHeightmap(){
+    static Heightmap* map = makeHeightmap(terrainSize);
+    return map;
+}
+
+// one large map at a time, the previous one is freed when another size is asked for
+static Heightmap* largeHeightmap(int size){
+    static Heightmap* map = 0;
+    if(map && map->width != size){
+        Heightmap_delete(map);
+        map = 0;
+    }
+    if(!map){
+        map = makeHeightmap(size);
+    }
+    return map;
+}
+
+static TerrainPatch* sharedPatch(){
+    static TerrainPatch* patch = 0;
+    if(!patch){
+        BenchQuietStdout quiet;
+        patch = new TerrainPatch(makeHeightmap(terrainSize));
+        patch->computeVariance(14);
+    }
+    return patch;
+}
+
+// tessellate takes the view in normalised patch coordinates (z negated),
+// with the rendering3 default LOD scaling and error margin
+static glm::vec3 centreView(){
+    return glm::vec3(0.5f, 0.0f, -0.5f);
+}
+
+BENCHMARK(Heightmap_read_text_257){
+    static std::string path = writeHeightmapText(257);
+    while(state.keepRunning()){
+        Heightmap* map = Heightmap_read(path.c_str(), false);
+        doNotOptimize(map->map[0]);
+        Heightmap_delete(map);
+    }
+    state.items = 257 * 257;
+}
+
+BENCHMARK(Heightmap_read_image_1025){
+    static std::string path = writeHeightmapImage(terrainSize);
+    BenchQuietStdout quiet;
+    while(state.keepRunning()){
+        Heightmap* map = Heightmap_read(path.c_str(), true);
+        doNotOptimize(map->map[0]);
+        Heightmap_delete(map);
+    }
+    state.items = terrainSize * terrainSize;
+}
+
+BENCHMARK(Heightmap_calculate_normals_1025){
+    Heightmap* map = sharedHeightmap();
+    while(state.keepRunning()){
+        Heightmap_calculate_normals(map);
+    }
+    doNotOptimize(map->normal_map[0]);
+    state.items = terrainSize * terrainSize;
+}
+
+BENCHMARK(Heightmap_calculate_normals_1025_singleThread){
+    Heightmap* map = sharedHeightmap();
+    while(state.keepRunning()){
+        Heightmap_calculate_normals(map, 32.0f, 1);
+    }
+    doNotOptimize(map->normal_map[0]);
+    state.items = terrainSize * terrainSize;
+}
+
+BENCHMARK(Heightmap_calculate_normals_1025_reference){
+    Heightmap* map = sharedHeightmap();
+    while(state.keepRunning()){
+        Heightmap_calculate_normals_reference(map);
+    }
+    doNotOptimize(map->normal_map[0]);
+    state.items = terrainSize * terrainSize;
+}
+
+BENCHMARK(Heightmap_calculate_normals_4097_large){
+    Heightmap* map = largeHeightmap(4097);
+    while(state.keepRunning()){
+        Heightmap_calculate_normals(map);
+    }
+    doNotOptimize(map->normal_map[0]);
+    state.items = 4097.0 * 4097.0;
+}
+
+BENCHMARK(Heightmap_calculate_normals_16385_large){
+    Heightmap* map = largeHeightmap(16385);
+    while(state.keepRunning()){
+        Heightmap_calculate_normals(map);
+    }
+    doNotOptimize(map->normal_map[0]);
+    state.items = 16385.0 * 16385.0;
+}
+
+BENCHMARK(Heightmap_calculate_normals_1021x613_4threads){
+    // odd widths leave a remainder after the four wide loop
+    Heightmap* map = makeHeightmap(1021, 613);
+    while(state.keepRunning()){
+        Heightmap_calculate_normals(map, 32.0f, 4);
+    }
+    state.items = 1021 * 613;
+
+    std::vector<float> normals(map->normal_map, map->normal_map + 3 * 1021 * 613);
+    Heightmap_calculate_normals_reference(map);
+    float error = 0.0f;
+    for(size_t i = 0; i < normals.size(); i++){
+        error = std::max(error, std::fabs(normals[i] - map->normal_map[i]));
+    }
+    Heightmap_delete(map);
+    char label[64];
+    snprintf(label, sizeof(label), "max difference %.2g", error);
+    state.label = label;
+    if(!(error < 1e-5f)){
+        state.fail(std::string("normals differ from the reference, ") + label);
+    }
+}
+
+BENCHMARK(Heightmap_pack_normals_RGB8){
+    Heightmap* map = sharedHeightmap();
+    if(!map->normal_map){
+        Heightmap_calculate_normals(map);
+    }
+    while(state.keepRunning()){
+        unsigned char* packed = Heightmap_pack_normals(map, HEIGHTMAP_NORMALS_RGB8);
+        doNotOptimize(packed[0]);
+        free(packed);
+    }
+    state.items = terrainSize * terrainSize;
+}
+
+BENCHMARK(Heightmap_pack_normals_OCT8){
+    Heightmap* map = sharedHeightmap();
+    if(!map->normal_map){
+        Heightmap_calculate_normals(map);
+    }
+    while(state.keepRunning()){
+        unsigned char* packed = Heightmap_pack_normals(map, HEIGHTMAP_NORMALS_OCT8);
+        doNotOptimize(packed[0]);
+        free(packed);
+    }
+    state.items = terrainSize * terrainSize;
+}
+
+BENCHMARK(TerrainPatch_computeVariance_14){
+    TerrainPatch* patch = sharedPatch();
+    while(state.keepRunning()){
+        patch->computeVariance(14);
+    }
+    state.items = 2 << 14;
+}
+
+BENCHMARK(TerrainPatch_tessellate){
+    TerrainPatch* patch = sharedPatch();
+    glm::vec3 view = centreView();
+    while(state.keepRunning()){
+        patch->reset();
+        patch->tessellate(view, 216.0f, 0.0045f);
+    }
+    state.items = patch->amountOfLeaves();
+    state.label = std::to_string(patch->amountOfLeaves()) + " triangles";
+}
+
+BENCHMARK(TerrainPatch_getTessellation){
+    TerrainPatch* patch = sharedPatch();
+    glm::vec3 view = centreView();
+    patch->reset();
+    patch->tessellate(view, 216.0f, 0.0045f);
+
+    size_t poolSize = patch->poolSize();
+    std::vector<float> vertices(poolSize * 9);
+    std::vector<float> colors(poolSize * 9);
+    std::vector<float> normalTexels(poolSize * 9);
+    while(state.keepRunning()){
+        patch->getTessellation(vertices.data(), colors.data(), normalTexels.data());
+    }
+    doNotOptimize(vertices[0]);
+    state.items = patch->amountOfLeaves();
+    state.label = std::to_string(patch->amountOfLeaves()) + " triangles";
+}
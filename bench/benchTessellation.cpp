@@ -0,0 +1,121 @@
+#include "bench.h"
+#include "fixtures.h"
+#include "../src/utils/tessellationFactors.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <map>
+
+// Adaptive tessellation levels for a 128x128 cell grid (32768 patches) seen
+// from low over one corner with a 45 degree, 16:9, 720p camera, the CPU
+// reference of tessShader.tesc. The label reports the share of patches culled
+// and the mean inner level against the uniform 5 inner / 10 outer of the demo
+// materials. Checked is what the shader relies on: every edge gets the same
+// level from the patches on both sides, and no culled patch had a displaced
+// point inside the frustum.
+
+static void gridPatches(std::vector<glm::vec3>& positions, std::vector<glm::vec3>& normals, std::vector<unsigned int>& indices){
+    makeGridMesh(128, positions, indices);
+    normals.assign(positions.size(), glm::vec3(0.0f));
+    for(size_t i = 0; i < indices.size(); i += 3){
+        glm::vec3 a = positions[indices[i]], b = positions[indices[i + 1]], c = positions[indices[i + 2]];
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        for(int k = 0; k < 3; k++){
+            normals[indices[i + k]] += normal;
+        }
+    }
+    for(glm::vec3& normal : normals){
+        normal = glm::normalize(normal);
+    }
+}
+
+static TessellationSettings gridSettings(){
+    TessellationSettings settings;
+    settings.viewPos = glm::vec3(4.0f, 1.5f, 4.0f);
+    settings.view = glm::lookAt(settings.viewPos, glm::vec3(-1.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    settings.projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    settings.viewportHeight = 720.0f;
+    settings.heightScale = 0.1f;
+    return settings;
+}
+
+// samples of the displaced patch (as the evaluation shader places them) against the clip volume
+static bool bruteForceVisible(const glm::vec3 p[3], const glm::vec3 n[3], const TessellationSettings& settings){
+    glm::mat4 viewProjection = settings.projection * settings.view;
+    const int steps = 8;
+    for(int i = 0; i <= steps; i++){
+        for(int j = 0; i + j <= steps; j++){
+            float u = (float)i / steps, v = (float)j / steps, w = 1.0f - u - v;
+            glm::vec3 position = u * p[0] + v * p[1] + w * p[2];
+            glm::vec3 normal = glm::normalize(u * n[0] + v * n[1] + w * n[2]);
+            for(int h = 0; h <= 1; h++){
+                glm::vec4 clip = viewProjection * glm::vec4(position + normal * (h * settings.heightScale), 1.0f);
+                if(std::abs(clip.x) <= clip.w && std::abs(clip.y) <= clip.w && std::abs(clip.z) <= clip.w){
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+BENCHMARK(TessellationFactors_computePatch_grid128){
+    std::vector<glm::vec3> positions, normals;
+    std::vector<unsigned int> indices;
+    gridPatches(positions, normals, indices);
+    TessellationSettings settings = gridSettings();
+    size_t patchCount = indices.size() / 3;
+    std::vector<PatchLevels> levels(patchCount);
+
+    while(state.keepRunning()){
+        for(size_t i = 0; i < patchCount; i++){
+            glm::vec3 p[3] = { positions[indices[3 * i]], positions[indices[3 * i + 1]], positions[indices[3 * i + 2]] };
+            glm::vec3 n[3] = { normals[indices[3 * i]], normals[indices[3 * i + 1]], normals[indices[3 * i + 2]] };
+            TessellationFactors::computePatch(p, n, settings, levels[i]);
+        }
+    }
+    doNotOptimize(levels.back().inner);
+    state.items = patchCount;
+
+    int culled = 0;
+    float innerSum = 0.0f;
+    bool crackFree = true;
+    bool conservative = true;
+    std::map<std::pair<unsigned int, unsigned int>, float> edgeLevels;
+    for(size_t i = 0; i < patchCount; i++){
+        const unsigned int* patch = &indices[3 * i];
+        glm::vec3 p[3] = { positions[patch[0]], positions[patch[1]], positions[patch[2]] };
+        glm::vec3 n[3] = { normals[patch[0]], normals[patch[1]], normals[patch[2]] };
+        if(levels[i].culled){
+            culled++;
+            // back facing patches may be in view, the check is for the frustum test
+            bool backFacing = true;
+            for(int k = 0; k < 3; k++){
+                backFacing = backFacing && glm::dot(n[k], glm::normalize(p[k] - settings.viewPos)) > settings.backfaceTolerance;
+            }
+            conservative = conservative && (backFacing || !bruteForceVisible(p, n, settings));
+            continue;
+        }
+        innerSum += levels[i].inner;
+        for(int k = 0; k < 3; k++){
+            unsigned int a = patch[(k + 1) % 3], b = patch[(k + 2) % 3];
+            std::pair<unsigned int, unsigned int> edge(std::min(a, b), std::max(a, b));
+            std::map<std::pair<unsigned int, unsigned int>, float>::iterator found = edgeLevels.find(edge);
+            if(found == edgeLevels.end()){
+                edgeLevels[edge] = levels[i].outer[k];
+            }
+            else if(found->second != levels[i].outer[k]){
+                crackFree = false;
+            }
+        }
+    }
+
+    if(!crackFree){
+        state.fail("edges shared by two patches get different levels");
+    }
+    if(!conservative){
+        state.fail("culled visible patches");
+    }
+    char label[160];
+    snprintf(label, sizeof(label), "%.0f%% culled, mean inner %.1f (uniform 5)",
+             100.0 * culled / patchCount, innerSum / std::max<size_t>(1, patchCount - culled));
+    state.label = label;
+}
@@ -0,0 +1,123 @@
+#include "bench.h"
+#include "fixtures.h"
+#include "../src/utils/textureCooker.h"
+#include "../src/utils/stb_image.h"
+
+// The texture cooker: block encoders on a 256x256 image (labels give the
+// PSNR of the decoded result, which must stay above a floor a little under
+// what each encoder reaches), a full
+// 1024x1024 cook with mips, and loading a 1024x1024 texture either by
+// decoding a PNG (what Texture did on every start) or by reading the cooked
+// container.
+
+static const std::vector<unsigned char>& textureImage(int size){
+    static std::vector<unsigned char> images[2];
+    std::vector<unsigned char>& image = images[size > 256];
+    if(image.empty()){
+        makeTextureImage(size, image);
+    }
+    return image;
+}
+
+static const std::vector<unsigned char>& normalMapImage(){
+    static std::vector<unsigned char> image;
+    if(image.empty()){
+        makeNormalMapImage(256, image);
+    }
+    return image;
+}
+
+static void encodeImage(BenchState& state, CookedFormat format, const std::vector<unsigned char>& image, bool isNormalMap, float minPsnr){
+    CookedTexture texture;
+    while(state.keepRunning()){
+        TextureCooker::cook(image.data(), 256, 256, format, isNormalMap, texture, false, 1);
+    }
+    std::vector<unsigned char> decoded;
+    TextureCooker::decode(texture, 0, decoded);
+    float psnr = TextureCooker::psnr(image.data(), decoded.data(), 256 * 256, TextureCooker::getChannelCount(format));
+    char label[64];
+    snprintf(label, sizeof(label), "PSNR %.2f dB", psnr);
+    state.items = 256 * 256;
+    state.label = label;
+    if(!(psnr >= minPsnr)){
+        state.fail(std::string(label) + ", below " + std::to_string((int)minPsnr) + " dB");
+    }
+}
+
+BENCHMARK(TextureCooker_encodeBC1_256){
+    encodeImage(state, COOKED_BC1, textureImage(256), false, 36.0f);
+}
+
+BENCHMARK(TextureCooker_encodeBC3_256){
+    encodeImage(state, COOKED_BC3, textureImage(256), false, 37.0f);
+}
+
+BENCHMARK(TextureCooker_encodeBC5_256_normalMap){
+    encodeImage(state, COOKED_BC5, normalMapImage(), true, 48.0f);
+}
+
+BENCHMARK(TextureCooker_encodeBC7_256){
+    encodeImage(state, COOKED_BC7, textureImage(256), false, 38.0f);
+}
+
+BENCHMARK(TextureCooker_generateMips_1024){
+    const std::vector<unsigned char>& image = textureImage(1024);
+    std::vector<std::vector<unsigned char> > levels;
+    while(state.keepRunning()){
+        TextureCooker::generateMips(image.data(), 1024, 1024, false, levels);
+    }
+    doNotOptimize(levels.back()[0]);
+    state.items = 1024 * 1024;
+}
+
+BENCHMARK(TextureCooker_cookBC1_1024){
+    const std::vector<unsigned char>& image = textureImage(1024);
+    CookedTexture texture;
+    while(state.keepRunning()){
+        TextureCooker::cook(image.data(), 1024, 1024, COOKED_BC1, false, texture);
+    }
+    doNotOptimize(texture.data[0]);
+    state.items = 1024 * 1024;
+}
+
+BENCHMARK(TextureCooker_cookBC1_1024_singleThread){
+    const std::vector<unsigned char>& image = textureImage(1024);
+    CookedTexture texture;
+    while(state.keepRunning()){
+        TextureCooker::cook(image.data(), 1024, 1024, COOKED_BC1, false, texture, true, 1);
+    }
+    doNotOptimize(texture.data[0]);
+    state.items = 1024 * 1024;
+}
+
+// the old load path up to the upload: decode, then mips (glGenerateMipmap's work)
+BENCHMARK(Texture_loadPNG_1024){
+    std::string path = benchTempPath("texture_1024.png");
+    const std::vector<unsigned char>& image = textureImage(1024);
+    stbi_write_png(path.c_str(), 1024, 1024, 4, image.data(), 1024 * 4);
+    std::vector<std::vector<unsigned char> > levels;
+    size_t size = 0;
+    while(state.keepRunning()){
+        int width, height, channels;
+        unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, 4);
+        TextureCooker::generateMips(data, width, height, false, levels);
+        stbi_image_free(data);
+    }
+    for(const std::vector<unsigned char>& level : levels){
+        size += level.size();
+    }
+    state.items = 1024 * 1024;
+    state.label = std::to_string(size / 1024) + " KB in video memory";
+}
+
+BENCHMARK(Texture_loadCookedBC1_1024){
+    std::string path = benchTempPath("texture_1024.gtex");
+    CookedTexture texture;
+    TextureCooker::cook(textureImage(1024).data(), 1024, 1024, COOKED_BC1, false, texture);
+    TextureCooker::write(path, texture);
+    while(state.keepRunning()){
+        doNotOptimize(TextureCooker::read(path, texture));
+    }
+    state.items = 1024 * 1024;
+    state.label = std::to_string(texture.getSize() / 1024) + " KB in video memory";
+}
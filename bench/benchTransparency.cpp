@@ -0,0 +1,87 @@
+#include "bench.h"
+#include "fixtures.h"
+#include "../src/utils/depthSort.h"
+#include <algorithm>
+
+// Back to front ordering of 100k transparent draws, what GlassShader sorts
+// every frame: the radix sort on view depth against std::sort on the same
+// depths. Depths are uniform in the camera's 0.1 to 100 range, and again with
+// only small changes since the last frame (a slow moving camera). The order
+// must match std::stable_sort.
+
+static std::vector<float> makeDepths(size_t count, unsigned int seed){
+    BenchRandom random(seed);
+    std::vector<float> depths(count);
+    for(float& depth : depths){
+        depth = random.uniform(0.1f, 100.0f);
+    }
+    return depths;
+}
+
+static bool matchesReference(const std::vector<float>& depths, const std::vector<uint32_t>& order){
+    std::vector<uint32_t> reference(depths.size());
+    for(size_t i = 0; i < reference.size(); i++){
+        reference[i] = (uint32_t)i;
+    }
+    std::stable_sort(reference.begin(), reference.end(), [&depths](uint32_t a, uint32_t b){ return depths[a] > depths[b]; });
+    return std::equal(reference.begin(), reference.end(), order.begin());
+}
+
+BENCHMARK(Transparency_radixSort_100k){
+    std::vector<float> depths = makeDepths(100000, 71);
+    DepthSort sort;
+    while(state.keepRunning()){
+        sort.sortBackToFront(depths.data(), depths.size());
+    }
+    state.items = depths.size();
+    if(!matchesReference(depths, sort.getOrder())){
+        state.fail("order differs from std::stable_sort");
+    }
+}
+
+BENCHMARK(Transparency_radixSort_100k_coherent){
+    std::vector<float> depths = makeDepths(100000, 71);
+    DepthSort sort;
+    sort.sortBackToFront(depths.data(), depths.size());
+    BenchRandom random(73);
+    while(state.keepRunning()){
+        for(float& depth : depths){
+            depth += random.uniform(-0.01f, 0.01f);
+        }
+        sort.sortBackToFront(depths.data(), depths.size());
+    }
+    state.items = depths.size();
+    if(!matchesReference(depths, sort.getOrder())){
+        state.fail("order differs from std::stable_sort");
+    }
+    state.label = "includes the depth update";
+}
+
+BENCHMARK(Transparency_stdSort_100k){
+    std::vector<float> depths = makeDepths(100000, 71);
+    std::vector<uint32_t> order(depths.size());
+    while(state.keepRunning()){
+        for(size_t i = 0; i < order.size(); i++){
+            order[i] = (uint32_t)i;
+        }
+        std::sort(order.begin(), order.end(), [&depths](uint32_t a, uint32_t b){ return depths[a] > depths[b]; });
+    }
+    doNotOptimize(order[0]);
+    state.items = depths.size();
+}
+
+BENCHMARK(Transparency_depthKeys){
+    // the key mapping orders like the floats, signs and zeros included
+    float values[] = { -1e30f, -100.0f, -1.0f, -1e-30f, -0.0f, 0.0f, 1e-30f, 0.5f, 1.0f, 100.0f, 1e30f };
+    bool ok = true;
+    while(state.keepRunning()){
+        ok = true;
+        for(int i = 1; i < 11; i++){
+            ok = DepthSort::getKey(values[i - 1]) < DepthSort::getKey(values[i]) && ok;
+        }
+    }
+    state.items = 10;
+    if(!ok){
+        state.fail("keys out of order");
+    }
+}
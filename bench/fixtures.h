@@ -0,0 +1,386 @@
+#ifndef BENCH_FIXTURES_H
+#define BENCH_FIXTURES_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <map>
+#include <glm/glm.hpp>
+#include <assimp/types.h>
+#include "../src/bone.h"
+#include "../demos/rendering3/heightmap.h"
+#include "../src/utils/stb_image_write.h"
+
+// Synthetic scene data for the benchmarks, deterministic so results are
+// comparable between commits. Nothing here touches GL or the assets folder.
+
+// deterministic xorshift, the same sequence on every platform
+class BenchRandom {
+public:
+    BenchRandom(unsigned int seed = 1) : state(seed ? seed : 1) {}
+
+    unsigned int next(){
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    // uniform in [min, max)
+    float uniform(float min = 0.0f, float max = 1.0f){
+        return min + (max - min) * (next() & 0xffffff) / 16777216.0f;
+    }
+
+    glm::vec3 vec3(float min = -1.0f, float max = 1.0f){
+        float x = uniform(min, max);
+        float y = uniform(min, max);
+        return glm::vec3(x, y, uniform(min, max));
+    }
+
+private:
+    unsigned int state;
+};
+
+inline std::string benchTempPath(const std::string& name){
+    const char* dir = getenv("TMPDIR");
+#ifdef _WIN32
+    if(!dir) dir = getenv("TEMP");
+    std::string separator = "\\";
+#else
+    std::string separator = "/";
+#endif
+    return std::string(dir ? dir : ".") + separator + "graphics_bench_" + name;
+}
+
+// rolling hills, size x size samples
+inline float benchTerrainHeight(int x, int y, int size){
+    float u = (float)x / size;
+    float v = (float)y / size;
+    return 20.0f * std::sin(u * 6.2831853f * 3.0f) * std::cos(v * 6.2831853f * 2.0f)
+         + 5.0f * std::sin((u + v) * 6.2831853f * 11.0f) + 30.0f;
+}
+
+inline Heightmap* makeHeightmap(int width, int height){
+    Heightmap* map = (Heightmap*)malloc(sizeof(Heightmap));
+    map->width = width;
+    map->height = height;
+    map->normal_map = NULL;
+    map->map = (float*)malloc((size_t)width * height * sizeof(float));
+    map->minZ = 1e30f;
+    map->maxZ = -1e30f;
+    for(int y = 0; y < height; y++){
+        for(int x = 0; x < width; x++){
+            float h = benchTerrainHeight(x, y, width);
+            map->map[(size_t)y * width + x] = h;
+            map->minZ = std::min(map->minZ, h);
+            map->maxZ = std::max(map->maxZ, h);
+        }
+    }
+    return map;
+}
+
+inline Heightmap* makeHeightmap(int size){
+    return makeHeightmap(size, size);
+}
+
+// the text format read by Heightmap_read(filename, false)
+inline std::string writeHeightmapText(int size){
+    std::string path = benchTempPath("heightmap_" + std::to_string(size) + ".txt");
+    FILE* file = fopen(path.c_str(), "w");
+    if(!file){
+        return "";
+    }
+    fprintf(file, "%d %d\n", size, size);
+    for(int y = 0; y < size; y++){
+        for(int x = 0; x < size; x++){
+            fprintf(file, "%.4f ", benchTerrainHeight(x, y, size));
+        }
+        fprintf(file, "\n");
+    }
+    fclose(file);
+    return path;
+}
+
+// 8 bit greyscale png read by Heightmap_read(filename, true)
+inline std::string writeHeightmapImage(int size){
+    std::string path = benchTempPath("heightmap_" + std::to_string(size) + ".png");
+    std::vector<unsigned char> pixels(size * size);
+    for(int y = 0; y < size; y++){
+        for(int x = 0; x < size; x++){
+            pixels[y * size + x] = (unsigned char)std::max(0.0f, std::min(255.0f, benchTerrainHeight(x, y, size) * 4.0f));
+        }
+    }
+    if(!stbi_write_png(path.c_str(), size, size, 1, pixels.data(), size)){
+        return "";
+    }
+    return path;
+}
+
+// a single level chain of boneCount bones (an arm or spine), each one unit above its parent
+inline Bone* makeBoneChain(int boneCount, int firstID = 0){
+    Bone* root = new Bone("bone" + std::to_string(firstID), glm::mat4(1.0f), firstID);
+    Bone* parent = root;
+    for(int i = 1; i < boneCount; i++){
+        Bone* bone = new Bone("bone" + std::to_string(firstID + i), glm::mat4(1.0f), firstID + i);
+        bone->setPosition(glm::vec3(0.0f, 1.0f, 0.0f));
+        parent->addChild(bone);
+        parent = bone;
+    }
+    return root;
+}
+
+// a humanoid-sized tree: a spine with branch chains spread along it
+inline Bone* makeSkeleton(int spineLength, int branches, int branchLength, int& boneCount){
+    Bone* root = makeBoneChain(spineLength, 0);
+    boneCount = spineLength;
+
+    std::vector<Bone*> spine(1, root);
+    while((int)spine.size() < spineLength){
+        spine.push_back(spine.back()->getChildren()[0]);
+    }
+    for(int i = 0; i < branches; i++){
+        Bone* branch = makeBoneChain(branchLength, boneCount);
+        boneCount += branchLength;
+        branch->setPosition(glm::vec3(i % 2 ? 1.0f : -1.0f, 0.0f, 0.0f));
+        branch->setRotation(glm::vec3(0.0f, 0.0f, i % 2 ? -60.0f : 60.0f));
+        spine[(i + 1) * spineLength / (branches + 1)]->addChild(branch);
+    }
+    return root;
+}
+
+// a node of an imported hierarchy, with the aiNode fields Skeleton::import reads
+struct BenchRigNode {
+    aiString mName;
+    aiMatrix4x4 mTransformation;
+    unsigned int mNumChildren = 0;
+    BenchRigNode** mChildren = nullptr;
+    std::vector<BenchRigNode*> children;
+
+    BenchRigNode(const std::string& name, float length) : mName(name) {
+        mTransformation.b4 = length;
+    }
+
+    BenchRigNode* addChild(const std::string& name, float length){
+        children.push_back(new BenchRigNode(name, length));
+        mChildren = children.data();
+        mNumChildren = children.size();
+        return children.back();
+    }
+};
+
+// a skinned bone, under an FBX pivot node when assimp would have made one
+inline BenchRigNode* addRigBone(BenchRigNode* parent, const std::string& name, bool fbxPivots, std::map<std::string, BoneInfo>& bones){
+    if(fbxPivots){
+        parent = parent->addChild(name + "_$AssimpFbx$_Rotation", 0.0f);
+    }
+    BoneInfo info;
+    info.id = bones.size();
+    info.offset = glm::mat4(1.0f);
+    info.offset[3][1] = -(float)info.id;
+    bones[name] = info;
+    return parent->addChild(name, 1.0f);
+}
+
+// the 65 bone Mixamo rig under its scene and armature nodes, hand bones
+// twelve deep, plus a tail of tailLength bones off the hips for deeper rigs.
+// Nodes are leaked like the Bone fixtures.
+inline BenchRigNode* makeMixamoRig(int tailLength, bool fbxPivots, std::map<std::string, BoneInfo>& bones){
+    bones.clear();
+    BenchRigNode* root = new BenchRigNode("RootNode", 0.0f);
+    BenchRigNode* hips = addRigBone(root->addChild("Armature", 0.0f), "mixamorig_Hips", fbxPivots, bones);
+    BenchRigNode* spine = addRigBone(hips, "mixamorig_Spine", fbxPivots, bones);
+    spine = addRigBone(spine, "mixamorig_Spine1", fbxPivots, bones);
+    spine = addRigBone(spine, "mixamorig_Spine2", fbxPivots, bones);
+    BenchRigNode* head = addRigBone(addRigBone(spine, "mixamorig_Neck", fbxPivots, bones), "mixamorig_Head", fbxPivots, bones);
+    addRigBone(head, "mixamorig_HeadTop_End", fbxPivots, bones);
+
+    const char* sides[2] = { "Left", "Right" };
+    const char* fingers[5] = { "Thumb", "Index", "Middle", "Ring", "Pinky" };
+    const char* arm[4] = { "Shoulder", "Arm", "ForeArm", "Hand" };
+    const char* leg[5] = { "UpLeg", "Leg", "Foot", "ToeBase", "Toe_End" };
+    for(int s = 0; s < 2; s++){
+        std::string side = std::string("mixamorig_") + sides[s];
+        BenchRigNode* node = spine;
+        for(int i = 0; i < 4; i++){
+            node = addRigBone(node, side + arm[i], fbxPivots, bones);
+        }
+        for(int f = 0; f < 5; f++){
+            BenchRigNode* finger = node;
+            for(int joint = 1; joint <= 4; joint++){
+                finger = addRigBone(finger, side + "Hand" + fingers[f] + std::to_string(joint), fbxPivots, bones);
+            }
+        }
+        node = hips;
+        for(int i = 0; i < 5; i++){
+            node = addRigBone(node, side + leg[i], fbxPivots, bones);
+        }
+    }
+    BenchRigNode* tail = hips;
+    for(int i = 0; i < tailLength; i++){
+        tail = addRigBone(tail, "mixamorig_Tail" + std::to_string(i), fbxPivots, bones);
+    }
+    return root;
+}
+
+// grid of (size + 1)^2 vertices on the xz plane with a gentle bump, two triangles per cell
+inline void makeGridMesh(int size, std::vector<glm::vec3>& positions, std::vector<unsigned int>& indices){
+    positions.clear();
+    indices.clear();
+    for(int z = 0; z <= size; z++){
+        for(int x = 0; x <= size; x++){
+            float u = (float)x / size - 0.5f;
+            float v = (float)z / size - 0.5f;
+            positions.push_back(glm::vec3(u * 10.0f, std::cos(u * 3.0f) * std::cos(v * 3.0f), v * 10.0f));
+        }
+    }
+    for(int z = 0; z < size; z++){
+        for(int x = 0; x < size; x++){
+            unsigned int i = z * (size + 1) + x;
+            indices.push_back(i);
+            indices.push_back(i + size + 1);
+            indices.push_back(i + 1);
+            indices.push_back(i + 1);
+            indices.push_back(i + size + 1);
+            indices.push_back(i + size + 2);
+        }
+    }
+}
+
+// blendshape targets in the style of a face rig: each shape moves a local
+// patch of about coverage * vertexCount vertices, the rest stay exactly on the base
+inline void makeBlendShapeTargets(const std::vector<glm::vec3>& base, int shapeCount, float coverage, std::vector<std::vector<glm::vec3> >& targets){
+    BenchRandom random(7);
+    targets.assign(shapeCount, base);
+    int vertexCount = base.size();
+    int patch = std::max(1, (int)(vertexCount * coverage));
+    for(int s = 0; s < shapeCount; s++){
+        int first = random.next() % vertexCount;
+        for(int i = 0; i < patch; i++){
+            targets[s][(first + i) % vertexCount] += random.vec3(-0.05f, 0.05f);
+        }
+    }
+}
+
+// text animation in the format parsed by AnimatorParser, one frame of weights per line
+inline std::string writeAnimationText(int frames, int channels){
+    std::string path = benchTempPath("animation_" + std::to_string(frames) + "x" + std::to_string(channels) + ".txt");
+    FILE* file = fopen(path.c_str(), "w");
+    if(!file){
+        return "";
+    }
+    for(int f = 0; f < frames; f++){
+        for(int c = 0; c < channels; c++){
+            fprintf(file, "%.6f ", 0.5f + 0.5f * std::sin(f * 0.05f + c));
+        }
+        fprintf(file, "\n");
+    }
+    fclose(file);
+    return path;
+}
+
+// RGBA8 texture with smooth gradients, some high frequency detail and noise,
+// roughly what a painted albedo map looks like to a block compressor
+inline void makeTextureImage(int size, std::vector<unsigned char>& rgba){
+    BenchRandom random(23);
+    rgba.resize((size_t)size * size * 4);
+    for(int y = 0; y < size; y++){
+        for(int x = 0; x < size; x++){
+            float u = (float)x / size;
+            float v = (float)y / size;
+            unsigned char* p = &rgba[4 * ((size_t)y * size + x)];
+            float detail = std::sin(u * 80.0f) * std::sin(v * 60.0f) > 0.6f ? 40.0f : 0.0f;
+            p[0] = (unsigned char)std::min(255.0f, 120.0f + 90.0f * std::sin(u * 12.0f) * std::cos(v * 7.0f) + detail + random.uniform(0.0f, 12.0f));
+            p[1] = (unsigned char)std::min(255.0f, 60.0f + 150.0f * v + detail * 0.5f + random.uniform(0.0f, 12.0f));
+            p[2] = (unsigned char)std::min(255.0f, 40.0f + 160.0f * u * (1.0f - v) + random.uniform(0.0f, 12.0f));
+            p[3] = (unsigned char)(255.0f * (0.5f + 0.5f * std::sin(u * 9.0f + v * 4.0f)));
+        }
+    }
+}
+
+// tangent space normal map of overlapping bumps, RGBA8 with z in blue
+inline void makeNormalMapImage(int size, std::vector<unsigned char>& rgba){
+    rgba.resize((size_t)size * size * 4);
+    for(int y = 0; y < size; y++){
+        for(int x = 0; x < size; x++){
+            float u = (float)x / size;
+            float v = (float)y / size;
+            glm::vec3 n = glm::normalize(glm::vec3(0.5f * std::sin(u * 40.0f), 0.5f * std::cos(v * 30.0f + u * 5.0f), 1.0f));
+            unsigned char* p = &rgba[4 * ((size_t)y * size + x)];
+            p[0] = (unsigned char)((n.x + 1.0f) * 127.5f);
+            p[1] = (unsigned char)((n.y + 1.0f) * 127.5f);
+            p[2] = (unsigned char)((n.z + 1.0f) * 127.5f);
+            p[3] = 255;
+        }
+    }
+}
+
+// single channel depth map (0 at the top) of bevelled bricks between deep
+// mortar lines with a little noise, tiling like the material height maps
+inline void makeDepthImage(int size, std::vector<unsigned char>& depths){
+    BenchRandom random(41);
+    depths.resize((size_t)size * size);
+    for(int y = 0; y < size; y++){
+        for(int x = 0; x < size; x++){
+            float v = 8.0f * y / size;
+            float u = 4.0f * x / size + ((int)v % 2 ? 0.5f : 0.0f);
+            float fu = u - std::floor(u);
+            float fv = v - std::floor(v);
+            // distance to the mortar in brick widths, rows are half as tall
+            float edge = std::min(std::min(fu, 1.0f - fu), 0.5f * std::min(fv, 1.0f - fv));
+            float bevel = std::min(1.0f, edge / 0.06f);
+            float top = 0.15f + 0.05f * std::sin(6.2831853f * 3.0f * x / size) * std::sin(6.2831853f * 5.0f * y / size);
+            depths[(size_t)y * size + x] = (unsigned char)std::min(255.0f, 255.0f * (1.0f - bevel * (1.0f - top)) + random.uniform(0.0f, 6.0f));
+        }
+    }
+}
+
+// six RGB8 cube faces (+X -X +Y -Y +Z -Z) of an outdoor sky: a blue gradient
+// over a brown ground, a bright soft sun and some cloud noise
+inline void makeSkyFaces(int size, std::vector<unsigned char> faces[6]){
+    BenchRandom random(53);
+    glm::vec3 sun = glm::normalize(glm::vec3(0.4f, 0.6f, -0.7f));
+    for(int face = 0; face < 6; face++){
+        faces[face].resize((size_t)size * size * 3);
+        for(int y = 0; y < size; y++){
+            for(int x = 0; x < size; x++){
+                float sc = 2.0f * (x + 0.5f) / size - 1.0f;
+                float tc = 2.0f * (y + 0.5f) / size - 1.0f;
+                glm::vec3 directions[6] = { glm::vec3(1.0f, -tc, -sc), glm::vec3(-1.0f, -tc, sc), glm::vec3(sc, 1.0f, tc),
+                                            glm::vec3(sc, -1.0f, -tc), glm::vec3(sc, -tc, 1.0f), glm::vec3(-sc, -tc, -1.0f) };
+                glm::vec3 d = glm::normalize(directions[face]);
+                glm::vec3 color = d.y > 0.0f ? glm::mix(glm::vec3(0.75f, 0.85f, 0.95f), glm::vec3(0.25f, 0.45f, 0.85f), d.y)
+                                             : glm::vec3(0.35f, 0.27f, 0.2f) * (1.0f + 0.5f * d.y);
+                color += glm::vec3(1.0f, 0.9f, 0.7f) * std::pow(std::max(glm::dot(d, sun), 0.0f), 200.0f);
+                if(d.y > 0.0f){
+                    color = glm::mix(color, glm::vec3(0.9f), 0.3f * std::max(0.0f, std::sin(d.x * 9.0f) * std::cos(d.z * 7.0f)));
+                }
+                unsigned char* p = &faces[face][3 * ((size_t)y * size + x)];
+                for(int c = 0; c < 3; c++){
+                    p[c] = (unsigned char)std::min(255.0f, 255.0f * std::pow(std::min(color[c], 1.0f), 1.0f / 2.2f) + random.uniform(0.0f, 2.0f));
+                }
+            }
+        }
+    }
+}
+
+// makeSkyFaces written as six JPEG faces, once per size and run
+inline void writeSkyFaces(int size, std::string paths[6]){
+    static std::vector<int> written;
+    for(int face = 0; face < 6; face++){
+        paths[face] = benchTempPath("sky_" + std::to_string(size) + "_" + std::to_string(face) + ".jpg");
+    }
+    if(std::find(written.begin(), written.end(), size) != written.end()){
+        return;
+    }
+    std::vector<unsigned char> faces[6];
+    makeSkyFaces(size, faces);
+    for(int face = 0; face < 6; face++){
+        stbi_write_jpg(paths[face].c_str(), size, size, 3, faces[face].data(), 90);
+    }
+    written.push_back(size);
+}
+
+#endif // BENCH_FIXTURES_H
@@ -0,0 +1,190 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// graphics_bench [--filter substring] [--min-time seconds] [--samples N]
+//                [--json file] [--commit id] [--list] [--large]
+//
+// Every benchmark uses synthetic fixtures, so no assets or GL context are
+// needed. --json writes the results for tracking regressions across commits.
+// The exit status is 1 when a benchmark's check failed (BenchState::fail), so
+// a run with --min-time 0 --samples 1 doubles as a test (ctest runs that).
+// Benchmarks whose names end in _large need gigabytes of memory and only run
+// with --large, which ctest doesn't pass.
+
+struct BenchOptions {
+    std::string filter;
+    std::string jsonPath;
+    std::string commit;
+    double minTime = 0.1;
+    int samples = 5;
+    bool list = false;
+    bool large = false;
+};
+
+static bool isLarge(const std::string& name)
+{
+    const std::string suffix = "_large";
+    return name.size() >= suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static double runOnce(BenchFunction function, BenchState& state)
+{
+    state.reset();
+    function(state);
+    return state.seconds();
+}
+
+static BenchResult runBenchmark(const std::string& name, BenchFunction function, const BenchOptions& options)
+{
+    BenchState state;
+    state.iterations = 1;
+
+    // grow the iteration count until a sample is long enough to time reliably
+    double seconds = runOnce(function, state);
+    while (seconds < options.minTime && state.iterations < (1LL << 40))
+    {
+        double scale = seconds > 0.0 ? options.minTime / seconds * 1.2 : 10.0;
+        state.iterations = std::max(state.iterations + 1, (long long)(state.iterations * std::min(scale, 10.0)));
+        seconds = runOnce(function, state);
+    }
+
+    BenchResult result;
+    result.name = name;
+    result.iterations = state.iterations;
+    for (int i = 0; i < options.samples; i++)
+    {
+        seconds = runOnce(function, state);
+        result.samples.push_back(seconds * 1e9 / state.iterations);
+    }
+    std::vector<double> sorted = result.samples;
+    std::sort(sorted.begin(), sorted.end());
+    result.nsPerIteration = sorted[sorted.size() / 2];
+    result.itemsPerSecond = state.items > 0.0 ? state.items * 1e9 / result.nsPerIteration : 0.0;
+    result.label = state.label;
+    result.failure = state.getFailure();
+    return result;
+}
+
+static std::string escapeJson(const std::string& text)
+{
+    std::string escaped;
+    for (int i = 0; i < text.size(); i++)
+    {
+        if (text[i] == '"' || text[i] == '\\')
+            escaped += '\\';
+        escaped += text[i];
+    }
+    return escaped;
+}
+
+static bool writeJson(const std::string& filename, const std::string& commit, const std::vector<BenchResult>& results)
+{
+    FILE* file = fopen(filename.c_str(), "w");
+    if (!file)
+        return false;
+
+    fprintf(file, "{\n  \"commit\": \"%s\",\n  \"benchmarks\": [\n", escapeJson(commit).c_str());
+    for (int i = 0; i < results.size(); i++)
+    {
+        const BenchResult& result = results[i];
+        fprintf(file, "    {\"name\": \"%s\", \"label\": \"%s\", \"failure\": \"%s\", \"iterations\": %lld, \"ns_per_iteration\": %.3f, \"items_per_second\": %.1f, \"samples_ns\": [",
+                escapeJson(result.name).c_str(), escapeJson(result.label).c_str(), escapeJson(result.failure).c_str(), result.iterations, result.nsPerIteration, result.itemsPerSecond);
+        for (int j = 0; j < result.samples.size(); j++)
+            fprintf(file, "%s%.3f", j ? ", " : "", result.samples[j]);
+        fprintf(file, "]}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+    return true;
+}
+
+static void printTime(double ns)
+{
+    if (ns < 1e3)
+        printf("%10.1f ns", ns);
+    else if (ns < 1e6)
+        printf("%10.2f us", ns / 1e3);
+    else
+        printf("%10.2f ms", ns / 1e6);
+}
+
+int main(int argc, char** argv)
+{
+    BenchOptions options;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--filter" && hasValue)
+            options.filter = argv[++i];
+        else if (arg == "--json" && hasValue)
+            options.jsonPath = argv[++i];
+        else if (arg == "--commit" && hasValue)
+            options.commit = argv[++i];
+        else if (arg == "--min-time" && hasValue)
+            options.minTime = atof(argv[++i]);
+        else if (arg == "--samples" && hasValue)
+            options.samples = std::max(1, atoi(argv[++i]));
+        else if (arg == "--list")
+            options.list = true;
+        else if (arg == "--large")
+            options.large = true;
+        else
+        {
+            std::cerr << "usage: graphics_bench [--filter substring] [--min-time seconds] [--samples N] [--json file] [--commit id] [--list] [--large]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<std::pair<std::string, BenchFunction> > benchmarks = BenchRegistry::get();
+    std::sort(benchmarks.begin(), benchmarks.end());
+
+    std::vector<BenchResult> results;
+    int failures = 0;
+    for (int i = 0; i < benchmarks.size(); i++)
+    {
+        const std::string& name = benchmarks[i].first;
+        if (!options.filter.empty() && name.find(options.filter) == std::string::npos)
+            continue;
+        if (isLarge(name) && !options.large)
+            continue;
+        if (options.list)
+        {
+            printf("%s\n", name.c_str());
+            continue;
+        }
+
+        BenchResult result = runBenchmark(name, benchmarks[i].second, options);
+        printf("%-52s", name.c_str());
+        printTime(result.nsPerIteration);
+        if (result.itemsPerSecond > 0.0)
+            printf("  %12.4g items/s", result.itemsPerSecond);
+        if (!result.label.empty())
+            printf("  %s", result.label.c_str());
+        if (!result.failure.empty())
+        {
+            printf("  FAILED: %s", result.failure.c_str());
+            failures++;
+        }
+        printf("\n");
+        fflush(stdout);
+        results.push_back(result);
+    }
+
+    if (!options.jsonPath.empty() && !writeJson(options.jsonPath, options.commit, results))
+    {
+        std::cerr << "Could not write " << options.jsonPath << std::endl;
+        return 1;
+    }
+    if (failures > 0)
+    {
+        std::cerr << failures << " benchmark check(s) failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -33,7 +33,7 @@ void setUpScene(){
     PointLight* pointLight = ResourceManager::loadPointLight(0.1f, glm::vec3(3.0f, 3.0f, 3.0f), 1.0f, 0.09f, 0.032f);
 
     Shader* shader = new blinnPhongShader(vShaderPath.c_str(), fShaderPath.c_str());
-    Shader* toonShader = new ToonShader(vToonShaderPath.c_str(), fToonShaderPath.c_str());
+    ToonShader* toonShader = new ToonShader(vToonShaderPath.c_str(), fToonShaderPath.c_str());
     Shader* pbrShader = new PBRShader(vPBRShaderPath.c_str(), fPBRShaderPath.c_str());
 
     ResourceManager::addShader(shader);
@@ -136,6 +136,7 @@ void setUpScene(){
     ImGuiWrapper::attachGuiFunction("Phong Shader", [phongMaterial](){phongMaterial->OnGui();});
     ImGuiWrapper::attachGuiFunction("PBR Shader", [pbrMaterial](){pbrMaterial->OnGui();});
     ImGuiWrapper::attachGuiFunction("Toon Shader", [toonMaterial](){toonMaterial->OnGui();});
+    ImGuiWrapper::attachGuiFunction("Screen Space Outlines", [toonShader](){toonShader->getScreenSpaceOutline()->OnGui();});
 }
 
 #endif // RENDERING1_H
\ No newline at end of file
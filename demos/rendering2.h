@@ -28,6 +28,7 @@ void OnGui(){
         skyboxIndex = (skyboxIndex + 1) % skyboxes.size();
         glassShader->setCubeMap(skyboxes[skyboxIndex]);
         skyboxShader->setCubeMap(skyboxes[skyboxIndex]);
+        ResourceManager::setEnvironment(skyboxes[skyboxIndex]);
     }
 }
 
@@ -108,9 +109,19 @@ void setUpScene(){
     glassShader = new GlassShader(vGlassShaderPath.c_str(), fGlassShaderPath.c_str(), skybox);
     skyboxShader = new SkyboxShader(vSkyShaderPath.c_str(), fSkyShaderPath.c_str(), skybox);
 
-    GlassMaterial* glassMaterial = new GlassMaterial(0.66f, 5.0f, 0.02f);
+    GlassMaterial* glassMaterial = new GlassMaterial(0.66f, 5.0f, 0.02f, 0.6f);
+    // the pot composites order independently, the others are depth sorted
+    GlassMaterial* potMaterial = new GlassMaterial(0.66f, 5.0f, 0.02f, 0.6f, TRANSPARENCY_WEIGHTED);
+
+    // lit by the skybox through image based lighting
+    std::string vPBRShaderPath = std::string(SRC_DIR) + "/shaders/forwardPass/cook-torrace/pbrShader.vert";
+    std::string fPBRShaderPath = std::string(SRC_DIR) + "/shaders/forwardPass/cook-torrace/pbrShader.frag";
+    PBRShader* pbrShader = new PBRShader(vPBRShaderPath.c_str(), fPBRShaderPath.c_str());
+    PBRMaterial* pbrMaterial = new PBRMaterial(glm::vec3(0.95f, 0.85f, 0.6f), 1.0f, 0.3f, 1.0f);
+    ResourceManager::setEnvironment(skybox);
 
     ResourceManager::addShader(skyboxShader);
+    ResourceManager::addShader(pbrShader);
     ResourceManager::addShader(glassShader);
 
     Camera* camera = new Camera(glm::vec3(0.0f, 1.0f, 0.0f), Camera_Projection::PERSP, 45.0f, 16.0f / 9.0f, 0.1f, 100.0f);
@@ -130,7 +141,7 @@ void setUpScene(){
     dragonObject->Scale(glm::vec3(0.15f, 0.15f, 0.15f));
 
     GameObject* potObject = ResourceManager::loadGameObject();
-    RenderModule* potRenderModule = new RenderModule(pot, glassMaterial, glassShader);
+    RenderModule* potRenderModule = new RenderModule(pot, potMaterial, glassShader);
     GameplayModule* potGameplayModule = new GameplayModule();
     potObject->addModule(potRenderModule);
     potObject->addModule(potGameplayModule);
@@ -144,11 +155,19 @@ void setUpScene(){
     sphereObject->setPosition(glm::vec3(0.0f, 0.5f, -10.0f));
     sphereObject->Scale(glm::vec3(0.7f, 0.7f, 0.7f));
 
+    GameObject* metalSphereObject = ResourceManager::loadGameObject();
+    RenderModule* metalSphereRenderModule = new RenderModule(sphere, pbrMaterial, pbrShader);
+    metalSphereObject->addModule(metalSphereRenderModule);
+    metalSphereObject->setPosition(glm::vec3(0.0f, 2.5f, -10.0f));
+    metalSphereObject->Scale(glm::vec3(0.7f, 0.7f, 0.7f));
+
     camera->setTarget(sphereObject);
     camera->setMode(Camera_Mode::FREE);
     camera->lookAt(sphereObject->getPosition(), glm::vec3(0.0f, 1.0f, 0.0f));
 
     ImGuiWrapper::attachGuiFunction("Material Properties", [glassMaterial](){glassMaterial->OnGui();});
+    ImGuiWrapper::attachGuiFunction("Pot Material Properties", [potMaterial](){potMaterial->OnGui();});
+    ImGuiWrapper::attachGuiFunction("Metal Properties", [pbrMaterial](){pbrMaterial->OnGui();});
     ImGuiWrapper::attachGuiFunction("Skybox Properties", OnGui);
 
 }
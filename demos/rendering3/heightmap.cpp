@@ -2,6 +2,7 @@
 #include "util.h"
 
 #include "../../src/utils/stb_image.h"
+#include "../../src/utils/profiler.h"
 #include <assert.h>
 #include <errno.h>
 #include <float.h>
@@ -10,6 +11,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
 
 void Heightmap_print(Heightmap *map)
 {
@@ -134,16 +141,19 @@ void Heightmap_normalize(Heightmap *map)
 	map->minZ /= map->maxZ;
 }
 
-void Heightmap_calculate_normals(Heightmap *map)
+// Scalar per-texel Sobel filter. Kept as the reference the row kernel below is
+// validated against.
+void Heightmap_calculate_normals_reference(Heightmap *map, float strength)
 {
 	int x, y;
 
-	map->normal_map = (float*)malloc(3*map->width*map->height*sizeof(float));
+	if (!map->normal_map)
+		map->normal_map = (float*)malloc(3*map->width*map->height*sizeof(float));
 	memset(map->normal_map, 0, 3*map->width*map->height*sizeof(float));
 
 	for (y=0; y<map->height; ++y) {
 		for (x=0; x<map->width; ++x) {
-			int k = 3*(map->height*y + x);
+			int k = 3*(map->width*y + x);
 
 			// corner cases
 			if (x == 0 || x == map->width-1 || y == 0 || y == map->height-1) {
@@ -174,23 +184,173 @@ void Heightmap_calculate_normals(Heightmap *map)
 			float dx = tr + 2 * r + br - tl - 2 * l - bl;
 			float dy = bl + 2 * b + br - tl - 2 * t - tr;
 
-			// trial & error value.
-			float str = 32.0;
-
-			float length = sqrtf(dx*dx + dy*dy + 1.0/str*1.0/str);
+			float length = sqrtf(dx*dx + dy*dy + 1.0/strength*1.0/strength);
 
 			map->normal_map[k+0] = dx / length;
 			map->normal_map[k+1] = dy / length;
-			map->normal_map[k+2] = 1.0 / (str*length);
+			map->normal_map[k+2] = 1.0 / (strength*length);
+		}
+	}
+}
+
+// Sobel filter over one interior row, reading the three source rows directly
+// instead of going through Heightmap_get.
+static void Heightmap_normals_row(const float *up, const float *mid, const float *down,
+                                  float *out, int width, float strength)
+{
+	const float invStr = 1.0f / strength;
+	int x = 1;
+
+	out[0] = 0; out[1] = 0; out[2] = 1.0f;
+
+#if defined(__SSE2__) || defined(_M_X64)
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 inv = _mm_set1_ps(invStr);
+	const __m128 inv2 = _mm_set1_ps(invStr*invStr);
+	float nx[4], ny[4], nz[4];
+
+	for (; x + 4 <= width - 1; x += 4) {
+		__m128 tl = _mm_loadu_ps(up + x - 1);
+		__m128 t  = _mm_loadu_ps(up + x);
+		__m128 tr = _mm_loadu_ps(up + x + 1);
+		__m128 l  = _mm_loadu_ps(mid + x - 1);
+		__m128 r  = _mm_loadu_ps(mid + x + 1);
+		__m128 bl = _mm_loadu_ps(down + x - 1);
+		__m128 b  = _mm_loadu_ps(down + x);
+		__m128 br = _mm_loadu_ps(down + x + 1);
+
+		// summed in the reference's order, the differences cancel to the same bits
+		__m128 dx = _mm_add_ps(_mm_mul_ps(two, r), tr);
+		dx = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(_mm_add_ps(dx, br), tl), _mm_mul_ps(two, l)), bl);
+		__m128 dy = _mm_add_ps(_mm_mul_ps(two, b), bl);
+		dy = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(_mm_add_ps(dy, br), tl), _mm_mul_ps(two, t)), tr);
+
+		__m128 len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), inv2);
+		__m128 invLen = _mm_div_ps(one, _mm_sqrt_ps(len2));
+
+		_mm_storeu_ps(nx, _mm_mul_ps(dx, invLen));
+		_mm_storeu_ps(ny, _mm_mul_ps(dy, invLen));
+		_mm_storeu_ps(nz, _mm_mul_ps(inv, invLen));
+
+		float *o = out + 3*x;
+		o[0] = nx[0]; o[1]  = ny[0]; o[2]  = nz[0];
+		o[3] = nx[1]; o[4]  = ny[1]; o[5]  = nz[1];
+		o[6] = nx[2]; o[7]  = ny[2]; o[8]  = nz[2];
+		o[9] = nx[3]; o[10] = ny[3]; o[11] = nz[3];
+	}
+#endif
+
+	// remainder (and the whole row on targets without SSE, where this loop
+	// is simple enough for the compiler to vectorise)
+	for (; x < width - 1; ++x) {
+		float dx = up[x+1] + 2 * mid[x+1] + down[x+1] - up[x-1] - 2 * mid[x-1] - down[x-1];
+		float dy = down[x-1] + 2 * down[x] + down[x+1] - up[x-1] - 2 * up[x] - up[x+1];
+		float invLen = 1.0f / sqrtf(dx*dx + dy*dy + invStr*invStr);
+
+		out[3*x+0] = dx * invLen;
+		out[3*x+1] = dy * invLen;
+		out[3*x+2] = invStr * invLen;
+	}
+
+	if (width > 1) {
+		out[3*(width-1)+0] = 0; out[3*(width-1)+1] = 0; out[3*(width-1)+2] = 1.0f;
+	}
+}
+
+static void Heightmap_normals_band(Heightmap *map, int firstRow, int lastRow, float strength)
+{
+	for (int y = firstRow; y < lastRow; ++y) {
+		float *out = map->normal_map + 3*map->width*y;
+
+		if (y == 0 || y == map->height-1) {
+			for (int x = 0; x < map->width; ++x) {
+				out[3*x+0] = 0; out[3*x+1] = 0; out[3*x+2] = 1.0f;
+			}
+			continue;
+		}
+
+		const float *mid = map->map + map->width*y;
+		Heightmap_normals_row(mid - map->width, mid, mid + map->width, out, map->width, strength);
+	}
+}
+
+void Heightmap_calculate_normals(Heightmap *map, float strength, int numThreads)
+{
+	PROFILE_SCOPE("Heightmap_calculate_normals");
+	if (!map->normal_map)
+		map->normal_map = (float*)malloc(3*map->width*map->height*sizeof(float));
+
+	if (numThreads <= 0)
+		numThreads = (int)std::thread::hardware_concurrency();
+
+	// small maps are not worth the thread start-up cost
+	const int minRowsPerBand = 64;
+	numThreads = MIN(numThreads, map->height / minRowsPerBand);
+
+	if (numThreads <= 1) {
+		Heightmap_normals_band(map, 0, map->height, strength);
+		return;
+	}
+
+	std::vector<std::thread> workers;
+	int rowsPerBand = (map->height + numThreads - 1) / numThreads;
+	for (int i = 0; i < numThreads; ++i) {
+		int firstRow = i * rowsPerBand;
+		int lastRow = MIN(firstRow + rowsPerBand, map->height);
+		if (firstRow >= lastRow)
+			break;
+		workers.push_back(std::thread(Heightmap_normals_band, map, firstRow, lastRow, strength));
+	}
+	for (size_t i = 0; i < workers.size(); ++i)
+		workers[i].join();
+}
+
+static unsigned char Heightmap_unorm8(float v)
+{
+	int q = (int)floorf((v * 0.5f + 0.5f) * 255.0f + 0.5f);
+	return (unsigned char)MAX(0, MIN(255, q));
+}
+
+unsigned char *Heightmap_pack_normals(Heightmap *map, HeightmapNormalFormat format)
+{
+	assert(map->normal_map);
+	const int texels = map->width*map->height;
+	const int stride = format == HEIGHTMAP_NORMALS_OCT8 ? 2 : 3;
+	unsigned char *packed = (unsigned char*)malloc(stride*texels);
+
+	for (int i = 0; i < texels; ++i) {
+		const float *n = map->normal_map + 3*i;
+		unsigned char *p = packed + stride*i;
+
+		if (format == HEIGHTMAP_NORMALS_RGB8) {
+			p[0] = Heightmap_unorm8(n[0]);
+			p[1] = Heightmap_unorm8(n[1]);
+			p[2] = Heightmap_unorm8(n[2]);
+		} else {
+			// project onto the octahedron and fold the lower hemisphere over
+			float invL1 = 1.0f / (fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]));
+			float u = n[0] * invL1;
+			float v = n[1] * invL1;
+			if (n[2] < 0.0f) {
+				float fu = (1.0f - fabsf(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+				float fv = (1.0f - fabsf(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+				u = fu;
+				v = fv;
+			}
+			p[0] = Heightmap_unorm8(u);
+			p[1] = Heightmap_unorm8(v);
 		}
 	}
+
+	return packed;
 }
 
 void Heightmap_get_normal(Heightmap *map, int x, int y, float *nx, float *ny, float *nz)
 {
 	assert(x >= 0 && x < map->width);
-	assert(y >= 0 && x < map->height);
-	int k = 3*(map->height*y + x);
+	assert(y >= 0 && y < map->height);
+	int k = 3*(map->width*y + x);
 	*nx = map->normal_map[k+0];
 	*ny = map->normal_map[k+1];
 	*nz = map->normal_map[k+2];
@@ -198,7 +358,7 @@ void Heightmap_get_normal(Heightmap *map, int x, int y, float *nx, float *ny, fl
 
 float Heightmap_get(Heightmap *map, int x, int y)
 {
-	assert((map->height*y + x) < (map->height*map->width));
-	assert((map->height*y + x) >= 0);
-	return (map->map[map->height*y + x]);
+	assert(x >= 0 && x < map->width);
+	assert(y >= 0 && y < map->height);
+	return (map->map[map->width*y + x]);
 }
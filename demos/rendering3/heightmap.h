@@ -14,11 +14,21 @@ typedef struct
 
 } Heightmap;
 
+// packed normal encodings for uploading the normal map as a smaller GPU texture
+typedef enum
+{
+	HEIGHTMAP_NORMALS_RGB8, // 3 bytes per texel, n*0.5+0.5
+	HEIGHTMAP_NORMALS_OCT8  // 2 bytes per texel, octahedral mapping
+
+} HeightmapNormalFormat;
+
 void Heightmap_print(Heightmap *map);
 Heightmap *Heightmap_read(const char *filename, bool isImage = true);
 void Heightmap_delete(Heightmap *map);
 void Heightmap_normalize(Heightmap *map);
-void Heightmap_calculate_normals(Heightmap *map);
+void Heightmap_calculate_normals(Heightmap *map, float strength = 32.0f, int numThreads = 0);
+void Heightmap_calculate_normals_reference(Heightmap *map, float strength = 32.0f);
+unsigned char *Heightmap_pack_normals(Heightmap *map, HeightmapNormalFormat format);
 void Heightmap_get_normal(Heightmap *map, int x, int y, float *nx, float *ny, float *nz);
 float Heightmap_get(Heightmap *map, int x, int y);
 
@@ -3,6 +3,7 @@
 #include "../../src/shader.h"
 #include "../../src/resourceManager.h"
 #include "../../src/entityModules/renderModule.h"
+#include "../../src/dynamicBuffer.h"
 #include "terrain_patch.hpp"
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
@@ -11,7 +12,7 @@ class RoamShader : public Shader {
 
 public:
     RoamShader(const char* PVS, const char* PFS, TerrainPatch* terrainPatch, float LODScaling = 216.0f, float errorMargin = 0.0045f){
-        this->Compile(this->readShaderSource(PVS), this->readShaderSource(PFS));
+        this->Load(PVS, PFS);
         this->terrainPatch = terrainPatch;
         this->terrainPatch->computeVariance(20);
         this->LODScaling = LODScaling;
@@ -28,20 +29,19 @@ public:
 
         this->SetMatrix4("view", ResourceManager::getActiveCamera()->getViewMatrix());
         this->SetMatrix4("projection", ResourceManager::getActiveCamera()->getProjectionMatrix());
+        this->SetVector3f("viewPos", ResourceManager::getActiveCamera()->getPosition());
 
-        if(pointLightsToRender[0] != nullptr){
-            this->SetVector3f("pointLight.position", pointLightsToRender[0]->getPosition());
-            this->SetVector3f("pointLight.ambient", pointLightsToRender[0]->getAmbient());
-            this->SetVector3f("pointLight.diffuse", pointLightsToRender[0]->getDiffuse());
-            this->SetVector3f("pointLight.specular", pointLightsToRender[0]->getSpecular());
-        }
+        // blinnPhong.frag, point lights come from the light clusters
+        ResourceManager::bindLightClusters(this);
 
-        if(dirLightsToRender[0] != nullptr){
-            this->SetVector3f("dirLight.direction", glm::eulerAngles(dirLightsToRender[0]->getRotation()));
+        this->SetInteger("hasDirLight", !dirLightsToRender.empty());
+        if(!dirLightsToRender.empty()){
+            this->SetVector3f("dirLight.direction", dirLightsToRender[0]->getDirection());
             this->SetVector3f("dirLight.ambient", dirLightsToRender[0]->getAmbient());
             this->SetVector3f("dirLight.diffuse", dirLightsToRender[0]->getDiffuse());
             this->SetVector3f("dirLight.specular", dirLightsToRender[0]->getSpecular());
         }
+        ResourceManager::bindShadows(this);
 
         for(RenderModule* module : objectsToRender){
             this->SetMatrix4("model", module->getParent()->getTransform());
@@ -51,32 +51,20 @@ public:
     }
 
     void initialiseTerrainPatch(){
-        const size_t poolSize = this->terrainPatch->poolSize();
-        this->triPool = new float[poolSize*9];
-        this->colorPool = new float[poolSize*9];
-        this->normalTexelPool = new float[poolSize*9];
-
-        glGenBuffers(3, buffers);
-        glGenVertexArrays(3, arrays);
-
-        glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
-        glBindVertexArray(arrays[0]);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(float)*poolSize*9, NULL, GL_STREAM_DRAW);
-        glBindBuffer(GL_ARRAY_BUFFER, buffers[1]);
-        glBindVertexArray(arrays[1]);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(float)*poolSize*9, NULL, GL_STREAM_DRAW);
-        glBindBuffer(GL_ARRAY_BUFFER, buffers[2]);
-        glBindVertexArray(arrays[2]);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(float)*poolSize*6, NULL, GL_STREAM_DRAW);
-
-        // generate normal texture
-        GLuint normalTexture = 0;
+        // the tessellation is written straight into the shared ring every frame
+        glGenVertexArrays(1, &terrainVAO);
+
+        // generate normal texture, packed to 8 bits per channel (n*0.5+0.5)
         Heightmap *map = this->terrainPatch->getHeightmap();
+        unsigned char* packedNormals = Heightmap_pack_normals(map, HEIGHTMAP_NORMALS_RGB8);
         glGenTextures(1, &normalTexture);
         glBindTexture(GL_TEXTURE_2D, normalTexture);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, map->width, map->height, 0, GL_RGB, GL_FLOAT, map->normal_map);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, map->width, map->height, 0, GL_RGB, GL_UNSIGNED_BYTE, packedNormals);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        free(packedNormals);
 
     }
 
@@ -86,47 +74,44 @@ public:
 
     void drawTerrainPatch(GameObject* self = nullptr){
 
-        if(isWireframe){
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        }
-
-		glLineWidth(2.0);
         this->terrainPatch->reset();
         glm::vec3 referencePosition = target != nullptr ? target->getPosition() : ResourceManager::getActiveCamera()->getPosition();
         this->terrainPatch->tessellate(referencePosition * scaler, LODScaling, errorMargin);
-        this->terrainPatch->getTessellation(triPool, colorPool, normalTexelPool);
 
+        // positions, colours and normal texels one after the other in this frame's allocation
         size_t leaves = this->terrainPatch->amountOfLeaves();
+        DynamicBuffer* ring = DynamicBuffer::shared();
+        RingAllocation allocation = leaves > 0 ? ring->allocate(sizeof(float)*24*leaves) : RingAllocation();
+        if(allocation.data == nullptr){
+            return;
+        }
+        float* vertices = (float*)allocation.data;
+        this->terrainPatch->getTessellation(vertices, vertices + 9*leaves, vertices + 18*leaves);
+        ring->commit(allocation);
+        const char* base = (const char*)allocation.offset;
 
-        // update the buffer data
-		glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
-		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float)*9*leaves, triPool);
-		glBindBuffer(GL_ARRAY_BUFFER, buffers[1]);
-		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float)*9*leaves, colorPool);
-		glBindBuffer(GL_ARRAY_BUFFER, buffers[2]);
-		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float)*6*leaves, normalTexelPool);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+        if(isWireframe){
+            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        }
+		glLineWidth(2.0);
 
         // normal texture
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_2D, normalTexture);
 		this->SetInteger("texture_normal", 0);
 
-		glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+		glBindVertexArray(terrainVAO);
+		glBindBuffer(GL_ARRAY_BUFFER, ring->getBuffer());
 		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-		glBindBuffer(GL_ARRAY_BUFFER, buffers[1]);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, base);
 		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
-		glBindBuffer(GL_ARRAY_BUFFER, buffers[2]);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, base + sizeof(float)*9*leaves);
 		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, 0);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, base + sizeof(float)*18*leaves);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 		glDrawArrays(GL_TRIANGLES, 0, leaves*3);
-
-		glDisableVertexAttribArray(0);
-		glDisableVertexAttribArray(1);
-		glDisableVertexAttribArray(2);
+		glBindVertexArray(0);
 
         if(isWireframe){
             glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
@@ -156,12 +141,8 @@ private:
     TerrainPatch* terrainPatch;
     GameObject* target = nullptr;
     float scaler = 0.001f;
-    GLuint buffers[3];
-    GLuint arrays[3];
+    GLuint terrainVAO;
     GLuint normalTexture;
-    float* triPool;
-    float* colorPool;
-    float* normalTexelPool;
     bool isInitialised = false;
     float LODScaling = 216.0f;
     float errorMargin = 0.0045f;
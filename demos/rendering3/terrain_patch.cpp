@@ -1,5 +1,6 @@
 #include "terrain_patch.hpp"
 #include "util.h"
+#include "../../src/utils/profiler.h"
 
 #include <math.h>
 #include <stdio.h>
@@ -27,9 +28,36 @@ TerrainPatch::TerrainPatch(const char *fn, int offset_x, int offset_y, bool isIm
 		return;
 	}
 
+	initialize();
+	Heightmap_print(m_map);
+}
+
+TerrainPatch::TerrainPatch(Heightmap *map, int offset_x, int offset_y)
+	: m_map(map)
+	, m_worldX(offset_x)
+	, m_worldY(offset_y)
+	, m_leftVariance(NULL)
+	, m_rightVariance(NULL)
+	, m_varianceSize(0)
+	, m_leftRoot(NULL)
+	, m_rightRoot(NULL)
+	, m_leftLeaves(0)
+	, m_rightLeaves(0)
+	, m_triPool(0)
+	, m_poolSize(100000)
+	, m_poolNext(0)
+{
+	if (m_map == NULL) {
+		return;
+	}
+
+	initialize();
+}
+
+void TerrainPatch::initialize()
+{
 	Heightmap_normalize(m_map);
 	Heightmap_calculate_normals(m_map);
-	Heightmap_print(m_map);
 
 	m_triPool = new BTTNode[m_poolSize];
 	memset(m_triPool, 0, sizeof(BTTNode)*m_poolSize);
@@ -58,8 +86,11 @@ void TerrainPatch::print() const
 
 void TerrainPatch::computeVariance(int maxTessellationLevels)
 {
+	PROFILE_SCOPE("TerrainPatch::computeVariance");
 	m_varianceSize = 2<<maxTessellationLevels;
 
+	delete [] m_leftVariance;
+	delete [] m_rightVariance;
 	m_leftVariance  = new float[m_varianceSize];
 	m_rightVariance = new float[m_varianceSize];
 	memset(m_leftVariance,  0, sizeof(float)*m_varianceSize);
@@ -93,6 +124,7 @@ void TerrainPatch::reset()
 
 void TerrainPatch::tessellate(const glm::vec3 &view, float LODScaling,  float errorMargin)
 {
+	PROFILE_SCOPE("TerrainPatch::tessellate");
 	tessellateRecursive(
 		m_leftRoot, view, errorMargin,
 		0,              m_map->height-1,
@@ -144,6 +176,7 @@ void TerrainPatch::tessellateRecursive(
 
 void TerrainPatch::getTessellation(float *vertices, float *colors, float *normalTexels)
 {
+	PROFILE_SCOPE("TerrainPatch::getTessellation");
 	int idx = 0;
 	getTessellationRecursive(
 		m_leftRoot, m_map, vertices, colors, normalTexels, &idx,
@@ -37,6 +37,8 @@ private:
 public:
 
 	TerrainPatch(const char *fn, int offset_x = 0, int offset_y = 0, bool isImage = true);
+	// takes ownership of map, which is normalized and gets normals computed
+	TerrainPatch(Heightmap *map, int offset_x = 0, int offset_y = 0);
 	~TerrainPatch();
 
 	void print() const;
@@ -57,6 +59,8 @@ public:
 
 private:
 
+	void initialize();
+
 	BTTNode *allocateNode();
 
 	void split(BTTNode *node);
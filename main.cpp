@@ -4,8 +4,18 @@
 #include <glm/glm.hpp>
 #include "src/resourceManager.h"
 #include <string>
-#include "demos/rendering3/rendering3.h"
+// the demo scene is picked at configure time, see DEMO_HEADER in CMakeLists.txt
+#ifndef DEMO_HEADER
+#define DEMO_HEADER "demos/rendering3/rendering3.h"
+#endif
+#include DEMO_HEADER
 #include "src/imgui/imguiWrapper.h"
+#include "src/utils/headless.h"
+#include "src/utils/offscreenContext.h"
+#include "src/utils/profiler.h"
+#include "src/utils/frameCapture.h"
+#include "src/shaderManager.h"
+#include "src/shaders/deferred/deferredRenderer.h"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -23,30 +33,108 @@ void clearCommandLine() {
 
 
 
-int main() {
+int main(int argc, char** argv) {
+
+    HeadlessOptions headless;
+    if (!HeadlessOptions::parse(argc, argv, headless)) {
+        return 1;
+    }
 
-    GLFWwindow* window = ResourceManager::createWindow(1920, 1080);
+    HeadlessRunner runner(headless);
+    // EGL and OSMesa runs have no window, GLFW and ImGui are never initialized
+    bool offscreen = headless.enabled && headless.context != HEADLESS_NATIVE;
+    OffscreenContext context;
+    GLFWwindow* window = nullptr;
+    if (offscreen) {
+        if (!OffscreenContext::isSupported(headless.context)) {
+            std::cerr << "This build has no " << (headless.context == HEADLESS_EGL ? "EGL" : "OSMesa") << " support, use --gl native" << std::endl;
+            return 1;
+        }
+        if (!context.create(headless.context, headless.width, headless.height))
+            return 1;
+        ResourceManager::setBackBuffer(context.getFramebuffer(), headless.width, headless.height);
+    } else {
+        window = headless.enabled
+            ? ResourceManager::createWindow(headless.width, headless.height, "Graphics", false)
+            : ResourceManager::createWindow(1920, 1080);
+        if (!window) {
+            if (headless.enabled)
+                std::cerr << "--gl native needs a display for its hidden window, use --gl egl or osmesa on machines without one" << std::endl;
+            return 1;
+        }
+        ImGuiWrapper::init();
+    }
 
-    ImGuiWrapper::init();
+    ImGuiWrapper::attachGuiFunction("Profiler", Profiler::OnGui);
+    ImGuiWrapper::attachGuiFunction("Renderer", [](){
+        bool deferred = ResourceManager::isDeferredEnabled();
+        if (ImGui::Checkbox("Deferred", &deferred))
+            ResourceManager::setDeferredEnabled(deferred);
+        if (deferred && ResourceManager::getDeferredRenderer() != nullptr)
+            ResourceManager::getDeferredRenderer()->OnGui();
+        bool adaptiveTessellation = ResourceManager::isAdaptiveTessellation();
+        if (ImGui::Checkbox("Adaptive tessellation", &adaptiveTessellation))
+            ResourceManager::setAdaptiveTessellation(adaptiveTessellation);
+        bool screenSpaceOutlines = ResourceManager::isScreenSpaceOutlines();
+        if (ImGui::Checkbox("Screen space outlines", &screenSpaceOutlines))
+            ResourceManager::setScreenSpaceOutlines(screenSpaceOutlines);
+        const RenderGraph& graph = ResourceManager::getRenderGraph();
+        if (graph.isCompiled() && ImGui::TreeNode("Render graph")) {
+            ImGui::Text("%d of %d passes, %d targets for %d transients (%.1f MB)",
+                (int)graph.getOrder().size(), graph.getPassCount(),
+                ResourceManager::getRenderGraphExecutor()->getTargetCount(), graph.getUsedTargetCount(),
+                ResourceManager::getRenderGraphExecutor()->getVideoMemory() / (1024.0 * 1024.0));
+            for (int pass : graph.getOrder())
+                ImGui::BulletText("%s", graph.getPassName(pass));
+            ImGui::TreePop();
+        }
+    });
+    ImGuiWrapper::attachGuiFunction("Capture", [](){ ResourceManager::getFrameCapture()->OnGui(); });
+    ImGuiWrapper::attachGuiFunction("Shaders", ShaderManager::OnGui);
+    if (headless.enabled) {
+        ShaderManager::setCacheEnabled(headless.shaderCache);
+        ShaderManager::setHotReload(false);
+    }
     setUpScene();
 
     ResourceManager::initialize();
 
+    if (headless.enabled) {
+        int result = runner.run(window);
+        ResourceManager::releaseFrameCapture();
+        if (offscreen) {
+            context.destroy();
+        } else {
+            ImGuiWrapper::shutdown();
+            glfwTerminate();
+        }
+        return result;
+    }
+
     // Main loop
     while (!glfwWindowShouldClose(window)) {
         //clearCommandLine();
         // Process events
         glfwPollEvents();
+        Profiler::beginFrame();
 
         // Update
         ResourceManager::runGameLoop();
-        ImGuiWrapper::update();
-        ImGuiWrapper::render();
+        {
+            PROFILE_SCOPE("ImGui");
+            ImGuiWrapper::update();
+            ImGuiWrapper::render();
+        }
 
         // Swap buffers
-        glfwSwapBuffers(window);
+        {
+            PROFILE_SCOPE("glfwSwapBuffers");
+            glfwSwapBuffers(window);
+        }
+        Profiler::endFrame();
     }
 
+    ResourceManager::releaseFrameCapture();
     ImGuiWrapper::shutdown();
     // Clean up
     glfwTerminate();
@@ -6,7 +6,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtx/quaternion.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include "Entity.h" // Assuming Entity.h is included in the same directory
+#include "entity.h"
 
 class IKSolver {
 public:
@@ -2,7 +2,11 @@
 #define ANIMATOR_H
 
 #include "resourceManager.h"
+#include "curve.h"
 
+// Moves an entity along a curve through the world positions of its control
+// points. Positions are cached in a Curve<glm::vec3> and only re-read when the
+// control points are edited (addControlPoint, OnGui or markDirty).
 class Animator{
 
 public:
@@ -12,96 +16,53 @@ public:
     }
 
     void update(){
+        if(keyFrames.empty()){
+            return;
+        }
+        refreshCurve();
+
         if(isPlaying){
             float deltaTime = ResourceManager::getDeltaTime();
-            currentFrame += deltaTime * speed;
-
-            if(currentFrame > keyFrames.size() - 1){
-                if(isLoop){
-                    currentFrame = 0;
-                } else{
-                    currentFrame = keyFrames.size() - 1;
+            if(isConstantSpeed){
+                // speed is in world units per second along the curve
+                distance += deltaTime * speed;
+                if(distance > curve.getLength()){
+                    distance = isLoop ? 0.0f : curve.getLength();
                 }
-            }
-
-            if(keyFrames.size() > 1){
-                if(isCubic){
-                    updateCubic(currentFrame);
-                } else{
-                    updateLinear(currentFrame);
+                currentFrame = curve.parameterAtDistance(distance);
+            } else {
+                currentFrame += deltaTime * speed;
+                if(currentFrame > keyFrames.size() - 1){
+                    if(isLoop){
+                        currentFrame = 0;
+                    } else{
+                        currentFrame = keyFrames.size() - 1;
+                    }
                 }
-            } else{
-                target->setPosition(keyFrames[0]->getWorldPosition());
             }
+            target->setPosition(curve.evaluate(currentFrame));
 
         } else{
             if(currentFrame != 0){
                 currentFrame = 0;
+                distance = 0;
                 if(keyFrames.size() > 1){
-                    target->setPosition(keyFrames[0]->getWorldPosition());
+                    target->setPosition(curve.evaluate(0.0f));
                 }
             }
         }
-        
-
-
     }
 
-    void updateLinear(float deltaTime){
-        if(isPlaying){
-            int pointAIndex = (int)currentFrame;
-            int pointBIndex = (int)currentFrame + 1;
-            if(pointBIndex > keyFrames.size() - 1){
-                pointBIndex = 0;
-            }
-            glm::vec3 pointA = keyFrames[pointAIndex]->getWorldPosition();
-            glm::vec3 pointB = keyFrames[pointBIndex]->getWorldPosition();
-            glm::vec3 newPosition = glm::mix(pointA, pointB, currentFrame - int(currentFrame));
-            target->setPosition(newPosition);
-        }
+    // call when control points were moved outside of OnGui
+    void markDirty(){
+        isDirty = true;
     }
 
-    void updateCubic(float deltaTime){
-        if(isPlaying){
-            int pointAIndex = std::max(0, (int)currentFrame - 1);
-            int pointBIndex = (int)currentFrame;
-            int pointCIndex = std::min((int)keyFrames.size() - 1, (int)currentFrame + 1);
-            int pointDIndex = std::min((int)keyFrames.size() - 1, (int)currentFrame + 2);
-
-            glm::vec3 pointA = keyFrames[pointAIndex]->getWorldPosition();
-            glm::vec3 pointB = keyFrames[pointBIndex]->getWorldPosition();
-            glm::vec3 pointC = keyFrames[pointCIndex]->getWorldPosition();
-            glm::vec3 pointD = keyFrames[pointDIndex]->getWorldPosition();
-
-            glm::vec3 newPosition;
-
-            if (keyFrames.size() == 2) {
-                float t = currentFrame - pointAIndex;
-                newPosition = glm::mix(pointA, pointB, t);
-            } else {
-                newPosition = interpolateCubic(pointA, pointB, pointC, pointD, currentFrame - int(currentFrame));
-            }
-
-            target->setPosition(newPosition);
-        }
-        else{
-            currentFrame = 0;
-        }
+    const Curve<glm::vec3>& getCurve(){
+        refreshCurve();
+        return curve;
     }
 
-    glm::vec3 interpolateCubic(glm::vec3 pointA, glm::vec3 pointB, glm::vec3 pointC, glm::vec3 pointD, float time){
-        float t2 = time * time;
-        float t3 = t2 * time;
-
-        glm::vec3 result = 0.5f * ((2.0f * pointB) +
-            (-pointA + pointC) * time +
-            (2.0f * pointA - 5.0f * pointB + 4.0f * pointC - pointD) * t2 +
-            (-pointA + 3.0f * pointB - 3.0f * pointC + pointD) * t3);
-
-        return result;
-    }
-
-
     int getControlPointCount(){
         return keyFrames.size();
     }
@@ -112,6 +73,7 @@ public:
 
     void addControlPoint(Entity* controlPoint){
         keyFrames.push_back(controlPoint);
+        isDirty = true;
     }
 
     void OnGui() {
@@ -130,13 +92,19 @@ public:
             isPlaying = false;
         }
 
-        if(isPlaying){
+        if(isPlaying && !isConstantSpeed){
             ImGui::DragFloat("Current Frame", &currentFrame, 0.1f, 0.0f, keyFrames.size() - 1);
         }
         
 
         ImGui::Checkbox("Loop", &isLoop);
-        ImGui::Checkbox("Cubic", &isCubic);
+        if(ImGui::Checkbox("Cubic", &isCubic)){
+            isDirty = true;
+        }
+        if(ImGui::Checkbox("Constant Speed", &isConstantSpeed)){
+            isDirty = true;
+            distance = 0;
+        }
 
         ImGui::Text("Control Points------------------");
 
@@ -145,6 +113,9 @@ public:
             ImGui::PushID(i); //prevents name collision
             keyFrames[i]->OnGui();
             ImGui::PopID();
+            if(i < curve.getKeyCount() && keyFrames[i]->getWorldPosition() != curve.getKeys()[i]){
+                isDirty = true;
+            }
         }
     }
 
@@ -152,12 +123,32 @@ public:
 private:
     Entity* target;
     std::vector<Entity*> keyFrames;
+    Curve<glm::vec3> curve;
+    bool isDirty = true;
     bool isPlaying = false;
     bool isLoop = true;
     bool isCubic = false;
+    bool isConstantSpeed = false;
     float speed = 1.0f;
     float currentFrame = 0.0f;
-    
+    float distance = 0.0f;
+
+    void refreshCurve(){
+        if(!isDirty){
+            return;
+        }
+        std::vector<glm::vec3> positions(keyFrames.size());
+        for(int i = 0; i < keyFrames.size(); i++){
+            positions[i] = keyFrames[i]->getWorldPosition();
+        }
+        curve.setCubic(isCubic);
+        curve.setKeys(positions);
+        if(isConstantSpeed){
+            curve.buildArcLengthTable();
+            distance = std::min(distance, curve.getLength());
+        }
+        isDirty = false;
+    }
 
 };
 
@@ -177,106 +168,43 @@ public:
     }
 
     void update(){
+        if(curve.getKeyCount() == 0){
+            return;
+        }
         if(isPlaying){
             float deltaTime = ResourceManager::getDeltaTime();
             currentFrame += deltaTime * speed;
 
-            if(currentFrame > keyFrames.size() - 1){
+            if(currentFrame > curve.getKeyCount() - 1){
                 if(isLoop){
                     currentFrame = 0;
                 } else{
-                    currentFrame = keyFrames.size() - 1;
+                    currentFrame = curve.getKeyCount() - 1;
                 }
             }
 
-            if(keyFrames.size() > 1){
-                if(isCubic){
-                    updateCubic(currentFrame);
-                } else{
-                    updateLinear(currentFrame);
-                }
-            } else{
-                *target = keyFrames[0];
-            }
+            *target = curve.evaluate(currentFrame);
 
         } else{
             if(currentFrame != 0){
                 currentFrame = 0;
-                if(keyFrames.size() > 1){
-                    *target = keyFrames[0];
+                if(curve.getKeyCount() > 1){
+                    *target = curve.evaluate(0.0f);
                 }
             }
         }
     }
 
-    void updateLinear(float deltaTime){
-        if(isPlaying){
-            int pointAIndex = (int)currentFrame;
-            int pointBIndex = (int)currentFrame + 1;
-            if(pointBIndex > keyFrames.size() - 1){
-                pointBIndex = 0;
-            }
-            float pointA = keyFrames[pointAIndex];
-            float pointB = keyFrames[pointBIndex];
-            float newPosition = interpolateLinear(pointA, pointB, currentFrame - int(currentFrame));
-            *target = newPosition;
-        }
-    }
-
-    void updateCubic(float deltaTime){
-        if(isPlaying){
-            int pointAIndex = std::max(0, (int)currentFrame - 1);
-            int pointBIndex = (int)currentFrame;
-            int pointCIndex = std::min((int)keyFrames.size() - 1, (int)currentFrame + 1);
-            int pointDIndex = std::min((int)keyFrames.size() - 1, (int)currentFrame + 2);
-
-            float pointA = keyFrames[pointAIndex];
-            float pointB = keyFrames[pointBIndex];
-            float pointC = keyFrames[pointCIndex];
-            float pointD = keyFrames[pointDIndex];
-
-            float newPosition;
-
-            if (keyFrames.size() == 2) {
-                float t = currentFrame - pointAIndex;
-                newPosition = interpolateLinear(pointA, pointB, t);
-            } else {
-                newPosition = interpolateCubic(pointA, pointB, pointC, pointD, currentFrame - int(currentFrame));
-            }
-
-            *target = newPosition;
-        }
-        else{
-            currentFrame = 0;
-        }
-    }
-
-    float interpolateLinear(float pointA, float pointB, float time){
-        return pointA + (pointB - pointA) * time;
-    }
-
-    float interpolateCubic(float pointA, float pointB, float pointC, float pointD, float time){
-        float t2 = time * time;
-        float t3 = t2 * time;
-
-        float result = 0.5f * ((2.0f * pointB) +
-            (-pointA + pointC) * time +
-            (2.0f * pointA - 5.0f * pointB + 4.0f * pointC - pointD) * t2 +
-            (-pointA + 3.0f * pointB - 3.0f * pointC + pointD) * t3);
-
-        return result;
-    }
-
     int getControlPointCount(){
-        return keyFrames.size();
+        return curve.getKeyCount();
     }
 
     float getLastControlPoint(){
-        return keyFrames[keyFrames.size() - 1];
+        return curve.getKeys().back();
     }
 
     void addControlPoint(float controlPoint){
-        keyFrames.push_back(controlPoint);
+        curve.addKey(controlPoint);
     }
 
     void OnGui() {
@@ -296,12 +224,15 @@ public:
         }
 
         if(isPlaying){
-            ImGui::DragFloat("Current Frame", &currentFrame, 0.1f, 0.0f, keyFrames.size() - 1);
+            ImGui::DragFloat("Current Frame", &currentFrame, 0.1f, 0.0f, curve.getKeyCount() - 1);
         }
         
 
         ImGui::Checkbox("Loop", &isLoop);
-        ImGui::Checkbox("Cubic", &isCubic);
+        bool _isCubic = curve.getCubic();
+        if(ImGui::Checkbox("Cubic", &_isCubic)){
+            curve.setCubic(_isCubic);
+        }
 
         ImGui::Text("Control Points------------------");
     }
@@ -315,7 +246,7 @@ public:
     }
 
     void setCubic(bool isCubic){
-        this->isCubic = isCubic;
+        curve.setCubic(isCubic);
     }
 
     void setPlaying(bool isPlaying){
@@ -326,20 +257,23 @@ public:
         this->currentFrame = currentFrame;
     }
 
-    void setKeyFrames(std::vector<float> keyFrames){
-        this->keyFrames = keyFrames;
+    void setKeyFrames(const std::vector<float>& keyFrames){
+        curve.setKeys(keyFrames);
     }
 
     float getCurrentFrame(){
         return currentFrame;
     }
 
+    const Curve<float>& getCurve() const {
+        return curve;
+    }
+
 private:
     float* target;
-    std::vector<float> keyFrames;
+    Curve<float> curve;
     bool isPlaying = false;
     bool isLoop = true;
-    bool isCubic = false;
     float speed = 1.0f;
     float currentFrame = 0.0f;
     
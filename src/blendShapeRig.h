@@ -0,0 +1,277 @@
+#ifndef BLEND_SHAPE_RIG_H
+#define BLEND_SHAPE_RIG_H
+
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BLEND_SHAPE_RIG_SSE
+#endif
+
+// Blendshape storage as sparse per-shape delta lists. Facial targets only move
+// a small part of the mesh, so each shape keeps just the vertices it displaces
+// (sorted by index) and evaluation only walks shapes with a non-zero weight.
+//
+// Output positions are vec4 so one vertex is one SSE register; the same buffer
+// is uploaded as the mesh's dynamic position stream (see Mesh::enableDynamicPositions).
+
+struct SparseDelta {
+    float x, y, z;
+    unsigned int index;
+};
+
+// 16-bit fixed point variant, scaled by BlendShape::scale
+struct QuantizedDelta {
+    short x, y, z;
+    unsigned short pad;
+    unsigned int index;
+};
+
+class BlendShapeRig {
+public:
+    BlendShapeRig(const std::vector<glm::vec3>& basePositions, bool quantize = false){
+        this->basePositions.resize(basePositions.size());
+        for(int i = 0; i < basePositions.size(); i++){
+            this->basePositions[i] = glm::vec4(basePositions[i], 1.0f);
+        }
+        this->quantize = quantize;
+        this->dirtyBegin = 0;
+        this->dirtyEnd = 0;
+    }
+
+    // Adds a target shape given its absolute vertex positions. Deltas with every
+    // component below epsilon are dropped. Returns the shape index.
+    int addShape(const std::vector<glm::vec3>& targetPositions, float epsilon = 1e-6f){
+        BlendShape shape;
+        float maxComponent = 0.0f;
+        int count = std::min(targetPositions.size(), basePositions.size());
+
+        for(int i = 0; i < count; i++){
+            glm::vec3 delta = targetPositions[i] - glm::vec3(basePositions[i]);
+            if(std::fabs(delta.x) <= epsilon && std::fabs(delta.y) <= epsilon && std::fabs(delta.z) <= epsilon){
+                continue;
+            }
+            SparseDelta d = { delta.x, delta.y, delta.z, (unsigned int)i };
+            shape.deltas.push_back(d);
+            maxComponent = std::max(maxComponent, std::max(std::fabs(delta.x), std::max(std::fabs(delta.y), std::fabs(delta.z))));
+        }
+
+        if(quantize && !shape.deltas.empty()){
+            shape.scale = maxComponent > 0.0f ? maxComponent / 32767.0f : 1.0f;
+            float invScale = 1.0f / shape.scale;
+            shape.quantized.resize(shape.deltas.size());
+            for(int i = 0; i < shape.deltas.size(); i++){
+                const SparseDelta& d = shape.deltas[i];
+                QuantizedDelta& q = shape.quantized[i];
+                q.x = (short)std::floor(d.x * invScale + 0.5f);
+                q.y = (short)std::floor(d.y * invScale + 0.5f);
+                q.z = (short)std::floor(d.z * invScale + 0.5f);
+                q.pad = 0;
+                q.index = d.index;
+            }
+            // the float copy is freed, getDelta decodes the quantized deltas
+            std::vector<SparseDelta>().swap(shape.deltas);
+        }
+
+        if(!shape.isEmpty()){
+            unsigned int first = shape.firstIndex();
+            unsigned int last = shape.lastIndex() + 1;
+            if(dirtyBegin == dirtyEnd){
+                dirtyBegin = first;
+                dirtyEnd = last;
+            } else {
+                dirtyBegin = std::min(dirtyBegin, first);
+                dirtyEnd = std::max(dirtyEnd, last);
+            }
+        }
+
+        shapes.push_back(shape);
+        return shapes.size() - 1;
+    }
+
+    int getShapeCount() const {
+        return shapes.size();
+    }
+
+    int getVertexCount() const {
+        return basePositions.size();
+    }
+
+    int getNonZeroCount(int shape) const {
+        return shapes[shape].size();
+    }
+
+    // first vertex and number of vertices any shape can touch; this is the
+    // only range evaluate writes and the only range that needs uploading
+    int getDirtyBegin() const {
+        return dirtyBegin;
+    }
+
+    int getDirtyCount() const {
+        return dirtyEnd - dirtyBegin;
+    }
+
+    const std::vector<glm::vec4>& getBasePositions() const {
+        return basePositions;
+    }
+
+    glm::vec3 getDelta(int shape, int vertexIndex) const {
+        const BlendShape& s = shapes[shape];
+        if(quantize){
+            std::vector<QuantizedDelta>::const_iterator it = std::lower_bound(s.quantized.begin(), s.quantized.end(), (unsigned int)vertexIndex, compareIndex<QuantizedDelta>);
+            if(it == s.quantized.end() || it->index != vertexIndex){
+                return glm::vec3(0.0f);
+            }
+            return glm::vec3(it->x, it->y, it->z) * s.scale;
+        }
+        std::vector<SparseDelta>::const_iterator it = std::lower_bound(s.deltas.begin(), s.deltas.end(), (unsigned int)vertexIndex, compareIndex<SparseDelta>);
+        if(it == s.deltas.end() || it->index != vertexIndex){
+            return glm::vec3(0.0f);
+        }
+        return glm::vec3(it->x, it->y, it->z);
+    }
+
+    // Writes base + sum(weights[i] * delta[i]) into positions over the dirty
+    // range. positions must hold getVertexCount() entries and already contain
+    // the base pose outside the dirty range (see initialisePositions). Only
+    // reads rig state, so it is safe to call concurrently for different outputs.
+    void evaluate(const float* weights, glm::vec4* positions) const {
+        std::copy(basePositions.begin() + dirtyBegin, basePositions.begin() + dirtyEnd, positions + dirtyBegin);
+
+        for(int i = 0; i < shapes.size(); i++){
+            float w = weights[i];
+            if(w == 0.0f || shapes[i].isEmpty()){
+                continue;
+            }
+            if(quantize){
+                accumulateQuantized(shapes[i], w, positions);
+            } else {
+                accumulate(shapes[i], w, positions);
+            }
+        }
+    }
+
+    void initialisePositions(std::vector<glm::vec4>& positions) const {
+        positions = basePositions;
+    }
+
+    // Evaluates many instances of the same rig, splitting them across threads.
+    // weights[i] holds getShapeCount() floats for instance i.
+    void evaluateBatch(const std::vector<const float*>& weights, const std::vector<glm::vec4*>& positions, int numThreads = 0) const {
+        int count = std::min(weights.size(), positions.size());
+        if(numThreads <= 0){
+            numThreads = std::thread::hardware_concurrency();
+        }
+        numThreads = std::max(1, std::min(numThreads, count));
+
+        if(numThreads == 1){
+            evaluateRange(weights, positions, 0, count);
+            return;
+        }
+
+        std::vector<std::thread> workers;
+        int perThread = (count + numThreads - 1) / numThreads;
+        for(int i = 0; i < numThreads; i++){
+            int first = i * perThread;
+            int last = std::min(first + perThread, count);
+            if(first >= last){
+                break;
+            }
+            workers.push_back(std::thread(&BlendShapeRig::evaluateRange, this, std::cref(weights), std::cref(positions), first, last));
+        }
+        for(int i = 0; i < workers.size(); i++){
+            workers[i].join();
+        }
+    }
+
+private:
+    struct BlendShape {
+        std::vector<SparseDelta> deltas;
+        std::vector<QuantizedDelta> quantized;
+        float scale = 1.0f;
+
+        bool isEmpty() const {
+            return deltas.empty() && quantized.empty();
+        }
+        int size() const {
+            return deltas.empty() ? quantized.size() : deltas.size();
+        }
+        unsigned int firstIndex() const {
+            return deltas.empty() ? quantized.front().index : deltas.front().index;
+        }
+        unsigned int lastIndex() const {
+            return deltas.empty() ? quantized.back().index : deltas.back().index;
+        }
+    };
+
+    std::vector<glm::vec4> basePositions;
+    std::vector<BlendShape> shapes;
+    bool quantize;
+    unsigned int dirtyBegin;
+    unsigned int dirtyEnd;
+
+    template<typename T>
+    static bool compareIndex(const T& delta, unsigned int index){
+        return delta.index < index;
+    }
+
+    void evaluateRange(const std::vector<const float*>& weights, const std::vector<glm::vec4*>& positions, int first, int last) const {
+        for(int i = first; i < last; i++){
+            evaluate(weights[i], positions[i]);
+        }
+    }
+
+    static void accumulate(const BlendShape& shape, float weight, glm::vec4* positions){
+        const SparseDelta* d = &shape.deltas[0];
+        int count = shape.deltas.size();
+        float* out = &positions[0].x;
+#ifdef BLEND_SHAPE_RIG_SSE
+        // the fourth lane of a SparseDelta is the index, so mask it off before the multiply-add
+        const __m128 w = _mm_set1_ps(weight);
+        const __m128 xyzMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+        for(int i = 0; i < count; i++){
+            float* p = out + 4 * d[i].index;
+            __m128 delta = _mm_and_ps(_mm_loadu_ps(&d[i].x), xyzMask);
+            _mm_storeu_ps(p, _mm_add_ps(_mm_loadu_ps(p), _mm_mul_ps(delta, w)));
+        }
+#else
+        for(int i = 0; i < count; i++){
+            float* p = out + 4 * d[i].index;
+            p[0] += d[i].x * weight;
+            p[1] += d[i].y * weight;
+            p[2] += d[i].z * weight;
+        }
+#endif
+    }
+
+    static void accumulateQuantized(const BlendShape& shape, float weight, glm::vec4* positions){
+        const QuantizedDelta* d = &shape.quantized[0];
+        int count = shape.quantized.size();
+        float* out = &positions[0].x;
+        float w = weight * shape.scale;
+#ifdef BLEND_SHAPE_RIG_SSE
+        // widen the four int16 lanes (x, y, z, pad) to float in one go; pad is always 0
+        const __m128 ws = _mm_set1_ps(w);
+        for(int i = 0; i < count; i++){
+            float* p = out + 4 * d[i].index;
+            __m128i packed = _mm_loadl_epi64((const __m128i*)&d[i].x);
+            __m128i widened = _mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16);
+            __m128 delta = _mm_cvtepi32_ps(widened);
+            _mm_storeu_ps(p, _mm_add_ps(_mm_loadu_ps(p), _mm_mul_ps(delta, ws)));
+        }
+#else
+        for(int i = 0; i < count; i++){
+            float* p = out + 4 * d[i].index;
+            p[0] += d[i].x * w;
+            p[1] += d[i].y * w;
+            p[2] += d[i].z * w;
+        }
+#endif
+    }
+};
+
+#endif // BLEND_SHAPE_RIG_H
@@ -0,0 +1,131 @@
+#ifndef BLEND_SHAPE_SOLVER_H
+#define BLEND_SHAPE_SOLVER_H
+
+#include <algorithm>
+#include <Eigen/Dense>
+
+// Direct manipulation solver for blendshape weights:
+//
+//   min_w  |B w - m|^2 + alpha |w - w0|^2 + u |w|^2
+//
+// B (3M x S) holds the shape deltas at the M manipulated vertices. It only
+// changes when the manipulator set does, so B^T B and the LDLT factorisation of
+// A = B^T B + (alpha + u) I are cached. Adding a manipulator appends three rows
+// to B, which is three rank-one updates of A. Per frame only b = B^T m + alpha w0
+// has to be formed and back-substituted.
+
+class BlendShapeSolver {
+public:
+    BlendShapeSolver(int shapeCount = 0, float alpha = 0.1f, float u = 0.001f){
+        this->alpha = alpha;
+        this->u = u;
+        setShapeCount(shapeCount);
+    }
+
+    // drops all manipulators
+    void setShapeCount(int shapeCount){
+        this->shapeCount = shapeCount;
+        B.resize(0, shapeCount);
+        BtB = Eigen::MatrixXf::Zero(shapeCount, shapeCount);
+        refactor();
+    }
+
+    int getShapeCount() const {
+        return shapeCount;
+    }
+
+    int getManipulatorCount() const {
+        return B.rows() / 3;
+    }
+
+    void setRegularization(float alpha, float u){
+        if(alpha == this->alpha && u == this->u){
+            return;
+        }
+        this->alpha = alpha;
+        this->u = u;
+        refactor();
+    }
+
+    // deltas is 3 x S: the x, y, z displacement of the manipulated vertex in every shape
+    void addManipulator(const Eigen::MatrixXf& deltas){
+        int row = B.rows();
+        B.conservativeResize(row + 3, Eigen::NoChange);
+        B.middleRows(row, 3) = deltas;
+        BtB.noalias() += deltas.transpose() * deltas;
+
+        for(int i = 0; i < 3; i++){
+            ldlt.rankUpdate(deltas.row(i).transpose(), 1.0f);
+        }
+        updateLipschitz();
+    }
+
+    void clearManipulators(){
+        setShapeCount(shapeCount);
+    }
+
+    // m is the stacked (3M) manipulator displacement, w0 the current weights
+    Eigen::VectorXf solve(const Eigen::VectorXf& m, const Eigen::VectorXf& w0) const {
+        return ldlt.solve(rightHandSide(m, w0));
+    }
+
+    // Same objective with 0 <= w <= 1 enforced by projected gradient, warm
+    // started from the clamped unconstrained solution.
+    Eigen::VectorXf solveBoxConstrained(const Eigen::VectorXf& m, const Eigen::VectorXf& w0, float lower = 0.0f, float upper = 1.0f, int maxIterations = 100, float tolerance = 1e-6f) const {
+        Eigen::VectorXf b = rightHandSide(m, w0);
+        Eigen::VectorXf w = ldlt.solve(b).cwiseMax(lower).cwiseMin(upper);
+        Eigen::VectorXf next(w.size());
+        Eigen::MatrixXf a = A();
+        float step = 1.0f / lipschitz;
+
+        for(int i = 0; i < maxIterations; i++){
+            Eigen::VectorXf gradient = a * w - b;
+            next = (w - step * gradient).cwiseMax(lower).cwiseMin(upper);
+            float change = (next - w).squaredNorm();
+            w.swap(next);
+            if(change < tolerance * tolerance){
+                break;
+            }
+        }
+        return w;
+    }
+
+private:
+    int shapeCount;
+    float alpha;
+    float u;
+    float lipschitz = 1.0f;
+    Eigen::MatrixXf B;
+    Eigen::MatrixXf BtB;
+    Eigen::LDLT<Eigen::MatrixXf> ldlt;
+
+    Eigen::MatrixXf A() const {
+        return BtB + (alpha + u) * Eigen::MatrixXf::Identity(shapeCount, shapeCount);
+    }
+
+    Eigen::VectorXf rightHandSide(const Eigen::VectorXf& m, const Eigen::VectorXf& w0) const {
+        Eigen::VectorXf b = alpha * w0;
+        if(B.rows() > 0){
+            b.noalias() += B.transpose() * m;
+        }
+        return b;
+    }
+
+    void refactor(){
+        ldlt.compute(A());
+        updateLipschitz();
+    }
+
+    // the gradient step must stay below 1 / lambda_max(A); the largest absolute
+    // row sum (Gershgorin) is a cheap bound that never underestimates it
+    void updateLipschitz(){
+        if(shapeCount == 0){
+            lipschitz = 1.0f;
+            return;
+        }
+        float bound = (BtB.cwiseAbs().rowwise().sum().maxCoeff()) + alpha + u;
+        lipschitz = std::max(bound, 1e-6f);
+    }
+};
+
+#endif // BLEND_SHAPE_SOLVER_H
@@ -5,9 +5,11 @@
 #include <vector>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include "../src/utils/assimpHelper.h"
-#include <assimp/scene.h>
+#include "skeleton.h"
 
+// The posable entity of one bone. Imported bones are views onto a row of
+// their model's Skeleton, which holds the name, palette ID and offset; bones
+// built by hand (benchmark rigs) carry their own.
 class Bone : public Entity {
 
 public:
@@ -17,16 +19,29 @@ public:
         this->offset = offset;
     }
 
-    Bone(const aiNode* node, glm::mat4 offset, int ID = -1) {
-        this->ID = ID;
-        this->name = node->mName.C_Str();
-        this->offset = offset;
-        glm::mat4 transform = AssimpGLMHelpers::ConvertMatrixToGLMFormat(node->mTransformation);
+    // starts in the bind pose
+    Bone(Skeleton* skeleton, int index) {
+        this->skeleton = skeleton;
+        this->index = index;
+        const glm::mat4& transform = skeleton->getJoint(index).bindPose;
         this->setPosition(glm::vec3(transform[3]));
         this->setRotation(glm::quat_cast(transform));
         this->setScale(glm::vec3(1.0f));
     }
 
+    // a view per row, parented as the table is; returns the root's, null for an empty table
+    static Bone* createViews(Skeleton& skeleton) {
+        for (int i = 0; i < skeleton.getBoneCount(); i++) {
+            Bone* bone = new Bone(&skeleton, i);
+            skeleton.setView(i, bone);
+            int parent = skeleton.getJoint(i).parent;
+            if (parent >= 0) {
+                skeleton.getView(parent)->addChild(bone);
+            }
+        }
+        return skeleton.getBoneCount() > 0 ? skeleton.getView(0) : nullptr;
+    }
+
     ~Bone() {
         for (auto child : children) {
             delete child;
@@ -43,19 +58,31 @@ public:
     }
 
     int getID() {
-        return ID;
+        return skeleton ? skeleton->getJoint(index).id : ID;
     }
 
-    std::string getName() {
-        return name;
+    const std::string& getName() {
+        return skeleton ? skeleton->getName(index) : name;
     }
 
     glm::mat4 getOffset() {
-        return offset;
+        return skeleton ? skeleton->getJoint(index).inverseBind : offset;
     }
 
     void setOffset(glm::mat4 offset) {
-        this->offset = offset;
+        if (skeleton)
+            skeleton->setInverseBind(index, offset);
+        else
+            this->offset = offset;
+    }
+
+    // null for bones built by hand
+    Skeleton* getSkeleton() {
+        return skeleton;
+    }
+
+    int getIndex() {
+        return index;
     }
 
     void OnGui() {
@@ -78,10 +105,12 @@ public:
     }
 
 private:
-    int ID;
+    Skeleton* skeleton = nullptr;
+    int index = -1;
+    int ID = -1;
     bool showTransfromGui = false;
     std::string name = "NO_NAME";
-    glm::mat4 offset;
+    glm::mat4 offset = glm::mat4(1.0f);
     std::vector<Bone*> children;
 };
 
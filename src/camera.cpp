@@ -7,6 +7,10 @@ Camera::Camera(glm::vec3 worldUp, Camera_Projection projection, float fov, float
     this->worldUp = worldUp;
     this->projection = projection;
     this->projectionMatrix = glm::perspective(glm::radians(fov), aspect, near, far);
+    this->fov = fov;
+    this->aspect = aspect;
+    this->nearPlane = near;
+    this->farPlane = far;
     this->front = glm::vec3(0.0f, 0.0f, -1.0f);
     this->up = worldUp;
     this->tpsOffset = tpsOffset;
@@ -15,6 +19,9 @@ Camera::Camera(glm::vec3 worldUp, Camera_Projection projection, float left, floa
     this->worldUp = worldUp;
     this->projection = projection;
     this->projectionMatrix = glm::ortho(left, right, bottom, top, near, far);
+    this->aspect = (right - left) / (top - bottom);
+    this->nearPlane = near;
+    this->farPlane = far;
     this->front = glm::vec3(0.0f, 0.0f, -1.0f);
     this->up = worldUp;
 }
@@ -34,6 +34,11 @@ public:
     glm::vec3 getUp();
     glm::vec3 getRight();
     glm::vec3 getRotationEuler();
+    float getFov(){return fov;}
+    float getAspect(){return aspect;}
+    float getNear(){return nearPlane;}
+    float getFar(){return farPlane;}
+    Camera_Projection getProjection(){return projection;}
     void setPosition(glm::vec3 position);
     void lookAt(glm::vec3 target, glm::vec3 up);
     void setActive(bool active);
@@ -57,6 +62,10 @@ private:
     float tpsOffset = 15.0f;
     float rotationSpeed = 0.1f;
     glm::mat4 projectionMatrix;
+    float fov = 0.0f; // degrees, 0 for orthographic
+    float aspect = 1.0f;
+    float nearPlane = 0.1f;
+    float farPlane = 100.0f;
     glm::mat4 viewMatrix;
     glm::vec3 front;
     glm::vec3 up;
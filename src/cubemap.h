@@ -5,39 +5,25 @@
 #include <vector>
 #include <string>
 #include <iostream>
-#include "utils/stb_image.h"
+#include <chrono>
+#include "texture.h"
+#include "utils/cubemapLoader.h"
+#include "utils/textureCooker.h"
+
+// Skybox cube maps with a full mip chain, so the skybox and the glass
+// reflections don't alias. A cooked <first face>.gtex with six faces (see
+// tools/textureCooker.cpp --cube) is uploaded as is when the driver takes its
+// format; otherwise the faces are decoded in parallel (utils/cubemapLoader.h)
+// and the mips are generated on the GPU. Storage for every face and level is
+// allocated once with glTexStorage2D where GL 4.2 is available.
 
 class Cubemap {
 public:
     Cubemap(const std::string* faces) {
-        glGenTextures(1, &ID);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, ID);
-
-        int width, height, channels;
-        for (unsigned int i = 0; i < 6; i++) {
-            std::cout << "Loading texture: " << faces[i];
-            unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &channels, 0);
-            if (data) {
-                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-                stbi_image_free(data);
-                std::cout << "          Done" << std::endl;
-            } else {
-                stbi_image_free(data);
-                std::cout << "          Failed" << std::endl;
-            }
-        }
-
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        loadFaces(faces);
     }
 
     Cubemap(std::string name , std::string format){
-        glGenTextures(1, &ID);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, ID);
-
         std::string faces[] = {
             name + "right" + format,
             name + "left" + format,
@@ -46,33 +32,10 @@ public:
             name + "front" + format,
             name + "back" + format
         };
-
-        int width, height, channels;
-        for (unsigned int i = 0; i < 6; i++) {
-            std::cout << "Loading texture: " << faces[i];
-            unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &channels, 0);
-            if (data) {
-                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-                stbi_image_free(data);
-                std::cout << "          Done" << std::endl;
-            } else {
-                stbi_image_free(data);
-                std::cout << "          Failed" << std::endl;
-            }
-        }
-
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    
+        loadFaces(faces);
     }
 
     Cubemap(std::string filePath){
-        glGenTextures(1, &ID);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, ID);
-
         std::string faces[] = {
             filePath + "posx.jpg",
             filePath + "negx.jpg",
@@ -81,26 +44,24 @@ public:
             filePath + "posz.jpg",
             filePath + "negz.jpg"
         };
+        loadFaces(faces);
+    }
 
-        int width, height, channels;
-        for (unsigned int i = 0; i < 6; i++) {
-            std::cout << "Loading texture: " << faces[i];
-            unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &channels, 0);
-            if (data) {
-                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-                stbi_image_free(data);
-                std::cout << "          Done" << std::endl;
-            } else {
-                stbi_image_free(data);
-                std::cout << "          Failed" << std::endl;
-            }
+    // An equirectangular image (.hdr, or any 8 bit image) projected to faces
+    // of faceSize texels, 0 for a quarter of its width. HDR cube maps stay
+    // linear in RGB16F, SkyboxShader tonemaps them.
+    Cubemap(std::string equirectangularPath, int faceSize){
+        sourcePaths.assign(1, equirectangularPath);
+        std::cout << "Loading cubemap: " << equirectangularPath;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        CubemapImage image;
+        glGenTextures(1, &ID);
+        if (CubemapLoader::loadEquirectangular(equirectangularPath, faceSize, image)) {
+            upload(image);
+            printDone("RGB16F", start);
+        } else {
+            std::cout << "          Failed" << std::endl;
         }
-
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
     }
 
     ~Cubemap() = default;
@@ -109,8 +70,125 @@ public:
         return ID;
     }
 
+    // the six faces (+X -X +Y -Y +Z -Z) or the one equirectangular image
+    const std::vector<std::string>& getSourcePaths() const {
+        return sourcePaths;
+    }
+
+    int getSize() const {
+        return size;
+    }
+
+    bool isHdr() const {
+        return hdr;
+    }
+
+    // bytes of every face and level
+    size_t getVideoMemory() const {
+        return videoMemory;
+    }
+
 private:
     unsigned int ID;
+    std::vector<std::string> sourcePaths;
+    int size = 0;
+    bool hdr = false;
+    size_t videoMemory = 0;
+
+    void loadFaces(const std::string* faces) {
+        sourcePaths.assign(faces, faces + 6);
+        std::cout << "Loading cubemap: " << faces[0];
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        glGenTextures(1, &ID);
+
+        CookedTexture cooked;
+        if (TextureCooker::read(TextureCooker::getCookedPath(faces[0]), cooked) && cooked.faces == 6 && cooked.width == cooked.height &&
+            Texture::isFormatSupported(cooked.format)) {
+            uploadCooked(cooked);
+            printDone(TextureCooker::getFormatName(cooked.format), start);
+            return;
+        }
+
+        CubemapImage image;
+        if (CubemapLoader::decodeFaces(faces, image)) {
+            upload(image);
+            printDone(image.channels == 4 ? "RGBA8" : "RGB8", start);
+        } else {
+            std::cout << "          Failed" << std::endl;
+        }
+    }
+
+    void upload(const CubemapImage& image) {
+        size = image.size;
+        hdr = image.isHdr;
+        GLenum internalFormat = hdr ? GL_RGB16F : image.channels == 4 ? GL_RGBA8 : GL_RGB8;
+        int levels = TextureCooker::getMipCount(size, size);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, ID);
+        bool immutable = hasTextureStorage();
+        if (immutable)
+            glTexStorage2D(GL_TEXTURE_CUBE_MAP, levels, internalFormat, size, size);
+        for (int face = 0; face < 6; face++) {
+            GLenum format = hdr ? GL_RGB : GL_RGBA;
+            GLenum type = hdr ? GL_FLOAT : GL_UNSIGNED_BYTE;
+            const void* data = hdr ? (const void*)image.getHdrFace(face) : (const void*)image.getFace(face);
+            if (immutable)
+                glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, 0, 0, size, size, format, type, data);
+            else
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, internalFormat, size, size, 0, format, type, data);
+        }
+        glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+        setParameters(levels);
+        videoMemory = (size_t)size * size * 6 * (hdr ? 6 : image.channels) * 4 / 3;
+    }
+
+    // the cooked chain replaces glGenerateMipmap, which can't run on compressed textures
+    void uploadCooked(const CookedTexture& cooked) {
+        size = cooked.width;
+        int levels = cooked.getLevelCount();
+        GLenum internalFormat = Texture::getCompressedFormat(cooked.format);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, ID);
+        bool immutable = hasTextureStorage();
+        if (immutable)
+            glTexStorage2D(GL_TEXTURE_CUBE_MAP, levels, internalFormat, size, size);
+        videoMemory = 0;
+        for (int level = 0; level < levels; level++) {
+            for (int face = 0; face < 6; face++) {
+                const CookedMip& mip = cooked.getMip(level, face);
+                GLenum target = GL_TEXTURE_CUBE_MAP_POSITIVE_X + face;
+                if (cooked.format == COOKED_RGBA8 && immutable)
+                    glTexSubImage2D(target, level, 0, 0, mip.width, mip.height, GL_RGBA, GL_UNSIGNED_BYTE, cooked.getLevel(level, face));
+                else if (cooked.format == COOKED_RGBA8)
+                    glTexImage2D(target, level, GL_RGBA8, mip.width, mip.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, cooked.getLevel(level, face));
+                else if (immutable)
+                    glCompressedTexSubImage2D(target, level, 0, 0, mip.width, mip.height, internalFormat, mip.size, cooked.getLevel(level, face));
+                else
+                    glCompressedTexImage2D(target, level, internalFormat, mip.width, mip.height, 0, mip.size, cooked.getLevel(level, face));
+                videoMemory += mip.size;
+            }
+        }
+        setParameters(levels);
+    }
+
+    void setParameters(int levels) {
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        // filter across face edges, the lower mips would show seams otherwise
+        glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+    }
+
+    // glTexStorage2D is core since 4.2, macOS stops at 4.1
+    static bool hasTextureStorage() {
+        return GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 2);
+    }
+
+    void printDone(const char* format, std::chrono::steady_clock::time_point start) {
+        std::cout << "          Done (" << size << "x" << size << " " << format << ", " << videoMemory / 1024 << " KB, "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms)" << std::endl;
+    }
 
 };
 
@@ -0,0 +1,384 @@
+#ifndef CURVE_H
+#define CURVE_H
+
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Keyframe curves shared by Animator and FloatAnimator.
+//
+// A Curve<T> is parameterised by keyframe index, u in [0, keyCount - 1]. Every
+// segment stores four coefficients that are built once when the keys change:
+//   float / vec3: Catmull-Rom (clamped ends) or linear polynomial, evaluated with Horner
+//   quat:         q_i, s_i, s_i+1, q_i+1 for squad (cubic) or slerp (linear)
+// An optional arc-length table maps distance along the curve back to u so
+// targets can move at constant speed regardless of key spacing.
+
+template<typename T>
+struct CurveTraits {
+    static float distance(const T& a, const T& b){
+        return glm::length(b - a);
+    }
+};
+
+template<>
+struct CurveTraits<float> {
+    static float distance(float a, float b){
+        return std::fabs(b - a);
+    }
+};
+
+// angular distance in radians
+template<>
+struct CurveTraits<glm::quat> {
+    static float distance(const glm::quat& a, const glm::quat& b){
+        float d = std::min(1.0f, std::fabs(glm::dot(a, b)));
+        return 2.0f * std::acos(d);
+    }
+};
+
+template<typename T>
+class Curve {
+public:
+    Curve(bool isCubic = false){
+        this->isCubic = isCubic;
+    }
+
+    void setKeys(const std::vector<T>& keys){
+        this->keys = keys;
+        build();
+    }
+
+    void addKey(const T& key){
+        keys.push_back(key);
+        build();
+    }
+
+    // replaces one key, only the up to four segments it influences are rebuilt
+    void setKey(int index, const T& key){
+        keys[index] = key;
+        if(arcSamplesPerSegment > 0){
+            build();
+            return;
+        }
+        build(std::max(0, index - 2), std::min(getSegmentCount(), index + 2));
+    }
+
+    const std::vector<T>& getKeys() const {
+        return keys;
+    }
+
+    int getKeyCount() const {
+        return keys.size();
+    }
+
+    int getSegmentCount() const {
+        return std::max(0, (int)keys.size() - 1);
+    }
+
+    void setCubic(bool isCubic){
+        if(this->isCubic != isCubic){
+            this->isCubic = isCubic;
+            build();
+        }
+    }
+
+    bool getCubic() const {
+        return isCubic;
+    }
+
+    // u in [0, getSegmentCount()]
+    T evaluate(float u) const {
+        if(keys.size() <= 1){
+            return keys.empty() ? T() : keys[0];
+        }
+        int segment = std::max(0, std::min((int)u, getSegmentCount() - 1));
+        return evaluateSegment(&coefficients[4 * segment], u - segment);
+    }
+
+    // Samples samplesPerSegment points per segment to build the distance -> u
+    // table used by evaluateAtDistance. Rebuilt automatically when keys change.
+    void buildArcLengthTable(int samplesPerSegment = 16){
+        arcSamplesPerSegment = std::max(1, samplesPerSegment);
+        buildArcLength();
+    }
+
+    float getLength() const {
+        return arcLength.empty() ? 0.0f : arcLength.back();
+    }
+
+    // u at a given distance along the curve, requires buildArcLengthTable
+    float parameterAtDistance(float distance) const {
+        if(arcLength.size() < 2){
+            return 0.0f;
+        }
+        distance = std::max(0.0f, std::min(distance, arcLength.back()));
+        int i = std::upper_bound(arcLength.begin(), arcLength.end(), distance) - arcLength.begin();
+        i = std::max(1, std::min(i, (int)arcLength.size() - 1));
+        float span = arcLength[i] - arcLength[i - 1];
+        float t = span > 0.0f ? (distance - arcLength[i - 1]) / span : 0.0f;
+        return (i - 1 + t) / arcSamplesPerSegment;
+    }
+
+    T evaluateAtDistance(float distance) const {
+        return evaluate(parameterAtDistance(distance));
+    }
+
+    const std::vector<T>& getCoefficients() const {
+        return coefficients;
+    }
+
+    const std::vector<float>& getArcLengthTable() const {
+        return arcLength;
+    }
+
+    int getArcSamplesPerSegment() const {
+        return arcSamplesPerSegment;
+    }
+
+    static T evaluateSegment(const T* c, float t);
+
+private:
+    std::vector<T> keys;
+    std::vector<T> coefficients;    // 4 per segment
+    std::vector<float> arcLength;   // cumulative length at each sample, arcSamplesPerSegment per segment + 1
+    int arcSamplesPerSegment = 0;
+    bool isCubic;
+
+    void build(){
+        coefficients.resize(4 * getSegmentCount());
+        build(0, getSegmentCount());
+        if(arcSamplesPerSegment > 0){
+            buildArcLength();
+        }
+    }
+
+    void build(int firstSegment, int lastSegment){
+        int last = keys.size() - 1;
+        for(int i = firstSegment; i < lastSegment; i++){
+            const T& p0 = keys[std::max(0, i - 1)];
+            const T& p1 = keys[i];
+            const T& p2 = keys[i + 1];
+            const T& p3 = keys[std::min(last, i + 2)];
+            // two keys fall back to linear, as the animators always did
+            buildSegment(&coefficients[4 * i], p0, p1, p2, p3, isCubic && keys.size() > 2);
+        }
+    }
+
+    static void buildSegment(T* c, const T& p0, const T& p1, const T& p2, const T& p3, bool cubic);
+
+    void buildArcLength(){
+        int segments = getSegmentCount();
+        arcLength.assign(1, 0.0f);
+        if(segments == 0){
+            return;
+        }
+        arcLength.reserve(segments * arcSamplesPerSegment + 1);
+        T previous = evaluate(0.0f);
+        for(int i = 1; i <= segments * arcSamplesPerSegment; i++){
+            T current = evaluate((float)i / arcSamplesPerSegment);
+            arcLength.push_back(arcLength.back() + CurveTraits<T>::distance(previous, current));
+            previous = current;
+        }
+    }
+};
+
+template<typename T>
+inline void Curve<T>::buildSegment(T* c, const T& p0, const T& p1, const T& p2, const T& p3, bool cubic){
+    if(cubic){
+        c[0] = p1;
+        c[1] = 0.5f * (p2 - p0);
+        c[2] = 0.5f * (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3);
+        c[3] = 0.5f * (-p0 + 3.0f * p1 - 3.0f * p2 + p3);
+    } else {
+        c[0] = p1;
+        c[1] = p2 - p1;
+        c[2] = p1 * 0.0f;
+        c[3] = p1 * 0.0f;
+    }
+}
+
+template<typename T>
+inline T Curve<T>::evaluateSegment(const T* c, float t){
+    return ((c[3] * t + c[2]) * t + c[1]) * t + c[0];
+}
+
+// log / exp of unit quaternions as rotation vectors; glm::exp returns an
+// uninitialised quaternion for a zero rotation, which breaks squad on
+// evenly spaced keys
+inline glm::vec3 quatLog(const glm::quat& q){
+    glm::vec3 v(q.x, q.y, q.z);
+    float length = glm::length(v);
+    if(length < 1e-6f){
+        return glm::vec3(0.0f);
+    }
+    return v * (std::atan2(length, q.w) / length);
+}
+
+inline glm::quat quatExp(const glm::vec3& v){
+    float angle = glm::length(v);
+    if(angle < 1e-6f){
+        return glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    }
+    glm::vec3 axis = v * (std::sin(angle) / angle);
+    return glm::quat(std::cos(angle), axis.x, axis.y, axis.z);
+}
+
+// squad control point between neighbours, all already on the same hemisphere
+inline glm::quat squadIntermediate(const glm::quat& previous, const glm::quat& current, const glm::quat& next){
+    glm::quat inverse = glm::inverse(current);
+    glm::vec3 a = quatLog(inverse * next);
+    glm::vec3 b = quatLog(inverse * previous);
+    return current * quatExp((a + b) * -0.25f);
+}
+
+template<>
+inline void Curve<glm::quat>::buildSegment(glm::quat* c, const glm::quat& p0, const glm::quat& p1, const glm::quat& p2, const glm::quat& p3, bool cubic){
+    // keep neighbours on p1's hemisphere so interpolation takes the short way
+    glm::quat q0 = glm::dot(p0, p1) < 0.0f ? -p0 : p0;
+    glm::quat q2 = glm::dot(p1, p2) < 0.0f ? -p2 : p2;
+    glm::quat q3 = glm::dot(q2, p3) < 0.0f ? -p3 : p3;
+    c[0] = p1;
+    c[3] = q2;
+    if(cubic){
+        c[1] = squadIntermediate(q0, p1, q2);
+        c[2] = squadIntermediate(p1, q2, q3);
+    } else {
+        c[1] = p1;
+        c[2] = q2;
+    }
+}
+
+template<>
+inline glm::quat Curve<glm::quat>::evaluateSegment(const glm::quat* c, float t){
+    // with s_i = q_i the squad reduces to slerp, so linear segments share this path
+    glm::quat outer = glm::slerp(c[0], c[3], t);
+    if(c[1] == c[0] && c[2] == c[3]){
+        return outer;
+    }
+    glm::quat inner = glm::slerp(c[1], c[2], t);
+    return glm::slerp(outer, inner, 2.0f * t * (1.0f - t));
+}
+
+// Many curves of one type packed into contiguous coefficient and arc-length
+// arrays, evaluated in bulk into a contiguous output.
+template<typename T>
+class CurveSet {
+public:
+    // returns the curve's index in the set
+    int add(const Curve<T>& curve){
+        Entry entry;
+        entry.firstCoefficient = coefficients.size();
+        entry.segmentCount = curve.getSegmentCount();
+        entry.firstArcSample = arcLength.size();
+        entry.arcSampleCount = curve.getArcLengthTable().size();
+        entry.arcSamplesPerSegment = curve.getArcSamplesPerSegment();
+        entry.key = curve.getKeys().empty() ? T() : curve.getKeys()[0];
+
+        const std::vector<T>& c = curve.getCoefficients();
+        coefficients.insert(coefficients.end(), c.begin(), c.end());
+        const std::vector<float>& a = curve.getArcLengthTable();
+        arcLength.insert(arcLength.end(), a.begin(), a.end());
+
+        entries.push_back(entry);
+        return entries.size() - 1;
+    }
+
+    int size() const {
+        return entries.size();
+    }
+
+    void clear(){
+        entries.clear();
+        coefficients.clear();
+        arcLength.clear();
+    }
+
+    T evaluate(int curve, float u) const {
+        const Entry& e = entries[curve];
+        if(e.segmentCount == 0){
+            return e.key;
+        }
+        int segment = std::max(0, std::min((int)u, e.segmentCount - 1));
+        return Curve<T>::evaluateSegment(&coefficients[e.firstCoefficient + 4 * segment], u - segment);
+    }
+
+    float getLength(int curve) const {
+        const Entry& e = entries[curve];
+        return e.arcSampleCount == 0 ? 0.0f : arcLength[e.firstArcSample + e.arcSampleCount - 1];
+    }
+
+    T evaluateAtDistance(int curve, float distance) const {
+        const Entry& e = entries[curve];
+        if(e.arcSampleCount < 2){
+            return evaluate(curve, 0.0f);
+        }
+        const float* table = &arcLength[e.firstArcSample];
+        distance = std::max(0.0f, std::min(distance, table[e.arcSampleCount - 1]));
+        int i = std::upper_bound(table, table + e.arcSampleCount, distance) - table;
+        i = std::max(1, std::min(i, e.arcSampleCount - 1));
+        float span = table[i] - table[i - 1];
+        float t = span > 0.0f ? (distance - table[i - 1]) / span : 0.0f;
+        return evaluate(curve, (i - 1 + t) / e.arcSamplesPerSegment);
+    }
+
+    // out[i] = curve i at parameter u[i] (or at distance u[i] along it when
+    // byDistance is set). Splits across threads once the batch is large enough.
+    void evaluate(const float* u, T* out, bool byDistance = false, int numThreads = 0) const {
+        int count = entries.size();
+        if(numThreads <= 0){
+            numThreads = std::thread::hardware_concurrency();
+        }
+        const int minCurvesPerThread = 4096;
+        numThreads = std::max(1, std::min(numThreads, count / minCurvesPerThread));
+
+        if(numThreads == 1){
+            evaluateRange(u, out, byDistance, 0, count);
+            return;
+        }
+        std::vector<std::thread> workers;
+        int perThread = (count + numThreads - 1) / numThreads;
+        for(int i = 0; i < numThreads; i++){
+            int first = i * perThread;
+            int last = std::min(first + perThread, count);
+            if(first >= last){
+                break;
+            }
+            workers.push_back(std::thread(&CurveSet<T>::evaluateRange, this, u, out, byDistance, first, last));
+        }
+        for(int i = 0; i < workers.size(); i++){
+            workers[i].join();
+        }
+    }
+
+private:
+    struct Entry {
+        int firstCoefficient;
+        int segmentCount;
+        int firstArcSample;
+        int arcSampleCount;
+        int arcSamplesPerSegment;
+        T key;      // returned for single-key curves
+    };
+
+    std::vector<Entry> entries;
+    std::vector<T> coefficients;
+    std::vector<float> arcLength;
+
+    void evaluateRange(const float* u, T* out, bool byDistance, int first, int last) const {
+        if(byDistance){
+            for(int i = first; i < last; i++){
+                out[i] = evaluateAtDistance(i, u[i]);
+            }
+        } else {
+            for(int i = first; i < last; i++){
+                out[i] = evaluate(i, u[i]);
+            }
+        }
+    }
+};
+
+#endif // CURVE_H
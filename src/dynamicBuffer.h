@@ -0,0 +1,162 @@
+#ifndef DYNAMIC_BUFFER_H
+#define DYNAMIC_BUFFER_H
+
+#include <glad/glad.h>
+#include "utils/ringAllocator.h"
+
+// The GL side of RingAllocator: one buffer that per frame vertex data is
+// written into and drawn from at the allocation's offset.
+//
+// On GL 4.4 the buffer is immutable storage mapped once, persistent and
+// coherent, so writes need neither a map call nor a flush and fences order
+// the reuse. Below that (macOS stops at 4.1) each allocation maps its range
+// unsynchronized, the fences still order the reuse, and a full ring orphans
+// the storage instead of waiting for the GPU.
+
+// the buffer and the fences, common to both
+class GLRingBackend : public RingBackend {
+public:
+    GLRingBackend() { glGenBuffers(1, &buffer); }
+
+    virtual ~GLRingBackend() {
+        glDeleteBuffers(1, &buffer);
+    }
+
+    RingFence insertFence() override {
+        return (RingFence)glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    bool waitFence(RingFence fence, bool block) override {
+        GLenum status = glClientWaitSync((GLsync)fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while(block && status == GL_TIMEOUT_EXPIRED){
+            status = glClientWaitSync((GLsync)fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        }
+        return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED || status == GL_WAIT_FAILED;
+    }
+
+    void deleteFence(RingFence fence) override {
+        glDeleteSync((GLsync)fence);
+    }
+
+    GLuint getBuffer() const { return buffer; }
+
+protected:
+    GLuint buffer = 0;
+};
+
+class PersistentRingBackend : public GLRingBackend {
+public:
+    ~PersistentRingBackend() {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    unsigned char* create(size_t size) override {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+        void* memory = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        return (unsigned char*)memory;
+    }
+
+    unsigned char* mapRange(size_t, size_t) override { return nullptr; }
+    void unmapRange() override {}
+};
+
+class OrphaningRingBackend : public GLRingBackend {
+public:
+    unsigned char* create(size_t size) override {
+        this->size = size;
+        orphan();
+        return nullptr;
+    }
+
+    unsigned char* mapRange(size_t offset, size_t size) override {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        void* memory = glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, size,
+                                        GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        return (unsigned char*)memory;
+    }
+
+    void unmapRange() override {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    bool canOrphan() const override { return true; }
+
+    void orphan() override {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+private:
+    size_t size = 0;
+};
+
+class DynamicBuffer {
+public:
+    DynamicBuffer(size_t capacity) {
+        bool persistent = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 4);
+        if(persistent)
+            backend = new PersistentRingBackend();
+        else
+            backend = new OrphaningRingBackend();
+        allocator = new RingAllocator(backend, capacity);
+    }
+
+    ~DynamicBuffer() {
+        delete allocator;
+    }
+
+    // the ring every producer shares, created on first use; three frames of the largest
+    // terrain tessellation (100k triangles) fit. ResourceManager ends its frames.
+    static DynamicBuffer* shared() {
+        DynamicBuffer*& buffer = sharedSlot();
+        if(buffer == nullptr){
+            buffer = new DynamicBuffer(32 << 20);
+        }
+        return buffer;
+    }
+
+    static void endSharedFrame() {
+        if(sharedSlot() != nullptr){
+            sharedSlot()->endFrame();
+        }
+    }
+
+    RingAllocation allocate(size_t size) { return allocator->allocate(size); }
+    void commit(const RingAllocation& allocation) { allocator->commit(allocation); }
+    void endFrame() { allocator->endFrame(); }
+
+    // allocations are read from here, at their offset
+    GLuint getBuffer() const { return backend->getBuffer(); }
+    const RingAllocator& getAllocator() const { return *allocator; }
+
+    // a committed allocation into a buffer of its own, on the GPU; for data drawn for
+    // longer than the frame it was written in
+    void copy(const RingAllocation& allocation, GLuint target, size_t targetOffset) {
+        glBindBuffer(GL_COPY_READ_BUFFER, backend->getBuffer());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, target);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, allocation.offset, targetOffset, allocation.size);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+private:
+    GLRingBackend* backend;
+
+    static DynamicBuffer*& sharedSlot() {
+        static DynamicBuffer* buffer = nullptr;
+        return buffer;
+    }
+
+    RingAllocator* allocator;   // owns backend
+};
+
+#endif // DYNAMIC_BUFFER_H
@@ -1,6 +1,8 @@
 #ifndef ENTITY_MODULE_H
 #define ENTITY_MODULE_H
 
+#include "utils/profiler.h"
+
 class GameObject;
 
 class EntityModule
@@ -26,12 +28,21 @@ public:
         this->ID = ID;
     }
 
+    // the dynamic type's readable name for profiler scopes, looked up on first
+    // use (during construction typeid would see EntityModule)
+    const char* getTypeName() {
+        if (typeName == nullptr)
+            typeName = Profiler::typeName(typeid(*this));
+        return typeName;
+    }
+
     virtual void OnUpdate() = 0;
     virtual void OnStart() = 0;
 
 private:
     unsigned int ID;
     GameObject* parent;
+    const char* typeName = nullptr;
 };
 
 #endif // ENTITY_MODULE_H
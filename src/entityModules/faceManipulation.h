@@ -4,61 +4,83 @@
 #include "../entityModule.h"
 #include "../resourceManager.h"
 #include "../animator.h"
+#include "../blendShapeRig.h"
+#include "../blendShapeSolver.h"
+#include "../utils/weightCurve.h"
+#include "../utils/profiler.h"
 #include <Eigen/Dense>
 #include <Eigen/Sparse>
 
+// Plays a weight curve on one shared timeline; channel i drives *targets[i].
+// Text animations are parsed into memory, .wcrv files are streamed in chunks.
 struct WeightAnimation{
     bool isPlaying = false;
     bool isLoop = true;
     bool isCubic = false;
-    float speed = 1.0f;
+    float speed = 0.5f;
     float currentFrame = 0.0f;
-    std::vector<FloatAnimator*> animators;
+    WeightCurveStream stream;
+    WeightCurvePlayer player;
+    std::vector<float*> targets;
+
+    bool load(const std::string& filename){
+        std::string extension = filename.substr(filename.find_last_of('.') + 1);
+        if(extension == "wcrv"){
+            if(!stream.open(filename)){
+                return false;
+            }
+        } else {
+            stream.loadFrames(AnimatorParser::parseAnimationFrames(filename));
+        }
+        player.setStream(&stream);
+        player.setSpeed(speed);
+        player.setLoop(isLoop);
+        player.setCubic(isCubic);
+        return true;
+    }
 
-    void addAnimator(FloatAnimator* animator){
-        animators.push_back(animator);
+    void addTarget(float* target){
+        targets.push_back(target);
     }
 
     void setSpeed(float speed){
         this->speed = speed;
-        for(int i = 0; i < animators.size(); i++){
-            animators[i]->setSpeed(speed);
-        }
+        player.setSpeed(speed);
     }
 
     void setIsLoop(bool isLoop){
         this->isLoop = isLoop;
-        for(int i = 0; i < animators.size(); i++){
-            animators[i]->setLoop(isLoop);
-        }
+        player.setLoop(isLoop);
     }
 
     void setIsCubic(bool isCubic){
         this->isCubic = isCubic;
-        for(int i = 0; i < animators.size(); i++){
-            animators[i]->setCubic(isCubic);
-        }
+        player.setCubic(isCubic);
     }
 
     void setIsPlaying(bool isPlaying){
         this->isPlaying = isPlaying;
-        for(int i = 0; i < animators.size(); i++){
-            animators[i]->setPlaying(isPlaying);
-        }
+        player.setPlaying(isPlaying);
     }
 
     void setCurrentFrame(float currentFrame){
         this->currentFrame = currentFrame;
-        for(int i = 0; i < animators.size(); i++){
-            animators[i]->setCurrentFrame(currentFrame);
-        }
+        player.setCurrentFrame(currentFrame);
     }
 
     void update(){
-        for(int i = 0; i < animators.size(); i++){
-            animators[i]->update();
+        if(targets.empty()){
+            return;
+        }
+        bool sampled = player.update(ResourceManager::getDeltaTime());
+        currentFrame = player.getCurrentFrame();
+        if(sampled){
+            const std::vector<float>& weights = player.getWeights();
+            int count = std::min((int)targets.size(), player.getChannelCount());
+            for(int i = 0; i < count; i++){
+                *targets[i] = weights[i];
+            }
         }
-        setCurrentFrame(animators[0]->getCurrentFrame());
     }
 
     void OnGui(){
@@ -116,26 +138,23 @@ struct manipulator{
 
 struct blendShape{
     std::string name;
-    std::vector<glm::vec3> verticies;
-    std::vector<glm::vec3> deltas;
+    int rigIndex;       // shape index in FaceManipulation's BlendShapeRig
     float weight = 0.0f;
 
-    blendShape(Mesh* mesh, Mesh* defaultMesh, std::string name){
+    blendShape(std::string name, int rigIndex){
         this->name = name;
-        this->verticies = mesh->getInitialPositions();
-        std::vector<glm::vec3> defaultVerticies = defaultMesh->getInitialPositions();
-        for(int i = 0; i < verticies.size(); i++){
-            deltas.push_back(verticies[i] - defaultVerticies[i]);
-        }
+        this->rigIndex = rigIndex;
     }
 };
 
 class FaceManipulation : public EntityModule {
 
 public:
-    FaceManipulation(Mesh* defaultMesh){
+    FaceManipulation(Mesh* defaultMesh) : rig(defaultMesh->getInitialPositions()){
         this->defaultMesh = defaultMesh;
         this->initialPositions = defaultMesh->getInitialPositions();
+        rig.initialisePositions(positions);
+        defaultMesh->enableDynamicPositions();
     };
 
     void OnStart() override {}
@@ -170,6 +189,9 @@ public:
         if(useManipulators){
             ImGui::SliderFloat("Alpha", &_alpha, 0.0f, 1.0f);
             ImGui::SliderFloat("U", &_u, 0.0f, 1.0f);
+            if(ImGui::Checkbox("Box Constrained Solve", &useBoxConstraints)){
+                updateWeights();
+            }
             if(ImGui::Button("Reset Manipulators")){
                 resetManipulators();
             }
@@ -181,34 +203,36 @@ public:
             ImGui::SliderFloat(blendShapes[i].name.c_str(), &blendShapes[i].weight, 0.0f, 1.0f);
         }
 
-        if(_alpha != alpha){
+        if(_alpha != alpha || _u != u){
             alpha = _alpha;
-            updateWeights();
-        }
-
-        if(_u != u){
             u = _u;
+            solver.setRegularization(alpha, u);
             updateWeights();
         }
     }
 
     void addBlendShape(Mesh* mesh, std::string name, float weight = 0.0f){
-        blendShape newBlendShape(mesh, defaultMesh, name);
+        // the OBJ targets move most vertices by their rounding noise alone (up to
+        // ~1e-5), the default epsilon would keep 79% of them instead of 15%
+        blendShape newBlendShape(name, rig.addShape(mesh->getInitialPositions(), 1e-5f));
         newBlendShape.weight = weight;
         blendShapes.push_back(newBlendShape);
+        weightBuffer.push_back(weight);
+        rebuildSolver();
     }
 
     void addManipulator(GameObject* controlPoint, int vertexIndex){
         manipulator newManipulator(controlPoint, vertexIndex);
         manipulators.push_back(newManipulator);
+        solver.addManipulator(getManipulatorDeltas(vertexIndex));
     }
 
     void loadWeightAnimation(const std::string& filename){
-        std::vector<std::vector<float>> animationFrames = AnimatorParser::parseAnimationData(filename);
+        if(!weightAnimation.load(filename)){
+            return;
+        }
         for (int i = 0; i < blendShapes.size(); i++) {
-            FloatAnimator* animator = new FloatAnimator(&blendShapes[i].weight, 0.5f);
-            animator->setKeyFrames(animationFrames[i]);
-            weightAnimation.addAnimator(animator);
+            weightAnimation.addTarget(&blendShapes[i].weight);
         }
     }
 
@@ -219,6 +243,12 @@ private:
     float u = 0.001f;
     std::vector<manipulator> manipulators;
     std::vector<blendShape> blendShapes;
+    BlendShapeRig rig;
+    BlendShapeSolver solver;
+    bool useBoxConstraints = true;
+    std::vector<float> weightBuffer;        // weights in rig order, last evaluated
+    std::vector<glm::vec4> positions;       // deformed positions, streamed to defaultMesh and read by picking
+    bool positionsValid = false;
     bool useManipulators = true;
     WeightAnimation weightAnimation;
     bool useAnimation = false;
@@ -263,52 +293,65 @@ private:
     }
 
     void updateDefaultMesh(int mainpulatorIndex = -1){
-        std::vector<Vertex>& vertices = defaultMesh->getVertices();
-        for(int i = 0; i < vertices.size(); i++){
-            glm::vec3 delta = glm::vec3(0.0f, 0.0f, 0.0f);
-            for(int j = 0; j < blendShapes.size(); j++){
-                if(blendShapes[j].weight > 0.0f){
-                    delta += blendShapes[j].deltas[i] * blendShapes[j].weight;
-                }
+        PROFILE_SCOPE("FaceManipulation::updateDefaultMesh");
+        bool weightsChanged = !positionsValid;
+        for(int i = 0; i < blendShapes.size(); i++){
+            if(weightBuffer[blendShapes[i].rigIndex] != blendShapes[i].weight){
+                weightBuffer[blendShapes[i].rigIndex] = blendShapes[i].weight;
+                weightsChanged = true;
             }
-            vertices[i].Position = initialPositions[i] + delta;
+        }
+
+        if(weightsChanged && !blendShapes.empty()){
+            rig.evaluate(&weightBuffer[0], &positions[0]);
+            defaultMesh->updateDynamicPositions(&positions[0], rig.getDirtyBegin(), rig.getDirtyCount());
+            positionsValid = true;
+
+            // clicks have to land on the deformed face, not the neutral one it was exposed with
+            ResourceManager::updateGeometryInfo(getParent(), &positions);
         }
 
         if(mainpulatorIndex != -1){
-            manipulators[mainpulatorIndex].controlPoint->setPosition(vertices[manipulators[mainpulatorIndex].vertexIndex].Position);
-            manipulators[mainpulatorIndex].currentPosition = vertices[manipulators[mainpulatorIndex].vertexIndex].Position;
+            glm::vec3 position = glm::vec3(positions[manipulators[mainpulatorIndex].vertexIndex]);
+            manipulators[mainpulatorIndex].controlPoint->setPosition(position);
+            manipulators[mainpulatorIndex].currentPosition = position;
         }
+    }
 
-        defaultMesh->updateVertexBuffer();
+    // 3 x S block of B for one manipulated vertex
+    Eigen::MatrixXf getManipulatorDeltas(int vertexIndex){
+        Eigen::MatrixXf deltas(3, blendShapes.size());
+        for (int i = 0; i < blendShapes.size(); i++) {
+            glm::vec3 delta = rig.getDelta(blendShapes[i].rigIndex, vertexIndex);
+            deltas(0, i) = delta.x;
+            deltas(1, i) = delta.y;
+            deltas(2, i) = delta.z;
+        }
+        return deltas;
+    }
+
+    // B has one column per shape, so a new shape invalidates the whole factorisation
+    void rebuildSolver(){
+        solver = BlendShapeSolver(blendShapes.size(), alpha, u);
+        for (int i = 0; i < manipulators.size(); i++) {
+            solver.addManipulator(getManipulatorDeltas(manipulators[i].vertexIndex));
+        }
     }
 
     void updateWeights(int manipulatorIndex = -1) {
+        PROFILE_SCOPE("FaceManipulation::updateWeights");
         Eigen::VectorXf m = updateM();
-        Eigen::MatrixXf _B = Eigen::MatrixXf::Zero(manipulators.size() * 3, blendShapes.size());
-        Eigen::MatrixXf _Bt = Eigen::MatrixXf::Zero(blendShapes.size(), manipulators.size() * 3);
-        Eigen::MatrixXf _BtB;
         Eigen::VectorXf w0 = getWeights();
+        Eigen::VectorXf w;
 
-        // Populate _B and _Bt matrices
-        for (int i = 0; i < blendShapes.size(); i++) {
-            for (int j = 0; j < manipulators.size(); j++) {
-                int vertexIndex = manipulators[j].vertexIndex;
-                _B(j * 3, i) = blendShapes[i].deltas[vertexIndex].x;
-                _B(j * 3 + 1, i) = blendShapes[i].deltas[vertexIndex].y;
-                _B(j * 3 + 2, i) = blendShapes[i].deltas[vertexIndex].z;
-            }
+        if(useBoxConstraints){
+            w = solver.solveBoxConstrained(m, w0);
+        } else {
+            w = solver.solve(m, w0);
         }
 
-        _Bt = _B.transpose();
-        _BtB = _Bt * _B;
-        Eigen::MatrixXf A = _BtB + ((alpha + u) * Eigen::MatrixXf::Identity(_BtB.rows(), _BtB.cols()));
-        Eigen::MatrixXf b = (_Bt * m) + (alpha * w0);
-        Eigen::LDLT<Eigen::MatrixXf> solver(A);
-        Eigen::VectorXf w = solver.solve(b);
-        
-        // Clamp the weights and update blendShapes
         for (int i = 0; i < blendShapes.size(); i++) {
-            blendShapes[i].weight = clamp(w(i), 1.0f, 0.0f);
+            blendShapes[i].weight = useBoxConstraints ? w(i) : clamp(w(i), 1.0f, 0.0f);
         }
 
         updateDefaultMesh(manipulatorIndex);
@@ -28,7 +28,7 @@ class RenderModule : public EntityModule {
                 for(Vertex vertex : vertices){
                     positions.push_back(vertex.Position);
                 }
-                ResourceManager::addGeometryInfo(parent, positions);
+                ResourceManager::addGeometryInfo(parent, positions, this->model->getIndices());
             }
         }
 
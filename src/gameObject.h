@@ -3,6 +3,7 @@
 
 #include "entity.h"
 #include "entityModule.h"
+#include "utils/profiler.h"
 #include <vector>
 #include <string>
 #include <imgui.h>
@@ -65,6 +66,7 @@ public:
 
     virtual void OnUpdate() {
         for (auto module : modules) {
+            PROFILE_SCOPE(Profiler::isEnabled() ? module->getTypeName() : nullptr);
             module->OnUpdate();
         }
         for (auto child : children) {
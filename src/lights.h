@@ -6,6 +6,8 @@
 #include <iostream>
 #include "shader.h"
 #include <string>
+#include <cmath>
+#include <algorithm>
 
 enum LightType{
     DIRECTIONAL_LIGHT,
@@ -54,7 +56,7 @@ public:
     void setIndex(int index){this->index = index;}
 
 private:
-    bool isOn;
+    bool isOn = true;
     int index;
     LightType type = NOT_SET;
     float strength = 1.0f;
@@ -85,9 +87,22 @@ public:
     // Destructor
     ~DirectionalLight() = default;
 
+    // Direction the light travels in. The shaders have always been given the
+    // euler angles of the rotation as the direction, and the demos set the
+    // rotation with that in mind, so this keeps the same convention.
+    glm::vec3 getDirection(){
+        glm::vec3 direction = glm::eulerAngles(getWorldRotation());
+        if(glm::length(direction) < 1e-6f){
+            return glm::vec3(0.0f, -1.0f, 0.0f);
+        }
+        return glm::normalize(direction);
+    }
+
+    void setCastShadows(bool castShadows){this->castShadows = castShadows;}
+    bool getCastShadows(){return castShadows;}
+
 private:
-    glm::mat4 lightViewMatrix;
-    glm::mat4 lightProjection = glm::ortho(-50.0f, 50.0f, -50.0f, 50.0f, -60.0f, 60.f);
+    bool castShadows = true;
 
 
 };
@@ -124,6 +139,22 @@ public:
     float getConstant(){return constant;}
     float getLinear(){return linear;}
     float getQuadratic(){return quadratic;}
+
+    // Distance at which 1 / (constant + linear * d + quadratic * d^2) drops
+    // the brightest colour below cutoff; clustered culling ignores the light
+    // past it and the shaders fade it out to zero there.
+    float getRange(float cutoff = 1.0f / 256.0f){
+        glm::vec3 colour = glm::max(getDiffuse(), glm::max(getAmbient(), getSpecular()));
+        float brightest = std::max(colour.r, std::max(colour.g, colour.b));
+        float c = constant - brightest / cutoff;
+        if(c >= 0.0f){
+            return 0.0f;
+        }
+        if(quadratic <= 0.0f){
+            return linear > 0.0f ? -c / linear : 1e30f;
+        }
+        return (-linear + std::sqrt(linear * linear - 4.0f * quadratic * c)) / (2.0f * quadratic);
+    }
     void OnGui(){
         Entity::OnGui();
         ImGui::SliderFloat("Constant", &constant, 0.0f, 1.0f);
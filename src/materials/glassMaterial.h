@@ -4,41 +4,62 @@
 #include "../material.h"
 #include "imgui.h"
 
+// How GlassShader composites a transparent object, see glassShader.h
+enum TransparencyMode {
+    TRANSPARENCY_SORTED,    // blended back to front, sorted per frame on view depth
+    TRANSPARENCY_WEIGHTED   // weighted blended order independent transparency
+};
+
 class GlassMaterial : public Material {
 public:
 
-    GlassMaterial(float eta, float fresnelPower, float chromaticAberrationFactor) {
+    GlassMaterial(float eta, float fresnelPower, float chromaticAberrationFactor, float opacity = 1.0f, TransparencyMode transparency = TRANSPARENCY_SORTED) {
         this->eta = eta;
         this->fresnelPower = fresnelPower;
         this->chromaticAberrationFactor = chromaticAberrationFactor;
+        this->opacity = opacity;
+        this->transparency = transparency;
     }
 
     // Getters
     float getEta() const { return this->eta; }
     float getFresnelPower() const { return this->fresnelPower; }
     float getChromaticAberrationFactor() const { return this->chromaticAberrationFactor; }
+    float getOpacity() const { return this->opacity; }
+    TransparencyMode getTransparency() const { return this->transparency; }
 
     // Setters  
     void setEta(float eta) { this->eta = eta; }
     void setFresnelPower(float fresnelPower) { this->fresnelPower = fresnelPower; }
     void setChromaticAberrationFactor(float chromaticAberrationFactor) { this->chromaticAberrationFactor = chromaticAberrationFactor; }
+    void setOpacity(float opacity) { this->opacity = opacity; }
+    void setTransparency(TransparencyMode transparency) { this->transparency = transparency; }
     
     void Draw(Shader* shader) override {
         shader->SetFloat("eta", this->eta);
         shader->SetFloat("fresnelPower", this->fresnelPower);
         shader->SetFloat("chromaticOffset", this->chromaticAberrationFactor);
+        shader->SetFloat("opacity", this->opacity);
     }
 
     void OnGui() override {
         ImGui::SliderFloat("Eta", &eta, 0.0f, 3.0f);
         ImGui::SliderFloat("Fresnel Power", &fresnelPower, 0.0f, 10.0f);
         ImGui::SliderFloat("Chromatic Offset", &chromaticAberrationFactor, 0.0f, 10.0f);
+        ImGui::SliderFloat("Opacity", &opacity, 0.0f, 1.0f);
+        const char* modes[] = { "Sorted", "Weighted OIT" };
+        int mode = transparency;
+        if (ImGui::Combo("Transparency", &mode, modes, 2)) {
+            transparency = (TransparencyMode)mode;
+        }
     }
 
 private:
     float eta = 1.5f;
     float fresnelPower = 5.0f;
     float chromaticAberrationFactor = 0.01f;
+    float opacity = 1.0f;
+    TransparencyMode transparency = TRANSPARENCY_SORTED;
 
 };
 
@@ -39,6 +39,7 @@ public:
         shader->SetFloat("material.height_scale", this->height_scale);
         shader->SetFloat("outerTessLevel", this->outerTessLevel);
         shader->SetFloat("innerTessLevel", this->innerTessLevel);
+        shader->SetFloat("edgeLength", this->edgeLength);
     }
 
     void OnGui() override {
@@ -49,6 +50,7 @@ public:
         ImGui::SliderFloat("Height Scale", &height_scale, -1.0f, 1.0f);
         ImGui::SliderFloat("Outer Tess Level", &outerTessLevel, 1.0f, 100.0f);
         ImGui::SliderFloat("Inner Tess Level", &innerTessLevel, 1.0f, 100.0f);
+        ImGui::SliderFloat("Edge Length (px)", &edgeLength, 1.0f, 64.0f); // adaptive tessellation target
     }
 
     glm::vec3 ambient = glm::vec3(0.5f);
@@ -58,6 +60,7 @@ public:
     float height_scale = 1.0f;
     float outerTessLevel = 5.0f;
     float innerTessLevel = 3.0f;
+    float edgeLength = 8.0f;
 };
 
 #endif // TESS_MATERIAL_H
\ No newline at end of file
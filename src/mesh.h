@@ -4,9 +4,11 @@
 #include <vector>
 #include <iostream>
 #include <string>
+#include <cstring>
 #include <glm/glm.hpp>
 #include "texture.h"
 #include "shader.h"
+#include "dynamicBuffer.h"
 
 #define MAX_BONE_INFLUENCE 4
 
@@ -47,6 +49,12 @@ public:
         return ID;
     }
 
+    // every Mesh::Draw so far, headless runs report it per frame
+    static unsigned long long& drawCalls() {
+        static unsigned long long count = 0;
+        return count;
+    }
+
     void setID(unsigned int ID) {
         this->ID = ID;
     }
@@ -109,6 +117,7 @@ public:
         }
         //glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
         glBindVertexArray(0);
+        drawCalls()++;
 
         // always good practice to set everything back to defaults once configured.
         glActiveTexture(GL_TEXTURE0);
@@ -122,17 +131,108 @@ public:
         return vertices;
     }
 
+    std::vector<unsigned int>& getIndices() {
+        return indices;
+    }
+
+    // the vertices through the shared ring and a GPU copy into the existing storage;
+    // when the vertex count changed or they don't fit the ring, new storage with glBufferData
     void updateVertexBuffer() {
-        glBindVertexArray(VAO);
+        size_t size = vertices.size() * sizeof(Vertex);
+        if(size == 0){
+            return;
+        }
+        DynamicBuffer* ring = DynamicBuffer::shared();
+        if(size == vertexBufferSize && size <= ring->getAllocator().getCapacity()){
+            RingAllocation allocation = ring->allocate(size);
+            if(allocation.data != nullptr){
+                memcpy(allocation.data, &vertices[0], size);
+                ring->commit(allocation);
+                ring->copy(allocation, VBO, 0);
+                return;
+            }
+        }
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+        glBufferData(GL_ARRAY_BUFFER, size, &vertices[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        vertexBufferSize = size;
+    }
+
+    // Moves attribute 0 onto its own vec4 buffer so deforming meshes can
+    // stream positions without re-uploading the full interleaved vertex data.
+    void enableDynamicPositions() {
+        if(positionVBO != 0){
+            return;
+        }
+        std::vector<glm::vec4> positions(vertices.size());
+        for(int i = 0; i < vertices.size(); i++){
+            positions[i] = glm::vec4(vertices[i].Position, 1.0f);
+        }
+
+        glGenBuffers(1, &positionVBO);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+        glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec4), &positions[0], GL_DYNAMIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
         glBindVertexArray(0);
     }
 
+    bool hasDynamicPositions() const {
+        return positionVBO != 0;
+    }
+
+    // uploads count positions starting at vertex first, with glBufferSubData when they don't fit the ring
+    void updateDynamicPositions(const glm::vec4* positions, int first, int count) {
+        if(positionVBO == 0 || count <= 0){
+            return;
+        }
+        glm::vec4* destination = beginDynamicPositions(first, count);
+        if(destination != nullptr){
+            memcpy(destination, positions + first, count * sizeof(glm::vec4));
+            endDynamicPositions();
+            return;
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+        glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(glm::vec4), count * sizeof(glm::vec4), positions + first);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // Memory in the shared ring for positions first to first + count, for
+    // producers that evaluate straight into it; endDynamicPositions() then
+    // copies them into the position buffer on the GPU. Nothing else may be
+    // allocated from the ring in between. Null when there is nothing to do or
+    // the positions don't fit the ring.
+    glm::vec4* beginDynamicPositions(int first, int count) {
+        if(positionVBO == 0 || count <= 0){
+            return nullptr;
+        }
+        DynamicBuffer* ring = DynamicBuffer::shared();
+        if(count * sizeof(glm::vec4) > ring->getAllocator().getCapacity()){
+            pendingPositions = RingAllocation();
+            return nullptr;
+        }
+        pendingPositions = ring->allocate(count * sizeof(glm::vec4));
+        pendingFirst = first;
+        return (glm::vec4*)pendingPositions.data;
+    }
+
+    void endDynamicPositions() {
+        if(pendingPositions.data == nullptr){
+            return;
+        }
+        DynamicBuffer* ring = DynamicBuffer::shared();
+        ring->commit(pendingPositions);
+        ring->copy(pendingPositions, positionVBO, pendingFirst * sizeof(glm::vec4));
+        pendingPositions = RingAllocation();
+    }
+
 private:
 
     unsigned int VAO, VBO, EBO, ID;
+    unsigned int positionVBO = 0;
+    size_t vertexBufferSize = 0;
+    RingAllocation pendingPositions;
+    int pendingFirst = 0;
     std::vector<Vertex>       vertices;
     std::vector<glm::vec3>    initialPositions; //exposed for override
     std::vector<unsigned int> indices;
@@ -159,6 +259,7 @@ private:
         // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
         // again translates to 3/2 floats which translates to a byte array.
         glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+        vertexBufferSize = vertices.size() * sizeof(Vertex);
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
@@ -1,4 +1,5 @@
 #include "model.h"
+#include <cfloat>
 
 unsigned int Model::getID() const {
     return ID;
@@ -29,6 +30,9 @@ void Model::setID(unsigned int ID) {
 
 		// process ASSIMP's root node recursively
 		processNode(scene->mRootNode, scene);
+		if (!m_BoneInfoMap.empty()){
+			processSkeleton(scene->mRootNode);
+		}
 	}
 
 	// processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
@@ -205,9 +209,6 @@ void Model::setID(unsigned int ID) {
 			}
 		}
 
-		rootBone = processSkeleton(scene->mRootNode, boneInfoMap);
-
-		printf("  %i bones\n", boneCount);
 	}
 
     std::vector<Texture*> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, TextureType typeName)
@@ -233,34 +234,25 @@ void Model::setID(unsigned int ID) {
 		return newName;
 	}
 
-	Bone* Model::processSkeleton(const aiNode* node, const std::map<std::string, BoneInfo>& boneInfoMap){
-		Bone* bone = nullptr;
-		for (int i = 0; i < node->mNumChildren; ++i){
-			Bone* childBone = processSkeleton(node->mChildren[i], boneInfoMap);
-			if (childBone){
-				if (!bone){
-					bone = childBone;
-				} else {
-					bone->addChild(childBone);
-				}
-			}
-		}
-		auto boneInfo = boneInfoMap.find(node->mName.C_Str());
-		if (boneInfo != boneInfoMap.end()){
-			bone = new Bone(node, boneInfo->second.offset, boneInfo->second.id);
-			for (int i = 0; i < node->mNumChildren; ++i){
-				Bone* childBone = processSkeleton(node->mChildren[i], boneInfoMap);
-				if (childBone){
-					bone->addChild(childBone);
-				}
-			}
-		}
-		return bone;
+	void Model::processSkeleton(const aiNode* root){
+		skeleton.import(root, m_BoneInfoMap);
+		rootBone = Bone::createViews(skeleton);
+		printf("  %i bones, %i in the hierarchy\n", m_BoneCounter, skeleton.getBoneCount());
 	}
 
 	std::vector<glm::mat4> Model::getBoneMatrices(Bone* rootBone){
 		std::vector<glm::mat4> boneMatrices = std::vector<glm::mat4>(m_BoneCounter, glm::mat4(1.0f));
-		if (rootBone){
+		Skeleton* table = rootBone ? rootBone->getSkeleton() : nullptr;
+		if (table && rootBone->getIndex() == 0){
+			// the whole table, no need to walk the tree
+			for (int i = 0; i < table->getBoneCount(); i++){
+				const Skeleton::Joint& joint = table->getJoint(i);
+				if (joint.id < m_BoneCounter){
+					boneMatrices[joint.id] = table->getView(i)->getTransform() * joint.inverseBind;
+				}
+			}
+		}
+		else if (rootBone){
 			getBoneTransfrom(rootBone, boneMatrices);
 		}
 		return boneMatrices;
@@ -275,11 +267,21 @@ void Model::setID(unsigned int ID) {
 	}
 
 	Bone* Model::findBone(const std::string& name, Bone* bone){
-		if (bone){
-			if (bone->getName() == name){
-				return bone;
+		Bone* root = bone ? bone : rootBone;
+		Skeleton* table = root ? root->getSkeleton() : nullptr;
+		if (table){
+			int index = table->findBone(name);
+			if (index < 0 || !table->isInSubtree(index, root->getIndex())){
+				return nullptr;
+			}
+			return table->getView(index);
+		}
+		// bones built by hand have no table to look in
+		if (root){
+			if (root->getName() == name){
+				return root;
 			}
-			for (auto child : bone->getChildren()){
+			for (auto child : root->getChildren()){
 				Bone* childBone = findBone(name, child);
 				if (childBone){
 					return childBone;
@@ -298,3 +300,36 @@ void Model::setID(unsigned int ID) {
 		}
 		return vertices;
 	}
+
+	void Model::getBounds(glm::vec3& min, glm::vec3& max){
+		if (!hasBounds){
+			boundsMin = glm::vec3(FLT_MAX);
+			boundsMax = glm::vec3(-FLT_MAX);
+			for (Mesh* mesh : meshes){
+				for (const Vertex& vertex : mesh->getVertices()){
+					boundsMin = glm::min(boundsMin, vertex.Position);
+					boundsMax = glm::max(boundsMax, vertex.Position);
+				}
+			}
+			if (boundsMin.x > boundsMax.x){
+				boundsMin = boundsMax = glm::vec3(0.0f);
+			}
+			hasBounds = true;
+		}
+		min = boundsMin;
+		max = boundsMax;
+	}
+
+	// indices of all meshes, offset to match the concatenated getVertices()
+	std::vector<unsigned int> Model::getIndices(){
+		std::vector<unsigned int> indices;
+		unsigned int offset = 0;
+		for (Mesh* mesh : meshes){
+			const std::vector<unsigned int>& meshIndices = mesh->getIndices();
+			for (unsigned int index : meshIndices){
+				indices.push_back(index + offset);
+			}
+			offset += mesh->getVertices().size();
+		}
+		return indices;
+	}
@@ -17,6 +17,7 @@
 #include "utils/animData.h"
 #include "resourceManager.h"
 #include "bone.h"
+#include "skeleton.h"
 
 class Model
 {
@@ -28,29 +29,49 @@ public:
 		loadModel(path);
 	}
 
+	// skeleton only, no meshes; lets the benchmarks build rigs without assets
+	Model(std::string const& name, Bone* rootBone, int boneCount) : gammaCorrection(false)
+	{
+		this->name = name;
+		this->rootBone = rootBone;
+		this->m_BoneCounter = boneCount;
+	}
+
     unsigned int getID() const;
 
     void setID(unsigned int ID);
     
 	int& getBoneCount() { return m_BoneCounter; }
 	Bone* getRootBone() { return rootBone; }
+	// a hash lookup for imported skeletons, limited to bone's subtree when given
 	Bone* findBone(const std::string& name, Bone* bone = nullptr);
+	const Skeleton& getSkeleton() const { return skeleton; }
 	void setRootBone(Bone* bone) { rootBone = bone; }
 	std::vector<Vertex> getVertices();
+	std::vector<unsigned int> getIndices();
 	std::vector<Mesh*> getMeshes() { return meshes; }
+	// object space bounding box of all meshes, computed on first use
+	void getBounds(glm::vec3& min, glm::vec3& max);
 
 	void Draw(Shader* shader, bool useOwnTextures = true, bool drawTessalated = false);
 
+	// world transform * offset of every bone, indexed by bone ID
+	std::vector<glm::mat4> getBoneMatrices(Bone* rootBone);
+
 private:
     unsigned int ID;
 	std::string name;
     std::vector<Texture*> textures;
 	std::vector<Mesh*>    meshes;
 	Bone* rootBone = nullptr;
+	Skeleton skeleton;
 	bool hasDiffuseMap = false;
 	bool hasSpecularMap = false;
 	bool hasNormalMap = false;
 	bool hasHeightMap = false;
+	bool hasBounds = false;
+	glm::vec3 boundsMin = glm::vec3(0.0f);
+	glm::vec3 boundsMax = glm::vec3(0.0f);
 
 	std::string directory;
 
@@ -71,7 +92,8 @@ private:
 	
 	void SetVertexBoneData(Vertex& vertex, int boneID, float weight);
 
-	Bone* processSkeleton(const aiNode* node, const std::map<std::string, BoneInfo>& boneInfoMap);
+	// the skeleton table and its Bone views, once every mesh's bones are known
+	void processSkeleton(const aiNode* root);
 
 	void ExtractBoneWeightForVertices(std::vector<Vertex>& vertices, aiMesh* mesh, const aiScene* scene);
 
@@ -79,8 +101,6 @@ private:
 
 	bool loadTextureMaps(aiMaterial* material, aiTextureType type, TextureType typeName, std::vector<Texture*>& textures);
 
-	std::vector<glm::mat4> getBoneMatrices(Bone* rootBone);
-
 	void getBoneTransfrom(Bone* bone, std::vector<glm::mat4>& transforms);
 
 	aiString removePathFromName(aiString name);
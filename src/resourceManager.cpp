@@ -1,5 +1,13 @@
 #include "resourceManager.h"
 #include "utils/programInfo.h"
+#include "shaders/shadow/cascadedShadowMap.h"
+#include "shaders/deferred/deferredRenderer.h"
+#include "shaders/ibl/imageBasedLighting.h"
+#include "shaders/renderGraph/renderGraphExecutor.h"
+#include "utils/frameCapture.h"
+#include "dynamicBuffer.h"
+#include "shaderManager.h"
+#include "utils/offscreenContext.h"
 
 std::vector<Shader *> ResourceManager::shaders;
 std::vector<Texture *> ResourceManager::textures;
@@ -7,8 +15,10 @@ std::vector<Mesh *> ResourceManager::meshes;
 std::vector<Model *> ResourceManager::models;
 std::vector<GameObject *> ResourceManager::gameObjects;
 GLFWwindow *ResourceManager::window;
+GLuint ResourceManager::backBuffer = 0;
 float ResourceManager::deltaTime = 0.0f;
 float ResourceManager::previousTime = 0.0f;
+float ResourceManager::fixedDeltaTime = 0.0f;
 double ResourceManager::mouseX = 0.0;
 double ResourceManager::mouseY = 0.0;
 double ResourceManager::lastMouseX = 0.0;
@@ -21,11 +31,31 @@ std::vector<DirectionalLight *> ResourceManager::directionalLights;
 bool ResourceManager::isDebug = false;
 bool ResourceManager::isMouseEnabled = false;
 int ResourceManager::screenWidth, ResourceManager::screenHeight;
-std::map<GameObject *, std::vector<glm::vec3>> ResourceManager::pickableVerticies;
+std::map<GameObject *, VertexBVH> ResourceManager::pickableVerticies;
+std::map<GameObject *, TriangleBVH> ResourceManager::pickableMeshes;
+std::map<GameObject *, ResourceManager::DeformedGeometry> ResourceManager::deformedGeometry;
+std::vector<GameObject *> ResourceManager::sceneObjects;
+SceneBVH ResourceManager::sceneBVH;
+LightClusters ResourceManager::lightClusters;
+GLuint ResourceManager::lightClusterBuffers[3] = {0, 0, 0};
+GLuint ResourceManager::lightClusterTextures[3] = {0, 0, 0};
+glm::vec4 ResourceManager::lightClusterViewport;
+int ResourceManager::lightClusterLightCount = 0;
+bool ResourceManager::shadowsEnabled = true;
+CascadedShadowMap *ResourceManager::shadowMap = nullptr;
+bool ResourceManager::deferredEnabled = false;
+bool ResourceManager::adaptiveTessellation = true;
+bool ResourceManager::screenSpaceOutlines = false;
+RenderGraph ResourceManager::renderGraph;
+RenderGraphExecutor *ResourceManager::renderGraphExecutor = nullptr;
+FrameCapture *ResourceManager::frameCapture = nullptr;
+DeferredRenderer *ResourceManager::deferredRenderer = nullptr;
+ImageBasedLighting *ResourceManager::imageBasedLighting = nullptr;
 GameObject *ResourceManager::currentlySelected;
 
 Model *ResourceManager::loadModel(const char *modelFile)
 {
+    PROFILE_FUNCTION();
     Model *model = new Model(modelFile);
     model->setID(models.size());
     models.push_back(model);
@@ -50,11 +80,12 @@ Texture *ResourceManager::loadTexture(TextureType type, const char *textureFile,
 {
     for (Texture *texture : textures)
     {
-        if (strcmp(texture->getFilePath().c_str(), textureFile) == 0)
+        if (texture->getType() == type && strcmp(texture->getFilePath().c_str(), textureFile) == 0)
         {
             return texture;
         }
     }
+    PROFILE_SCOPE("ResourceManager::loadTexture");
     Texture *texture = new Texture(type, textureFile, useMipmaps, interpolation);
     textures.push_back(texture);
     return texture;
@@ -96,13 +127,27 @@ float ResourceManager::getDeltaTime()
 
 void ResourceManager::updateDeltaTime()
 {
+    // headless runs step time by a fixed amount so animation is reproducible
+    if (fixedDeltaTime > 0.0f)
+    {
+        deltaTime = fixedDeltaTime;
+        return;
+    }
+
     float currentTime = glfwGetTime();
     deltaTime = currentTime - previousTime;
     previousTime = currentTime;
 }
 
+void ResourceManager::setFixedDeltaTime(float deltaTime)
+{
+    fixedDeltaTime = deltaTime;
+}
+
 void ResourceManager::updateKeysPressed()
 {
+    if (window == nullptr)
+        return;
     for (int i = 0; i < 1024; i++)
     {
         if (glfwGetKey(window, i) == GLFW_PRESS)
@@ -127,7 +172,7 @@ bool ResourceManager::isKeyPressed(int key)
     return keyStates[key].isPressed;
 }
 
-GLFWwindow *ResourceManager::createWindow(int width, int height, const char *title)
+GLFWwindow *ResourceManager::createWindow(int width, int height, const char *title, bool visible)
 {
 
     screenWidth = width;
@@ -144,6 +189,8 @@ GLFWwindow *ResourceManager::createWindow(int width, int height, const char *tit
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
     glfwWindowHint(GLFW_SAMPLES, 4);
+    // hidden windows are used for headless runs with the native context
+    glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
 
     window = glfwCreateWindow(screenWidth, screenHeight, title, nullptr, nullptr);
     if (!window)
@@ -172,6 +219,20 @@ GLFWwindow *ResourceManager::getWindow()
     return window;
 }
 
+void ResourceManager::setBackBuffer(GLuint framebuffer, int width, int height)
+{
+    backBuffer = framebuffer;
+    screenWidth = width;
+    screenHeight = height;
+}
+
+void *ResourceManager::getProcAddress(const char *name)
+{
+    if (window != nullptr)
+        return (void *)glfwGetProcAddress(name);
+    return OffscreenContext::getProcAddress(name);
+}
+
 double ResourceManager::getMouseX()
 {
     return mouseX;
@@ -201,7 +262,7 @@ void ResourceManager::updateMousePosition()
         mouseX = ImGui::GetIO().MousePos.x * 2;
         mouseY = ImGui::GetIO().MousePos.y * 2;
     }
-    else
+    else if (window != nullptr)
     {
         glfwGetCursorPos(window, &mouseX, &mouseY);
     }
@@ -212,6 +273,9 @@ void ResourceManager::updateMousePosition()
 
 void ResourceManager::initialize()
 {
+    PROFILE_FUNCTION();
+    // every program built during setup, compiled meanwhile when the driver has the threads for it
+    ShaderManager::finishAll();
     for (GameObject *gameObject : gameObjects)
     {
         gameObject->OnStart();
@@ -233,13 +297,15 @@ void ResourceManager::initialize()
 
 void ResourceManager::runGameLoop()
 {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    PROFILE_FUNCTION();
+    glBindFramebuffer(GL_FRAMEBUFFER, backBuffer);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glClearColor(0.01f, 0.01f, 0.01f, 1.0f);
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_MULTISAMPLE);
     glEnable(GL_FRAMEBUFFER_SRGB); 
 
+    ShaderManager::pollChanges();
     updateDeltaTime();
     updateKeysPressed();
     updateMousePressed();
@@ -250,21 +316,95 @@ void ResourceManager::runGameLoop()
         screenWidth = ImGui::GetIO().DisplaySize.x * 2;
     }
 
-    activeCamera->OnUpdate();
+    {
+        PROFILE_SCOPE("Camera::OnUpdate");
+        activeCamera->OnUpdate();
+    }
 
     if (isDebug)
         ProgramInfo::printAllInfo();
 
-    for (GameObject *gameObject : gameObjects)
     {
-        gameObject->OnUpdate();
+        PROFILE_SCOPE("GameObject::OnUpdate");
+        for (GameObject *gameObject : gameObjects)
+        {
+            gameObject->OnUpdate();
+        }
     }
 
-    for (Shader *shader : shaders)
+    updateLightClusters();
+
     {
+        PROFILE_SCOPE("Render graph compile");
+        buildRenderGraph();
+        if (!renderGraph.compile())
+            std::cerr << "The frame's render graph has a dependency cycle" << std::endl;
+    }
+    renderGraphExecutor->execute(renderGraph);
+    DynamicBuffer::endSharedFrame();
+}
+
+void ResourceManager::buildRenderGraph()
+{
+    if (renderGraphExecutor == nullptr)
+        renderGraphExecutor = new RenderGraphExecutor();
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
 
-        shader->Render();
+    renderGraph.reset();
+    FrameResources frame;
+    frame.backbuffer = renderGraph.importResource("Backbuffer");
+    frame.shadowMap = renderGraph.importResource("Shadow map");
+    frame.width = viewport[2];
+    frame.height = viewport[3];
+    frame.deferred = deferredEnabled;
+    frame.executor = renderGraphExecutor;
+
+    int pass = renderGraph.addPass("Shadows", renderShadows);
+    renderGraph.write(pass, frame.shadowMap, USAGE_DEPTH_ATTACHMENT);
+    if (deferredEnabled)
+    {
+        pass = renderGraph.addPass("Deferred", renderDeferred);
+        renderGraph.read(pass, frame.shadowMap);
+        renderGraph.write(pass, frame.backbuffer);
+    }
+
+    // transparent shaders blend over everything opaque, whatever the order they were added in
+    for (int transparent = 0; transparent < 2; transparent++)
+    {
+        for (Shader *shader : shaders)
+        {
+            if (shader->isTransparent() == (transparent == 1))
+                shader->addPasses(renderGraph, frame);
+        }
     }
+
+    if (frameCapture != nullptr)
+        frameCapture->addPasses(renderGraph, frame);
+}
+
+const RenderGraph &ResourceManager::getRenderGraph()
+{
+    return renderGraph;
+}
+
+RenderGraphExecutor *ResourceManager::getRenderGraphExecutor()
+{
+    return renderGraphExecutor;
+}
+
+FrameCapture *ResourceManager::getFrameCapture()
+{
+    if (frameCapture == nullptr)
+        frameCapture = new FrameCapture();
+    return frameCapture;
+}
+
+// writes out the captures still in flight, needs the context
+void ResourceManager::releaseFrameCapture()
+{
+    delete frameCapture;
+    frameCapture = nullptr;
 }
 
 void ResourceManager::setActiveCamera(Camera *camera)
@@ -284,6 +424,8 @@ Camera *ResourceManager::getActiveCamera()
 
 void ResourceManager::updateMousePressed()
 {
+    if (window == nullptr)
+        return;
     for (int i = 0; i < 8; i++)
     {
         if (glfwGetMouseButton(window, i) == GLFW_PRESS)
@@ -318,15 +460,215 @@ PointLight *ResourceManager::loadPointLight(float strength, glm::vec3 position,
     return light;
 }
 
-void ResourceManager::setMouseEnabled(bool isEnabled)
+void ResourceManager::updateLightClusters()
+{
+    PROFILE_FUNCTION();
+    if (lightClusterBuffers[0] == 0)
+    {
+        glGenBuffers(3, lightClusterBuffers);
+        glGenTextures(3, lightClusterTextures);
+    }
+
+    // 4 texels per light: position + range, then ambient, diffuse and specular
+    // each with one of the constant, linear and quadratic attenuation terms
+    glm::mat4 view = activeCamera->getViewMatrix();
+    std::vector<glm::vec4> viewLights;
+    std::vector<glm::vec4> lightData;
+    for (PointLight *light : pointLights)
+    {
+        if (!light->isLightOn())
+            continue;
+        glm::vec3 position = light->getWorldPosition();
+        float range = light->getRange();
+        viewLights.push_back(glm::vec4(glm::vec3(view * glm::vec4(position, 1.0f)), range));
+        lightData.push_back(glm::vec4(position, range));
+        lightData.push_back(glm::vec4(light->getAmbient(), light->getConstant()));
+        lightData.push_back(glm::vec4(light->getDiffuse(), light->getLinear()));
+        lightData.push_back(glm::vec4(light->getSpecular(), light->getQuadratic()));
+    }
+    lightClusterLightCount = viewLights.size();
+
+    lightClusters.setProjection(activeCamera->getProjectionMatrix());
+    lightClusters.assign(viewLights);
+
+    // texture buffers can't be empty
+    std::vector<unsigned int> indices = lightClusters.getIndices();
+    if (lightData.empty())
+        lightData.push_back(glm::vec4(0.0f));
+    if (indices.empty())
+        indices.push_back(0);
+
+    const std::vector<unsigned int> &grid = lightClusters.getGrid();
+    const void *data[3] = {lightData.data(), grid.data(), indices.data()};
+    size_t sizes[3] = {lightData.size() * sizeof(glm::vec4), grid.size() * sizeof(unsigned int), indices.size() * sizeof(unsigned int)};
+    GLenum formats[3] = {GL_RGBA32F, GL_RG32UI, GL_R32UI};
+    for (int i = 0; i < 3; i++)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, lightClusterBuffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, sizes[i], data[i], GL_STREAM_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, lightClusterTextures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, formats[i], lightClusterBuffers[i]);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    lightClusterViewport = glm::vec4(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+void ResourceManager::bindLightClusters(Shader *shader)
+{
+    const char *samplers[3] = {"lightData", "lightGrid", "lightIndices"};
+    for (int i = 0; i < 3; i++)
+    {
+        glActiveTexture(GL_TEXTURE0 + lightClusterTextureUnit + i);
+        glBindTexture(GL_TEXTURE_BUFFER, lightClusterTextures[i]);
+        shader->SetInteger(samplers[i], lightClusterTextureUnit + i);
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    glm::ivec3 gridSize = lightClusters.getGridSize();
+    glm::vec2 tileSize = glm::vec2(lightClusterViewport.z / gridSize.x, lightClusterViewport.w / gridSize.y);
+    shader->SetVector3f("clusterCount", glm::vec3(gridSize));
+    shader->SetVector2f("clusterOrigin", glm::vec2(lightClusterViewport));
+    shader->SetVector2f("clusterTileSize", tileSize);
+    shader->SetFloat("clusterScale", lightClusters.getSliceScale());
+    shader->SetFloat("clusterBias", lightClusters.getSliceBias());
+    shader->SetInteger("numPointLights", lightClusterLightCount);
+}
+
+const LightClusters &ResourceManager::getLightClusters()
+{
+    return lightClusters;
+}
+
+void ResourceManager::renderShadows()
+{
+    DirectionalLight *light = directionalLights.empty() ? nullptr : directionalLights[0];
+    if (!shadowsEnabled || light == nullptr || !light->getCastShadows() || !light->isLightOn())
+    {
+        if (shadowMap != nullptr)
+            shadowMap->render(activeCamera, nullptr, std::vector<RenderModule *>());
+        return;
+    }
+    if (shadowMap == nullptr)
+    {
+        std::string vShaderPath = std::string(SRC_DIR) + "/shaders/shadow/shadowDepth.vert";
+        std::string fShaderPath = std::string(SRC_DIR) + "/shaders/shadow/shadowDepth.frag";
+        shadowMap = new CascadedShadowMap(vShaderPath.c_str(), fShaderPath.c_str());
+    }
+
+    // everything drawn with a model casts, whichever shader draws it
+    std::vector<RenderModule *> casters;
+    for (Shader *shader : shaders)
+    {
+        for (RenderModule *module : shader->getRenderModules())
+        {
+            if (module->isEnabled && module->model != nullptr)
+                casters.push_back(module);
+        }
+    }
+    shadowMap->render(activeCamera, light, casters);
+}
+
+void ResourceManager::setShadowsEnabled(bool enabled)
+{
+    shadowsEnabled = enabled;
+}
+
+CascadedShadowMap *ResourceManager::getShadowMap()
+{
+    return shadowMap;
+}
+
+void ResourceManager::renderDeferred()
+{
+    if (deferredRenderer == nullptr)
+    {
+        std::string vShaderPath = std::string(SRC_DIR) + "/shaders/deferred/deferredLighting.vert";
+        std::string fShaderPath = std::string(SRC_DIR) + "/shaders/deferred/deferredLighting.frag";
+        std::string gBufferVShaderPath = std::string(SRC_DIR) + "/shaders/deferred/gBuffer.vert";
+        std::string gBufferFShaderPath = std::string(SRC_DIR) + "/shaders/deferred/gBuffer.frag";
+        deferredRenderer = new DeferredRenderer(vShaderPath.c_str(), fShaderPath.c_str(), gBufferVShaderPath.c_str(), gBufferFShaderPath.c_str());
+    }
+    deferredRenderer->render(shaders, directionalLights.empty() ? nullptr : directionalLights[0]);
+}
+
+void ResourceManager::setDeferredEnabled(bool enabled)
+{
+    deferredEnabled = enabled;
+}
+
+bool ResourceManager::isDeferredEnabled()
+{
+    return deferredEnabled;
+}
+
+DeferredRenderer *ResourceManager::getDeferredRenderer()
+{
+    return deferredRenderer;
+}
+
+void ResourceManager::setAdaptiveTessellation(bool enabled)
 {
-    if (isEnabled)
+    adaptiveTessellation = enabled;
+}
+
+bool ResourceManager::isAdaptiveTessellation()
+{
+    return adaptiveTessellation;
+}
+
+void ResourceManager::setScreenSpaceOutlines(bool enabled)
+{
+    screenSpaceOutlines = enabled;
+}
+
+bool ResourceManager::isScreenSpaceOutlines()
+{
+    return screenSpaceOutlines;
+}
+
+void ResourceManager::setEnvironment(Cubemap *cubemap)
+{
+    if (imageBasedLighting == nullptr)
+    {
+        if (cubemap == nullptr)
+            return;
+        imageBasedLighting = new ImageBasedLighting();
+    }
+    imageBasedLighting->setEnvironment(cubemap);
+}
+
+void ResourceManager::bindEnvironment(Shader *shader)
+{
+    if (imageBasedLighting != nullptr)
     {
-        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        imageBasedLighting->bind(shader);
+        return;
     }
-    else
+    shader->SetInteger("prefilteredMap", ImageBasedLighting::textureUnit);
+    shader->SetInteger("brdfLUT", ImageBasedLighting::textureUnit + 1);
+    shader->SetInteger("hasEnvironment", 0);
+}
+
+void ResourceManager::bindShadows(Shader *shader)
+{
+    if (shadowMap != nullptr)
     {
-        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+        shadowMap->bind(shader);
+        return;
+    }
+    shader->SetInteger("shadowMap", CascadedShadowMap::textureUnit);
+    shader->SetInteger("numCascades", 0);
+}
+
+void ResourceManager::setMouseEnabled(bool isEnabled)
+{
+    if (window != nullptr)
+    {
+        glfwSetInputMode(window, GLFW_CURSOR, isEnabled ? GLFW_CURSOR_DISABLED : GLFW_CURSOR_NORMAL);
     }
     isMouseEnabled = isEnabled;
 }
@@ -346,24 +688,123 @@ keyData ResourceManager::getMouseData(int button)
     return mouseStates[button];
 }
 
-void ResourceManager::addGeometryInfo(GameObject *gameObject, std::vector<glm::vec3> vertexPositions)
+void ResourceManager::addGeometryInfo(GameObject *gameObject, std::vector<glm::vec3> vertexPositions, const std::vector<unsigned int> &indices)
+{
+    pickableVerticies[gameObject].build(vertexPositions);
+    if (!indices.empty())
+    {
+        pickableMeshes[gameObject].build(vertexPositions, indices);
+    }
+    deformedGeometry.erase(gameObject);
+}
+
+// only marks the object, a mesh deformed every frame is read and refit when
+// something is picked
+void ResourceManager::updateGeometryInfo(GameObject *gameObject, const std::vector<glm::vec4> *vertexPositions)
+{
+    if (pickableVerticies.find(gameObject) == pickableVerticies.end())
+    {
+        return;
+    }
+    DeformedGeometry &geometry = deformedGeometry[gameObject];
+    geometry.positions = vertexPositions;
+    geometry.dirty = true;
+}
+
+void ResourceManager::refitGeometry()
 {
-    pickableVerticies[gameObject] = vertexPositions;
+    static std::vector<glm::vec3> positions;
+    for (auto &pair : deformedGeometry)
+    {
+        if (!pair.second.dirty)
+        {
+            continue;
+        }
+        pair.second.dirty = false;
+        const std::vector<glm::vec4> &deformed = *pair.second.positions;
+        VertexBVH &vertices = pickableVerticies[pair.first];
+        if (vertices.size() != deformed.size())
+        {
+            continue;
+        }
+        positions.resize(deformed.size());
+        for (int i = 0; i < deformed.size(); i++)
+        {
+            positions[i] = glm::vec3(deformed[i]);
+        }
+        vertices.refit(positions);
+        std::map<GameObject *, TriangleBVH>::iterator mesh = pickableMeshes.find(pair.first);
+        if (mesh != pickableMeshes.end())
+        {
+            mesh->second.refit(positions);
+        }
+    }
 }
 
+// surface point under the mouse, ray cast on the CPU against the pickable meshes;
+// misses return the far plane point, as the old depth readback did
 glm::vec3 ResourceManager::getMouseRayHit()
 {
+    Ray ray = getMouseRay();
+    RayHit hit;
+    if (raycast(ray, hit) != nullptr)
+    {
+        return ray.at(hit.distance);
+    }
+
     int mouseX = ResourceManager::getMouseX();
     int mouseY = ResourceManager::getMouseY();
-    int screenWidth = ResourceManager::getScreenWidth();
-    int screenHeight = ResourceManager::getScreenHeight();
-    glm::mat4 projectionMatrix = ResourceManager::getActiveCamera()->getProjectionMatrix();
-    glm::mat4 viewMatrix = ResourceManager::getActiveCamera()->getViewMatrix();
+    glm::vec3 window = glm::vec3(mouseX, screenHeight - mouseY - 1, 1.0f);
+    return glm::unProject(window, activeCamera->getViewMatrix(), activeCamera->getProjectionMatrix(), glm::vec4(0, 0, screenWidth, screenHeight));
+}
 
-    glm::vec3 window = glm::vec3(mouseX, screenHeight - mouseY - 1, 0);
-    glReadPixels(mouseX, screenHeight - mouseY - 1, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &window.z);
+Ray ResourceManager::getMouseRay()
+{
+    int mouseX = ResourceManager::getMouseX();
+    int mouseY = ResourceManager::getMouseY();
+    glm::mat4 projectionMatrix = activeCamera->getProjectionMatrix();
+    glm::mat4 viewMatrix = activeCamera->getViewMatrix();
+    glm::vec4 viewport = glm::vec4(0, 0, screenWidth, screenHeight);
 
-    return glm::unProject(window, viewMatrix, projectionMatrix, glm::vec4(0, 0, screenWidth, screenHeight));
+    glm::vec3 nearPoint = glm::unProject(glm::vec3(mouseX, screenHeight - mouseY - 1, 0.0f), viewMatrix, projectionMatrix, viewport);
+    glm::vec3 farPoint = glm::unProject(glm::vec3(mouseX, screenHeight - mouseY - 1, 1.0f), viewMatrix, projectionMatrix, viewport);
+    return Ray(nearPoint, glm::normalize(farPoint - nearPoint));
+}
+
+// the top level tree only holds one box per object, so it is rebuilt from the
+// current transforms on every query
+void ResourceManager::updateSceneBVH()
+{
+    refitGeometry();
+    sceneBVH.clear();
+    sceneObjects.clear();
+    for (auto &pair : pickableMeshes)
+    {
+        sceneBVH.add(&pair.second, pair.first->getTransform(), sceneObjects.size());
+        sceneObjects.push_back(pair.first);
+    }
+    sceneBVH.build();
+}
+
+GameObject *ResourceManager::raycast(const Ray &ray, RayHit &hit)
+{
+    updateSceneBVH();
+    if (!sceneBVH.intersect(ray, hit))
+    {
+        return nullptr;
+    }
+    return sceneObjects[hit.object];
+}
+
+void ResourceManager::raycast(const std::vector<Ray> &rays, std::vector<RayHit> &hits, std::vector<GameObject *> &objects)
+{
+    updateSceneBVH();
+    sceneBVH.intersect(rays, hits);
+    objects.resize(hits.size());
+    for (int i = 0; i < hits.size(); i++)
+    {
+        objects[i] = hits[i].isHit() ? sceneObjects[hits[i].object] : nullptr;
+    }
 }
 
 glm::vec3 ResourceManager::getMouseRayOrigin()
@@ -381,35 +822,66 @@ glm::vec3 ResourceManager::getMouseRayOrigin()
 
 GameObject *ResourceManager::checkMouseVertexPick(glm::vec3 &vertex, int &vertexIndex)
 {
-    glm::vec3 mouseRayDirection = getMouseRayHit();
+    // pick along the mouse ray, but not past the visible surface under the cursor
+    glm::vec3 hit = getMouseRayHit();
+    glm::vec3 origin = getMouseRayOrigin();
+    glm::vec3 direction = hit - origin;
+    float maxT = glm::length(direction);
+    if (maxT <= 0.0f)
+    {
+        return nullptr;
+    }
+    return checkRayVertexPick(origin, direction / maxT, 1.0f, maxT + 1.0f, vertex, vertexIndex);
+}
+
+GameObject *ResourceManager::checkRayVertexPick(glm::vec3 origin, glm::vec3 direction, float maxDistance, float maxT, glm::vec3 &vertex, int &vertexIndex)
+{
+    refitGeometry();
     GameObject *closestGameObject = nullptr;
-    glm::vec3 closestVertex = glm::vec3(0, 0, 0);
-    
-    float closestDistance = 1000000;
-    for ( const auto& pair : pickableVerticies)
+    float closestDistance = maxDistance;
+
+    for (auto &pair : pickableVerticies)
     {
-        GameObject* gameObject = pair.first;
-        const std::vector<glm::vec3> vertices = pair.second;
+        GameObject *gameObject = pair.first;
+        const VertexBVH &bvh = pair.second;
+        if (bvh.empty())
+        {
+            continue;
+        }
 
+        // query in object space; distances scale by the object's scale, which is
+        // exact for uniform scaling and conservative (smallest axis) otherwise
         glm::mat4 modelMatrix = gameObject->getTransform();
-        for (int i = 0; i < vertices.size(); i++)
+        glm::mat4 inverseModel = glm::inverse(modelMatrix);
+        float scale = glm::min(glm::length(glm::vec3(modelMatrix[0])), glm::min(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+        if (scale <= 0.0f)
         {
-            glm::vec4 vertex = modelMatrix * glm::vec4(vertices[i], 1);
-            float distance = glm::distance(glm::vec3(vertex), mouseRayDirection);
-            if (distance < closestDistance)
-            {
-                closestDistance = distance;
-                closestVertex = glm::vec3(vertex);
-                closestGameObject = gameObject;
-                vertexIndex = i;
-            }
+            continue;
         }
-    }
 
-    if(closestDistance > 1.0f){
-        return nullptr;
+        glm::vec3 localOrigin = glm::vec3(inverseModel * glm::vec4(origin, 1.0f));
+        glm::vec3 localEnd = glm::vec3(inverseModel * glm::vec4(origin + direction * maxT, 1.0f));
+        glm::vec3 localDirection = localEnd - localOrigin;
+        float localMaxT = glm::length(localDirection);
+        if (localMaxT <= 0.0f)
+        {
+            continue;
+        }
+
+        float localDistance;
+        glm::vec3 localVertex;
+        int index = bvh.nearestToRay(localOrigin, localDirection / localMaxT, closestDistance / scale, localMaxT, &localDistance, &localVertex);
+        if (index == -1 || localDistance * scale >= closestDistance)
+        {
+            continue;
+        }
+
+        closestDistance = localDistance * scale;
+        closestGameObject = gameObject;
+        vertex = glm::vec3(modelMatrix * glm::vec4(localVertex, 1.0f));
+        vertexIndex = index;
     }
-    vertex = closestVertex;
+
     return closestGameObject;
 }
 
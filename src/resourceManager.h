@@ -15,10 +15,19 @@
 #include "lights.h"
 #include "camera.h"
 #include "bone.h"
+#include "utils/vertexBVH.h"
+#include "utils/raycast.h"
+#include "utils/lightClusters.h"
+#include "utils/renderGraph.h"
 
 class Model;
 class Bone;
-class Ray;
+class CascadedShadowMap;
+class DeferredRenderer;
+class ImageBasedLighting;
+class RenderGraphExecutor;
+class FrameCapture;
+class Cubemap;
 
 struct keyData{
     float pressDuration;
@@ -27,8 +36,14 @@ struct keyData{
 
 class ResourceManager {
 public:
-    static GLFWwindow* createWindow(int width = 800, int height = 600, const char* title = "Graphics");
+    static GLFWwindow* createWindow(int width = 800, int height = 600, const char* title = "Graphics", bool visible = true);
     static GLFWwindow* getWindow();
+    // the framebuffer a frame ends up in: 0 with a window, the offscreen
+    // context's FBO in headless runs without one (window is null then)
+    static GLuint getBackBuffer() { return backBuffer; };
+    static void setBackBuffer(GLuint framebuffer, int width, int height);
+    // GL entry points of whichever context is current
+    static void* getProcAddress(const char* name);
 
     //Resource management
     static Shader* addShader(Shader* shader);
@@ -44,9 +59,43 @@ public:
     static DirectionalLight* loadDirectionalLight(float strength, glm::vec3 rotation);
     static PointLight* loadPointLight(float strength ,glm::vec3 position, float constant, float linear, float quadratic);
 
+    //Clustered lighting, rebuilt every frame before the shaders render
+    static void bindLightClusters(Shader* shader);
+    static const LightClusters& getLightClusters();
+
+    //Directional light shadows, rendered before the shaders when enabled
+    static void setShadowsEnabled(bool enabled);
+    static CascadedShadowMap* getShadowMap();
+    static void bindShadows(Shader* shader);
+
+    //Deferred path for the phong, toon and PBR shaders, forward shaders draw on top
+    static void setDeferredEnabled(bool enabled);
+    static bool isDeferredEnabled();
+    static DeferredRenderer* getDeferredRenderer();
+
+    //Screen size driven tessellation levels and patch culling, uniform material levels when off
+    static void setAdaptiveTessellation(bool enabled);
+    static bool isAdaptiveTessellation();
+
+    //The last frame's passes, see utils/renderGraph.h
+    static const RenderGraph& getRenderGraph();
+    static RenderGraphExecutor* getRenderGraphExecutor();
+    //Asynchronous screenshots and depth captures, created on first use
+    static FrameCapture* getFrameCapture();
+    static void releaseFrameCapture();
+
+    //Toon outlines from one full screen edge pass instead of inverted hull draws
+    static void setScreenSpaceOutlines(bool enabled);
+    static bool isScreenSpaceOutlines();
+
+    //Image based ambient light for the PBR shaders from a skybox, nullptr for the constant ambient
+    static void setEnvironment(Cubemap* cubemap);
+    static void bindEnvironment(Shader* shader);
+
     //IO events
     static float getDeltaTime();
     static void updateDeltaTime();
+    static void setFixedDeltaTime(float deltaTime);
     static void updateKeysPressed();
     static bool isKeyPressed(int key);
     static void updateMousePosition();
@@ -66,8 +115,15 @@ public:
     static int getScreenHeight() { return screenHeight; };
     static glm::vec3 getMouseRayHit();
     static glm::vec3 getMouseRayOrigin();
-    static void addGeometryInfo(GameObject* gameObject, std::vector<glm::vec3> vertexPositions);
+    static Ray getMouseRay();
+    static GameObject* raycast(const Ray& ray, RayHit& hit);
+    static void raycast(const std::vector<Ray>& rays, std::vector<RayHit>& hits, std::vector<GameObject*>& objects);
+    static void addGeometryInfo(GameObject* gameObject, std::vector<glm::vec3> vertexPositions, const std::vector<unsigned int>& indices = std::vector<unsigned int>());
+    // moved vertices of an object added above (same count and order); its trees are refit before the next pick.
+    // Only the pointer is kept and read at that pick, so the positions have to outlive the object's picking
+    static void updateGeometryInfo(GameObject* gameObject, const std::vector<glm::vec4>* vertexPositions);
     static GameObject* checkMouseVertexPick(glm::vec3& vertex, int& vertexIndex);
+    static GameObject* checkRayVertexPick(glm::vec3 origin, glm::vec3 direction, float maxDistance, float maxT, glm::vec3& vertex, int& vertexIndex);
     static GameObject* getCurrentlySelected();
     static void setCurrentlySelected(GameObject* selected);
 
@@ -79,8 +135,10 @@ private:
     static bool isDebug;
     static bool isMouseEnabled;
     static GLFWwindow* window;
+    static GLuint backBuffer;
     static int screenWidth, screenHeight;
     static float deltaTime, previousTime;
+    static float fixedDeltaTime;
     static double mouseX, mouseY, lastMouseX, lastMouseY;
     static Camera* activeCamera;
     static std::unordered_map<int, keyData> keyStates;
@@ -92,7 +150,37 @@ private:
     static std::vector<GameObject*> gameObjects;
     static std::vector<PointLight*> pointLights;
     static std::vector<DirectionalLight*> directionalLights;
-    static std::map<GameObject*, std::vector<glm::vec3>> pickableVerticies;
+    static std::map<GameObject*, VertexBVH> pickableVerticies;
+    static std::map<GameObject*, TriangleBVH> pickableMeshes;
+    struct DeformedGeometry {
+        const std::vector<glm::vec4>* positions;
+        bool dirty;
+    };
+    static std::map<GameObject*, DeformedGeometry> deformedGeometry;
+    static void refitGeometry();
+    static std::vector<GameObject*> sceneObjects;
+    static SceneBVH sceneBVH;
+    static void updateSceneBVH();
+    static const int lightClusterTextureUnit = 13; // light data, cluster grid, light indices
+    static LightClusters lightClusters;
+    static GLuint lightClusterBuffers[3];
+    static GLuint lightClusterTextures[3];
+    static glm::vec4 lightClusterViewport;
+    static int lightClusterLightCount;
+    static void updateLightClusters();
+    static bool shadowsEnabled;
+    static CascadedShadowMap* shadowMap;
+    static void renderShadows();
+    static bool deferredEnabled;
+    static bool adaptiveTessellation;
+    static bool screenSpaceOutlines;
+    static DeferredRenderer* deferredRenderer;
+    static void renderDeferred();
+    static RenderGraph renderGraph;
+    static RenderGraphExecutor* renderGraphExecutor;
+    static FrameCapture* frameCapture;
+    static void buildRenderGraph();
+    static ImageBasedLighting* imageBasedLighting;
     static GameObject* currentlySelected;
 };
 
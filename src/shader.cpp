@@ -1,19 +1,28 @@
 #include "shader.h"
+#include "shaderManager.h"
 #include "entityModules/renderModule.h"
 #include "lights.h"
+#include "utils/profiler.h"
+#include "shaders/renderGraph/renderGraphExecutor.h"
 
 	Shader::Shader() {}
 
 	Shader::Shader(const char* PVS, const char* PFS, const char* PGS, const char* PTS, const char* TES) {
-		this->Compile(this->readShaderSource(PVS), this->readShaderSource(PFS), this->readShaderSource(PGS), this->readShaderSource(PTS), this->readShaderSource(TES));
+		this->Load(PVS, PFS, PGS, PTS, TES);
+	}
+
+	Shader::~Shader() {
+		ShaderManager::untrack(this);
 	}
 	
 	Shader& Shader::Use() {
+		this->finishLink();
 		glUseProgram(ID);
 		return *this;
 	}
 
 	unsigned int Shader::getID() const {
+		this->finishLink();
 		return ID;
 	}
 
@@ -119,6 +128,7 @@
 	}
 
 	void Shader::Compile(const char* PVS, const char* PFS, const char* PGS, const char* PTS, const char* TES) {
+		PROFILE_FUNCTION();
 		if (!PVS || !PFS) {
 			#ifdef __APPLE__
 				throw "SHADER_LINKING_ERROR: Shader data is empty";
@@ -127,52 +137,73 @@
 			#endif
 		}
 
-		ID = glCreateProgram();
+		const char* sources[ShaderManager::stageCount] = { PVS, PFS, PGS, PTS, TES };
+		ID = ShaderManager::beginProgram(sources);
 		if (ID == 0)
 		{
 			fprintf(stderr, "Error creating shader program\n");
 			exit(1);
 		}
+		linking = true;
+		ShaderManager::track(this);
+	}
 
-		unsigned int vertex, fragment, geometry, tessControl, tessEval;
-
-		vertex = this->AddShader(PVS, GL_VERTEX_SHADER);
-		fragment = this->AddShader(PFS, GL_FRAGMENT_SHADER);
-		if (PGS) {
-			geometry = this->AddShader(PGS, GL_GEOMETRY_SHADER);
+	void Shader::Load(const char* PVS, const char* PFS, const char* PGS, const char* PTS, const char* TES) {
+		const char* paths[ShaderManager::stageCount] = { PVS, PFS, PGS, PTS, TES };
+		std::string sources[ShaderManager::stageCount];
+		const char* stages[ShaderManager::stageCount];
+		sourcePaths.assign(ShaderManager::stageCount, std::string());
+		for (int stage = 0; stage < ShaderManager::stageCount; stage++) {
+			bool loaded = paths[stage] && this->readShaderSource(paths[stage], sources[stage]);
+			stages[stage] = loaded ? sources[stage].c_str() : nullptr;
+			if (paths[stage]) {
+				sourcePaths[stage] = paths[stage];
+			}
 		}
-		if (PTS) {
-			tessControl = this->AddShader(PTS, GL_TESS_CONTROL_SHADER);
+		this->Compile(stages[0], stages[1], stages[2], stages[3], stages[4]);
+	}
+
+	bool Shader::Reload() {
+		if (sourcePaths.empty()) {
+			return false;
 		}
-		if (TES) {
-			tessEval = this->AddShader(TES, GL_TESS_EVALUATION_SHADER);
+		std::string sources[ShaderManager::stageCount];
+		const char* stages[ShaderManager::stageCount];
+		for (int stage = 0; stage < ShaderManager::stageCount; stage++) {
+			stages[stage] = nullptr;
+			if (sourcePaths[stage].empty()) {
+				continue;
+			}
+			if (!this->readShaderSource(sourcePaths[stage].c_str(), sources[stage])) {
+				return false;
+			}
+			stages[stage] = sources[stage].c_str();
 		}
 
-		GLint Success = 0;
-		GLchar ErrorLog[1024] = { 0 };
-
-		// After compiling all shader objects and attaching them to the program, we can finally link it
-		glLinkProgram(ID);
-		glGetProgramiv(ID, GL_LINK_STATUS, &Success);
-		if (Success == 0)
-		{
-			glGetProgramInfoLog(ID, sizeof(ErrorLog), NULL, ErrorLog);
-			fprintf(stderr, "Error linking shader program: '%s'\n", ErrorLog);
-			exit(1);
+		this->finishLink();
+		std::string log;
+		GLuint program = ShaderManager::beginProgram(stages);
+		if (program == 0 || !ShaderManager::finishProgram(program, log)) {
+			fprintf(stderr, "Error reloading shader program %s: '%s'\n", sourcePaths[0].c_str(), log.c_str());
+			glDeleteProgram(program);
+			return false;
 		}
+		ShaderManager::copyUniforms(ID, program);
+		glDeleteProgram(ID);
+		ID = program;
+		return true;
+	}
 
-		glDeleteShader(vertex);
-		glDeleteShader(fragment);
-		if (PGS) {
-			glDeleteShader(geometry);
-		}
-		if (PTS) {
-			glDeleteShader(tessControl);
+	void Shader::finishLink() const {
+		if (!linking) {
+			return;
 		}
-		if (TES) {
-			glDeleteShader(tessEval);
+		linking = false;
+		std::string log;
+		if (!ShaderManager::finishProgram(ID, log)) {
+			fprintf(stderr, "Error building shader program: '%s'\n", log.c_str());
+			exit(1);
 		}
-	
 	}
 
 	void Shader::Delete()
@@ -190,6 +221,25 @@
         }
 	}; // override in inherited class
 
+	void Shader::addPasses(RenderGraph& graph, const FrameResources& frame) {
+		bool overlay = frame.deferred && getShadingModel() != SHADING_FORWARD;
+		int pass = graph.addPass(getTypeName(), [this, overlay]() {
+			if (overlay)
+				this->RenderOverlay();
+			else
+				this->Render();
+		});
+		graph.read(pass, frame.shadowMap);
+		graph.write(pass, frame.backbuffer);
+	}
+
+	const char* Shader::getTypeName() {
+		// on first use, during construction typeid would see the base class
+		if (typeName == nullptr)
+			typeName = Profiler::typeName(typeid(*this));
+		return typeName;
+	}
+
 	void Shader::bindRenderModule(RenderModule* object) {
 		objectsToRender.push_back(object);
 	}
@@ -202,7 +252,7 @@
 		pointLightsToRender.push_back(light);
 	}
 
-	char* Shader::readShaderSource(const char* shaderFile) {
+	bool Shader::readShaderSource(const char* shaderFile, std::string& source) {
 		FILE* fp;
 		#ifdef _WIN32
 			fopen_s(&fp, shaderFile, "rb");
@@ -212,47 +262,19 @@
 
 		if (fp == NULL) { 
 			std::cout << "Shader could not be loaded." << std::endl;	
-			return NULL; 
+			return false; 
 		}
 
 		fseek(fp, 0L, SEEK_END);
 		long size = ftell(fp);
 
 		fseek(fp, 0L, SEEK_SET);
-		char* buf = new char[size + 1];
-		fread(buf, 1, size, fp);
-		buf[size] = '\0';
+		source.resize(size);
+		if (size > 0) {
+			fread(&source[0], 1, size, fp);
+		}
 
 		fclose(fp);
 
-		return buf;
+		return true;
 	}
-
-	unsigned int Shader::AddShader(const char* shaderText, GLenum shaderType)
-	{
-		// Create Shader Object and get its reference
-		unsigned int ShaderObj = glCreateShader(shaderType);
-		if (ShaderObj == 0)
-		{
-			fprintf(stderr, "Error creating shader type %d\n", ShaderObj);
-			exit(0);
-		}
-		// Attach Shader source to the Vertex Shader Object
-		glShaderSource(ShaderObj, 1, (const char**)&shaderText, NULL);
-		// Compile the  Shader into machine code
-		glCompileShader(ShaderObj);
-		// Check for shader related errors using glGetShaderiv
-		GLint success;
-		glGetShaderiv(ShaderObj, GL_COMPILE_STATUS, &success);
-		if (!success)
-		{
-			char InfoLog[1024];
-			glGetShaderInfoLog(ShaderObj, 1024, NULL, InfoLog);
-			fprintf(stderr, "Error compiling shader type %d: '%s'\n", shaderType, InfoLog);
-			exit(1);
-		}
-
-		// Attach the Shader to the Shader Program
-		glAttachShader(ID, ShaderObj);
-		return ShaderObj;
-	}
\ No newline at end of file
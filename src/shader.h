@@ -11,11 +11,23 @@
 class RenderModule;
 class DirectionalLight;
 class PointLight;
+class RenderGraph;
+struct FrameResources;
+
+// Lighting a shader gives its objects. Everything but SHADING_FORWARD can be
+// drawn by the deferred path, see shaders/deferred/deferredRenderer.h
+enum ShadingModel {
+    SHADING_FORWARD,
+    SHADING_PHONG,
+    SHADING_TOON,
+    SHADING_PBR
+};
 
 class Shader {
 public:
     Shader();
     Shader(const char* PVS, const char* PFS, const char* PGS = nullptr, const char* PTS = nullptr, const char* TES = nullptr);
+    virtual ~Shader();
     Shader& Use();
     unsigned int getID() const;
 
@@ -31,24 +43,45 @@ public:
     void SetVector4f(const std::string& name, const glm::vec4& value, bool useShader = false);
     void SetMatrix4(const std::string& name, const glm::mat4& matrix, bool useShader = false);
 
+    // the program is built through ShaderManager: from its binary cache when it can, and its
+    // status is only checked on first use so the driver can compile several at once
     void Compile(const char* PVS, const char* PFS, const char* PGS = nullptr, const char* PTS = nullptr, const char* TES = nullptr);
+    // Compile() from files, which ShaderManager reloads when they change
+    void Load(const char* PVS, const char* PFS, const char* PGS = nullptr, const char* PTS = nullptr, const char* TES = nullptr);
+    // rebuilds the program from its files, keeping the old one (and returning false) when that fails
+    bool Reload();
+    // waits for the program to be built, exits when it failed like Compile() did
+    void finishLink() const;
+    // one per stage in Compile() order, empty for the stages not used or without files
+    const std::vector<std::string>& getSourcePaths() const { return sourcePaths; }
     void Delete();
     virtual void Render();
+    virtual ShadingModel getShadingModel() const { return SHADING_FORWARD; }
+    virtual void RenderOverlay() {} // forward extras still drawn when the deferred path lit the objects
+    virtual bool isTransparent() const { return false; } // drawn after every opaque shader
+    // the shader's passes in the frame's render graph, by default one that calls Render()
+    // (RenderOverlay() when the deferred pass lit its objects) and draws to the backbuffer
+    virtual void addPasses(RenderGraph& graph, const FrameResources& frame);
 
     virtual void bindRenderModule(RenderModule* object);
     void bindDirectionalLight(DirectionalLight* light);
     void bindPointLight(PointLight* light);
+    const std::vector<RenderModule*>& getRenderModules() const {return objectsToRender;}
+    // the dynamic type's readable name, looked up once for pass and profiler names
+    const char* getTypeName();
 
 protected:
-    char* readShaderSource(const char* shaderFile);
+    bool readShaderSource(const char* shaderFile, std::string& source);
     std::vector<RenderModule*> objectsToRender;
     std::vector<DirectionalLight*> dirLightsToRender;
     std::vector<PointLight*> pointLightsToRender;
 
 private:
     bool isDebug = false;
-    unsigned int ID;
-    unsigned int AddShader(const char* shaderText, GLenum shaderType);
+    unsigned int ID = 0;
+    mutable bool linking = false;
+    std::vector<std::string> sourcePaths;
+    const char* typeName = nullptr;
 
 
 };
@@ -0,0 +1,336 @@
+#include "shaderManager.h"
+#include "shader.h"
+#include "utils/programCache.h"
+#include "utils/profiler.h"
+#include "resourceManager.h"
+#include <sys/stat.h>
+#include <chrono>
+#include <cstring>
+#include "imgui.h"
+
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+// headless runs have no GLFW to ask the time
+static double getSeconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool ShaderManager::initialized = false;
+bool ShaderManager::parallelCompile = false;
+bool ShaderManager::binariesSupported = false;
+bool ShaderManager::cacheEnabled = true;
+bool ShaderManager::hotReload = true;
+std::string ShaderManager::cacheDirectory = "shader_cache";
+std::string ShaderManager::driver;
+std::unordered_map<GLuint, ShaderManager::Build> ShaderManager::building;
+std::vector<ShaderManager::Watch> ShaderManager::watches;
+double ShaderManager::lastPoll = 0.0;
+int ShaderManager::programCount = 0;
+int ShaderManager::cacheHits = 0;
+int ShaderManager::reloads = 0;
+double ShaderManager::buildSeconds = 0.0;
+
+void ShaderManager::initialize()
+{
+    if (initialized)
+        return;
+    initialized = true;
+    driver = std::string((const char *)glGetString(GL_RENDERER)) + "|" + (const char *)glGetString(GL_VERSION);
+
+    // glProgramBinary is core since 4.1, some drivers still offer no format to use it with
+    GLint formats = 0;
+    if (GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 1))
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    binariesSupported = formats > 0;
+
+    GLint extensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+    for (GLint i = 0; i < extensions && !parallelCompile; i++)
+    {
+        const char *name = (const char *)glGetStringi(GL_EXTENSIONS, i);
+        parallelCompile = strcmp(name, "GL_KHR_parallel_shader_compile") == 0 || strcmp(name, "GL_ARB_parallel_shader_compile") == 0;
+    }
+    if (parallelCompile)
+    {
+        // not in the glad build, both extensions share the entry point's signature
+        PFNGLMAXSHADERCOMPILERTHREADSKHRPROC maxThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)ResourceManager::getProcAddress("glMaxShaderCompilerThreadsKHR");
+        if (maxThreads == nullptr)
+            maxThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)ResourceManager::getProcAddress("glMaxShaderCompilerThreadsARB");
+        if (maxThreads != nullptr)
+            maxThreads(0xFFFFFFFF); // as many as the driver likes
+        else
+            parallelCompile = false;
+    }
+}
+
+GLuint ShaderManager::beginProgram(const char *const sources[stageCount])
+{
+    PROFILE_FUNCTION();
+    initialize();
+    double start = getSeconds();
+    GLuint program = glCreateProgram();
+    if (program == 0)
+        return 0;
+    programCount++;
+
+    Build build;
+    bool useCache = cacheEnabled && binariesSupported;
+    if (useCache)
+    {
+        build.key = ProgramCache::getKey(driver, sources);
+        build.fromCache = loadBinary(program, build.key);
+    }
+    if (build.fromCache)
+    {
+        cacheHits++;
+    }
+    else
+    {
+        static const GLenum types[stageCount] = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER,
+                                                 GL_TESS_CONTROL_SHADER, GL_TESS_EVALUATION_SHADER};
+        for (int stage = 0; stage < stageCount; stage++)
+        {
+            if (sources[stage] == nullptr)
+                continue;
+            GLuint shader = glCreateShader(types[stage]);
+            glShaderSource(shader, 1, &sources[stage], NULL);
+            glCompileShader(shader);
+            glAttachShader(program, shader);
+            build.shaders.push_back(shader);
+        }
+        if (useCache)
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        // neither the compile nor the link status is read here, see finishProgram()
+        glLinkProgram(program);
+    }
+    building[program] = build;
+    buildSeconds += getSeconds() - start;
+    return program;
+}
+
+bool ShaderManager::finishProgram(GLuint program, std::string &log)
+{
+    std::unordered_map<GLuint, Build>::iterator it = building.find(program);
+    if (it == building.end())
+        return true;
+    PROFILE_FUNCTION();
+    double start = getSeconds();
+    Build build = it->second;
+    building.erase(it);
+
+    GLint linked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked)
+    {
+        GLchar errorLog[1024];
+        for (GLuint shader : build.shaders)
+        {
+            GLint compiled = 0;
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+            if (!compiled)
+            {
+                GLint type = 0;
+                glGetShaderiv(shader, GL_SHADER_TYPE, &type);
+                glGetShaderInfoLog(shader, sizeof(errorLog), NULL, errorLog);
+                log += "shader type " + std::to_string(type) + ": " + errorLog + "\n";
+            }
+        }
+        glGetProgramInfoLog(program, sizeof(errorLog), NULL, errorLog);
+        log += errorLog;
+    }
+    for (GLuint shader : build.shaders)
+    {
+        glDetachShader(program, shader);
+        glDeleteShader(shader);
+    }
+    if (linked && !build.fromCache && cacheEnabled && binariesSupported)
+        storeBinary(program, build.key);
+    buildSeconds += getSeconds() - start;
+    return linked != 0;
+}
+
+void ShaderManager::finishAll()
+{
+    PROFILE_FUNCTION();
+    for (const Watch &watch : watches)
+        watch.shader->finishLink();
+}
+
+bool ShaderManager::loadBinary(GLuint program, uint64_t key)
+{
+    uint32_t format;
+    std::vector<unsigned char> binary;
+    if (!ProgramCache::read(ProgramCache::getPath(cacheDirectory, key), key, format, binary))
+        return false;
+    glProgramBinary(program, format, binary.data(), (GLsizei)binary.size());
+    // rejected after a driver update, the program is compiled from source instead
+    GLint linked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    return linked != 0;
+}
+
+void ShaderManager::storeBinary(GLuint program, uint64_t key)
+{
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0 || !ProgramCache::makeDirectory(cacheDirectory))
+        return;
+    std::vector<unsigned char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, NULL, &format, binary.data());
+    if (!ProgramCache::write(ProgramCache::getPath(cacheDirectory, key), key, format, binary))
+        std::cerr << "Could not write program binary to " << cacheDirectory << std::endl;
+}
+
+void ShaderManager::track(Shader *shader)
+{
+    untrack(shader);
+    Watch watch;
+    watch.shader = shader;
+    getModifiedTimes(shader, watch.times);
+    watches.push_back(watch);
+}
+
+void ShaderManager::untrack(Shader *shader)
+{
+    for (size_t i = 0; i < watches.size(); i++)
+    {
+        if (watches[i].shader == shader)
+        {
+            watches.erase(watches.begin() + i);
+            return;
+        }
+    }
+}
+
+void ShaderManager::getModifiedTimes(Shader *shader, std::vector<time_t> &times)
+{
+    const std::vector<std::string> &paths = shader->getSourcePaths();
+    times.assign(paths.size(), 0);
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        struct stat info;
+        if (!paths[i].empty() && stat(paths[i].c_str(), &info) == 0)
+            times[i] = info.st_mtime;
+    }
+}
+
+void ShaderManager::pollChanges()
+{
+    double now = getSeconds();
+    if (!hotReload || now - lastPoll < 0.5)
+        return;
+    PROFILE_FUNCTION();
+    lastPoll = now;
+    std::vector<time_t> times;
+    for (Watch &watch : watches)
+    {
+        if (watch.times.empty())
+            continue;
+        getModifiedTimes(watch.shader, times);
+        if (times == watch.times)
+            continue;
+        // taken as seen even when the build fails, the next save tries again
+        watch.times = times;
+        if (watch.shader->Reload())
+        {
+            reloads++;
+            std::cout << "Reloaded " << watch.shader->getSourcePaths()[0] << std::endl;
+        }
+    }
+}
+
+void ShaderManager::reloadAll()
+{
+    for (Watch &watch : watches)
+    {
+        if (!watch.times.empty() && watch.shader->Reload())
+            reloads++;
+    }
+}
+
+void ShaderManager::copyUniforms(GLuint from, GLuint to)
+{
+    GLint count = 0;
+    glGetProgramiv(from, GL_ACTIVE_UNIFORMS, &count);
+    GLint previous = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+    glUseProgram(to);
+    for (GLint i = 0; i < count; i++)
+    {
+        GLchar name[256];
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(from, i, sizeof(name), NULL, &size, &type, name);
+        std::string base = name;
+        if (base.size() > 3 && base.compare(base.size() - 3, 3, "[0]") == 0)
+            base.resize(base.size() - 3);
+        for (GLint element = 0; element < size; element++)
+        {
+            std::string elementName = size > 1 ? base + "[" + std::to_string(element) + "]" : base;
+            // -1 for members of uniform blocks, which live in buffers and need no copy
+            GLint source = glGetUniformLocation(from, elementName.c_str());
+            GLint target = glGetUniformLocation(to, elementName.c_str());
+            if (source < 0 || target < 0)
+                continue;
+            GLfloat floats[16];
+            GLint ints[4];
+            GLuint uints[4];
+            switch (type)
+            {
+            case GL_FLOAT: glGetUniformfv(from, source, floats); glUniform1fv(target, 1, floats); break;
+            case GL_FLOAT_VEC2: glGetUniformfv(from, source, floats); glUniform2fv(target, 1, floats); break;
+            case GL_FLOAT_VEC3: glGetUniformfv(from, source, floats); glUniform3fv(target, 1, floats); break;
+            case GL_FLOAT_VEC4: glGetUniformfv(from, source, floats); glUniform4fv(target, 1, floats); break;
+            case GL_FLOAT_MAT2: glGetUniformfv(from, source, floats); glUniformMatrix2fv(target, 1, GL_FALSE, floats); break;
+            case GL_FLOAT_MAT3: glGetUniformfv(from, source, floats); glUniformMatrix3fv(target, 1, GL_FALSE, floats); break;
+            case GL_FLOAT_MAT4: glGetUniformfv(from, source, floats); glUniformMatrix4fv(target, 1, GL_FALSE, floats); break;
+            case GL_INT_VEC2: case GL_BOOL_VEC2: glGetUniformiv(from, source, ints); glUniform2iv(target, 1, ints); break;
+            case GL_INT_VEC3: case GL_BOOL_VEC3: glGetUniformiv(from, source, ints); glUniform3iv(target, 1, ints); break;
+            case GL_INT_VEC4: case GL_BOOL_VEC4: glGetUniformiv(from, source, ints); glUniform4iv(target, 1, ints); break;
+            case GL_UNSIGNED_INT: glGetUniformuiv(from, source, uints); glUniform1uiv(target, 1, uints); break;
+            case GL_DOUBLE: case GL_DOUBLE_VEC2: case GL_DOUBLE_VEC3: case GL_DOUBLE_VEC4: break;
+            // int, bool and every sampler type
+            default: glGetUniformiv(from, source, ints); glUniform1iv(target, 1, ints); break;
+            }
+        }
+    }
+    glUseProgram(previous);
+}
+
+void ShaderManager::setHotReload(bool enabled)
+{
+    hotReload = enabled;
+}
+
+bool ShaderManager::isHotReload()
+{
+    return hotReload;
+}
+
+void ShaderManager::setCacheEnabled(bool enabled)
+{
+    cacheEnabled = enabled;
+}
+
+bool ShaderManager::isCacheEnabled()
+{
+    return cacheEnabled;
+}
+
+void ShaderManager::setCacheDirectory(const std::string &directory)
+{
+    cacheDirectory = directory;
+}
+
+void ShaderManager::OnGui()
+{
+    ImGui::Text("%d programs, %d from the cache, %.1f ms", programCount, cacheHits, getBuildMilliseconds());
+    ImGui::Text("Parallel compile: %s, binaries: %s", parallelCompile ? "yes" : "no", binariesSupported ? "yes" : "no");
+    ImGui::Checkbox("Hot reload", &hotReload);
+    ImGui::SameLine();
+    if (ImGui::Button("Reload all"))
+        reloadAll();
+    ImGui::Text("%d reloads", reloads);
+}
@@ -0,0 +1,96 @@
+#ifndef SHADER_MANAGER_H
+#define SHADER_MANAGER_H
+
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <ctime>
+#include <stdint.h>
+
+class Shader;
+
+// Builds every Shader's program and keeps them in sync with their files.
+//
+// Startup: a program whose key (see utils/programCache.h) has a binary in the
+// cache directory is loaded with glProgramBinary instead of compiled. The
+// others are compiled and linked without reading their status, which only
+// happens on the program's first use (or in finishAll() at the end of scene
+// setup). With KHR_parallel_shader_compile the driver compiles them on its
+// own threads meanwhile, without it most drivers still defer some of the
+// work. Programs linked from source are stored once their status is known.
+//
+// Hot reload: pollChanges() stats the files of every shader loaded from
+// files, a couple of times a second, and relinks the ones that changed. A
+// failed build prints its log and keeps the old program; a good one takes
+// over the old program's uniform values, so those set once at setup survive.
+
+class ShaderManager {
+public:
+    static const int stageCount = 5;
+
+    // starts building a program from the stages in Shader::Compile order, null for
+    // the stages not used; 0 when no program could be created
+    static GLuint beginProgram(const char* const sources[stageCount]);
+    // waits for a program from beginProgram(), false with the compile and link logs
+    static bool finishProgram(GLuint program, std::string& log);
+    // the status of every program still building, called once the scene is set up
+    static void finishAll();
+
+    // every shader with a program; the ones loaded from files are checked by pollChanges()
+    static void track(Shader* shader);
+    static void untrack(Shader* shader);
+    static void pollChanges();
+    static void reloadAll();
+    // values of the active default block uniforms of from set on to
+    static void copyUniforms(GLuint from, GLuint to);
+
+    static void setHotReload(bool enabled);
+    static bool isHotReload();
+    static void setCacheEnabled(bool enabled);
+    static bool isCacheEnabled();
+    static void setCacheDirectory(const std::string& directory);
+
+    static int getProgramCount() { return programCount; }
+    static int getCacheHits() { return cacheHits; }
+    static int getReloads() { return reloads; }
+    static bool hasParallelCompile() { return parallelCompile; }
+    // render thread time spent creating programs and waiting for them
+    static double getBuildMilliseconds() { return buildSeconds * 1000.0; }
+
+    static void OnGui();
+
+private:
+    struct Build {
+        uint64_t key = 0;
+        bool fromCache = false;
+        std::vector<GLuint> shaders;
+    };
+
+    struct Watch {
+        Shader* shader;
+        std::vector<time_t> times;
+    };
+
+    static bool initialized;
+    static bool parallelCompile;
+    static bool binariesSupported;
+    static bool cacheEnabled;
+    static bool hotReload;
+    static std::string cacheDirectory;
+    static std::string driver;
+    static std::unordered_map<GLuint, Build> building;
+    static std::vector<Watch> watches;
+    static double lastPoll;
+    static int programCount;
+    static int cacheHits;
+    static int reloads;
+    static double buildSeconds;
+
+    static void initialize();
+    static bool loadBinary(GLuint program, uint64_t key);
+    static void storeBinary(GLuint program, uint64_t key);
+    static void getModifiedTimes(Shader* shader, std::vector<time_t>& times);
+};
+
+#endif // SHADER_MANAGER_H
@@ -0,0 +1,304 @@
+#version 330 core
+
+in vec2 TexCoords;
+
+out vec4 FragColor;
+
+// G-buffer, see gBuffer.frag
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gSpecular;
+uniform sampler2D gAmbient;
+uniform sampler2D gDepth;
+
+const int SHADING_PHONG = 1;
+const int SHADING_TOON = 2;
+const int SHADING_PBR = 3;
+const float PI = 3.14159265359;
+
+struct PointLight {
+    vec3 position;
+    float range;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+struct DirLight {
+    vec3 direction;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+uniform DirLight dirLight;
+uniform bool hasDirLight;
+uniform vec3 viewPos;
+uniform mat4 view;
+uniform mat4 inverseViewProjection;
+uniform vec3 pbrLightColor;
+uniform int debugView;
+
+// clustered lights, see ResourceManager::bindLightClusters
+uniform samplerBuffer lightData;
+uniform usamplerBuffer lightGrid;
+uniform usamplerBuffer lightIndices;
+uniform vec3 clusterCount;
+uniform vec2 clusterOrigin;
+uniform vec2 clusterTileSize;
+uniform float clusterScale;
+uniform float clusterBias;
+
+uvec2 getCluster(vec3 worldPos)
+{
+    float depth = -(view * vec4(worldPos, 1.0)).z;
+    ivec3 count = ivec3(clusterCount);
+    ivec2 tile = clamp(ivec2((gl_FragCoord.xy - clusterOrigin) / clusterTileSize), ivec2(0), count.xy - 1);
+    int slice = clamp(int(floor(log(max(depth, 1e-6)) * clusterScale + clusterBias)), 0, count.z - 1);
+    return texelFetch(lightGrid, tile.x + count.x * (tile.y + count.y * slice)).xy;
+}
+
+PointLight getPointLight(int index)
+{
+    vec4 t0 = texelFetch(lightData, 4 * index);
+    vec4 t1 = texelFetch(lightData, 4 * index + 1);
+    vec4 t2 = texelFetch(lightData, 4 * index + 2);
+    vec4 t3 = texelFetch(lightData, 4 * index + 3);
+    return PointLight(t0.xyz, t0.w, t1.xyz, t2.xyz, t3.xyz, t1.w, t2.w, t3.w);
+}
+
+// directional light shadows, see CascadedShadowMap::bind
+uniform sampler2DShadow shadowMap;
+uniform int numCascades;
+uniform mat4 shadowMatrices[4];
+uniform vec4 shadowTileRects[4];
+uniform float cascadeSplits[4];
+uniform float shadowTexelSize;
+uniform float shadowBias;
+
+float getShadow(vec3 worldPos, vec3 normal, vec3 lightDir)
+{
+    float depth = -(view * vec4(worldPos, 1.0)).z;
+    int cascade = 0;
+    while(cascade < numCascades && depth > cascadeSplits[cascade])
+        cascade++;
+    if(cascade == numCascades)
+        return 1.0;
+
+    // slope scaled bias, then 3x3 taps of the hardware 2x2 PCF kept inside the cascade's tile
+    vec3 coord = (shadowMatrices[cascade] * vec4(worldPos, 1.0)).xyz;
+    float bias = shadowBias * (1.0 + 4.0 * (1.0 - max(dot(normal, lightDir), 0.0)));
+    vec4 rect = shadowTileRects[cascade] + vec4(1.5, 1.5, -1.5, -1.5) * shadowTexelSize;
+    float lit = 0.0;
+    for(int x = -1; x <= 1; x++)
+        for(int y = -1; y <= 1; y++)
+            lit += texture(shadowMap, vec3(clamp(coord.xy + vec2(x, y) * shadowTexelSize, rect.xy, rect.zw), coord.z - bias));
+    return lit / 9.0;
+}
+
+// fades to zero at the range the light was culled with
+float getAttenuation(PointLight light, float distance)
+{
+    float window = clamp(1.0 - pow(distance / light.range, 4.0), 0.0, 1.0);
+    return window * window / (light.constant + light.linear * distance + light.quadratic * distance * distance);
+}
+
+// image based lighting, see ImageBasedLighting::bind
+uniform bool hasEnvironment;
+uniform samplerCube prefilteredMap;
+uniform sampler2D brdfLUT;
+uniform vec3 irradianceSH[9];
+uniform float prefilteredLevels;
+
+// irradiance / pi from the SH coefficients
+vec3 getIrradiance(vec3 n)
+{
+    vec3 result = irradianceSH[0] * 0.282095
+                + irradianceSH[1] * 0.488603 * n.y
+                + irradianceSH[2] * 0.488603 * n.z
+                + irradianceSH[3] * 0.488603 * n.x
+                + irradianceSH[4] * 1.092548 * n.x * n.y
+                + irradianceSH[5] * 1.092548 * n.y * n.z
+                + irradianceSH[6] * 0.315392 * (3.0 * n.z * n.z - 1.0)
+                + irradianceSH[7] * 1.092548 * n.x * n.z
+                + irradianceSH[8] * 0.546274 * (n.x * n.x - n.y * n.y);
+    return max(result, vec3(0.0));
+}
+
+// split sum ambient, as pbrShader.frag
+vec3 getAmbient(vec3 N, vec3 V, vec3 albedo, float metallic, float roughness, vec3 F0)
+{
+    float NdotV = max(dot(N, V), 0.0);
+    vec3 F = F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(1.0 - NdotV, 5.0);
+    vec3 kD = (vec3(1.0) - F) * (1.0 - metallic);
+    vec3 prefiltered = textureLod(prefilteredMap, reflect(-V, N), roughness * prefilteredLevels).rgb;
+    vec2 brdf = texture(brdfLUT, vec2(NdotV, roughness)).rg;
+    return kD * albedo * getIrradiance(N) + prefiltered * (F0 * brdf.x + brdf.y);
+}
+
+// ----------------------------------------------------------------------------
+// blinn-phong and toon, as blinnPhong.frag and toonShader.frag
+
+float getBand(float intensity, float shininess, float bands)
+{
+    intensity = pow(max(intensity, 0.0), shininess);
+    return floor(intensity * bands) / bands;
+}
+
+vec3 shadePhong(vec3 P, vec3 N, vec3 V, bool toon, uvec2 cluster)
+{
+    vec3 diffuseColor = texture(gAlbedo, TexCoords).rgb;
+    vec4 specular = texture(gSpecular, TexCoords);
+    vec4 ambient = texture(gAmbient, TexCoords);
+    float shininess = specular.a * 256.0;
+    float bands = max(floor(ambient.a * 255.0 + 0.5), 1.0);
+    vec3 result = vec3(0.0);
+
+    if(hasDirLight)
+    {
+        vec3 L = normalize(-dirLight.direction);
+        float shadow = getShadow(P, N, L);
+        result += dirLight.ambient * ambient.rgb;
+        if(toon)
+        {
+            float intensity = getBand(dot(L, N) * shadow, shininess, bands);
+            result += (dirLight.diffuse * diffuseColor + dirLight.specular * specular.rgb) * intensity;
+        }
+        else
+        {
+            vec3 H = normalize(L + V);
+            vec3 diffuse = dirLight.diffuse * max(dot(N, L), 0.0) * diffuseColor;
+            vec3 spec = dirLight.specular * pow(max(dot(N, H), 0.0), shininess) * specular.rgb;
+            result += (diffuse + spec) * shadow;
+        }
+    }
+
+    for(uint i = 0u; i < cluster.y; i++)
+    {
+        PointLight light = getPointLight(int(texelFetch(lightIndices, int(cluster.x + i)).r));
+        float distance = length(light.position - P);
+        vec3 L = (light.position - P) / max(distance, 1e-6);
+        vec3 color = light.ambient * ambient.rgb;
+        if(toon)
+        {
+            float intensity = getBand(dot(L, N), shininess, bands);
+            color += (light.diffuse * diffuseColor + light.specular * specular.rgb) * intensity;
+        }
+        else
+        {
+            vec3 H = normalize(L + V);
+            color += light.diffuse * max(dot(N, L), 0.0) * diffuseColor;
+            color += light.specular * pow(max(dot(N, H), 0.0), shininess) * specular.rgb;
+        }
+        result += color * getAttenuation(light, distance);
+    }
+    return result;
+}
+
+// ----------------------------------------------------------------------------
+// Cook-Torrance, as pbrShader.frag
+
+float DistributionGGX(vec3 N, vec3 H, float roughness)
+{
+    float a = roughness * roughness;
+    float a2 = a * a;
+    float NdotH = max(dot(N, H), 0.0);
+    float denom = (NdotH * NdotH * (a2 - 1.0) + 1.0);
+    return a2 / (PI * denom * denom);
+}
+
+float GeometrySchlickGGX(float NdotV, float roughness)
+{
+    float r = (roughness + 1.0);
+    float k = (r * r) / 8.0;
+    return NdotV / (NdotV * (1.0 - k) + k);
+}
+
+float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness)
+{
+    return GeometrySchlickGGX(max(dot(N, V), 0.0), roughness) * GeometrySchlickGGX(max(dot(N, L), 0.0), roughness);
+}
+
+vec3 fresnelSchlick(float cosTheta, vec3 F0)
+{
+    return F0 + (1.0 - F0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
+}
+
+vec3 getRadiance(vec3 N, vec3 V, vec3 L, vec3 radiance, vec3 albedo, float metallic, float roughness, vec3 F0)
+{
+    vec3 H = normalize(V + L);
+    float NDF = DistributionGGX(N, H, roughness);
+    float G = GeometrySmith(N, V, L, roughness);
+    vec3 F = fresnelSchlick(clamp(dot(H, V), 0.0, 1.0), F0);
+    vec3 specular = NDF * G * F / (4.0 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0) + 0.0001);
+    vec3 kD = (vec3(1.0) - F) * (1.0 - metallic);
+    return (kD * albedo / PI + specular) * radiance * max(dot(N, L), 0.0);
+}
+
+vec3 shadePBR(vec3 P, vec3 N, vec3 V, uvec2 cluster)
+{
+    vec4 albedo = texture(gAlbedo, TexCoords);
+    vec2 metallicRoughness = texture(gSpecular, TexCoords).rg;
+    vec3 F0 = mix(vec3(0.04), albedo.rgb, metallicRoughness.x);
+
+    vec3 Lo = vec3(0.0);
+    if(hasDirLight)
+    {
+        vec3 L = normalize(-dirLight.direction);
+        Lo += getRadiance(N, V, L, dirLight.diffuse, albedo.rgb, metallicRoughness.x, metallicRoughness.y, F0) * getShadow(P, N, L);
+    }
+    for(uint i = 0u; i < cluster.y; i++)
+    {
+        vec4 light = texelFetch(lightData, 4 * int(texelFetch(lightIndices, int(cluster.x + i)).r));
+        float distance = length(light.xyz - P);
+        float window = clamp(1.0 - pow(distance / light.w, 4.0), 0.0, 1.0);
+        vec3 radiance = pbrLightColor * window * window / (distance * distance);
+        Lo += getRadiance(N, V, normalize(light.xyz - P), radiance, albedo.rgb, metallicRoughness.x, metallicRoughness.y, F0);
+    }
+
+    // same tonemapping and gamma as the forward shader
+    vec3 ambient = vec3(0.03) * albedo.rgb;
+    if(hasEnvironment)
+        ambient = getAmbient(N, V, albedo.rgb, metallicRoughness.x, metallicRoughness.y, F0);
+    vec3 color = ambient * albedo.a + Lo;
+    color = color / (color + vec3(1.0));
+    return pow(color, vec3(1.0 / 2.2));
+}
+
+// ----------------------------------------------------------------------------
+
+void main()
+{
+    float depth = texture(gDepth, TexCoords).r;
+    vec4 normalModel = texture(gNormal, TexCoords);
+    int model = int(normalModel.w + 0.5);
+    if(model == 0)
+        discard;
+
+    vec4 clip = inverseViewProjection * vec4(vec3(TexCoords, depth) * 2.0 - 1.0, 1.0);
+    vec3 P = clip.xyz / clip.w;
+    vec3 N = normalize(normalModel.xyz);
+    vec3 V = normalize(viewPos - P);
+    uvec2 cluster = getCluster(P);
+
+    vec3 color;
+    if(debugView == 1)
+        color = texture(gAlbedo, TexCoords).rgb;
+    else if(debugView == 2)
+        color = N * 0.5 + 0.5;
+    else if(debugView == 3)
+        color = texture(gSpecular, TexCoords).rgb;
+    else if(debugView == 4)
+        color = vec3(float(cluster.y) / 32.0, 0.0, 1.0 - float(cluster.y) / 32.0);
+    else if(model == SHADING_PBR)
+        color = shadePBR(P, N, V, cluster);
+    else
+        color = shadePhong(P, N, V, model == SHADING_TOON, cluster);
+
+    FragColor = vec4(color, 1.0);
+    // forward passes drawn afterwards (glass, skybox, outlines) test against the scene
+    gl_FragDepth = depth;
+}
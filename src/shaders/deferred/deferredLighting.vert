@@ -0,0 +1,11 @@
+#version 330 core
+
+out vec2 TexCoords;
+
+// one triangle covering the screen, no vertex buffer needed
+void main()
+{
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    TexCoords = position;
+    gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,166 @@
+#ifndef DEFERRED_RENDERER_H
+#define DEFERRED_RENDERER_H
+
+#include "../../shader.h"
+#include "../../resourceManager.h"
+#include "../../entityModules/renderModule.h"
+#include "../../utils/profiler.h"
+
+// Deferred path for the phong, toon and PBR shaders. Their RenderModules are
+// drawn once into a G-buffer and lit by a single full screen pass with the
+// clustered lights, the shadow map and the image based ambient light, so
+// overdrawn fragments are never lit.
+// The lighting pass writes the G-buffer depth to the default framebuffer,
+// so forward-only shaders (glass, textured, tessellation, skybox) and the
+// toon outlines are drawn on top as before.
+//
+// G-buffer layout:
+//   gAlbedo   RGBA8    diffuse / albedo, PBR ambient occlusion
+//   gNormal   RGBA16F  world normal, ShadingModel (0 where nothing was drawn)
+//   gSpecular RGBA8    specular, shininess / 256 | PBR metallic, roughness
+//   gAmbient  RGBA8    ambient, toon bands / 255
+//   gDepth    DEPTH24
+
+class DeferredRenderer : public Shader {
+public:
+    DeferredRenderer(const char* PVS, const char* PFS, const char* gBufferVS, const char* gBufferFS) {
+        this->Load(PVS, PFS);
+        gBufferShader = new Shader(gBufferVS, gBufferFS);
+        glGenVertexArrays(1, &screenVAO);
+    }
+
+    // G-buffer pass for every deferred shader's objects, then the lighting pass
+    void render(const std::vector<Shader*>& shaders, DirectionalLight* light) {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        if(viewport[2] != width || viewport[3] != height){
+            createGBuffer(viewport[2], viewport[3]);
+        }
+        Camera* camera = ResourceManager::getActiveCamera();
+
+        {
+            PROFILE_SCOPE("G-buffer pass");
+            PROFILE_GPU_SCOPE("G-buffer pass");
+            GLfloat clearColor[4];
+            glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            glViewport(0, 0, width, height);
+            // zero normal.w marks pixels nothing was drawn to
+            glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+
+            gBufferShader->Use();
+            gBufferShader->SetMatrix4("view", camera->getViewMatrix());
+            gBufferShader->SetMatrix4("projection", camera->getProjectionMatrix());
+            objectCount = 0;
+            for(Shader* shader : shaders){
+                ShadingModel shadingModel = shader->getShadingModel();
+                if(shadingModel == SHADING_FORWARD){
+                    continue;
+                }
+                gBufferShader->SetInteger("shadingModel", shadingModel);
+                for(RenderModule* module : shader->getRenderModules()){
+                    if (!module->isEnabled) continue;
+                    gBufferShader->SetMatrix4("model", module->getParent()->getTransform());
+                    module->material->Draw(gBufferShader);
+                    module->model->Draw(gBufferShader, false);
+                    objectCount++;
+                }
+            }
+
+            glBindFramebuffer(GL_FRAMEBUFFER, ResourceManager::getBackBuffer());
+            glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        }
+
+        PROFILE_SCOPE("Deferred lighting pass");
+        PROFILE_GPU_SCOPE("Deferred lighting pass");
+        this->Use();
+        for(int i = 0; i < 5; i++){
+            glActiveTexture(GL_TEXTURE0 + i);
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            this->SetInteger(textureNames[i], i);
+        }
+        glActiveTexture(GL_TEXTURE0);
+
+        this->SetMatrix4("view", camera->getViewMatrix());
+        this->SetMatrix4("inverseViewProjection", glm::inverse(camera->getProjectionMatrix() * camera->getViewMatrix()));
+        this->SetVector3f("viewPos", camera->getPosition());
+        this->SetVector3f("pbrLightColor", pbrLightColor);
+        this->SetInteger("debugView", debugView);
+        this->SetInteger("hasDirLight", light != nullptr);
+        if(light != nullptr){
+            this->SetVector3f("dirLight.direction", light->getDirection());
+            this->SetVector3f("dirLight.ambient", light->getAmbient());
+            this->SetVector3f("dirLight.diffuse", light->getDiffuse());
+            this->SetVector3f("dirLight.specular", light->getSpecular());
+        }
+        ResourceManager::bindLightClusters(this);
+        ResourceManager::bindShadows(this);
+        ResourceManager::bindEnvironment(this);
+
+        // gl_FragDepth carries the scene depth over, so depth writes stay on
+        glDepthFunc(GL_ALWAYS);
+        glBindVertexArray(screenVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        glDepthFunc(GL_LESS);
+    }
+
+    void OnGui() {
+        const char* views[] = { "Lit", "Albedo", "Normal", "Specular / Metallic Roughness", "Lights per Cluster" };
+        ImGui::Combo("View", &debugView, views, 5);
+        ImGui::Text("%d objects in the G-buffer, %dx%d", objectCount, width, height);
+    }
+
+    void setPBRLightColor(const glm::vec3& color) {
+        pbrLightColor = color;
+    }
+
+    GLuint getNormalTexture() const { return textures[1]; }
+    GLuint getDepthTexture() const { return textures[4]; }
+
+private:
+    Shader* gBufferShader;
+    GLuint framebuffer = 0;
+    GLuint textures[5] = {0, 0, 0, 0, 0};
+    GLuint screenVAO = 0;
+    int width = 0;
+    int height = 0;
+    int objectCount = 0;
+    int debugView = 0;
+    glm::vec3 pbrLightColor = glm::vec3(155.0f); // matches PBRShader
+    const char* textureNames[5] = { "gAlbedo", "gNormal", "gSpecular", "gAmbient", "gDepth" };
+
+    void createGBuffer(int width, int height) {
+        this->width = width;
+        this->height = height;
+        if(framebuffer == 0){
+            glGenFramebuffers(1, &framebuffer);
+            glGenTextures(5, textures);
+        }
+
+        const GLenum internalFormats[5] = { GL_RGBA8, GL_RGBA16F, GL_RGBA8, GL_RGBA8, GL_DEPTH_COMPONENT24 };
+        const GLenum formats[5] = { GL_RGBA, GL_RGBA, GL_RGBA, GL_RGBA, GL_DEPTH_COMPONENT };
+        const GLenum types[5] = { GL_UNSIGNED_BYTE, GL_HALF_FLOAT, GL_UNSIGNED_BYTE, GL_UNSIGNED_BYTE, GL_FLOAT };
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        for(int i = 0; i < 5; i++){
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, internalFormats[i], width, height, 0, formats[i], types[i], nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, i < 4 ? GL_COLOR_ATTACHMENT0 + i : GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, textures[i], 0);
+        }
+        const GLenum drawBuffers[4] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3 };
+        glDrawBuffers(4, drawBuffers);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "G-buffer framebuffer is not complete!" << std::endl;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+};
+
+#endif // DEFERRED_RENDERER_H
@@ -0,0 +1,49 @@
+#version 330 core
+
+in vec3 FragPos;
+in vec3 Normal;
+
+// see DeferredRenderer for the layout
+layout(location = 0) out vec4 gAlbedo;
+layout(location = 1) out vec4 gNormal;
+layout(location = 2) out vec4 gSpecular;
+layout(location = 3) out vec4 gAmbient;
+
+const int SHADING_PHONG = 1;
+const int SHADING_TOON = 2;
+const int SHADING_PBR = 3;
+
+uniform int shadingModel;
+
+// BasicMaterial and ToonMaterial
+struct Material {
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    float shininess;
+};
+uniform Material material;
+uniform int numOfBands;
+
+// PBRMaterial
+uniform vec3 albedo;
+uniform float metallic;
+uniform float roughness;
+uniform float ao;
+
+void main()
+{
+    gNormal = vec4(normalize(Normal), float(shadingModel));
+    if(shadingModel == SHADING_PBR)
+    {
+        gAlbedo = vec4(albedo, ao);
+        gSpecular = vec4(metallic, roughness, 0.0, 0.0);
+        gAmbient = vec4(0.0);
+    }
+    else
+    {
+        gAlbedo = vec4(material.diffuse, 1.0);
+        gSpecular = vec4(material.specular, material.shininess / 256.0);
+        gAmbient = vec4(material.ambient, float(numOfBands) / 255.0);
+    }
+}
@@ -10,7 +10,7 @@ class AnimShader : public Shader {
 
 public:
     AnimShader(const char* PVS, const char* PFS) {
-        this->Compile(this->readShaderSource(PVS), this->readShaderSource(PFS));
+        this->Load(PVS, PFS);
     }
 
     void Render() override {
@@ -10,16 +10,98 @@ uniform float metallic;
 uniform float roughness;
 uniform float ao;
 
-uniform int numPointLights;
-
 // lights
-uniform vec3 lightPositions[1];
-uniform vec3 lightColors[1];
+uniform vec3 lightColor;
+uniform vec3 dirLightDirection;
+uniform vec3 dirLightColor;
+uniform bool hasDirLight;
 
 uniform vec3 camPos;
+uniform mat4 view;
+
+// clustered lights, see ResourceManager::bindLightClusters
+uniform samplerBuffer lightData;
+uniform usamplerBuffer lightGrid;
+uniform usamplerBuffer lightIndices;
+uniform vec3 clusterCount;
+uniform vec2 clusterOrigin;
+uniform vec2 clusterTileSize;
+uniform float clusterScale;
+uniform float clusterBias;
 
 const float PI = 3.14159265359;
 // ----------------------------------------------------------------------------
+// directional light shadows, see CascadedShadowMap::bind
+uniform sampler2DShadow shadowMap;
+uniform int numCascades;
+uniform mat4 shadowMatrices[4];
+uniform vec4 shadowTileRects[4];
+uniform float cascadeSplits[4];
+uniform float shadowTexelSize;
+uniform float shadowBias;
+
+float getShadow(vec3 worldPos, vec3 normal, vec3 lightDir)
+{
+    float depth = -(view * vec4(worldPos, 1.0)).z;
+    int cascade = 0;
+    while(cascade < numCascades && depth > cascadeSplits[cascade])
+        cascade++;
+    if(cascade == numCascades)
+        return 1.0;
+
+    // slope scaled bias, then 3x3 taps of the hardware 2x2 PCF kept inside the cascade's tile
+    vec3 coord = (shadowMatrices[cascade] * vec4(worldPos, 1.0)).xyz;
+    float bias = shadowBias * (1.0 + 4.0 * (1.0 - max(dot(normal, lightDir), 0.0)));
+    vec4 rect = shadowTileRects[cascade] + vec4(1.5, 1.5, -1.5, -1.5) * shadowTexelSize;
+    float lit = 0.0;
+    for(int x = -1; x <= 1; x++)
+        for(int y = -1; y <= 1; y++)
+            lit += texture(shadowMap, vec3(clamp(coord.xy + vec2(x, y) * shadowTexelSize, rect.xy, rect.zw), coord.z - bias));
+    return lit / 9.0;
+}
+// ----------------------------------------------------------------------------
+// image based lighting, see ImageBasedLighting::bind
+uniform bool hasEnvironment;
+uniform samplerCube prefilteredMap;
+uniform sampler2D brdfLUT;
+uniform vec3 irradianceSH[9];
+uniform float prefilteredLevels;
+
+// irradiance / pi from the SH coefficients, EnvironmentLighting::evaluateSH
+vec3 getIrradiance(vec3 n)
+{
+    vec3 result = irradianceSH[0] * 0.282095
+                + irradianceSH[1] * 0.488603 * n.y
+                + irradianceSH[2] * 0.488603 * n.z
+                + irradianceSH[3] * 0.488603 * n.x
+                + irradianceSH[4] * 1.092548 * n.x * n.y
+                + irradianceSH[5] * 1.092548 * n.y * n.z
+                + irradianceSH[6] * 0.315392 * (3.0 * n.z * n.z - 1.0)
+                + irradianceSH[7] * 1.092548 * n.x * n.z
+                + irradianceSH[8] * 0.546274 * (n.x * n.x - n.y * n.y);
+    return max(result, vec3(0.0));
+}
+
+// split sum ambient: SH diffuse plus the prefiltered environment scaled by the BRDF LUT
+vec3 getAmbient(vec3 N, vec3 V, vec3 albedo, float metallic, float roughness, vec3 F0)
+{
+    float NdotV = max(dot(N, V), 0.0);
+    vec3 F = F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(1.0 - NdotV, 5.0);
+    vec3 kD = (vec3(1.0) - F) * (1.0 - metallic);
+    vec3 prefiltered = textureLod(prefilteredMap, reflect(-V, N), roughness * prefilteredLevels).rgb;
+    vec2 brdf = texture(brdfLUT, vec2(NdotV, roughness)).rg;
+    return kD * albedo * getIrradiance(N) + prefiltered * (F0 * brdf.x + brdf.y);
+}
+// ----------------------------------------------------------------------------
+uvec2 getCluster()
+{
+    float depth = -(view * vec4(WorldPos, 1.0)).z;
+    ivec3 count = ivec3(clusterCount);
+    ivec2 tile = clamp(ivec2((gl_FragCoord.xy - clusterOrigin) / clusterTileSize), ivec2(0), count.xy - 1);
+    int slice = clamp(int(floor(log(max(depth, 1e-6)) * clusterScale + clusterBias)), 0, count.z - 1);
+    return texelFetch(lightGrid, tile.x + count.x * (tile.y + count.y * slice)).xy;
+}
+// ----------------------------------------------------------------------------
 float DistributionGGX(vec3 N, vec3 H, float roughness)
 {
     float a = roughness*roughness;
@@ -60,6 +142,38 @@ vec3 fresnelSchlick(float cosTheta, vec3 F0)
     return F0 + (1.0 - F0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
 }
 // ----------------------------------------------------------------------------
+// outgoing radiance towards V from one light arriving along L
+vec3 getRadiance(vec3 N, vec3 V, vec3 L, vec3 radiance, vec3 F0)
+{
+    vec3 H = normalize(V + L);
+
+    // Cook-Torrance BRDF
+    float NDF = DistributionGGX(N, H, roughness);   
+    float G   = GeometrySmith(N, V, L, roughness);      
+    vec3 F    = fresnelSchlick(clamp(dot(H, V), 0.0, 1.0), F0);
+       
+    vec3 numerator    = NDF * G * F; 
+    float denominator = 4.0 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0) + 0.0001; // + 0.0001 to prevent divide by zero
+    vec3 specular = numerator / denominator;
+    
+    // kS is equal to Fresnel
+    vec3 kS = F;
+    // for energy conservation, the diffuse and specular light can't
+    // be above 1.0 (unless the surface emits light); to preserve this
+    // relationship the diffuse component (kD) should equal 1.0 - kS.
+    vec3 kD = vec3(1.0) - kS;
+    // multiply kD by the inverse metalness such that only non-metals 
+    // have diffuse lighting, or a linear blend if partly metal (pure metals
+    // have no diffuse light).
+    kD *= 1.0 - metallic;	  
+
+    // scale light by NdotL
+    float NdotL = max(dot(N, L), 0.0);        
+
+    // note that we already multiplied the BRDF by the Fresnel (kS) so we won't multiply by kS again
+    return (kD * albedo / PI + specular) * radiance * NdotL;
+}
+// ----------------------------------------------------------------------------
 void main()
 {		
     vec3 N = normalize(Normal);
@@ -72,43 +186,32 @@ void main()
 
     // reflectance equation
     vec3 Lo = vec3(0.0);
-    for(int i = 0; i < numPointLights; ++i) 
+    if(hasDirLight)
     {
-        // calculate per-light radiance
-        vec3 L = normalize(lightPositions[i] - WorldPos);
-        vec3 H = normalize(V + L);
-        float distance = length(lightPositions[i] - WorldPos);
-        float attenuation = 1.0 / (distance * distance);
-        vec3 radiance = lightColors[i] * attenuation;
-
-        // Cook-Torrance BRDF
-        float NDF = DistributionGGX(N, H, roughness);   
-        float G   = GeometrySmith(N, V, L, roughness);      
-        vec3 F    = fresnelSchlick(clamp(dot(H, V), 0.0, 1.0), F0);
-           
-        vec3 numerator    = NDF * G * F; 
-        float denominator = 4.0 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0) + 0.0001; // + 0.0001 to prevent divide by zero
-        vec3 specular = numerator / denominator;
-        
-        // kS is equal to Fresnel
-        vec3 kS = F;
-        // for energy conservation, the diffuse and specular light can't
-        // be above 1.0 (unless the surface emits light); to preserve this
-        // relationship the diffuse component (kD) should equal 1.0 - kS.
-        vec3 kD = vec3(1.0) - kS;
-        // multiply kD by the inverse metalness such that only non-metals 
-        // have diffuse lighting, or a linear blend if partly metal (pure metals
-        // have no diffuse light).
-        kD *= 1.0 - metallic;	  
-
-        // scale light by NdotL
-        float NdotL = max(dot(N, L), 0.0);        
+        vec3 L = normalize(-dirLightDirection);
+        Lo += getRadiance(N, V, L, dirLightColor, F0) * getShadow(WorldPos, N, L);
+    }
+
+    uvec2 cluster = getCluster();
+    for(uint i = 0u; i < cluster.y; ++i) 
+    {
+        // position and culling range of the light
+        vec4 light = texelFetch(lightData, 4 * int(texelFetch(lightIndices, int(cluster.x + i)).r));
+
+        // calculate per-light radiance; inverse square, windowed to zero at the range
+        vec3 L = normalize(light.xyz - WorldPos);
+        float distance = length(light.xyz - WorldPos);
+        float window = clamp(1.0 - pow(distance / light.w, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (distance * distance);
+        vec3 radiance = lightColor * attenuation;
 
         // add to outgoing radiance Lo
-        Lo += (kD * albedo / PI + specular) * radiance * NdotL;  // note that we already multiplied the BRDF by the Fresnel (kS) so we won't multiply by kS again
+        Lo += getRadiance(N, V, L, radiance, F0);
     }   
     
     vec3 ambient = vec3(0.03) * albedo * ao;
+    if(hasEnvironment)
+        ambient = getAmbient(N, V, albedo, metallic, roughness, F0) * ao;
 
     vec3 color = ambient + Lo;
 
@@ -9,7 +9,7 @@
 class PBRShader : public Shader {
 public:
     PBRShader(const char* PVS, const char* PFS) {
-        this->Compile(this->readShaderSource(PVS), this->readShaderSource(PFS));
+        this->Load(PVS, PFS);
     }
 
     void Render() override {        
@@ -21,18 +21,27 @@ public:
         this->SetMatrix4("projection", ResourceManager::getActiveCamera()->getProjectionMatrix());
         this->SetVector3f("camPos", ResourceManager::getActiveCamera()->getPosition());
 
-        for(int i = 0; i < pointLightsToRender.size(); i++){
-            this->SetVector3f("lightPositions[" + std::to_string(i) + "]", pointLightsToRender[i]->getPosition());
-            this->SetVector3f("lightColors[" + std::to_string(i) + "]", glm::vec3(155.0f,155.0f,155.0f));
-        }
+        // point lights come from the light clusters
+        ResourceManager::bindLightClusters(this);
+        this->SetVector3f("lightColor", glm::vec3(155.0f,155.0f,155.0f));
 
-        this->SetInteger("numPointLights", pointLightsToRender.size());
+        this->SetInteger("hasDirLight", !dirLightsToRender.empty());
+        if(!dirLightsToRender.empty()){
+            this->SetVector3f("dirLightDirection", dirLightsToRender[0]->getDirection());
+            this->SetVector3f("dirLightColor", dirLightsToRender[0]->getDiffuse());
+        }
+        ResourceManager::bindShadows(this);
+        ResourceManager::bindEnvironment(this);
 
         // Load RenderModule uniforms
 
         Shader::Render();
     }
 
+    ShadingModel getShadingModel() const override {
+        return SHADING_PBR;
+    }
+
 };
 
 #endif // PBR_SHADER_H
\ No newline at end of file
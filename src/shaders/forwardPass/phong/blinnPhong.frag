@@ -14,32 +14,130 @@ struct Material {
 
 struct PointLight {
     vec3 position;
+    float range;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+struct DirLight {
+    vec3 direction;
     vec3 ambient;
     vec3 diffuse;
     vec3 specular;
 };
 
 uniform Material material;
-uniform PointLight pointLight;
+uniform DirLight dirLight;
+uniform bool hasDirLight;
 uniform vec3 viewPos;
+uniform mat4 view;
 
-void main()
+// clustered lights, see ResourceManager::bindLightClusters
+uniform samplerBuffer lightData;
+uniform usamplerBuffer lightGrid;
+uniform usamplerBuffer lightIndices;
+uniform vec3 clusterCount;
+uniform vec2 clusterOrigin;
+uniform vec2 clusterTileSize;
+uniform float clusterScale;
+uniform float clusterBias;
+
+uvec2 getCluster()
 {
-    // Ambient
-    vec3 ambient = pointLight.ambient * material.ambient;
+    float depth = -(view * vec4(FragPos, 1.0)).z;
+    ivec3 count = ivec3(clusterCount);
+    ivec2 tile = clamp(ivec2((gl_FragCoord.xy - clusterOrigin) / clusterTileSize), ivec2(0), count.xy - 1);
+    int slice = clamp(int(floor(log(max(depth, 1e-6)) * clusterScale + clusterBias)), 0, count.z - 1);
+    return texelFetch(lightGrid, tile.x + count.x * (tile.y + count.y * slice)).xy;
+}
 
-    // Diffuse
-    vec3 normal = normalize(Normal);
-    vec3 lightDir = normalize(pointLight.position - FragPos);
-    float diff = max(dot(normal, lightDir), 0.0);  
-    vec3 diffuse = pointLight.diffuse * (diff * material.diffuse);
+PointLight getPointLight(int index)
+{
+    vec4 t0 = texelFetch(lightData, 4 * index);
+    vec4 t1 = texelFetch(lightData, 4 * index + 1);
+    vec4 t2 = texelFetch(lightData, 4 * index + 2);
+    vec4 t3 = texelFetch(lightData, 4 * index + 3);
+    return PointLight(t0.xyz, t0.w, t1.xyz, t2.xyz, t3.xyz, t1.w, t2.w, t3.w);
+}
+
+// directional light shadows, see CascadedShadowMap::bind
+uniform sampler2DShadow shadowMap;
+uniform int numCascades;
+uniform mat4 shadowMatrices[4];
+uniform vec4 shadowTileRects[4];
+uniform float cascadeSplits[4];
+uniform float shadowTexelSize;
+uniform float shadowBias;
+
+float getShadow(vec3 worldPos, vec3 normal, vec3 lightDir)
+{
+    float depth = -(view * vec4(worldPos, 1.0)).z;
+    int cascade = 0;
+    while(cascade < numCascades && depth > cascadeSplits[cascade])
+        cascade++;
+    if(cascade == numCascades)
+        return 1.0;
 
-    // Specular
+    // slope scaled bias, then 3x3 taps of the hardware 2x2 PCF kept inside the cascade's tile
+    vec3 coord = (shadowMatrices[cascade] * vec4(worldPos, 1.0)).xyz;
+    float bias = shadowBias * (1.0 + 4.0 * (1.0 - max(dot(normal, lightDir), 0.0)));
+    vec4 rect = shadowTileRects[cascade] + vec4(1.5, 1.5, -1.5, -1.5) * shadowTexelSize;
+    float lit = 0.0;
+    for(int x = -1; x <= 1; x++)
+        for(int y = -1; y <= 1; y++)
+            lit += texture(shadowMap, vec3(clamp(coord.xy + vec2(x, y) * shadowTexelSize, rect.xy, rect.zw), coord.z - bias));
+    return lit / 9.0;
+}
+
+// fades to zero at the range the light was culled with
+float getAttenuation(PointLight light, float distance)
+{
+    float window = clamp(1.0 - pow(distance / light.range, 4.0), 0.0, 1.0);
+    return window * window / (light.constant + light.linear * distance + light.quadratic * distance * distance);
+}
+
+void main()
+{
+    vec3 normal = normalize(Normal);
     vec3 viewDir = normalize(viewPos - FragPos);
-    vec3 halfwayDir = normalize(lightDir + viewDir);
-    float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
-    vec3 specular = pointLight.specular * (spec * material.specular);
+    vec3 result = vec3(0.0);
+
+    if(hasDirLight)
+    {
+        vec3 lightDir = normalize(-dirLight.direction);
+        vec3 halfwayDir = normalize(lightDir + viewDir);
+        vec3 ambient = dirLight.ambient * material.ambient;
+        vec3 diffuse = dirLight.diffuse * (max(dot(normal, lightDir), 0.0) * material.diffuse);
+        vec3 specular = dirLight.specular * (pow(max(dot(normal, halfwayDir), 0.0), material.shininess) * material.specular);
+        result += ambient + (diffuse + specular) * getShadow(FragPos, normal, lightDir);
+    }
+
+    uvec2 cluster = getCluster();
+    for(uint i = 0u; i < cluster.y; i++)
+    {
+        PointLight pointLight = getPointLight(int(texelFetch(lightIndices, int(cluster.x + i)).r));
+        float distance = length(pointLight.position - FragPos);
+        float attenuation = getAttenuation(pointLight, distance);
+
+        // Ambient
+        vec3 ambient = pointLight.ambient * material.ambient;
+
+        // Diffuse
+        vec3 lightDir = (pointLight.position - FragPos) / max(distance, 1e-6);
+        float diff = max(dot(normal, lightDir), 0.0);
+        vec3 diffuse = pointLight.diffuse * (diff * material.diffuse);
+
+        // Specular
+        vec3 halfwayDir = normalize(lightDir + viewDir);
+        float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+        vec3 specular = pointLight.specular * (spec * material.specular);
+
+        result += (ambient + diffuse + specular) * attenuation;
+    }
 
-    vec3 result = ambient + diffuse + specular;
     FragColor = vec4(result, 1.0);
 }
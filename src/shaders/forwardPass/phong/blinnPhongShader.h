@@ -9,7 +9,7 @@
 class blinnPhongShader : public Shader {
 public:
     blinnPhongShader(const char* PVS, const char* PFS) {
-        this->Compile(this->readShaderSource(PVS), this->readShaderSource(PFS));
+        this->Load(PVS, PFS);
     }
 
     void Render() override {
@@ -19,26 +19,36 @@ public:
 
         this->SetMatrix4("view", ResourceManager::getActiveCamera()->getViewMatrix());
         this->SetMatrix4("projection", ResourceManager::getActiveCamera()->getProjectionMatrix());
+        this->SetVector3f("viewPos", ResourceManager::getActiveCamera()->getPosition());
 
-        if(pointLightsToRender[0] != nullptr){
+        // point lights come from the light clusters; the single light is for
+        // fragment shaders without clustering (blinnPhongTex.frag)
+        ResourceManager::bindLightClusters(this);
+
+        if(!pointLightsToRender.empty()){
             this->SetVector3f("pointLight.position", pointLightsToRender[0]->getPosition());
             this->SetVector3f("pointLight.ambient", pointLightsToRender[0]->getAmbient());
             this->SetVector3f("pointLight.diffuse", pointLightsToRender[0]->getDiffuse());
             this->SetVector3f("pointLight.specular", pointLightsToRender[0]->getSpecular());
         }
 
-        if(dirLightsToRender[0] != nullptr){
-            this->SetVector3f("dirLight.direction", glm::eulerAngles(dirLightsToRender[0]->getRotation()));
+        this->SetInteger("hasDirLight", !dirLightsToRender.empty());
+        if(!dirLightsToRender.empty()){
+            this->SetVector3f("dirLight.direction", dirLightsToRender[0]->getDirection());
             this->SetVector3f("dirLight.ambient", dirLightsToRender[0]->getAmbient());
             this->SetVector3f("dirLight.diffuse", dirLightsToRender[0]->getDiffuse());
             this->SetVector3f("dirLight.specular", dirLightsToRender[0]->getSpecular());
         }
+        ResourceManager::bindShadows(this);
 
 
         // Load RenderModule uniforms
 
         Shader::Render();
+    }
 
+    ShadingModel getShadingModel() const override {
+        return SHADING_PHONG;
     }
 
 };
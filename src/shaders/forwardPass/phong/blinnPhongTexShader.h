@@ -9,7 +9,7 @@
 class blinnPhongTexShader : public Shader {
 public:
     blinnPhongTexShader(const char* PVS, const char* PFS, bool useOwnTextures = true) {
-        this->Compile(this->readShaderSource(PVS), this->readShaderSource(PFS));
+        this->Load(PVS, PFS);
         this->useOwnTextures = useOwnTextures;
     }
 
@@ -25,14 +25,14 @@ public:
         this->SetMatrix4("view", ResourceManager::getActiveCamera()->getViewMatrix());
         this->SetMatrix4("projection", ResourceManager::getActiveCamera()->getProjectionMatrix());
 
-        if(pointLightsToRender[0] != nullptr){
+        if(!pointLightsToRender.empty()){
             this->SetVector3f("pointLight.position", pointLightsToRender[0]->getPosition());
             this->SetVector3f("pointLight.ambient", pointLightsToRender[0]->getAmbient());
             this->SetVector3f("pointLight.diffuse", pointLightsToRender[0]->getDiffuse());
             this->SetVector3f("pointLight.specular", pointLightsToRender[0]->getSpecular());
         }
 
-        if(dirLightsToRender[0] != nullptr){
+        if(!dirLightsToRender.empty()){
             this->SetVector3f("dirLight.direction", glm::eulerAngles(dirLightsToRender[0]->getRotation()));
             this->SetVector3f("dirLight.ambient", dirLightsToRender[0]->getAmbient());
             this->SetVector3f("dirLight.diffuse", dirLightsToRender[0]->getDiffuse());
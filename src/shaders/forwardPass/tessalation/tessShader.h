@@ -9,7 +9,7 @@
 class TessalationShader : public Shader {
 public:
     TessalationShader(const char* PVS, const char* PFS, const char* PGS, const char* PTS, const char* TES) {
-        this->Compile(this->readShaderSource(PVS), this->readShaderSource(PFS), this->readShaderSource(PGS), this->readShaderSource(PTS), this->readShaderSource(TES));
+        this->Load(PVS, PFS, PGS, PTS, TES);
     }
 
     void Render() override {
@@ -21,10 +21,17 @@ public:
         this->SetMatrix4("projection", ResourceManager::getActiveCamera()->getProjectionMatrix());
         this->SetVector3f("viewPos", ResourceManager::getActiveCamera()->getPosition());
 
-        if(pointLightsToRender[0] != nullptr){
+        if(!pointLightsToRender.empty()){
             this->SetVector3f("lightPos", pointLightsToRender[0]->getPosition());
         }
 
+        // per edge levels from the screen size, see tessShader.tesc
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        this->SetInteger("adaptiveTessellation", ResourceManager::isAdaptiveTessellation());
+        this->SetFloat("viewportHeight", (float)viewport[3]);
+        this->SetFloat("backfaceTolerance", 0.2f);
+
         // Load RenderModule uniforms
 
         Shader::Render();
@@ -12,11 +12,13 @@ uniform bool hasDiffuse;
 uniform bool hasNormal;
 uniform bool hasHeight;
 uniform bool hasRoughness;
+uniform bool hasConeMap;
 
 uniform sampler2D texture_diffuse;
 uniform sampler2D texture_normal;
 uniform sampler2D texture_height;
 uniform sampler2D texture_roughness;
+uniform sampler2D texture_cone;   // depth, sqrt(cone ratio), see src/utils/coneStepMap.h
 
 uniform Material material;
 
@@ -71,6 +73,45 @@ vec2 ParallaxMapping(vec2 TexCoords, vec3 viewDir)
     return finalTexCoords;
 }
 
+// x and y only, so BC5 normal maps from the texture cooker work as well
+vec3 getNormalMap(vec2 texCoords){
+    vec2 xy = texture(texture_normal, texCoords).rg * 2.0 - 1.0;
+    return vec3(xy, sqrt(max(1.0 - dot(xy, xy), 0.0)));
+}
+
+// Steps along the view ray to the edge of the relaxed cone above the current
+// texel. A step can end below the surface, but never past more than the
+// first hit, which then lies between the last two samples.
+vec2 ConeStepMapping(vec2 texCoords, vec3 viewDir)
+{
+    const int maxSteps = 24;
+    // texture coordinates moved per unit of depth, the cone ratios are in the same units
+    vec2 P = viewDir.xy / viewDir.z * material.height_scale;
+    float rayRatio = length(P);
+    float depth = 0.0;
+    float previousDepth = 0.0;
+    float previousGap = 1.0;
+    float gap = 1.0;
+    for(int i = 0; i <= maxSteps; i++)
+    {
+        vec2 cone = texture(texture_cone, texCoords - P * depth).rg;
+        gap = cone.r - depth;
+        if(gap < 0.002 || i == maxSteps)
+            break;
+        previousDepth = depth;
+        previousGap = gap;
+        float ratio = cone.g * cone.g;
+        depth += ratio * gap / (rayRatio + ratio);
+    }
+    // below the surface: the hit where the gap crosses zero between the last two
+    // samples; above it: close the last gap as if the surface were flat
+    if(gap < 0.0)
+        depth = previousDepth + (depth - previousDepth) * previousGap / (previousGap - gap);
+    else
+        depth += gap;
+    return texCoords - P * depth;
+}
+
 vec3 getSpecular(vec3 normal , vec3 viewDir){
     vec3 halfwayDir = normalize(TangentLightPos + viewDir);
     float spec = pow(max(dot(normal, halfwayDir), 0), material.shininess);
@@ -91,9 +132,9 @@ void main()
 {
     vec3 viewDir = normalize(TangentViewPos - TangentFragPos);
     float height = hasHeight ? texture(texture_height, TexCoords).r : 0.0;
-    vec2 texCoords = hasHeight ? ParallaxMapping(TexCoords, viewDir) : TexCoords;
+    vec2 texCoords = hasConeMap ? ConeStepMapping(TexCoords, viewDir) : hasHeight ? ParallaxMapping(TexCoords, viewDir) : TexCoords;
 
-    vec3 normal = hasNormal ? normalize(normalize(texture(texture_normal, texCoords).rgb) * 2.0 - 1.0) : Normal;
+    vec3 normal = hasNormal ? getNormalMap(texCoords) : Normal;
     vec3 color = hasDiffuse ? texture(texture_diffuse, texCoords).rgb : vec3(1.0);
     
 
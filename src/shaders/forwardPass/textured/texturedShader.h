@@ -9,7 +9,7 @@
 class TexturedShader : public Shader {
 public:
     TexturedShader(const char* PVS, const char* PFS) {
-        this->Compile(this->readShaderSource(PVS), this->readShaderSource(PFS), nullptr, nullptr, nullptr);
+        this->Load(PVS, PFS);
     }
 
     void Render() override {
@@ -21,7 +21,7 @@ public:
         this->SetMatrix4("projection", ResourceManager::getActiveCamera()->getProjectionMatrix());
         this->SetVector3f("viewPos", ResourceManager::getActiveCamera()->getPosition());
 
-        if(pointLightsToRender[0] != nullptr){
+        if(!pointLightsToRender.empty()){
             this->SetVector3f("lightPos", pointLightsToRender[0]->getPosition());
         }
 
@@ -44,6 +44,11 @@ public:
         }
         else if(texture->getType() == HEIGHT){
             hasHeight = true;
+            // parallax marches the cone step map of the height texture when it was cooked
+            Texture* cones = ResourceManager::loadTexture(CONE_STEP, texture->getFilePath().c_str(), false);
+            if(cones->getID() != 0){
+                addTexture(cones);
+            }
         }
     }
 
@@ -60,6 +65,7 @@ public:
         this->SetInteger("hasNormal", 0);
         this->SetInteger("hasHeight", 0);
         this->SetInteger("hasRoughness", 0);
+        this->SetInteger("hasConeMap", 0);
 
         for (unsigned int i = 0; i < textures.size(); i++)
         {
@@ -98,6 +104,10 @@ public:
                 this->SetInteger((name).c_str(), i + 1);
                 this->SetInteger("hasRoughness", 1);
             }
+            else if (type == CONE_STEP){
+                this->SetInteger("texture_cone", i + 1);
+                this->SetInteger("hasConeMap", 1);
+            }
             glBindTexture(GL_TEXTURE_2D, textures[i]->getID());
         }
     }
@@ -9,7 +9,7 @@
 class OutlineShader : public Shader {
 public:
     OutlineShader(const char* PVS, const char* PFS) {
-        this->Compile(this->readShaderSource(PVS), this->readShaderSource(PFS));
+        this->Load(PVS, PFS);
     }
 
     void Render() override {    
@@ -0,0 +1,73 @@
+#version 330 core
+
+// Toon outlines from depth and normals, see ScreenSpaceOutline. Four taps
+// thickness pixels away are compared with the centre:
+//   silhouette  a toon tap in front of a pixel without toon shading
+//   occlusion   a toon tap nearer than a toon centre by depthThreshold of its depth
+//   crease      toon normals more than the crease angle apart
+// Outline pixels take the depth of the nearest toon tap so later passes depth
+// test against them.
+
+const int SHADING_TOON = 2;
+
+uniform sampler2D normals;    // world normal, ShadingModel (0 where nothing was drawn)
+uniform sampler2D depths;
+uniform sampler2D colors;     // the toon pass, when hasColors
+uniform bool hasColors;       // false over the G-buffer, the lit scene is already drawn
+uniform mat4 inverseProjection;
+uniform float thickness;
+uniform float creaseCosine;
+uniform float depthThreshold;
+uniform vec3 outlineColor;
+
+out vec4 FragColor;
+
+float getViewDepth(float depth) {
+    vec4 position = inverseProjection * vec4(0.0, 0.0, depth * 2.0 - 1.0, 1.0);
+    return -position.z / position.w;
+}
+
+void main()
+{
+    ivec2 size = textureSize(depths, 0);
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    vec4 centre = texelFetch(normals, texel, 0);
+    bool isToon = int(centre.w + 0.5) == SHADING_TOON;
+    float centreDepth = texelFetch(depths, texel, 0).r;
+    float centreView = getViewDepth(centreDepth);
+
+    bool edge = false;
+    float outlineDepth = isToon ? centreDepth : 1.0;
+    int step = max(1, int(thickness + 0.5));
+    ivec2 offsets[4] = ivec2[](ivec2(step, 0), ivec2(-step, 0), ivec2(0, step), ivec2(0, -step));
+    for (int i = 0; i < 4; i++) {
+        ivec2 tap = clamp(texel + offsets[i], ivec2(0), size - 1);
+        vec4 normal = texelFetch(normals, tap, 0);
+        if (int(normal.w + 0.5) != SHADING_TOON)
+            continue;
+        float depth = texelFetch(depths, tap, 0).r;
+        if (!isToon) {
+            if (depth < centreDepth) {
+                edge = true;
+                outlineDepth = min(outlineDepth, depth);
+            }
+        }
+        else if (centreView - getViewDepth(depth) > depthThreshold * centreView
+                 || dot(normal.xyz, centre.xyz) < creaseCosine) {
+            edge = true;
+            outlineDepth = min(outlineDepth, depth);
+        }
+    }
+
+    if (edge) {
+        FragColor = vec4(outlineColor, 1.0);
+        gl_FragDepth = outlineDepth;
+    }
+    else if (isToon && hasColors) {
+        FragColor = texelFetch(colors, texel, 0);
+        gl_FragDepth = centreDepth;
+    }
+    else {
+        discard;
+    }
+}
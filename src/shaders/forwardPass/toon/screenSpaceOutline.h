@@ -0,0 +1,75 @@
+#ifndef SCREEN_SPACE_OUTLINE_H
+#define SCREEN_SPACE_OUTLINE_H
+
+#include <glm/gtc/matrix_transform.hpp>
+#include "../../../shader.h"
+#include "../../../resourceManager.h"
+#include "imgui.h"
+
+// Toon outlines as one full screen pass over depth and normals instead of a
+// second, inverted hull draw of every object (OutlineShader).
+//
+// Forward, ToonShader draws its objects into transient colour, normal and
+// depth targets of the frame's render graph; toonShader.frag writes the normal
+// and the toon ShadingModel to its second output. resolve() then draws the
+// toon colour and the outlines onto the bound framebuffer, writing depth so
+// the forward shaders after it are occluded as before. Deferred, it runs over
+// the G-buffer, which already has the same normals, and only adds the
+// outlines. See screenOutline.frag for the edge tests.
+
+class ScreenSpaceOutline : public Shader {
+public:
+    ScreenSpaceOutline(const char* PVS, const char* PFS) {
+        this->Load(PVS, PFS);
+        glGenVertexArrays(1, &screenVAO);
+    }
+
+    // normals hold the ShadingModel in w; without colors only the outlines are drawn
+    void resolve(GLuint normals, GLuint depths, GLuint colors = 0) {
+        this->Use();
+        GLuint inputs[3] = { normals, depths, colors };
+        const char* names[3] = { "normals", "depths", "colors" };
+        for(int i = 0; i < 3; i++){
+            glActiveTexture(GL_TEXTURE0 + i);
+            glBindTexture(GL_TEXTURE_2D, inputs[i]);
+            this->SetInteger(names[i], i);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        this->SetInteger("hasColors", colors != 0);
+        this->SetMatrix4("inverseProjection", glm::inverse(ResourceManager::getActiveCamera()->getProjectionMatrix()));
+        this->SetFloat("thickness", thickness);
+        this->SetFloat("creaseCosine", glm::cos(glm::radians(creaseAngle)));
+        this->SetFloat("depthThreshold", depthThreshold);
+        this->SetVector3f("outlineColor", outlineColor);
+
+        // crease outlines sit at the depth already written there
+        glDepthFunc(GL_LEQUAL);
+        glBindVertexArray(screenVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        glDepthFunc(GL_LESS);
+    }
+
+    void OnGui() {
+        ImGui::SliderFloat("Outline thickness (px)", &thickness, 1.0f, 8.0f);
+        ImGui::SliderFloat("Crease angle", &creaseAngle, 1.0f, 180.0f);
+        ImGui::SliderFloat("Depth threshold", &depthThreshold, 0.001f, 0.5f);
+        ImGui::ColorEdit3("Outline color", (float*)&outlineColor);
+    }
+
+    void setThickness(float pixels) { thickness = pixels; }
+    void setCreaseAngle(float degrees) { creaseAngle = degrees; }
+    void setDepthThreshold(float threshold) { depthThreshold = threshold; }
+    void setOutlineColor(const glm::vec3& color) { outlineColor = color; }
+    float getThickness() const { return thickness; }
+    float getCreaseAngle() const { return creaseAngle; }
+
+private:
+    GLuint screenVAO = 0;
+    float thickness = 2.0f;       // pixels
+    float creaseAngle = 60.0f;    // degrees between normals
+    float depthThreshold = 0.05f; // of the farther view depth
+    glm::vec3 outlineColor = glm::vec3(0.0f);
+};
+
+#endif // SCREEN_SPACE_OUTLINE_H
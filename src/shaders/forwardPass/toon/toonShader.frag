@@ -3,7 +3,8 @@
 in vec3 FragPos;
 in vec3 Normal;
 
-out vec4 FragColor;
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out vec4 NormalOut; // normal, SHADING_TOON for the screen space outlines
 
 struct Material {
     vec3 ambient;
@@ -14,17 +15,90 @@ struct Material {
 
 struct Light {
     vec3 position;
+    float range;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+struct DirLight {
+    vec3 direction;
     vec3 ambient;
     vec3 diffuse;
     vec3 specular;
 };
 
 uniform Material material;
-uniform Light light;
+uniform DirLight dirLight;
+uniform bool hasDirLight;
 uniform vec3 viewPos;
 uniform int numOfBands;
+uniform mat4 view;
+
+// clustered lights, see ResourceManager::bindLightClusters
+uniform samplerBuffer lightData;
+uniform usamplerBuffer lightGrid;
+uniform usamplerBuffer lightIndices;
+uniform vec3 clusterCount;
+uniform vec2 clusterOrigin;
+uniform vec2 clusterTileSize;
+uniform float clusterScale;
+uniform float clusterBias;
+
+uvec2 getCluster() {
+    float depth = -(view * vec4(FragPos, 1.0)).z;
+    ivec3 count = ivec3(clusterCount);
+    ivec2 tile = clamp(ivec2((gl_FragCoord.xy - clusterOrigin) / clusterTileSize), ivec2(0), count.xy - 1);
+    int slice = clamp(int(floor(log(max(depth, 1e-6)) * clusterScale + clusterBias)), 0, count.z - 1);
+    return texelFetch(lightGrid, tile.x + count.x * (tile.y + count.y * slice)).xy;
+}
+
+Light getLight(int index) {
+    vec4 t0 = texelFetch(lightData, 4 * index);
+    vec4 t1 = texelFetch(lightData, 4 * index + 1);
+    vec4 t2 = texelFetch(lightData, 4 * index + 2);
+    vec4 t3 = texelFetch(lightData, 4 * index + 3);
+    return Light(t0.xyz, t0.w, t1.xyz, t2.xyz, t3.xyz, t1.w, t2.w, t3.w);
+}
+
+// directional light shadows, see CascadedShadowMap::bind
+uniform sampler2DShadow shadowMap;
+uniform int numCascades;
+uniform mat4 shadowMatrices[4];
+uniform vec4 shadowTileRects[4];
+uniform float cascadeSplits[4];
+uniform float shadowTexelSize;
+uniform float shadowBias;
+
+float getShadow(vec3 worldPos, vec3 normal, vec3 lightDir) {
+    float depth = -(view * vec4(worldPos, 1.0)).z;
+    int cascade = 0;
+    while(cascade < numCascades && depth > cascadeSplits[cascade])
+        cascade++;
+    if(cascade == numCascades)
+        return 1.0;
+
+    // slope scaled bias, then 3x3 taps of the hardware 2x2 PCF kept inside the cascade's tile
+    vec3 coord = (shadowMatrices[cascade] * vec4(worldPos, 1.0)).xyz;
+    float bias = shadowBias * (1.0 + 4.0 * (1.0 - max(dot(normal, lightDir), 0.0)));
+    vec4 rect = shadowTileRects[cascade] + vec4(1.5, 1.5, -1.5, -1.5) * shadowTexelSize;
+    float lit = 0.0;
+    for(int x = -1; x <= 1; x++)
+        for(int y = -1; y <= 1; y++)
+            lit += texture(shadowMap, vec3(clamp(coord.xy + vec2(x, y) * shadowTexelSize, rect.xy, rect.zw), coord.z - bias));
+    return lit / 9.0;
+}
 
-vec3 calcColorMix(float intensity, vec3 ambient, vec3 diffuse, vec3 specular) {
+// fades to zero at the range the light was culled with
+float getAttenuation(Light light, float distance) {
+    float window = clamp(1.0 - pow(distance / light.range, 4.0), 0.0, 1.0);
+    return window * window / (light.constant + light.linear * distance + light.quadratic * distance * distance);
+}
+
+vec3 calcColorMix(Light light, float intensity, vec3 ambient, vec3 diffuse, vec3 specular) {
     vec3 ambientColor = ambient * light.ambient;
     vec3 diffuseColor = diffuse * light.diffuse * intensity;
     vec3 specularColor = specular * light.specular * intensity;
@@ -32,20 +106,36 @@ vec3 calcColorMix(float intensity, vec3 ambient, vec3 diffuse, vec3 specular) {
     return ambientColor + diffuseColor + specularColor;
 }
 
+float getBand(float intensity) {
+    intensity = pow(max(intensity, 0.0), material.shininess);
+    return floor(intensity * numOfBands) / numOfBands;
+}
+
 void main() {
-    vec3 lightDir = normalize(light.position - FragPos);
-    float intensity = dot(lightDir, normalize(Normal));
+    vec3 color = vec3(0.0);
 
-    intensity = pow(intensity, material.shininess);
+    if(hasDirLight) {
+        vec3 lightDir = normalize(-dirLight.direction);
+        // the shadow term is banded with the light so shadows get a hard toon edge
+        float intensity = getBand(dot(lightDir, normalize(Normal)) * getShadow(FragPos, normalize(Normal), lightDir));
+        color += material.ambient * dirLight.ambient + (material.diffuse * dirLight.diffuse + material.specular * dirLight.specular) * intensity;
+    }
 
-    intensity = floor(intensity * numOfBands) / numOfBands;
+    uvec2 cluster = getCluster();
+    for(uint i = 0u; i < cluster.y; i++) {
+        Light light = getLight(int(texelFetch(lightIndices, int(cluster.x + i)).r));
+        float distance = length(light.position - FragPos);
 
-    vec4 color;
+        vec3 lightDir = (light.position - FragPos) / max(distance, 1e-6);
+        float intensity = getBand(dot(lightDir, normalize(Normal)));
 
-    // Calculate the color using the non-linear intensity
-    color = vec4(calcColorMix(intensity, material.ambient, material.diffuse, material.specular), 1.0);
+        // Calculate the color using the non-linear intensity; attenuation is
+        // kept out of the banding so bands don't shift with distance
+        color += calcColorMix(light, intensity, material.ambient, material.diffuse, material.specular) * getAttenuation(light, distance);
+    }
 
-    FragColor = color;
+    FragColor = vec4(color, 1.0);
+    NormalOut = vec4(normalize(Normal), 2.0);
 }
 
 
@@ -5,36 +5,81 @@
 #include "../../../resourceManager.h"
 #include "../../../entityModules/renderModule.h"
 #include "outlineShader.h"
+#include "screenSpaceOutline.h"
+#include "../../deferred/deferredRenderer.h"
+#include "../../renderGraph/renderGraphExecutor.h"
 
 
 class ToonShader : public Shader {
 public:
     ToonShader(const char* PVS, const char* PFS) {
-        this->Compile(this->readShaderSource(PVS), this->readShaderSource(PFS));
+        this->Load(PVS, PFS);
         std::string vshaderPath = std::string(SRC_DIR) + "/shaders/forwardPass/toon/outlineShader.vert";
         std::string fshaderPath = std::string(SRC_DIR) + "/shaders/forwardPass/toon/outlineShader.frag";
         outlineShader = new OutlineShader(vshaderPath.c_str(), fshaderPath.c_str());
+        vshaderPath = std::string(SRC_DIR) + "/shaders/forwardPass/toon/screenOutline.vert";
+        fshaderPath = std::string(SRC_DIR) + "/shaders/forwardPass/toon/screenOutline.frag";
+        screenSpaceOutline = new ScreenSpaceOutline(vshaderPath.c_str(), fshaderPath.c_str());
     }
 
-    void Render() override {        
-        this->Use();
+    void Render() override {
+        drawObjects();
+        outlineShader->Render();
+    }
 
-        // Load camera uniforms
+    // with screen space outlines the objects go to transient targets and one
+    // pass resolves them and their outlines onto the backbuffer
+    void addPasses(RenderGraph& graph, const FrameResources& frame) override {
+        if(!ResourceManager::isScreenSpaceOutlines()){
+            Shader::addPasses(graph, frame);
+            return;
+        }
+        if(frame.deferred){
+            int pass = graph.addPass("Screen space outline", [this](){ RenderOverlay(); });
+            graph.write(pass, frame.backbuffer);
+            return;
+        }
 
-        this->SetMatrix4("view", ResourceManager::getActiveCamera()->getViewMatrix());
-        this->SetMatrix4("projection", ResourceManager::getActiveCamera()->getProjectionMatrix());
+        int color = graph.createTarget("Toon colour", RenderTargetDesc(frame.width, frame.height, GL_RGBA8));
+        int normal = graph.createTarget("Toon normal", RenderTargetDesc(frame.width, frame.height, GL_RGBA16F));
+        int depth = graph.createTarget("Toon depth", RenderTargetDesc(frame.width, frame.height, GL_DEPTH_COMPONENT24));
+        int pass = graph.addPass("Toon", [this](){
+            const GLfloat zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            const GLfloat farthest = 1.0f;
+            glClearBufferfv(GL_COLOR, 0, zero);
+            glClearBufferfv(GL_COLOR, 1, zero);
+            glClearBufferfv(GL_DEPTH, 0, &farthest);
+            drawObjects();
+        });
+        graph.read(pass, frame.shadowMap);
+        graph.write(pass, color);
+        graph.write(pass, normal);
+        graph.write(pass, depth, USAGE_DEPTH_ATTACHMENT);
 
-        if(pointLightsToRender[0] != nullptr){
-            this->SetVector3f("light.position", pointLightsToRender[0]->getPosition());
-            this->SetVector3f("light.ambient", pointLightsToRender[0]->getAmbient());
-            this->SetVector3f("light.diffuse", pointLightsToRender[0]->getDiffuse());
-            this->SetVector3f("light.specular", pointLightsToRender[0]->getSpecular());
-        }
+        RenderGraphExecutor* executor = frame.executor;
+        pass = graph.addPass("Screen space outline", [this, executor, color, normal, depth](){
+            screenSpaceOutline->resolve(executor->getTexture(normal), executor->getTexture(depth), executor->getTexture(color));
+        });
+        graph.read(pass, color);
+        graph.read(pass, normal);
+        graph.read(pass, depth);
+        graph.write(pass, frame.backbuffer);
+    }
 
-        // Load RenderModule uniforms
-        Shader::Render();
+    ShadingModel getShadingModel() const override {
+        return SHADING_TOON;
+    }
 
-        outlineShader->Render();
+    void RenderOverlay() override {
+        DeferredRenderer* deferredRenderer = ResourceManager::getDeferredRenderer();
+        if(ResourceManager::isScreenSpaceOutlines() && deferredRenderer != nullptr)
+            screenSpaceOutline->resolve(deferredRenderer->getNormalTexture(), deferredRenderer->getDepthTexture());
+        else
+            outlineShader->Render();
+    }
+
+    ScreenSpaceOutline* getScreenSpaceOutline() {
+        return screenSpaceOutline;
     }
 
     void bindRenderModule(RenderModule* object) override{
@@ -44,7 +89,31 @@ public:
     
 private:
     Shader* outlineShader;
+    ScreenSpaceOutline* screenSpaceOutline;
+
+    void drawObjects() {
+        this->Use();
+
+        // Load camera uniforms
+
+        this->SetMatrix4("view", ResourceManager::getActiveCamera()->getViewMatrix());
+        this->SetMatrix4("projection", ResourceManager::getActiveCamera()->getProjectionMatrix());
+
+        // point lights come from the light clusters
+        ResourceManager::bindLightClusters(this);
+
+        this->SetInteger("hasDirLight", !dirLightsToRender.empty());
+        if(!dirLightsToRender.empty()){
+            this->SetVector3f("dirLight.direction", dirLightsToRender[0]->getDirection());
+            this->SetVector3f("dirLight.ambient", dirLightsToRender[0]->getAmbient());
+            this->SetVector3f("dirLight.diffuse", dirLightsToRender[0]->getDiffuse());
+            this->SetVector3f("dirLight.specular", dirLightsToRender[0]->getSpecular());
+        }
+        ResourceManager::bindShadows(this);
 
+        // Load RenderModule uniforms
+        Shader::Render();
+    }
 };
 
 #endif // TOON_SHADER_H
\ No newline at end of file
@@ -1,6 +1,8 @@
 #version 330 core
 
 uniform samplerCube Cubemap;
+uniform float opacity;
+uniform bool weighted; // weighted blended OIT targets, see glassShader.h
 
 in vec3 Reflect;
 in vec3 RefractR;
@@ -9,7 +11,8 @@ in vec3 RefractB;
 
 in float Ratio;
 
-out vec4 FragColor;
+layout(location = 0) out vec4 FragColor;  // colour | weighted premultiplied colour and alpha
+layout(location = 1) out float Revealage; // product of (1 - alpha), weighted only
 
 void main()
 {
@@ -21,5 +24,17 @@ void main()
 
     reflectColor = vec3(texture(Cubemap, Reflect));
     vec3 color = mix(refractColor, reflectColor, Ratio);
-    FragColor = vec4(color, 1.0);
+    // the reflected part covers what is behind
+    float alpha = mix(opacity, 1.0, Ratio);
+
+    if (weighted) {
+        // McGuire and Bavoil's depth weight, nearer surfaces count more
+        float weight = clamp(alpha * max(1e-2, 3e3 * pow(1.0 - gl_FragCoord.z, 3.0)), 1e-2, 3e3);
+        FragColor = vec4(color * alpha, alpha) * weight;
+        Revealage = alpha;
+    }
+    else {
+        FragColor = vec4(color, alpha);
+        Revealage = 0.0;
+    }
 }
\ No newline at end of file
@@ -5,16 +5,107 @@
 #include "../../../resourceManager.h"
 #include "../../../entityModules/renderModule.h"
 #include "../../../cubemap.h"
+#include "../../../materials/glassMaterial.h"
+#include "../../../utils/depthSort.h"
+#include "../../../utils/profiler.h"
+#include "../../renderGraph/renderGraphExecutor.h"
 
+// Transparent glass, drawn after every opaque shader (see isTransparent())
+// with depth writes off. Each GlassMaterial picks how its objects composite:
+//
+//   TRANSPARENCY_SORTED    objects are blended back to front, ordered every
+//                          frame by the view depth of their bounds centre
+//                          (utils/depthSort.h). Exact between objects, but a
+//                          mesh overlapping itself is not sorted.
+//   TRANSPARENCY_WEIGHTED  weighted blended order independent transparency
+//                          (McGuire and Bavoil 2013). Objects are accumulated
+//                          into an RGBA16F colour and an R8 revealage target,
+//                          depth tested against a copy of the opaque depth,
+//                          and resolved over the scene by one full screen
+//                          pass. No sorting, self overlap included, but the
+//                          order is approximated by the depth weight.
+//
+// In the frame's render graph that is up to three passes: the weighted
+// accumulation into transient targets, its resolve, then the sorted objects
+// over it. The depth copy is a blit, so the backbuffer's depth must be
+// DEPTH24_STENCIL8 (the default framebuffer's usual format). Render() on its
+// own has no targets and draws every object sorted.
 
 class GlassShader : public Shader {
 public:
     GlassShader(const char* PVS, const char* PFS, Cubemap* cubemap) {
-        this->Compile(this->readShaderSource(PVS), this->readShaderSource(PFS));
+        this->Load(PVS, PFS);
         this->cubemap = cubemap;
+        std::string vshaderPath = std::string(SRC_DIR) + "/shaders/forwardPass/transmittance/oitComposite.vert";
+        std::string fshaderPath = std::string(SRC_DIR) + "/shaders/forwardPass/transmittance/oitComposite.frag";
+        compositeShader = new Shader(vshaderPath.c_str(), fshaderPath.c_str());
+        glGenVertexArrays(1, &screenVAO);
     }
 
     void Render() override {
+        sortedModules.clear();
+        for(RenderModule* module : objectsToRender){
+            if (module->isEnabled) sortedModules.push_back(module);
+        }
+        renderSorted();
+    }
+
+    void addPasses(RenderGraph& graph, const FrameResources& frame) override {
+        sortedModules.clear();
+        weightedModules.clear();
+        for(RenderModule* module : objectsToRender){
+            if (!module->isEnabled) continue;
+            GlassMaterial* glass = dynamic_cast<GlassMaterial*>(module->material);
+            if(glass != nullptr && glass->getTransparency() == TRANSPARENCY_WEIGHTED)
+                weightedModules.push_back(module);
+            else
+                sortedModules.push_back(module);
+        }
+
+        if(!weightedModules.empty()){
+            int accumulation = graph.createTarget("OIT accumulation", RenderTargetDesc(frame.width, frame.height, GL_RGBA16F));
+            int revealage = graph.createTarget("OIT revealage", RenderTargetDesc(frame.width, frame.height, GL_R8));
+            int depth = graph.createTarget("OIT depth", RenderTargetDesc(frame.width, frame.height, GL_DEPTH24_STENCIL8));
+            int pass = graph.addPass("Glass weighted", [this](){ renderWeighted(); });
+            graph.read(pass, frame.backbuffer, USAGE_DEPTH_ATTACHMENT);
+            graph.write(pass, accumulation);
+            graph.write(pass, revealage);
+            graph.write(pass, depth, USAGE_DEPTH_ATTACHMENT);
+
+            RenderGraphExecutor* executor = frame.executor;
+            pass = graph.addPass("Glass weighted resolve", [this, executor, accumulation, revealage](){
+                resolveWeighted(executor->getTexture(accumulation), executor->getTexture(revealage));
+            });
+            graph.read(pass, accumulation);
+            graph.read(pass, revealage);
+            graph.write(pass, frame.backbuffer);
+        }
+        if(!sortedModules.empty()){
+            int pass = graph.addPass("Glass sorted", [this](){ renderSorted(); });
+            graph.write(pass, frame.backbuffer);
+        }
+    }
+
+    bool isTransparent() const override { return true; }
+
+    void setCubeMap(Cubemap* cubemap) {
+        this->cubemap = cubemap;
+    }
+
+    Cubemap* getCubeMap() {
+        return this->cubemap;
+    }
+
+private:
+    Cubemap* cubemap;
+    std::vector<RenderModule*> sortedModules;
+    std::vector<RenderModule*> weightedModules;
+    std::vector<float> depths;
+    DepthSort depthSort;
+    Shader* compositeShader;
+    GLuint screenVAO = 0;
+
+    void begin(bool weighted) {
         this->Use();
 
         // Load camera uniforms
@@ -22,28 +113,93 @@ public:
         this->SetMatrix4("view", ResourceManager::getActiveCamera()->getViewMatrix());
         this->SetMatrix4("projection", ResourceManager::getActiveCamera()->getProjectionMatrix());
         this->SetVector3f("camPos", ResourceManager::getActiveCamera()->getPosition());
+        this->SetInteger("weighted", weighted);
 
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap->getID());
+        glDepthMask(GL_FALSE);
+        glEnable(GL_BLEND);
+    }
 
-        // Load RenderModule uniforms
-
-        Shader::Render();
+    void end() {
+        glDisable(GL_BLEND);
+        glDepthMask(GL_TRUE);
+    }
 
+    void draw(RenderModule* module) {
+        this->SetMatrix4("model", module->getParent()->getTransform());
+        module->material->Draw(this);
+        module->model->Draw(this);
     }
 
+    void renderSorted() {
+        if(sortedModules.empty()){
+            return;
+        }
+        {
+            PROFILE_SCOPE("Transparency sort");
+            glm::mat4 view = ResourceManager::getActiveCamera()->getViewMatrix();
+            depths.resize(sortedModules.size());
+            for(size_t i = 0; i < sortedModules.size(); i++){
+                glm::vec3 min, max;
+                sortedModules[i]->model->getBounds(min, max);
+                glm::vec4 centre = sortedModules[i]->getParent()->getTransform() * glm::vec4(0.5f * (min + max), 1.0f);
+                depths[i] = -(view * centre).z;
+            }
+            depthSort.sortBackToFront(depths.data(), depths.size());
+        }
 
-    void setCubeMap(Cubemap* cubemap) {
-        this->cubemap = cubemap;
+        begin(false);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        const std::vector<uint32_t>& order = depthSort.getOrder();
+        for(size_t i = 0; i < sortedModules.size(); i++){
+            draw(sortedModules[order[i]]);
+        }
+        end();
     }
 
-    Cubemap* getCubeMap() {
-        return this->cubemap;
+    // into the accumulation and revealage targets the render graph bound
+    void renderWeighted() {
+        GLint viewport[4], targets;
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &targets);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, ResourceManager::getBackBuffer());
+        glBlitFramebuffer(0, 0, viewport[2], viewport[3], 0, 0, viewport[2], viewport[3], GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, targets);
+        const GLfloat transparent[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        const GLfloat revealed[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        glClearBufferfv(GL_COLOR, 0, transparent);
+        glClearBufferfv(GL_COLOR, 1, revealed);
+
+        begin(true);
+        glBlendFunci(0, GL_ONE, GL_ONE);
+        glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+        for(RenderModule* module : weightedModules){
+            draw(module);
+        }
+        end();
     }
-    
-private:
-    Cubemap* cubemap;
 
+    void resolveWeighted(GLuint accumulation, GLuint revealage) {
+        compositeShader->Use();
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, accumulation);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, revealage);
+        glActiveTexture(GL_TEXTURE0);
+        compositeShader->SetInteger("accumulation", 0);
+        compositeShader->SetInteger("revealage", 1);
+
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDepthMask(GL_FALSE);
+        glDepthFunc(GL_ALWAYS);
+        glBindVertexArray(screenVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        glDepthFunc(GL_LESS);
+        end();
+    }
 };
 
-#endif // GLASS_SHADER_H
\ No newline at end of file
+#endif // GLASS_SHADER_H
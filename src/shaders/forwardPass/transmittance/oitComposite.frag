@@ -0,0 +1,24 @@
+#version 330 core
+
+// Resolves the weighted blended OIT targets over the opaque scene, blended
+// with SRC_ALPHA, ONE_MINUS_SRC_ALPHA.
+
+uniform sampler2D accumulation;
+uniform sampler2D revealage;
+
+out vec4 FragColor;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float reveal = texelFetch(revealage, texel, 0).r;
+    if (reveal >= 0.9999)
+        discard;
+
+    vec4 accum = texelFetch(accumulation, texel, 0);
+    // half floats overflow under many bright layers
+    if (isinf(max(max(abs(accum.r), abs(accum.g)), abs(accum.b))))
+        accum.rgb = vec3(accum.a);
+
+    FragColor = vec4(accum.rgb / max(accum.a, 1e-5), 1.0 - reveal);
+}
@@ -0,0 +1,168 @@
+#ifndef IMAGE_BASED_LIGHTING_H
+#define IMAGE_BASED_LIGHTING_H
+
+#include <glad/glad.h>
+#include <unordered_map>
+#include <chrono>
+#include <iostream>
+#include "../../shader.h"
+#include "../../cubemap.h"
+#include "../../utils/environmentLighting.h"
+#include "../../utils/fileHash.h"
+#include "../../utils/cubemapLoader.h"
+
+// Ambient lighting for the Cook-Torrance shaders from a skybox cubemap. The
+// irradiance SH, the GGX prefiltered mip chain and the BRDF LUT are computed
+// on the CPU (utils/environmentLighting.h); the first two are cached per
+// cubemap as <first face>.ibl and rebuilt when a source image changes. Every
+// cubemap set once stays on the GPU, so switching skyboxes back is free.
+// See getAmbient() in pbrShader.frag.
+
+class ImageBasedLighting {
+public:
+    ImageBasedLighting() {
+        glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::vector<glm::vec2> lut;
+        EnvironmentLighting::integrateBRDF(lutSize, lutSamples, lut);
+        glGenTextures(1, &brdfTexture);
+        glBindTexture(GL_TEXTURE_2D, brdfTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, lutSize, lutSize, 0, GL_RG, GL_FLOAT, lut.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        std::cout << "BRDF LUT integrated in " << millisecondsSince(start) << " ms" << std::endl;
+    }
+
+    // false when the faces can't be read, the shaders then keep the constant ambient
+    bool setEnvironment(Cubemap* cubemap) {
+        active = nullptr;
+        if(cubemap == nullptr){
+            return true;
+        }
+        std::unordered_map<Cubemap*, Probe>::iterator it = probes.find(cubemap);
+        if(it != probes.end()){
+            active = &it->second;
+            return true;
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        const std::vector<std::string>& sources = cubemap->getSourcePaths();
+        uint64_t hash = FileHash::seed;
+        for(const std::string& source : sources){
+            if(!FileHash::update(source, hash)){
+                std::cout << "IBL: can't read " << source << std::endl;
+                return false;
+            }
+        }
+        PrefilteredEnvironment environment;
+        std::string cachePath = EnvironmentLighting::getCachePath(sources[0]);
+        bool cached = EnvironmentLighting::read(cachePath, hash, environment);
+        if(!cached){
+            EnvironmentMap map;
+            if(!loadFaces(cubemap, map)){
+                return false;
+            }
+            EnvironmentLighting::compute(map, environment);
+            if(!EnvironmentLighting::write(cachePath, hash, environment)){
+                std::cout << "IBL: can't write " << cachePath << std::endl;
+            }
+        }
+        Probe& probe = probes[cubemap];
+        upload(environment, probe);
+        active = &probe;
+        std::cout << "IBL for " << sources[0] << (cached ? ": loaded from cache in " : ": precomputed in ")
+                  << millisecondsSince(start) << " ms" << std::endl;
+        return true;
+    }
+
+    void bind(Shader* shader) {
+        glActiveTexture(GL_TEXTURE0 + textureUnit);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, active != nullptr ? active->texture : 0);
+        glActiveTexture(GL_TEXTURE0 + textureUnit + 1);
+        glBindTexture(GL_TEXTURE_2D, brdfTexture);
+        glActiveTexture(GL_TEXTURE0);
+        shader->SetInteger("prefilteredMap", textureUnit);
+        shader->SetInteger("brdfLUT", textureUnit + 1);
+        shader->SetInteger("hasEnvironment", active != nullptr);
+        if(active == nullptr){
+            return;
+        }
+        shader->SetFloat("prefilteredLevels", (float)(active->levelCount - 1));
+        for(int i = 0; i < 9; i++){
+            shader->SetVector3f("irradianceSH[" + std::to_string(i) + "]", active->irradiance[i]);
+        }
+    }
+
+    static const int textureUnit = 16; // prefiltered environment, BRDF LUT
+
+private:
+    struct Probe {
+        GLuint texture = 0;
+        int levelCount = 0;
+        glm::vec3 irradiance[9];
+    };
+
+    static const int lutSize = 128;
+    static const int lutSamples = 512;
+
+    std::unordered_map<Cubemap*, Probe> probes;
+    Probe* active = nullptr;
+    GLuint brdfTexture = 0;
+
+    // the source images again, the cubemap's texture may be compressed
+    static bool loadFaces(Cubemap* cubemap, EnvironmentMap& map) {
+        const std::vector<std::string>& sources = cubemap->getSourcePaths();
+        CubemapImage image;
+        bool ok = sources.size() == 6 ? CubemapLoader::decodeFaces(sources.data(), image)
+                                      : CubemapLoader::loadEquirectangular(sources[0], cubemap->getSize(), image);
+        if(!ok){
+            std::cout << "IBL: the faces of " << sources[0] << " can't be loaded" << std::endl;
+            return false;
+        }
+        if(image.isHdr){
+            const float* faces[6];
+            for(int face = 0; face < 6; face++){
+                faces[face] = image.getHdrFace(face);
+            }
+            EnvironmentLighting::fromHdrImages(faces, image.size, map);
+        }
+        else{
+            const unsigned char* faces[6];
+            for(int face = 0; face < 6; face++){
+                faces[face] = image.getFace(face);
+            }
+            EnvironmentLighting::fromImages(faces, image.size, 4, map);
+        }
+        return true;
+    }
+
+    static void upload(const PrefilteredEnvironment& environment, Probe& probe) {
+        glGenTextures(1, &probe.texture);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, probe.texture);
+        probe.levelCount = environment.specular.size();
+        for(int level = 0; level < probe.levelCount; level++){
+            const EnvironmentMap& map = environment.specular[level];
+            for(int face = 0; face < 6; face++){
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGB16F, map.size, map.size, 0, GL_RGBA, GL_FLOAT, map.getTexel(face, 0, 0));
+            }
+        }
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, probe.levelCount - 1);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        for(int i = 0; i < 9; i++){
+            probe.irradiance[i] = environment.irradiance[i];
+        }
+    }
+
+    static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+#endif // IMAGE_BASED_LIGHTING_H
@@ -0,0 +1,228 @@
+#ifndef RENDER_GRAPH_EXECUTOR_H
+#define RENDER_GRAPH_EXECUTOR_H
+
+#include <glad/glad.h>
+#include <iostream>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include "../../utils/renderGraph.h"
+#include "../../utils/profiler.h"
+
+// Runs a compiled RenderGraph. The physical targets are textures kept from
+// frame to frame and only reallocated when the graph asks for a different
+// size or format, so transient targets cost nothing per frame once the
+// resolution settles.
+//
+// A pass that writes transient targets as attachments gets a framebuffer with
+// them bound (colour attachments in the order they were declared) and the
+// viewport set to their size; framebuffers are cached per attachment set. A
+// pass writing only imported resources runs on whatever framebuffer is bound,
+// the default one, and binds its own when it needs to. Barriers after storage
+// writes become glMemoryBarrier (GL 4.2+, there is no storage on 4.1 anyway);
+// the other transitions need nothing in GL once the writing framebuffer is
+// unbound.
+
+class RenderGraphExecutor;
+
+// What ResourceManager's frame graph hands Shader::addPasses
+struct FrameResources {
+    int backbuffer;     // the default framebuffer, colour and depth
+    int shadowMap;      // CascadedShadowMap's atlas
+    int width;
+    int height;
+    bool deferred;      // the deferred pass lit the objects of the non-forward shaders
+    RenderGraphExecutor* executor;
+};
+
+class RenderGraphExecutor {
+public:
+    void execute(const RenderGraph& graph) {
+        current = &graph;
+        allocateTargets(graph.getPhysicalTargets());
+
+        // passes without attachments draw into whatever was bound, the default
+        // framebuffer or a headless run's offscreen one
+        GLint viewport[4], framebuffer;
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+        for(int pass : graph.getOrder()){
+            PROFILE_SCOPE(graph.getPassName(pass));
+            PROFILE_GPU_SCOPE(graph.getPassName(pass));
+            issueBarriers(graph.getBarriers(pass));
+            bool bound = bindAttachments(graph, pass);
+            if(graph.getExecute(pass)){
+                graph.getExecute(pass)();
+            }
+            if(bound){
+                glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+                glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+            }
+        }
+        current = nullptr;
+    }
+
+    // the texture behind a transient resource of the graph being executed
+    GLuint getTexture(int resource) const {
+        int physical = current != nullptr ? current->getPhysical(resource) : -1;
+        return physical >= 0 ? targets[physical].texture : 0;
+    }
+
+    int getTargetCount() const {
+        return targets.size();
+    }
+
+    // bytes of all the physical targets
+    size_t getVideoMemory() const {
+        size_t bytes = 0;
+        for(const Target& target : targets){
+            bytes += (size_t)target.desc.width * target.desc.height * getBytesPerPixel(target.desc.format);
+        }
+        return bytes;
+    }
+
+    static int getBytesPerPixel(GLenum format) {
+        switch(format){
+        case GL_R8: return 1;
+        case GL_RG16F: return 4;
+        case GL_RGBA16F: return 8;
+        case GL_RGBA32F: return 16;
+        case GL_DEPTH_COMPONENT32F: return 4;
+        default: return 4; // RGBA8, DEPTH24(_STENCIL8), R32F
+        }
+    }
+
+private:
+    struct Target {
+        RenderTargetDesc desc;
+        GLuint texture = 0;
+    };
+
+    const RenderGraph* current = nullptr;
+    std::vector<Target> targets;
+    std::map<std::vector<GLuint>, GLuint> framebuffers; // attachments, depth last
+
+    static bool isDepthFormat(GLenum format) {
+        return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F
+            || format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+    }
+
+    void allocateTargets(const std::vector<RenderTargetDesc>& descs) {
+        if(targets.size() < descs.size()){
+            targets.resize(descs.size());
+        }
+        for(size_t i = 0; i < descs.size(); i++){
+            Target& target = targets[i];
+            if(target.texture != 0 && target.desc == descs[i]){
+                continue;
+            }
+            if(target.texture != 0){
+                releaseFramebuffers(target.texture);
+                glDeleteTextures(1, &target.texture);
+            }
+            target.desc = descs[i];
+            glGenTextures(1, &target.texture);
+            glBindTexture(GL_TEXTURE_2D, target.texture);
+            GLenum format = target.desc.format;
+            bool depth = isDepthFormat(format);
+            bool stencil = format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+            glTexImage2D(GL_TEXTURE_2D, 0, format, target.desc.width, target.desc.height, 0,
+                         stencil ? GL_DEPTH_STENCIL : (depth ? GL_DEPTH_COMPONENT : GL_RGBA),
+                         stencil ? GL_UNSIGNED_INT_24_8 : (depth ? GL_FLOAT : GL_UNSIGNED_BYTE), nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    // a framebuffer holding a texture that changed is stale
+    void releaseFramebuffers(GLuint texture) {
+        std::map<std::vector<GLuint>, GLuint>::iterator it = framebuffers.begin();
+        while(it != framebuffers.end()){
+            if(std::find(it->first.begin(), it->first.end(), texture) != it->first.end()){
+                glDeleteFramebuffers(1, &it->second);
+                it = framebuffers.erase(it);
+            }
+            else{
+                ++it;
+            }
+        }
+    }
+
+    bool bindAttachments(const RenderGraph& graph, int pass) {
+        std::vector<GLuint> colors;
+        GLuint depth = 0;
+        GLenum depthFormat = 0;
+        int width = 0, height = 0;
+        for(const RenderGraphAccess& access : graph.getAccesses(pass)){
+            int physical = graph.getPhysical(access.resource);
+            if(!access.write || physical < 0 || (access.usage != USAGE_COLOR_ATTACHMENT && access.usage != USAGE_DEPTH_ATTACHMENT)){
+                continue;
+            }
+            if(access.usage == USAGE_DEPTH_ATTACHMENT){
+                depth = targets[physical].texture;
+                depthFormat = targets[physical].desc.format;
+            }
+            else{
+                colors.push_back(targets[physical].texture);
+            }
+            width = targets[physical].desc.width;
+            height = targets[physical].desc.height;
+        }
+        if(colors.empty() && depth == 0){
+            return false;
+        }
+
+        std::vector<GLuint> key = colors;
+        key.push_back(depth);
+        GLuint& framebuffer = framebuffers[key];
+        if(framebuffer == 0){
+            glGenFramebuffers(1, &framebuffer);
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            std::vector<GLenum> drawBuffers;
+            for(size_t i = 0; i < colors.size(); i++){
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colors[i], 0);
+                drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+            }
+            if(depth != 0){
+                bool stencil = depthFormat == GL_DEPTH24_STENCIL8 || depthFormat == GL_DEPTH32F_STENCIL8;
+                glFramebufferTexture2D(GL_FRAMEBUFFER, stencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+            }
+            if(drawBuffers.empty()){
+                glDrawBuffer(GL_NONE);
+            }
+            else{
+                glDrawBuffers(drawBuffers.size(), drawBuffers.data());
+            }
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+                std::cerr << "Render graph framebuffer for " << graph.getPassName(pass) << " is not complete!" << std::endl;
+            }
+        }
+        else{
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        }
+        glViewport(0, 0, width, height);
+        return true;
+    }
+
+    void issueBarriers(const std::vector<RenderGraphBarrier>& barriers) {
+        GLbitfield bits = 0;
+        for(const RenderGraphBarrier& barrier : barriers){
+            if(barrier.before != USAGE_STORAGE){
+                continue;
+            }
+            switch(barrier.after){
+            case USAGE_SAMPLED: bits |= GL_TEXTURE_FETCH_BARRIER_BIT; break;
+            case USAGE_STORAGE: bits |= GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT; break;
+            default: bits |= GL_FRAMEBUFFER_BARRIER_BIT; break;
+            }
+        }
+        if(bits != 0 && (GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 2))){
+            glMemoryBarrier(bits);
+        }
+    }
+};
+
+#endif // RENDER_GRAPH_EXECUTOR_H
@@ -0,0 +1,170 @@
+#ifndef CASCADED_SHADOW_MAP_H
+#define CASCADED_SHADOW_MAP_H
+
+#include "../../shader.h"
+#include "../../resourceManager.h"
+#include "../../entityModules/renderModule.h"
+#include "../../utils/shadowCascades.h"
+#include "../../utils/profiler.h"
+
+// Directional light shadows: the cascades (see utils/shadowCascades.h) are
+// rendered into one depth atlas, two cascades per row. Receivers get the
+// atlas as a sampler2DShadow plus one matrix per cascade that maps world
+// space straight to atlas uv and depth; see getShadow() in blinnPhong.frag.
+
+class CascadedShadowMap : public Shader {
+public:
+    CascadedShadowMap(const char* PVS, const char* PFS, int resolution = 1024, int cascadeCount = 4) {
+        this->Load(PVS, PFS);
+        cascades.setResolution(resolution);
+        cascades.setCascadeCount(cascadeCount);
+    }
+
+    // Fits the cascades to the camera and draws the casters each one sees
+    void render(Camera* camera, DirectionalLight* light, const std::vector<RenderModule*>& casters) {
+        PROFILE_SCOPE("Shadow pass");
+        PROFILE_GPU_SCOPE("Shadow pass");
+        isActive = camera->getProjection() == PERSP && light != nullptr;
+        if(!isActive){
+            return;
+        }
+        if(atlasResolution != getAtlasSize()){
+            createAtlas();
+        }
+
+        std::vector<glm::vec3> mins(casters.size()), maxs(casters.size());
+        glm::vec3 sceneMin(FLT_MAX), sceneMax(-FLT_MAX);
+        for(int i = 0; i < casters.size(); i++){
+            glm::vec3 min, max;
+            casters[i]->model->getBounds(min, max);
+            ShadowCascades::transformBounds(casters[i]->getParent()->getTransform(), min, max, mins[i], maxs[i]);
+            sceneMin = glm::min(sceneMin, mins[i]);
+            sceneMax = glm::max(sceneMax, maxs[i]);
+        }
+
+        {
+            PROFILE_SCOPE("Shadow cascade fitting");
+            cascades.fit(camera->getViewMatrix(), camera->getFov(), camera->getAspect(), camera->getNear(), camera->getFar(), light->getDirection(), sceneMin, sceneMax);
+            cascades.cullCasters(mins, maxs, visible);
+        }
+
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, atlasResolution, atlasResolution);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        glEnable(GL_DEPTH_TEST);
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(slopeBias, 1.0f);
+
+        this->Use();
+        int resolution = cascades.getResolution();
+        for(int c = 0; c < cascades.getCascadeCount(); c++){
+            glViewport((c % 2) * resolution, (c / 2) * resolution, resolution, resolution);
+            this->SetMatrix4("lightSpace", cascades.getCascade(c).viewProjection);
+            for(int i : visible[c]){
+                this->SetInteger("hasBones", 0);
+                this->SetMatrix4("model", casters[i]->getParent()->getTransform());
+                casters[i]->model->Draw(this, false);
+            }
+        }
+
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glBindFramebuffer(GL_FRAMEBUFFER, ResourceManager::getBackBuffer());
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    }
+
+    // Uniforms and atlas for a receiving shader
+    void bind(Shader* shader) {
+        glActiveTexture(GL_TEXTURE0 + textureUnit);
+        glBindTexture(GL_TEXTURE_2D, depthTexture);
+        glActiveTexture(GL_TEXTURE0);
+        shader->SetInteger("shadowMap", textureUnit);
+        shader->SetInteger("numCascades", isActive ? cascades.getCascadeCount() : 0);
+        if(!isActive){
+            return;
+        }
+
+        float tile = (float)cascades.getResolution() / atlasResolution;
+        for(int c = 0; c < cascades.getCascadeCount(); c++){
+            // ndc -> [0, 1], then into the cascade's tile of the atlas
+            glm::vec2 offset = glm::vec2(c % 2, c / 2) * tile;
+            glm::mat4 toAtlas = glm::translate(glm::mat4(1.0f), glm::vec3(offset + glm::vec2(0.5f * tile), 0.5f)) *
+                                glm::scale(glm::mat4(1.0f), glm::vec3(0.5f * tile, 0.5f * tile, 0.5f));
+            std::string index = "[" + std::to_string(c) + "]";
+            shader->SetMatrix4("shadowMatrices" + index, toAtlas * cascades.getCascade(c).viewProjection);
+            shader->SetVector4f("shadowTileRects" + index, glm::vec4(offset, offset + glm::vec2(tile)));
+            shader->SetFloat("cascadeSplits" + index, cascades.getCascade(c).splitFar);
+        }
+        shader->SetFloat("shadowTexelSize", 1.0f / atlasResolution);
+        shader->SetFloat("shadowBias", depthBias);
+    }
+
+    ShadowCascades& getCascades() {
+        return cascades;
+    }
+
+    void OnGui() {
+        ImGui::Begin("Shadows");
+        float distance = cascades.getShadowDistance();
+        if(ImGui::SliderFloat("Shadow Distance", &distance, 1.0f, 1000.0f)){
+            cascades.setShadowDistance(distance);
+        }
+        float lambda = cascades.getSplitLambda();
+        if(ImGui::SliderFloat("Split Lambda", &lambda, 0.0f, 1.0f)){
+            cascades.setSplitLambda(lambda);
+        }
+        ImGui::SliderFloat("Depth Bias", &depthBias, 0.0f, 0.01f, "%.5f");
+        ImGui::SliderFloat("Slope Bias", &slopeBias, 0.0f, 8.0f);
+        for(int c = 0; c < cascades.getCascadeCount() && c < visible.size(); c++){
+            const ShadowCascade& cascade = cascades.getCascade(c);
+            ImGui::Text("Cascade %d: %.1f - %.1f, %d casters, %.3f units/texel", c, cascade.splitNear, cascade.splitFar, (int)visible[c].size(), cascade.texelSize);
+        }
+        ImGui::End();
+    }
+
+    static const int textureUnit = 12;
+
+private:
+    ShadowCascades cascades;
+    std::vector<std::vector<int> > visible;
+    GLuint framebuffer = 0;
+    GLuint depthTexture = 0;
+    int atlasResolution = 0;
+    bool isActive = false;
+    float depthBias = 0.0005f;
+    float slopeBias = 2.0f;
+
+    int getAtlasSize() {
+        return cascades.getResolution() * (cascades.getCascadeCount() > 1 ? 2 : 1);
+    }
+
+    void createAtlas() {
+        if(framebuffer == 0){
+            glGenFramebuffers(1, &framebuffer);
+            glGenTextures(1, &depthTexture);
+        }
+        atlasResolution = getAtlasSize();
+
+        // depth compare for hardware 2x2 PCF through sampler2DShadow
+        glBindTexture(GL_TEXTURE_2D, depthTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, atlasResolution, atlasResolution, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "Shadow map framebuffer is not complete!" << std::endl;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+};
+
+#endif // CASCADED_SHADOW_MAP_H
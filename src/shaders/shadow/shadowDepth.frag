@@ -0,0 +1,6 @@
+#version 330 core
+
+// depth only, written by the rasteriser
+void main()
+{
+}
@@ -0,0 +1,36 @@
+#version 330 core
+
+layout(location = 0) in vec3 pos;
+layout(location = 5) in ivec4 boneIds;
+layout(location = 6) in vec4 weights;
+
+uniform mat4 lightSpace;
+uniform mat4 model;
+uniform bool hasBones;
+
+const int MAX_BONES = 100;
+const int MAX_BONE_INFLUENCE = 4;
+uniform mat4 boneTransforms[MAX_BONES];
+
+void main()
+{
+    vec4 position = vec4(pos, 1.0);
+    if(hasBones)
+    {
+        // same skinning as animShader.vert
+        vec4 skinned = vec4(0.0);
+        for(int i = 0; i < MAX_BONE_INFLUENCE; i++)
+        {
+            if(boneIds[i] == -1)
+                continue;
+            if(boneIds[i] >= MAX_BONES)
+            {
+                skinned = position;
+                break;
+            }
+            skinned += boneTransforms[boneIds[i]] * position * weights[i];
+        }
+        position = skinned;
+    }
+    gl_Position = lightSpace * model * position;
+}
@@ -5,8 +5,12 @@ in vec3 TexCoord;
 out vec4 FragColor;
 
 uniform samplerCube skybox;
+uniform bool isHdr;
 
 void main()
 {
     FragColor = texture(skybox, TexCoord);
+    // linear HDR cubemaps get the PBR shader's tonemapping and gamma
+    if(isHdr)
+        FragColor.rgb = pow(FragColor.rgb / (FragColor.rgb + vec3(1.0)), vec3(1.0 / 2.2));
 } 
\ No newline at end of file
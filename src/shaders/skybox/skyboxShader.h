@@ -9,7 +9,7 @@
 class SkyboxShader : public Shader {
 public:
     SkyboxShader(const char* PVS, const char* PFS, Cubemap* skybox) {
-        this->Compile(this->readShaderSource(PVS), this->readShaderSource(PFS));
+        this->Load(PVS, PFS);
         this->skybox = skybox;
         this->setupBox();
     }
@@ -83,6 +83,7 @@ public:
         glBindVertexArray(VAO);
             glActiveTexture(GL_TEXTURE0);
             glBindTexture(GL_TEXTURE_CUBE_MAP, skybox->getID());
+        this->SetInteger("isHdr", skybox->isHdr());
         glDrawArrays(GL_TRIANGLES, 0, 36);
         glBindVertexArray(0);
         glDepthFunc(GL_LESS);
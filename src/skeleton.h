@@ -0,0 +1,107 @@
+#ifndef SKELETON_H
+#define SKELETON_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <glm/glm.hpp>
+#include "utils/assimpHelper.h"
+#include "utils/animData.h"
+
+class Bone;
+
+// A model's bones as one flat table: name, parent index, palette index (the
+// BoneInfo id the vertices are skinned with), the local bind pose and the
+// inverse bind (offset) matrix. Parents come before their children, so
+// anything that walks the hierarchy top down is a loop over the table, and
+// names are hashed to indices, so finding a bone doesn't walk the tree.
+//
+// import() builds it in one pass over the node hierarchy: a node whose name
+// has a BoneInfo is a bone, its parent the nearest bone above it. A bone with
+// no bone above it besides the first root hangs off that root, as the tree
+// walk this replaced did. The Bone entities Model poses and animates are
+// views onto the table (Bone::createViews), one per row; a row's view is
+// reachable from its index. GL free, graphics_bench imports its own rigs.
+
+class Skeleton {
+public:
+    struct Joint {
+        int parent;             // -1 for the root
+        int id;                 // into the bone palette
+        glm::mat4 bindPose;     // relative to the parent
+        glm::mat4 inverseBind;  // model space to bone space
+    };
+
+    // Node has aiNode's fields (mName, mTransformation, mNumChildren, mChildren)
+    template<typename Node>
+    void import(const Node* root, const std::map<std::string, BoneInfo>& boneInfoMap){
+        clear();
+        std::vector<std::pair<const Node*, int> > stack;
+        if(root != nullptr){
+            stack.push_back(std::make_pair(root, -1));
+        }
+        while(!stack.empty()){
+            const Node* node = stack.back().first;
+            int parent = stack.back().second;
+            stack.pop_back();
+            std::map<std::string, BoneInfo>::const_iterator info = boneInfoMap.find(node->mName.C_Str());
+            if(info != boneInfoMap.end()){
+                parent = addJoint(node->mName.C_Str(), parent < 0 && !joints.empty() ? 0 : parent, info->second.id,
+                                  AssimpGLMHelpers::ConvertMatrixToGLMFormat(node->mTransformation), info->second.offset);
+            }
+            // pushed last to first, so siblings keep their order
+            for(unsigned int i = node->mNumChildren; i-- > 0;){
+                stack.push_back(std::make_pair((const Node*)node->mChildren[i], parent));
+            }
+        }
+    }
+
+    // parent must already be in the table; returns the new bone's index
+    int addJoint(const std::string& name, int parent, int id, const glm::mat4& bindPose, const glm::mat4& inverseBind){
+        Joint joint = { parent, id, bindPose, inverseBind };
+        joints.push_back(joint);
+        names.push_back(name);
+        views.push_back(nullptr);
+        // a repeated name keeps finding the first bone with it
+        indices.insert(std::make_pair(name, (int)joints.size() - 1));
+        return (int)joints.size() - 1;
+    }
+
+    void clear(){
+        joints.clear();
+        names.clear();
+        views.clear();
+        indices.clear();
+    }
+
+    // -1 when there is no bone with that name
+    int findBone(const std::string& name) const {
+        std::unordered_map<std::string, int>::const_iterator it = indices.find(name);
+        return it == indices.end() ? -1 : it->second;
+    }
+
+    // true when index is ancestor or below it
+    bool isInSubtree(int index, int ancestor) const {
+        while(index > ancestor){
+            index = joints[index].parent;
+        }
+        return index == ancestor;
+    }
+
+    int getBoneCount() const { return joints.size(); }
+    const Joint& getJoint(int index) const { return joints[index]; }
+    const std::string& getName(int index) const { return names[index]; }
+    void setInverseBind(int index, const glm::mat4& inverseBind) { joints[index].inverseBind = inverseBind; }
+    Bone* getView(int index) const { return views[index]; }
+    void setView(int index, Bone* bone) { views[index] = bone; }
+
+private:
+    std::vector<Joint> joints;
+    std::vector<std::string> names;
+    std::vector<Bone*> views;
+    std::unordered_map<std::string, int> indices;
+};
+
+#endif // SKELETON_H
@@ -3,15 +3,29 @@
 
 #include <string>
 #include <iostream>
+#include <chrono>
+#include <cstring>
 #include <glad/glad.h>
 #include "utils/stb_image.h"
+#include "utils/textureCooker.h"
+#include "utils/coneStepMap.h"
+#include "utils/fileHash.h"
+
+// S3TC isn't core GL, glad only has the core enums
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
 
 enum TextureType {
     DIFFUSE,
     SPECULAR,
     NORMAL,
     HEIGHT,
-    ROUGHNESS
+    ROUGHNESS,
+    CONE_STEP   // built from a height image, see loadConeStep
 };
 
 class Texture {
@@ -23,8 +37,25 @@ public:
     }
     ~Texture() = default;
 
+    // A cooked <file>.gtex next to the image (see tools/textureCooker.cpp) is
+    // used when the driver takes its format, otherwise the image is decoded.
     unsigned int load(bool useMipmaps = true, GLenum interpolation = GL_LINEAR) {
         std::cout << "Loading texture: " << filePath;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (type == CONE_STEP) {
+            if (loadConeStep(interpolation))
+                std::cout << "          Done (cone step map, " << videoMemory / 1024 << " KB, "
+                          << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms)" << std::endl;
+            else
+                std::cout << "          Missing (build it with texture_cooker --cone " << filePath << ")" << std::endl;
+            return ID;
+        }
+        if (loadCooked(useMipmaps, interpolation)) {
+            std::cout << "          Done (" << TextureCooker::getFormatName(format) << ", " << videoMemory / 1024 << " KB, "
+                      << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms)" << std::endl;
+            return ID;
+        }
+
         const char* path = filePath.c_str();
         unsigned char* data = stbi_load(path, &width, &height, &channels, 0);
         if (data) {
@@ -56,7 +87,11 @@ public:
 
             stbi_image_free(data);
 
-            std::cout << "          Done" << std::endl;
+            videoMemory = (size_t)width * height * channels;
+            if (useMipmaps)
+                videoMemory = videoMemory * 4 / 3;
+            std::cout << "          Done (" << videoMemory / 1024 << " KB, "
+                      << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms)" << std::endl;
         } else {
             std::cout << "          Failed" << std::endl;
             stbi_image_free(data);
@@ -89,12 +124,115 @@ public:
         return channels;
     }
 
+    // COOKED_RGBA8 for images loaded uncompressed
+    CookedFormat getFormat() const {
+        return format;
+    }
+
+    // bytes of every uploaded level
+    size_t getVideoMemory() const {
+        return videoMemory;
+    }
+
+    static GLenum getCompressedFormat(CookedFormat format) {
+        switch (format) {
+            case COOKED_BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            case COOKED_BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            case COOKED_BC5: return GL_COMPRESSED_RG_RGTC2;
+            case COOKED_BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+            default: return GL_RGBA8;
+        }
+    }
+
+    // RGTC is core since 3.0, S3TC is an extension (everywhere but some
+    // mobile drivers) and BPTC needs 4.2, which macOS doesn't have
+    static bool isFormatSupported(CookedFormat format) {
+        if (format == COOKED_RGBA8 || format == COOKED_BC5)
+            return true;
+        const char* extension = format == COOKED_BC7 ? "GL_ARB_texture_compression_bptc" : "GL_EXT_texture_compression_s3tc";
+        if (format == COOKED_BC7 && (GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 2)))
+            return true;
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++) {
+            const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+            if (name != nullptr && strcmp(name, extension) == 0)
+                return true;
+        }
+        return false;
+    }
+
 private:
-    unsigned int ID;
+    unsigned int ID = 0;
     std::string filePath;
     int width, height;
     TextureType type;
     int channels;
+    CookedFormat format = COOKED_RGBA8;
+    size_t videoMemory = 0;
+
+    bool loadCooked(bool useMipmaps, GLenum interpolation) {
+        CookedTexture cooked;
+        if (!TextureCooker::read(TextureCooker::getCookedPath(filePath), cooked) || cooked.faces != 1 || !isFormatSupported(cooked.format))
+            return false;
+
+        glGenTextures(1, &ID);
+        glBindTexture(GL_TEXTURE_2D, ID);
+        // the cooked chain replaces glGenerateMipmap, which can't run on compressed textures
+        int levels = useMipmaps ? cooked.mips.size() : 1;
+        videoMemory = 0;
+        for (int level = 0; level < levels; level++) {
+            const CookedMip& mip = cooked.mips[level];
+            if (cooked.format == COOKED_RGBA8)
+                glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, mip.width, mip.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, cooked.getLevel(level));
+            else
+                glCompressedTexImage2D(GL_TEXTURE_2D, level, getCompressedFormat(cooked.format), mip.width, mip.height, 0, mip.size, cooked.getLevel(level));
+            videoMemory += mip.size;
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+        if (levels > 1)
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, interpolation == GL_NEAREST ? GL_NEAREST_MIPMAP_NEAREST : GL_LINEAR_MIPMAP_LINEAR);
+        else
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, interpolation);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, interpolation);
+
+        width = cooked.width;
+        height = cooked.height;
+        channels = cooked.channels;
+        format = cooked.format;
+        return true;
+    }
+
+    // Cone step map (depth, sqrt cone ratio) of the height image, read from
+    // the <file>.cone texture_cooker --cone wrote. Building one takes seconds,
+    // so a missing or stale map isn't built here: ID stays 0 and the shader
+    // marches the height texture instead. No mips, averaged cones would be
+    // wider than the texels' own.
+    bool loadConeStep(GLenum interpolation) {
+        uint64_t hash;
+        if (!FileHash::hashFile(filePath, hash))
+            return false;
+        std::vector<unsigned char> cones;
+        if (!ConeStepMap::read(ConeStepMap::getCachePath(filePath), hash, width, height, cones))
+            return false;
+
+        glGenTextures(1, &ID);
+        glBindTexture(GL_TEXTURE_2D, ID);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG8, width, height, 0, GL_RG, GL_UNSIGNED_BYTE, cones.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, interpolation);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, interpolation);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+        channels = 2;
+        videoMemory = cones.size();
+        return true;
+    }
 };
 
 #endif 
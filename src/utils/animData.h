@@ -5,6 +5,8 @@
 #include <vector>
 #include <string>
 #include <sstream>
+#include <fstream>
+#include "weightCurve.h"
 
 struct BoneInfo
 {
@@ -29,7 +31,54 @@ public:
         return result;
     }
 
-    // Function to read the input and parse each line
+    // Function to read the input and parse each line, one vector per frame
+    static std::vector<std::vector<float>> parseAnimationFrames(const std::string& filename) {
+        std::vector<std::vector<float>> result;
+        std::ifstream file(filename);
+        if (!file.is_open()) {
+            std::cerr << "Error opening file: " << filename << std::endl;
+            return result;
+        }
+        std::string line;
+        while (std::getline(file, line)) {
+            std::vector<float> floatArray = parseFrame(line);
+            if (!floatArray.empty()) {
+                result.push_back(floatArray);
+            }
+        }
+        return result;
+    }
+
+    // Converts a text animation (one frame of weights per line) to the binary
+    // .wcrv format, streaming line by line so long takes are never held whole
+    static bool convertAnimationData(const std::string& textFile, const std::string& binaryFile, float frameRate = 30.0f) {
+        std::ifstream file(textFile);
+        if (!file.is_open()) {
+            std::cerr << "Error opening file: " << textFile << std::endl;
+            return false;
+        }
+        WeightCurveWriter writer;
+        std::string line;
+        int channelCount = -1;
+        while (std::getline(file, line)) {
+            std::vector<float> frame = parseFrame(line);
+            if (frame.empty()) {
+                continue;
+            }
+            if (channelCount == -1) {
+                channelCount = frame.size();
+                if (!writer.open(binaryFile, channelCount, frameRate)) {
+                    return false;
+                }
+            }
+            frame.resize(channelCount, 0.0f);
+            writer.appendFrame(&frame[0]);
+        }
+        writer.close();
+        return channelCount != -1;
+    }
+
+    // Function to read the input and parse each line, transposed to one vector per channel
     static std::vector<std::vector<float>> parseAnimationData(const std::string& filename) {
         std::vector<std::vector<float>> result;
         std::ifstream file(filename);
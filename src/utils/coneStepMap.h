@@ -0,0 +1,287 @@
+#ifndef CONE_STEP_MAP_H
+#define CONE_STEP_MAP_H
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cfloat>
+#include <stdint.h>
+
+// Relaxed cone step maps for parallax mapping (Policarpo and Oliveira, GPU
+// Gems 3 ch. 18). Texel p with depth d(p) (the height texture's value, 0 at
+// the top as texturedShader.frag reads it) gets the widest cone standing on
+// it that a ray from the top plane crosses the surface in at most once:
+//
+//   ratio(p) = min over d(q) < d(p), q an exit, of |q - p| / (d(p) - d(q))
+//
+// with |q - p| in texture coordinates, wrapping around as GL_REPEAT does,
+// and the ratio capped at 1. q is an exit when the ray from the top above p
+// through the surface at q comes out of it again right behind q (isExit).
+// The conservative cone takes every higher q and so has no surface inside
+// it; on a noisy height map every one-level bump next to p closes it. The
+// relaxed cone may hold surface, but only as one solid stretch, so a ray
+// advanced to the cone's edge is either still above the first hit or past
+// it with nothing skipped, and the shader finds the hit between its last two
+// samples.
+//
+// The output is two channels per texel: the depth and sqrt(ratio), rounded
+// down so quantisation never widens a cone. build() prunes the search with a
+// pyramid of minimum depths (the conservative ratio bounds the relaxed one
+// from below) and splits rows over threads; buildReference() is the brute
+// force O(n^2) version it is checked against. GL free; texture_cooker --cone
+// builds the maps offline and Texture only reads them (type CONE_STEP).
+
+class ConeStepMap {
+public:
+    static const uint32_t magic = 0x454E4F43;  // "CONE"
+    static const uint32_t version = 2;  // 1 held conservative cones
+
+    // <image>.cone, the cache next to the height image
+    static std::string getCachePath(const std::string& imagePath){
+        return imagePath + ".cone";
+    }
+
+    // heights with the given stride between texels (the first channel is used)
+    static void build(const unsigned char* heights, int width, int height, int stride, std::vector<unsigned char>& cones, int numThreads = 0){
+        MinPyramid pyramid;
+        buildPyramid(heights, width, height, stride, pyramid);
+        cones.resize((size_t)width * height * 2);
+
+        if(numThreads <= 0){
+            numThreads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        // a few rows per thread at least, small maps aren't worth the threads
+        numThreads = std::max(1, std::min(numThreads, height / 8));
+        if(numThreads == 1){
+            buildRows(pyramid, cones, 0, height);
+            return;
+        }
+        std::vector<std::thread> threads;
+        int chunk = (height + numThreads - 1) / numThreads;
+        for(int t = 0; t < numThreads; t++){
+            int begin = t * chunk;
+            int end = std::min(height, begin + chunk);
+            if(begin < end){
+                threads.push_back(std::thread(&ConeStepMap::buildRows, std::cref(pyramid), std::ref(cones), begin, end));
+            }
+        }
+        for(std::thread& thread : threads){
+            thread.join();
+        }
+    }
+
+    static void buildReference(const unsigned char* heights, int width, int height, int stride, std::vector<unsigned char>& cones){
+        cones.resize((size_t)width * height * 2);
+        for(int y = 0; y < height; y++){
+            for(int x = 0; x < width; x++){
+                unsigned char depth = heights[(size_t)(x + width * y) * stride];
+                float best = 1.0f;
+                for(int qy = 0; qy < height; qy++){
+                    for(int qx = 0; qx < width; qx++){
+                        unsigned char other = heights[(size_t)(qx + width * qy) * stride];
+                        if(other < depth && isExit(heights, width, height, x, y, qx, qy, stride)){
+                            float dx = (float)wrappedDistance(x, qx, qx, width) / width;
+                            float dy = (float)wrappedDistance(y, qy, qy, height) / height;
+                            best = std::min(best, getRatio(dx, dy, depth, other));
+                        }
+                    }
+                }
+                store(cones, (size_t)x + (size_t)width * y, depth, best);
+            }
+        }
+    }
+
+    // sourceHash is FileHash::hashFile of the height image
+    static bool write(const std::string& path, uint64_t sourceHash, int width, int height, const std::vector<unsigned char>& cones){
+        FILE* fp = fopen(path.c_str(), "wb");
+        if(fp == NULL){
+            return false;
+        }
+        uint32_t header[4] = { magic, version, (uint32_t)width, (uint32_t)height };
+        bool ok = fwrite(header, sizeof(header), 1, fp) == 1 && fwrite(&sourceHash, sizeof(sourceHash), 1, fp) == 1;
+        ok = ok && (cones.empty() || fwrite(cones.data(), cones.size(), 1, fp) == 1);
+        fclose(fp);
+        return ok;
+    }
+
+    // false when missing, stale (built from another image) or malformed
+    static bool read(const std::string& path, uint64_t sourceHash, int& width, int& height, std::vector<unsigned char>& cones){
+        FILE* fp = fopen(path.c_str(), "rb");
+        if(fp == NULL){
+            return false;
+        }
+        uint32_t header[4];
+        uint64_t hash;
+        bool ok = fread(header, sizeof(header), 1, fp) == 1 && fread(&hash, sizeof(hash), 1, fp) == 1;
+        ok = ok && header[0] == magic && header[1] == version && hash == sourceHash;
+        if(ok){
+            width = header[2];
+            height = header[3];
+            cones.resize((size_t)width * height * 2);
+            ok = cones.empty() || fread(cones.data(), cones.size(), 1, fp) == 1;
+        }
+        fclose(fp);
+        return ok;
+    }
+
+    // the cone ratio a stored texel stands for
+    static float getStoredRatio(const unsigned char* texel){
+        float root = texel[1] / 255.0f;
+        return root * root;
+    }
+
+private:
+    struct MinPyramid {
+        int width;
+        int height;
+        std::vector<int> widths;
+        std::vector<int> heights;
+        std::vector<std::vector<unsigned char> > levels;  // minimum depth of the 2^level square below
+    };
+
+    struct Node {
+        int level;
+        int x;
+        int y;
+        float bound;
+    };
+
+    static void buildPyramid(const unsigned char* heights, int width, int height, int stride, MinPyramid& pyramid){
+        pyramid.width = width;
+        pyramid.height = height;
+        pyramid.widths.assign(1, width);
+        pyramid.heights.assign(1, height);
+        pyramid.levels.assign(1, std::vector<unsigned char>((size_t)width * height));
+        for(size_t i = 0; i < (size_t)width * height; i++){
+            pyramid.levels[0][i] = heights[i * stride];
+        }
+        while(pyramid.widths.back() > 1 || pyramid.heights.back() > 1){
+            int w = pyramid.widths.back();
+            int h = pyramid.heights.back();
+            int nw = (w + 1) / 2;
+            int nh = (h + 1) / 2;
+            const std::vector<unsigned char>& src = pyramid.levels.back();
+            std::vector<unsigned char> level((size_t)nw * nh);
+            for(int y = 0; y < nh; y++){
+                for(int x = 0; x < nw; x++){
+                    unsigned char m = 255;
+                    for(int sy = 2 * y; sy < std::min(h, 2 * y + 2); sy++){
+                        for(int sx = 2 * x; sx < std::min(w, 2 * x + 2); sx++){
+                            m = std::min(m, src[sx + (size_t)w * sy]);
+                        }
+                    }
+                    level[x + (size_t)nw * y] = m;
+                }
+            }
+            pyramid.widths.push_back(nw);
+            pyramid.heights.push_back(nh);
+            pyramid.levels.push_back(level);
+        }
+    }
+
+    static void buildRows(const MinPyramid& pyramid, std::vector<unsigned char>& cones, int begin, int end){
+        std::vector<Node> stack;
+        int top = pyramid.levels.size() - 1;
+        for(int y = begin; y < end; y++){
+            for(int x = 0; x < pyramid.width; x++){
+                unsigned char depth = pyramid.levels[0][x + (size_t)pyramid.width * y];
+                float best = 1.0f;
+                stack.clear();
+                Node root = { top, 0, 0, 0.0f };
+                stack.push_back(root);
+                while(!stack.empty()){
+                    Node node = stack.back();
+                    stack.pop_back();
+                    if(node.bound >= best){
+                        continue;
+                    }
+                    if(node.level == 0){
+                        if(isExit(pyramid.levels[0].data(), pyramid.width, pyramid.height, x, y, node.x, node.y)){
+                            best = node.bound;
+                        }
+                        continue;
+                    }
+                    // children nearest last, so the closest higher texels tighten best early
+                    Node children[4];
+                    int count = 0;
+                    int level = node.level - 1;
+                    for(int cy = 2 * node.y; cy <= 2 * node.y + 1 && cy < pyramid.heights[level]; cy++){
+                        for(int cx = 2 * node.x; cx <= 2 * node.x + 1 && cx < pyramid.widths[level]; cx++){
+                            Node child = { level, cx, cy, getBound(pyramid, level, cx, cy, x, y, depth) };
+                            if(child.bound < best){
+                                children[count++] = child;
+                            }
+                        }
+                    }
+                    std::sort(children, children + count, farthestFirst);
+                    stack.insert(stack.end(), children, children + count);
+                }
+                store(cones, (size_t)x + (size_t)pyramid.width * y, depth, best);
+            }
+        }
+    }
+
+    // lowest ratio any texel in the node can give texel (x, y): the distance to
+    // the nearest point of the node's square over the largest depth difference
+    static float getBound(const MinPyramid& pyramid, int level, int nx, int ny, int x, int y, unsigned char depth){
+        unsigned char m = pyramid.levels[level][nx + (size_t)pyramid.widths[level] * ny];
+        if(m >= depth){
+            return FLT_MAX;
+        }
+        int x0 = nx << level, y0 = ny << level;
+        int x1 = std::min(pyramid.width - 1, x0 + (1 << level) - 1);
+        int y1 = std::min(pyramid.height - 1, y0 + (1 << level) - 1);
+        float dx = (float)wrappedDistance(x, x0, x1, pyramid.width) / pyramid.width;
+        float dy = (float)wrappedDistance(y, y0, y1, pyramid.height) / pyramid.height;
+        return getRatio(dx, dy, depth, m);
+    }
+
+    static bool farthestFirst(const Node& a, const Node& b){
+        return a.bound > b.bound;
+    }
+
+    // texels from p to the nearest of [first, last] on a wrapping axis of the given size
+    static int wrappedDistance(int p, int first, int last, int size){
+        if(p >= first && p <= last){
+            return 0;
+        }
+        return std::min((first - p + size) % size, (p - last + size) % size);
+    }
+
+    // whether a ray from the top plane above texel p down through the surface at
+    // texel q leaves the surface again right behind q: q is the last solid texel
+    // on the ray when the next texel along it is lower than the ray gets there.
+    // With depths d and distances from p in texels, d(next) / (h + 1) > d(q) / h.
+    static bool isExit(const unsigned char* depths, int width, int height, int px, int py, int qx, int qy, int stride = 1){
+        int ox = wrappedOffset(px, qx, width);
+        int oy = wrappedOffset(py, qy, height);
+        float h = std::sqrt((float)(ox * ox + oy * oy));
+        int nx = ((qx + (int)std::floor(ox / h + 0.5f)) % width + width) % width;
+        int ny = ((qy + (int)std::floor(oy / h + 0.5f)) % height + height) % height;
+        unsigned char next = depths[(size_t)(nx + width * ny) * stride];
+        unsigned char depth = depths[(size_t)(qx + width * qy) * stride];
+        return next * h > depth * (h + 1.0f);
+    }
+
+    // q - p on a wrapping axis, the shorter way round
+    static int wrappedOffset(int p, int q, int size){
+        int offset = ((q - p) % size + size) % size;
+        return offset > size / 2 ? offset - size : offset;
+    }
+
+    static float getRatio(float dx, float dy, unsigned char depth, unsigned char other){
+        return std::sqrt(dx * dx + dy * dy) / ((depth - other) / 255.0f);
+    }
+
+    static void store(std::vector<unsigned char>& cones, size_t index, unsigned char depth, float ratio){
+        cones[2 * index] = depth;
+        cones[2 * index + 1] = (unsigned char)std::floor(std::sqrt(std::min(ratio, 1.0f)) * 255.0f);
+    }
+};
+
+#endif // CONE_STEP_MAP_H
@@ -0,0 +1,158 @@
+#ifndef CUBEMAP_LOADER_H
+#define CUBEMAP_LOADER_H
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <glm/glm.hpp>
+#include "stb_image.h"
+#include "environmentLighting.h"
+
+// CPU side of Cubemap loading, GL free so graphics_bench can time it.
+//
+// Six face images are decoded on one thread each straight into a single
+// allocation, face after face, as RGBA8 whatever the file's channels (grey
+// faces are expanded, Cubemap uploads RGB sources as GL_RGB8). An
+// equirectangular image (.hdr or any 8 bit image, loaded as linear float) is
+// projected onto six faces with bilinear lookups, wrapping around in
+// longitude; its faces stay linear float for an RGB16F upload.
+//
+// Faces are +X -X +Y -Y +Z -Z in the GL cube map layout, rows top down, with
+// the face directions of EnvironmentLighting::getDirection. The equirectangular
+// image has +Y at the top row and longitude 0 (its centre column) along -Z.
+
+struct CubemapImage {
+    int size = 0;
+    int channels = 0;                   // of the source images
+    bool isHdr = false;
+    std::vector<unsigned char> pixels;  // 6 * size * size RGBA8, when !isHdr
+    std::vector<float> hdrPixels;       // 6 * size * size RGB, when isHdr
+
+    const unsigned char* getFace(int face) const {
+        return &pixels[(size_t)face * size * size * 4];
+    }
+
+    const float* getHdrFace(int face) const {
+        return &hdrPixels[(size_t)face * size * size * 3];
+    }
+};
+
+class CubemapLoader {
+public:
+    // false when a face is missing, not square or not the size of the others
+    static bool decodeFaces(const std::string* paths, CubemapImage& image, int numThreads = 0){
+        int width, height, channels;
+        if(!stbi_info(paths[0].c_str(), &width, &height, &channels) || width != height){
+            return false;
+        }
+        image.size = width;
+        image.channels = std::max(channels, 3);
+        image.isHdr = false;
+        image.hdrPixels.clear();
+        image.pixels.resize((size_t)6 * width * width * 4);
+
+        bool ok[6] = { false, false, false, false, false, false };
+        numThreads = getThreadCount(numThreads, 6);
+        std::vector<std::thread> threads;
+        for(int t = 1; t < numThreads; t++){
+            threads.push_back(std::thread(&CubemapLoader::decodeFaceRange, paths, std::ref(image), ok, t, numThreads));
+        }
+        decodeFaceRange(paths, image, ok, 0, numThreads);
+        for(std::thread& thread : threads){
+            thread.join();
+        }
+        return std::find(ok, ok + 6, false) == ok + 6;
+    }
+
+    // faceSize 0 picks a quarter of the image width, the same texel density at the equator
+    static bool loadEquirectangular(const std::string& path, int faceSize, CubemapImage& image, int numThreads = 0){
+        int width, height, channels;
+        float* data = stbi_loadf(path.c_str(), &width, &height, &channels, 3);
+        if(data == NULL){
+            return false;
+        }
+        projectEquirectangular(data, width, height, faceSize > 0 ? faceSize : std::max(1, width / 4), image, numThreads);
+        stbi_image_free(data);
+        return true;
+    }
+
+    static void projectEquirectangular(const float* rgb, int width, int height, int faceSize, CubemapImage& image, int numThreads = 0){
+        image.size = faceSize;
+        image.channels = 3;
+        image.isHdr = true;
+        image.pixels.clear();
+        image.hdrPixels.resize((size_t)6 * faceSize * faceSize * 3);
+
+        int rows = 6 * faceSize;
+        numThreads = getThreadCount(numThreads, rows / 16);
+        std::vector<std::thread> threads;
+        int chunk = (rows + numThreads - 1) / numThreads;
+        for(int t = 0; t < numThreads; t++){
+            int begin = t * chunk;
+            int end = std::min(rows, begin + chunk);
+            if(begin < end){
+                threads.push_back(std::thread(&CubemapLoader::projectRows, rgb, width, height, std::ref(image), begin, end));
+            }
+        }
+        for(std::thread& thread : threads){
+            thread.join();
+        }
+    }
+
+private:
+    // faces first, first + step, ...
+    static void decodeFaceRange(const std::string* paths, CubemapImage& image, bool* ok, int first, int step){
+        for(int face = first; face < 6; face += step){
+            int width, height, channels;
+            unsigned char* data = stbi_load(paths[face].c_str(), &width, &height, &channels, 4);
+            ok[face] = data != NULL && width == image.size && height == image.size;
+            if(ok[face]){
+                memcpy(&image.pixels[(size_t)face * image.size * image.size * 4], data, (size_t)image.size * image.size * 4);
+            }
+            stbi_image_free(data);
+        }
+    }
+
+    static void projectRows(const float* rgb, int width, int height, CubemapImage& image, int begin, int end){
+        const float pi = 3.14159265f;
+        for(int row = begin; row < end; row++){
+            int face = row / image.size;
+            int y = row % image.size;
+            float* out = &image.hdrPixels[(size_t)row * image.size * 3];
+            for(int x = 0; x < image.size; x++){
+                glm::vec3 d = EnvironmentLighting::getDirection(face, (x + 0.5f) / image.size, (y + 0.5f) / image.size);
+                float u = 0.5f + std::atan2(d.x, -d.z) / (2.0f * pi);
+                float v = std::acos(std::max(-1.0f, std::min(1.0f, d.y))) / pi;
+                sampleBilinear(rgb, width, height, u * width - 0.5f, v * height - 0.5f, out + 3 * x);
+            }
+        }
+    }
+
+    static void sampleBilinear(const float* rgb, int width, int height, float x, float y, float* out){
+        int x0 = (int)std::floor(x), y0 = (int)std::floor(y);
+        float fx = x - x0, fy = y - y0;
+        int x1 = x0 + 1, y1 = std::min(y0 + 1, height - 1);
+        x0 = (x0 % width + width) % width;
+        x1 = x1 % width;
+        y0 = std::max(y0, 0);
+        const float* p00 = rgb + 3 * (x0 + (size_t)width * y0);
+        const float* p10 = rgb + 3 * (x1 + (size_t)width * y0);
+        const float* p01 = rgb + 3 * (x0 + (size_t)width * y1);
+        const float* p11 = rgb + 3 * (x1 + (size_t)width * y1);
+        for(int c = 0; c < 3; c++){
+            out[c] = (p00[c] * (1.0f - fx) + p10[c] * fx) * (1.0f - fy) + (p01[c] * (1.0f - fx) + p11[c] * fx) * fy;
+        }
+    }
+
+    static int getThreadCount(int numThreads, int work){
+        if(numThreads <= 0){
+            numThreads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        return std::max(1, std::min(numThreads, work));
+    }
+};
+
+#endif // CUBEMAP_LOADER_H
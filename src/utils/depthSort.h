@@ -0,0 +1,86 @@
+#ifndef DEPTH_SORT_H
+#define DEPTH_SORT_H
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+// Back to front draw order for transparent objects, GL free so graphics_bench
+// can check and time it.
+//
+// An LSD radix sort on view depth. Each depth becomes a 32 bit key that orders
+// like the float (the sign bit flipped for positive values, every bit for
+// negative ones) and is then inverted, so the farthest item sorts first. Key
+// and item index are packed into one 64 bit value and only its upper half is
+// sorted, 8 bits per pass. The four histograms are counted in a single pass
+// over the keys, and a pass is skipped when every key has the same digit, as
+// the top byte often is for depths in a narrow range. The sort is stable, so
+// items at the same depth keep their bind order. Buffers grow to the largest
+// count seen and are kept between frames.
+
+class DepthSort {
+public:
+    // the order is then getOrder()[0..count), indices into depths
+    void sortBackToFront(const float* depths, size_t count){
+        items.resize(count);
+        scratch.resize(count);
+        order.resize(count);
+
+        size_t histograms[4][256];
+        memset(histograms, 0, sizeof(histograms));
+        for(size_t i = 0; i < count; i++){
+            uint32_t key = ~getKey(depths[i]);
+            items[i] = ((uint64_t)key << 32) | (uint32_t)i;
+            histograms[0][key & 0xFF]++;
+            histograms[1][(key >> 8) & 0xFF]++;
+            histograms[2][(key >> 16) & 0xFF]++;
+            histograms[3][key >> 24]++;
+        }
+
+        uint64_t* source = items.data();
+        uint64_t* destination = scratch.data();
+        for(int pass = 0; pass < 4; pass++){
+            size_t* histogram = histograms[pass];
+            int shift = 32 + 8 * pass;
+            if(count == 0 || histogram[(source[0] >> shift) & 0xFF] == count){
+                continue;
+            }
+            size_t offset = 0;
+            for(int digit = 0; digit < 256; digit++){
+                size_t digitCount = histogram[digit];
+                histogram[digit] = offset;
+                offset += digitCount;
+            }
+            for(size_t i = 0; i < count; i++){
+                uint64_t item = source[i];
+                destination[histogram[(item >> shift) & 0xFF]++] = item;
+            }
+            uint64_t* swap = source;
+            source = destination;
+            destination = swap;
+        }
+
+        for(size_t i = 0; i < count; i++){
+            order[i] = (uint32_t)source[i];
+        }
+    }
+
+    const std::vector<uint32_t>& getOrder() const {
+        return order;
+    }
+
+    // unsigned key with the same order as depth, -0 just below +0 and NaNs at the ends
+    static uint32_t getKey(float depth){
+        uint32_t bits;
+        memcpy(&bits, &depth, sizeof(bits));
+        return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+    }
+
+private:
+    std::vector<uint64_t> items;
+    std::vector<uint64_t> scratch;
+    std::vector<uint32_t> order;
+};
+
+#endif // DEPTH_SORT_H
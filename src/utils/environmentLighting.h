@@ -0,0 +1,638 @@
+#ifndef ENVIRONMENT_LIGHTING_H
+#define ENVIRONMENT_LIGHTING_H
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <stdint.h>
+#include <glm/glm.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define ENVIRONMENT_LIGHTING_SSE
+#endif
+
+// Image based lighting for the Cook-Torrance shaders, precomputed on the CPU
+// from a skybox cubemap with the split sum approximation:
+//
+//   irradiance  nine SH coefficients of the cosine convolved environment,
+//               stored divided by pi so diffuse = albedo * sum(c_i * Y_i(N))
+//   specular    the environment prefiltered with GGX lobes (N = V = R), one
+//               mip level per roughness step, roughness = level / (levels - 1).
+//               Samples are GGX importance sampled from Hammersley points and
+//               read from a box filtered mip chain of the source at the lod
+//               matching their pdf, so 64 samples per texel don't alias
+//   BRDF LUT    scale and bias on F0 of the GGX specular integral, indexed by
+//               NdotV and roughness, the same for every environment
+//
+// Texels are linear rgb plus a padding float, so one texel is one SSE
+// register in the filtering loops. Faces follow the GL cube map layout
+// (+X -X +Y -Y +Z -Z, rows top down as stb_image loads them); bilinear
+// lookups clamp at face edges. The reference* functions are plain Monte
+// Carlo integrals of the same quantities that graphics_bench checks the
+// precomputation against. GL free; ImageBasedLighting uploads the results
+// and caches them next to the cubemap as <first face>.ibl.
+
+struct EnvironmentMap {
+    int size = 0;
+    std::vector<float> texels;  // 6 * size * size texels of 4 floats
+
+    void resize(int size){
+        this->size = size;
+        texels.assign((size_t)6 * size * size * 4, 0.0f);
+    }
+
+    float* getTexel(int face, int x, int y){
+        return &texels[4 * (((size_t)face * size + y) * size + x)];
+    }
+
+    const float* getTexel(int face, int x, int y) const {
+        return &texels[4 * (((size_t)face * size + y) * size + x)];
+    }
+};
+
+struct PrefilteredEnvironment {
+    glm::vec3 irradiance[9];
+    std::vector<EnvironmentMap> specular;  // level 0 is the sharpest, sizes halve per level
+};
+
+class EnvironmentLighting {
+public:
+    static const uint32_t magic = 0x204C4249;  // "IBL "
+    static const uint32_t version = 1;
+
+    static std::string getCachePath(const std::string& firstFacePath){
+        return firstFacePath + ".ibl";
+    }
+
+    // six square 8 bit sRGB faces with the given channel count (3 or 4) to linear
+    static void fromImages(const unsigned char* const faces[6], int size, int channels, EnvironmentMap& map){
+        float toLinear[256];
+        for(int i = 0; i < 256; i++){
+            toLinear[i] = std::pow(i / 255.0f, 2.2f);
+        }
+        map.resize(size);
+        for(int face = 0; face < 6; face++){
+            for(size_t i = 0; i < (size_t)size * size; i++){
+                const unsigned char* pixel = faces[face] + i * channels;
+                float* texel = &map.texels[4 * ((size_t)face * size * size + i)];
+                texel[0] = toLinear[pixel[0]];
+                texel[1] = toLinear[pixel[channels > 2 ? 1 : 0]];
+                texel[2] = toLinear[pixel[channels > 2 ? 2 : 0]];
+            }
+        }
+    }
+
+    // six linear RGB float faces
+    static void fromHdrImages(const float* const faces[6], int size, EnvironmentMap& map){
+        map.resize(size);
+        for(int face = 0; face < 6; face++){
+            for(size_t i = 0; i < (size_t)size * size; i++){
+                float* texel = &map.texels[4 * ((size_t)face * size * size + i)];
+                texel[0] = faces[face][3 * i];
+                texel[1] = faces[face][3 * i + 1];
+                texel[2] = faces[face][3 * i + 2];
+            }
+        }
+    }
+
+    // direction through (s, t) in [0, 1] of a face
+    static glm::vec3 getDirection(int face, float s, float t){
+        float sc = 2.0f * s - 1.0f;
+        float tc = 2.0f * t - 1.0f;
+        switch(face){
+            case 0: return glm::normalize(glm::vec3(1.0f, -tc, -sc));
+            case 1: return glm::normalize(glm::vec3(-1.0f, -tc, sc));
+            case 2: return glm::normalize(glm::vec3(sc, 1.0f, tc));
+            case 3: return glm::normalize(glm::vec3(sc, -1.0f, -tc));
+            case 4: return glm::normalize(glm::vec3(sc, -tc, 1.0f));
+            default: return glm::normalize(glm::vec3(-sc, -tc, -1.0f));
+        }
+    }
+
+    static void getFaceCoords(const glm::vec3& direction, int& face, float& s, float& t){
+        glm::vec3 a = glm::abs(direction);
+        float sc, tc, ma;
+        if(a.x >= a.y && a.x >= a.z){
+            face = direction.x > 0.0f ? 0 : 1;
+            ma = a.x;
+            sc = direction.x > 0.0f ? -direction.z : direction.z;
+            tc = -direction.y;
+        }
+        else if(a.y >= a.z){
+            face = direction.y > 0.0f ? 2 : 3;
+            ma = a.y;
+            sc = direction.x;
+            tc = direction.y > 0.0f ? direction.z : -direction.z;
+        }
+        else{
+            face = direction.z > 0.0f ? 4 : 5;
+            ma = a.z;
+            sc = direction.z > 0.0f ? direction.x : -direction.x;
+            tc = -direction.y;
+        }
+        s = 0.5f * (sc / ma + 1.0f);
+        t = 0.5f * (tc / ma + 1.0f);
+    }
+
+    static glm::vec3 sample(const EnvironmentMap& map, const glm::vec3& direction){
+        int face;
+        float s, t;
+        getFaceCoords(direction, face, s, t);
+        return toVec3(fetch(map, face, s, t));
+    }
+
+    // solid angle of texel (x, y) of a size * size face
+    static float getTexelSolidAngle(int x, int y, int size){
+        float x0 = 2.0f * x / size - 1.0f, x1 = 2.0f * (x + 1) / size - 1.0f;
+        float y0 = 2.0f * y / size - 1.0f, y1 = 2.0f * (y + 1) / size - 1.0f;
+        return getAreaElement(x0, y0) - getAreaElement(x0, y1) - getAreaElement(x1, y0) + getAreaElement(x1, y1);
+    }
+
+    // halves every face with a box filter, down to 1x1
+    static void buildMipChain(const EnvironmentMap& map, std::vector<EnvironmentMap>& chain){
+        chain.assign(1, map);
+        while(chain.back().size > 1){
+            const EnvironmentMap& src = chain.back();
+            EnvironmentMap level;
+            level.resize(src.size / 2);
+            for(int face = 0; face < 6; face++){
+                for(int y = 0; y < level.size; y++){
+                    for(int x = 0; x < level.size; x++){
+                        float* texel = level.getTexel(face, x, y);
+                        for(int c = 0; c < 4; c++){
+                            texel[c] = 0.25f * (src.getTexel(face, 2 * x, 2 * y)[c] + src.getTexel(face, 2 * x + 1, 2 * y)[c] +
+                                                src.getTexel(face, 2 * x, 2 * y + 1)[c] + src.getTexel(face, 2 * x + 1, 2 * y + 1)[c]);
+                        }
+                    }
+                }
+            }
+            chain.push_back(level);
+        }
+    }
+
+    static void getSHBasis(const glm::vec3& n, float basis[9]){
+        basis[0] = 0.282095f;
+        basis[1] = 0.488603f * n.y;
+        basis[2] = 0.488603f * n.z;
+        basis[3] = 0.488603f * n.x;
+        basis[4] = 1.092548f * n.x * n.y;
+        basis[5] = 1.092548f * n.y * n.z;
+        basis[6] = 0.315392f * (3.0f * n.z * n.z - 1.0f);
+        basis[7] = 1.092548f * n.x * n.z;
+        basis[8] = 0.546274f * (n.x * n.x - n.y * n.y);
+    }
+
+    // irradiance / pi for normal n, the shader's getIrradiance()
+    static glm::vec3 evaluateSH(const glm::vec3 coefficients[9], const glm::vec3& n){
+        float basis[9];
+        getSHBasis(n, basis);
+        glm::vec3 result(0.0f);
+        for(int i = 0; i < 9; i++){
+            result += coefficients[i] * basis[i];
+        }
+        return glm::max(result, glm::vec3(0.0f));
+    }
+
+    // projects the radiance onto SH9 with exact texel solid angles, then
+    // convolves with the clamped cosine (pi, 2pi/3, pi/4 per band) over pi
+    static void projectIrradiance(const EnvironmentMap& map, glm::vec3 coefficients[9], int numThreads = 0){
+        Radiance sums[6][9];
+        int threads = std::min(6, getThreadCount(numThreads, 6 * map.size * map.size, 16 * 16));
+        // a face per task, so the sums don't depend on the thread count
+        runParallel(6, threads, [&](int begin, int end){
+            for(int face = begin; face < end; face++){
+                projectFace(map, face, sums[face]);
+            }
+        });
+        const float band[9] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+        for(int i = 0; i < 9; i++){
+            Radiance sum = zeroRadiance();
+            for(int face = 0; face < 6; face++){
+                sum = add(sum, sums[face][i]);
+            }
+            coefficients[i] = toVec3(sum) * band[i];
+        }
+    }
+
+    // GGX prefiltered levels from the source's mip chain; the first level is
+    // the source box filtered to baseSize (roughness 0, a mirror)
+    static void prefilter(const std::vector<EnvironmentMap>& chain, int baseSize, int levelCount, int sampleCount, std::vector<EnvironmentMap>& levels, int numThreads = 0){
+        baseSize = std::min(baseSize, chain[0].size);
+        levelCount = std::max(1, std::min(levelCount, (int)std::log2((float)baseSize) + 1));
+        levels.resize(levelCount);
+        for(int level = 0; level < levelCount; level++){
+            EnvironmentMap& target = levels[level];
+            target.resize(std::max(1, baseSize >> level));
+            std::vector<LobeSample> lobe;
+            float roughness = levelCount > 1 ? (float)level / (levelCount - 1) : 0.0f;
+            float mirrorLod = std::log2((float)chain[0].size / target.size);
+            if(level == 0){
+                LobeSample mirror = { glm::vec3(0.0f, 0.0f, 1.0f), 1.0f, mirrorLod };
+                lobe.push_back(mirror);
+            }
+            else{
+                buildLobe(roughness, sampleCount, chain[0].size, lobe);
+            }
+            int rows = 6 * target.size;
+            runParallel(rows, getThreadCount(numThreads, rows * target.size, 32 * 32), [&](int begin, int end){
+                prefilterRows(chain, lobe, target, begin, end);
+            });
+        }
+    }
+
+    // split sum scale and bias on F0 for (NdotV, roughness) = ((x + 0.5) / size, (y + 0.5) / size)
+    static void integrateBRDF(int size, int sampleCount, std::vector<glm::vec2>& lut, int numThreads = 0){
+        lut.resize((size_t)size * size);
+        runParallel(size, getThreadCount(numThreads, size * size, 16 * 16), [&](int begin, int end){
+            for(int y = begin; y < end; y++){
+                for(int x = 0; x < size; x++){
+                    lut[(size_t)y * size + x] = integrateBRDFTexel((x + 0.5f) / size, (y + 0.5f) / size, sampleCount);
+                }
+            }
+        });
+    }
+
+    static glm::vec2 integrateBRDFTexel(float nDotV, float roughness, int sampleCount){
+        glm::vec3 V(std::sqrt(1.0f - nDotV * nDotV), 0.0f, nDotV);
+        float a = roughness * roughness;
+        float scale = 0.0f, bias = 0.0f;
+        for(int i = 0; i < sampleCount; i++){
+            glm::vec3 H = sampleGGX(getHammersley(i, sampleCount), a);
+            glm::vec3 L = 2.0f * glm::dot(V, H) * H - V;
+            float nDotL = L.z;
+            float nDotH = std::max(H.z, 0.0f);
+            float vDotH = std::max(glm::dot(V, H), 0.0f);
+            if(nDotL > 0.0f){
+                // pdf = D * NdotH / (4 VdotH), so f * NdotL / pdf = G * VdotH / (NdotH * NdotV) * F
+                float visibility = getGeometry(nDotV, nDotL, roughness) * vDotH / (nDotH * nDotV);
+                float fresnel = std::pow(1.0f - vDotH, 5.0f);
+                scale += (1.0f - fresnel) * visibility;
+                bias += fresnel * visibility;
+            }
+        }
+        return glm::vec2(scale, bias) / (float)sampleCount;
+    }
+
+    // SH irradiance, the prefiltered levels from a 128 base and the source mip chain
+    static void compute(const EnvironmentMap& map, PrefilteredEnvironment& environment, int baseSize = 128, int levelCount = 5, int sampleCount = 64, int numThreads = 0){
+        std::vector<EnvironmentMap> chain;
+        buildMipChain(map, chain);
+        // SH9 only holds low frequencies, a 32x32 face loses nothing of them
+        const EnvironmentMap& small = chain[std::min((int)chain.size() - 1, std::max(0, (int)std::log2(map.size / 32.0f)))];
+        projectIrradiance(small, environment.irradiance, numThreads);
+        prefilter(chain, baseSize, levelCount, sampleCount, environment.specular, numThreads);
+    }
+
+    // Monte Carlo references ---------------------------------------------------
+
+    // irradiance / pi for normal n with cosine weighted directions
+    static glm::vec3 referenceIrradiance(const EnvironmentMap& map, const glm::vec3& n, int sampleCount, unsigned int seed = 1){
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+        glm::vec3 tangent, bitangent;
+        getBasis(n, tangent, bitangent);
+        glm::vec3 sum(0.0f);
+        for(int i = 0; i < sampleCount; i++){
+            float u = uniform(random), phi = 6.2831853f * uniform(random);
+            float r = std::sqrt(u);
+            glm::vec3 local(r * std::cos(phi), r * std::sin(phi), std::sqrt(1.0f - u));
+            sum += sample(map, tangent * local.x + bitangent * local.y + n * local.z);
+        }
+        return sum / (float)sampleCount;
+    }
+
+    // the GGX lobe average around R (N = V = R) that the prefiltered levels
+    // store: uniform directions on the sphere weighted by D(H) * NdotL,
+    // read from the unfiltered source
+    static glm::vec3 referencePrefiltered(const EnvironmentMap& map, const glm::vec3& r, float roughness, int sampleCount, unsigned int seed = 1){
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+        float a = roughness * roughness;
+        glm::vec3 sum(0.0f);
+        float weight = 0.0f;
+        for(int i = 0; i < sampleCount; i++){
+            glm::vec3 L;
+            do{
+                L = glm::vec3(uniform(random), uniform(random), uniform(random));
+            }while(glm::dot(L, L) > 1.0f || glm::dot(L, L) < 1e-6f);
+            L = glm::normalize(L);
+            float nDotL = glm::dot(r, L);
+            if(nDotL <= 0.0f){
+                continue;
+            }
+            float w = getDistribution(glm::dot(r, glm::normalize(r + L)), a) * nDotL;
+            sum += sample(map, L) * w;
+            weight += w;
+        }
+        return weight > 0.0f ? sum / weight : glm::vec3(0.0f);
+    }
+
+    // the split sum terms with uniform hemisphere directions
+    static glm::vec2 referenceBRDF(float nDotV, float roughness, int sampleCount, unsigned int seed = 1){
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+        glm::vec3 V(std::sqrt(1.0f - nDotV * nDotV), 0.0f, nDotV);
+        float a = roughness * roughness;
+        float scale = 0.0f, bias = 0.0f;
+        for(int i = 0; i < sampleCount; i++){
+            float cosTheta = uniform(random), phi = 6.2831853f * uniform(random);
+            float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+            glm::vec3 L(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta);
+            glm::vec3 H = glm::normalize(V + L);
+            float vDotH = std::max(glm::dot(V, H), 0.0f);
+            // f * NdotL / pdf with pdf = 1 / 2pi
+            float specular = getDistribution(H.z, a) * getGeometry(nDotV, L.z, roughness) / (4.0f * nDotV) * 6.2831853f;
+            float fresnel = std::pow(1.0f - vDotH, 5.0f);
+            scale += (1.0f - fresnel) * specular;
+            bias += fresnel * specular;
+        }
+        return glm::vec2(scale, bias) / (float)sampleCount;
+    }
+
+    // Cache --------------------------------------------------------------------
+
+    // sourceHash covers the six face images (FileHash::update over each)
+    static bool write(const std::string& path, uint64_t sourceHash, const PrefilteredEnvironment& environment){
+        FILE* fp = fopen(path.c_str(), "wb");
+        if(fp == NULL){
+            return false;
+        }
+        uint32_t header[4] = { magic, version, (uint32_t)environment.specular.size(),
+                               (uint32_t)(environment.specular.empty() ? 0 : environment.specular[0].size) };
+        bool ok = fwrite(header, sizeof(header), 1, fp) == 1 && fwrite(&sourceHash, sizeof(sourceHash), 1, fp) == 1;
+        ok = ok && fwrite(environment.irradiance, sizeof(environment.irradiance), 1, fp) == 1;
+        for(size_t i = 0; i < environment.specular.size() && ok; i++){
+            const std::vector<float>& texels = environment.specular[i].texels;
+            ok = fwrite(texels.data(), texels.size() * sizeof(float), 1, fp) == 1;
+        }
+        fclose(fp);
+        return ok;
+    }
+
+    // false when missing, stale (built from other faces) or malformed
+    static bool read(const std::string& path, uint64_t sourceHash, PrefilteredEnvironment& environment){
+        FILE* fp = fopen(path.c_str(), "rb");
+        if(fp == NULL){
+            return false;
+        }
+        uint32_t header[4];
+        uint64_t hash;
+        bool ok = fread(header, sizeof(header), 1, fp) == 1 && fread(&hash, sizeof(hash), 1, fp) == 1;
+        ok = ok && header[0] == magic && header[1] == version && hash == sourceHash && header[2] > 0 && header[2] <= 16;
+        ok = ok && fread(environment.irradiance, sizeof(environment.irradiance), 1, fp) == 1;
+        if(ok){
+            environment.specular.resize(header[2]);
+            for(uint32_t i = 0; i < header[2] && ok; i++){
+                environment.specular[i].resize(std::max(1u, header[3] >> i));
+                std::vector<float>& texels = environment.specular[i].texels;
+                ok = fread(texels.data(), texels.size() * sizeof(float), 1, fp) == 1;
+            }
+        }
+        fclose(fp);
+        return ok;
+    }
+
+private:
+#ifdef ENVIRONMENT_LIGHTING_SSE
+    typedef __m128 Radiance;
+
+    static Radiance zeroRadiance(){
+        return _mm_setzero_ps();
+    }
+
+    static Radiance add(Radiance a, Radiance b){
+        return _mm_add_ps(a, b);
+    }
+
+    // a + texel * weight
+    static Radiance mulAdd(Radiance a, const float* texel, float weight){
+        return _mm_add_ps(a, _mm_mul_ps(_mm_loadu_ps(texel), _mm_set1_ps(weight)));
+    }
+
+    static Radiance scale(Radiance a, float weight){
+        return _mm_mul_ps(a, _mm_set1_ps(weight));
+    }
+
+    static void store(Radiance a, float* texel){
+        _mm_storeu_ps(texel, a);
+    }
+
+    static glm::vec3 toVec3(Radiance a){
+        float texel[4];
+        _mm_storeu_ps(texel, a);
+        return glm::vec3(texel[0], texel[1], texel[2]);
+    }
+#else
+    struct Radiance {
+        float c[4];
+    };
+
+    static Radiance zeroRadiance(){
+        Radiance a = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+        return a;
+    }
+
+    static Radiance add(Radiance a, Radiance b){
+        for(int i = 0; i < 4; i++){
+            a.c[i] += b.c[i];
+        }
+        return a;
+    }
+
+    static Radiance mulAdd(Radiance a, const float* texel, float weight){
+        for(int i = 0; i < 4; i++){
+            a.c[i] += texel[i] * weight;
+        }
+        return a;
+    }
+
+    static Radiance scale(Radiance a, float weight){
+        for(int i = 0; i < 4; i++){
+            a.c[i] *= weight;
+        }
+        return a;
+    }
+
+    static void store(Radiance a, float* texel){
+        for(int i = 0; i < 4; i++){
+            texel[i] = a.c[i];
+        }
+    }
+
+    static glm::vec3 toVec3(Radiance a){
+        return glm::vec3(a.c[0], a.c[1], a.c[2]);
+    }
+#endif
+
+    // GGX sample in the tangent space of N = V, with its reflected direction's lod
+    struct LobeSample {
+        glm::vec3 direction;
+        float weight;  // NdotL
+        float lod;
+    };
+
+    static Radiance fetch(const EnvironmentMap& map, int face, float s, float t){
+        float x = s * map.size - 0.5f, y = t * map.size - 0.5f;
+        int x0 = (int)std::floor(x), y0 = (int)std::floor(y);
+        float fx = x - x0, fy = y - y0;
+        int x1 = std::min(x0 + 1, map.size - 1), y1 = std::min(y0 + 1, map.size - 1);
+        x0 = std::max(x0, 0);
+        y0 = std::max(y0, 0);
+        Radiance sum = mulAdd(zeroRadiance(), map.getTexel(face, x0, y0), (1.0f - fx) * (1.0f - fy));
+        sum = mulAdd(sum, map.getTexel(face, x1, y0), fx * (1.0f - fy));
+        sum = mulAdd(sum, map.getTexel(face, x0, y1), (1.0f - fx) * fy);
+        return mulAdd(sum, map.getTexel(face, x1, y1), fx * fy);
+    }
+
+    // trilinear between the two chain levels around lod
+    static Radiance fetchLod(const std::vector<EnvironmentMap>& chain, const glm::vec3& direction, float lod){
+        int face;
+        float s, t;
+        getFaceCoords(direction, face, s, t);
+        lod = std::min(std::max(lod, 0.0f), (float)chain.size() - 1.0f);
+        int level = (int)lod;
+        float blend = lod - level;
+        Radiance result = fetch(chain[level], face, s, t);
+        if(blend > 0.0f && level + 1 < (int)chain.size()){
+            result = add(scale(result, 1.0f - blend), scale(fetch(chain[level + 1], face, s, t), blend));
+        }
+        return result;
+    }
+
+    static float getAreaElement(float x, float y){
+        return std::atan2(x * y, std::sqrt(x * x + y * y + 1.0f));
+    }
+
+    static void projectFace(const EnvironmentMap& map, int face, Radiance sums[9]){
+        for(int i = 0; i < 9; i++){
+            sums[i] = zeroRadiance();
+        }
+        float basis[9];
+        for(int y = 0; y < map.size; y++){
+            for(int x = 0; x < map.size; x++){
+                glm::vec3 n = getDirection(face, (x + 0.5f) / map.size, (y + 0.5f) / map.size);
+                float solidAngle = getTexelSolidAngle(x, y, map.size);
+                getSHBasis(n, basis);
+                const float* texel = map.getTexel(face, x, y);
+                for(int i = 0; i < 9; i++){
+                    sums[i] = mulAdd(sums[i], texel, basis[i] * solidAngle);
+                }
+            }
+        }
+    }
+
+    // Hammersley directions of the lobe, the reflected direction with NdotL
+    // as weight and the source lod whose texels cover the sample's share of
+    // the lobe (filtered importance sampling, lod 1 bias as in the usual GPU version)
+    static void buildLobe(float roughness, int sampleCount, int sourceSize, std::vector<LobeSample>& lobe){
+        float a = roughness * roughness;
+        float texelSolidAngle = 4.0f * 3.14159265f / (6.0f * sourceSize * sourceSize);
+        for(int i = 0; i < sampleCount; i++){
+            glm::vec3 H = sampleGGX(getHammersley(i, sampleCount), a);
+            glm::vec3 L = 2.0f * H.z * H - glm::vec3(0.0f, 0.0f, 1.0f);
+            if(L.z <= 0.0f){
+                continue;
+            }
+            // pdf of L is D * NdotH / (4 VdotH) = D / 4 with N = V
+            float pdf = getDistribution(H.z, a) * 0.25f;
+            float sampleSolidAngle = 1.0f / (sampleCount * pdf + 1e-6f);
+            LobeSample lobeSample = { L, L.z, std::max(0.0f, 0.5f * std::log2(sampleSolidAngle / texelSolidAngle) + 1.0f) };
+            lobe.push_back(lobeSample);
+        }
+    }
+
+    static void prefilterRows(const std::vector<EnvironmentMap>& chain, const std::vector<LobeSample>& lobe, EnvironmentMap& target, int begin, int end){
+        float weight = 0.0f;
+        for(const LobeSample& lobeSample : lobe){
+            weight += lobeSample.weight;
+        }
+        float inverseWeight = 1.0f / weight;
+        for(int row = begin; row < end; row++){
+            int face = row / target.size;
+            int y = row % target.size;
+            for(int x = 0; x < target.size; x++){
+                glm::vec3 n = getDirection(face, (x + 0.5f) / target.size, (y + 0.5f) / target.size);
+                glm::vec3 tangent, bitangent;
+                getBasis(n, tangent, bitangent);
+                Radiance sum = zeroRadiance();
+                for(const LobeSample& lobeSample : lobe){
+                    glm::vec3 L = tangent * lobeSample.direction.x + bitangent * lobeSample.direction.y + n * lobeSample.direction.z;
+                    sum = add(sum, scale(fetchLod(chain, L, lobeSample.lod), lobeSample.weight));
+                }
+                store(scale(sum, inverseWeight), target.getTexel(face, x, y));
+            }
+        }
+    }
+
+    static glm::vec2 getHammersley(int i, int count){
+        uint32_t bits = (uint32_t)i;
+        bits = (bits << 16u) | (bits >> 16u);
+        bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+        bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+        bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+        bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+        return glm::vec2((float)i / count, bits * 2.3283064365386963e-10f);
+    }
+
+    // half vector around +z for GGX alpha a
+    static glm::vec3 sampleGGX(const glm::vec2& xi, float a){
+        float phi = 6.2831853f * xi.x;
+        float cosTheta = std::sqrt((1.0f - xi.y) / (1.0f + (a * a - 1.0f) * xi.y));
+        float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+        return glm::vec3(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta);
+    }
+
+    static float getDistribution(float nDotH, float a){
+        float a2 = a * a;
+        float denom = nDotH * nDotH * (a2 - 1.0f) + 1.0f;
+        return a2 / (3.14159265f * denom * denom);
+    }
+
+    // Smith with Schlick-GGX, k = a / 2 for image based lighting
+    static float getGeometry(float nDotV, float nDotL, float roughness){
+        float k = roughness * roughness * 0.5f;
+        return nDotV / (nDotV * (1.0f - k) + k) * nDotL / (nDotL * (1.0f - k) + k);
+    }
+
+    static void getBasis(const glm::vec3& n, glm::vec3& tangent, glm::vec3& bitangent){
+        glm::vec3 up = std::abs(n.z) < 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+        tangent = glm::normalize(glm::cross(up, n));
+        bitangent = glm::cross(n, tangent);
+    }
+
+    static int getThreadCount(int numThreads, int work, int minWorkPerThread){
+        if(numThreads <= 0){
+            numThreads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        return std::max(1, std::min(numThreads, work / minWorkPerThread));
+    }
+
+    // function(begin, end) over [0, count) split in contiguous ranges
+    template<typename Function>
+    static void runParallel(int count, int numThreads, Function function){
+        numThreads = std::max(1, std::min(numThreads, count));
+        if(numThreads == 1){
+            function(0, count);
+            return;
+        }
+        std::vector<std::thread> threads;
+        int chunk = (count + numThreads - 1) / numThreads;
+        for(int t = 0; t < numThreads; t++){
+            int begin = t * chunk;
+            int end = std::min(count, begin + chunk);
+            if(begin < end){
+                threads.push_back(std::thread(function, begin, end));
+            }
+        }
+        for(std::thread& thread : threads){
+            thread.join();
+        }
+    }
+};
+
+#endif // ENVIRONMENT_LIGHTING_H
@@ -0,0 +1,44 @@
+#ifndef FILE_HASH_H
+#define FILE_HASH_H
+
+#include <string>
+#include <cstdio>
+#include <stdint.h>
+
+// FNV-1a over file contents, the key the on-disk caches (cone step maps,
+// prefiltered environments, program binaries) check against so they are
+// rebuilt when their sources change.
+
+class FileHash {
+public:
+    static const uint64_t seed = 14695981039346656037ull;
+
+    static bool hashFile(const std::string& path, uint64_t& hash){
+        hash = seed;
+        return update(path, hash);
+    }
+
+    // continues hash with the file's bytes, to key a cache on several files
+    static bool update(const std::string& path, uint64_t& hash){
+        FILE* fp = fopen(path.c_str(), "rb");
+        if(fp == NULL){
+            return false;
+        }
+        unsigned char buffer[1 << 16];
+        size_t count;
+        while((count = fread(buffer, 1, sizeof(buffer), fp)) > 0){
+            updateBytes(buffer, count, hash);
+        }
+        fclose(fp);
+        return true;
+    }
+
+    static void updateBytes(const void* data, size_t size, uint64_t& hash){
+        const unsigned char* bytes = (const unsigned char*)data;
+        for(size_t i = 0; i < size; i++){
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+    }
+};
+
+#endif // FILE_HASH_H
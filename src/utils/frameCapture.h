@@ -0,0 +1,287 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include "imageEncoder.h"
+#include "renderGraph.h"
+#include "../resourceManager.h"
+#include "../camera.h"
+#include "../shaders/renderGraph/renderGraphExecutor.h"
+#include "imgui.h"
+
+// Screenshots, depth captures and frame sequences without stalling the frame.
+//
+// A requested capture becomes a "Frame capture" pass at the end of the frame's
+// render graph. It reads the backbuffer (colour as RGB8, depth as float window
+// depth) into a pixel pack buffer and fences it, so glReadPixels returns
+// without waiting for the GPU. Later frames map the buffers whose fence has
+// signalled, at most latency frames after the read; only older ones are waited
+// on, counted as stalls. The pixels then go to an ImageEncoder, which
+// linearizes depth and writes PNG or EXR on its own threads.
+//
+// Memory is bounded on both sides: 2 * (latency + 1) pack buffers, one colour
+// and one depth read per frame in flight, and the encoder's queue, which
+// slows the frame down when the disk can't keep up rather than growing.
+// Captures are taken before the GUI is drawn.
+
+class FrameCapture {
+public:
+    FrameCapture(int latency = 2, int encoderThreads = 0) : encoder(encoderThreads) {
+        this->latency = std::max(0, latency);
+        slots.resize(2 * (this->latency + 1));
+    }
+
+    ~FrameCapture() {
+        flush();
+        for(Readback& slot : slots){
+            if(slot.buffer != 0){
+                glDeleteBuffers(1, &slot.buffer);
+            }
+        }
+    }
+
+    // .png or .exr, written a few frames from now
+    void requestScreenshot(const std::string& path) {
+        requests.push_back(Request(CAPTURED_COLOR, path));
+    }
+
+    // linear view depth, .exr in scene units or a .png preview
+    void requestDepth(const std::string& path) {
+        requests.push_back(Request(CAPTURED_DEPTH, path));
+    }
+
+    // patterns take the frame number since the start (printf %d), an empty one skips that
+    // capture; maxFrames 0 records until stopSequence()
+    void startSequence(const std::string& colorPattern, const std::string& depthPattern, int every = 1, int maxFrames = 0) {
+        this->colorPattern = colorPattern;
+        this->depthPattern = depthPattern;
+        sequenceEvery = std::max(1, every);
+        sequenceFrames = maxFrames;
+        sequenceFrame = 0;
+        sequenceCaptured = 0;
+        recording = true;
+    }
+
+    void stopSequence() {
+        recording = false;
+    }
+
+    bool isRecording() const {
+        return recording;
+    }
+
+    // called by ResourceManager once per frame with the rest of the graph
+    void addPasses(RenderGraph& graph, const FrameResources& frame) {
+        frameIndex++;
+        collect(false);
+        addSequenceRequests();
+        if(requests.empty()){
+            return;
+        }
+        pending.swap(requests);
+        requests.clear();
+        int pass = graph.addPass("Frame capture", [this](){ readBack(); });
+        graph.read(pass, frame.backbuffer);
+        graph.setSideEffect(pass);
+    }
+
+    // writes out everything read back so far, blocking on the GPU and the disk
+    void flush() {
+        collect(true);
+        encoder.flush();
+    }
+
+    int getInFlight() const {
+        int count = 0;
+        for(const Readback& slot : slots){
+            count += slot.fence != 0;
+        }
+        return count;
+    }
+
+    int getStalls() const { return stalls; }
+    ImageEncoder& getEncoder() { return encoder; }
+
+    void OnGui() {
+        static char colorPath[128] = "screenshot.png";
+        static char depthPath[128] = "depth.exr";
+        ImGui::InputText("Screenshot", colorPath, sizeof(colorPath));
+        ImGui::SameLine();
+        if(ImGui::Button("Capture##color")) requestScreenshot(colorPath);
+        ImGui::InputText("Depth", depthPath, sizeof(depthPath));
+        ImGui::SameLine();
+        if(ImGui::Button("Capture##depth")) requestDepth(depthPath);
+        if(!recording && ImGui::Button("Record sequence")) startSequence("capture_%05d.png", "", 1);
+        if(recording && ImGui::Button("Stop recording")) stopSequence();
+        ImGui::Text("%d in flight, %d encoding, %d written, %d stalls",
+                    getInFlight(), encoder.getPending(), encoder.getWritten(), stalls);
+    }
+
+private:
+    struct Request {
+        CapturedImage type;
+        std::string path;
+        Request(CapturedImage type, const std::string& path) : type(type), path(path) {}
+    };
+
+    struct Readback {
+        GLuint buffer = 0;
+        size_t capacity = 0;
+        GLsync fence = 0;
+        unsigned long long frame = 0;
+        CapturedImage type = CAPTURED_COLOR;
+        std::string path;
+        int width = 0;
+        int height = 0;
+        DepthProjection projection;
+    };
+
+    ImageEncoder encoder;
+    std::vector<Readback> slots;
+    std::vector<Request> requests;  // for the next frame
+    std::vector<Request> pending;   // for this frame's capture pass
+    int latency;
+    unsigned long long frameIndex = 0;
+    int stalls = 0;
+
+    bool recording = false;
+    std::string colorPattern;
+    std::string depthPattern;
+    int sequenceEvery = 1;
+    int sequenceFrames = 0;
+    int sequenceFrame = 0;
+    int sequenceCaptured = 0;
+
+    void addSequenceRequests() {
+        if(!recording){
+            return;
+        }
+        if(sequenceFrame % sequenceEvery == 0){
+            char path[512];
+            if(!colorPattern.empty()){
+                snprintf(path, sizeof(path), colorPattern.c_str(), sequenceFrame);
+                requestScreenshot(path);
+            }
+            if(!depthPattern.empty()){
+                snprintf(path, sizeof(path), depthPattern.c_str(), sequenceFrame);
+                requestDepth(path);
+            }
+            sequenceCaptured++;
+        }
+        sequenceFrame++;
+        if(sequenceFrames > 0 && sequenceCaptured >= sequenceFrames){
+            recording = false;
+        }
+    }
+
+    void readBack() {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        Camera* camera = ResourceManager::getActiveCamera();
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, ResourceManager::getBackBuffer());
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        for(const Request& request : pending){
+            Readback& slot = acquireSlot();
+            slot.type = request.type;
+            slot.path = request.path;
+            slot.width = viewport[2];
+            slot.height = viewport[3];
+            slot.frame = frameIndex;
+            if(camera != nullptr){
+                slot.projection.nearPlane = camera->getNear();
+                slot.projection.farPlane = camera->getFar();
+                slot.projection.perspective = camera->getProjection() == PERSP;
+            }
+            bool depth = request.type == CAPTURED_DEPTH;
+            size_t bytes = (size_t)slot.width * slot.height * (depth ? sizeof(float) : 3);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+            if(slot.capacity != bytes){
+                glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+                slot.capacity = bytes;
+            }
+            glReadPixels(viewport[0], viewport[1], slot.width, slot.height,
+                         depth ? GL_DEPTH_COMPONENT : GL_RGB, depth ? GL_FLOAT : GL_UNSIGNED_BYTE, nullptr);
+            slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        pending.clear();
+    }
+
+    // a free slot, or the oldest one once it is written out
+    Readback& acquireSlot() {
+        Readback* oldest = nullptr;
+        for(Readback& slot : slots){
+            if(slot.fence == 0){
+                if(slot.buffer == 0){
+                    glGenBuffers(1, &slot.buffer);
+                }
+                return slot;
+            }
+            if(oldest == nullptr || slot.frame < oldest->frame){
+                oldest = &slot;
+            }
+        }
+        stalls++;
+        finish(*oldest);
+        return *oldest;
+    }
+
+    void collect(bool wait) {
+        for(Readback& slot : slots){
+            if(slot.fence == 0){
+                continue;
+            }
+            // due latency frames after the read, waited on if the GPU is still behind then
+            bool due = frameIndex - slot.frame > (unsigned long long)latency;
+            if(!isSignalled(slot.fence)){
+                if(!wait && !due){
+                    continue;
+                }
+                stalls += !wait;
+            }
+            finish(slot);
+        }
+    }
+
+    static bool isSignalled(GLsync fence) {
+        GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+    }
+
+    // waits for the read, then hands the pixels to the encoder
+    void finish(Readback& slot) {
+        GLenum status = GL_TIMEOUT_EXPIRED;
+        bool ready = isSignalled(slot.fence);
+        while(!ready && status != GL_WAIT_FAILED){
+            status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+            ready = status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+        }
+        glDeleteSync(slot.fence);
+        slot.fence = 0;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        const void* data = ready ? glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.capacity, GL_MAP_READ_BIT) : nullptr;
+        if(data != nullptr){
+            if(slot.type == CAPTURED_DEPTH){
+                std::vector<float> depths((const float*)data, (const float*)data + (size_t)slot.width * slot.height);
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+                encoder.submitDepth(slot.path, slot.width, slot.height, depths, slot.projection);
+            }
+            else{
+                std::vector<unsigned char> bytes((const unsigned char*)data, (const unsigned char*)data + slot.capacity);
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+                encoder.submitColor(slot.path, slot.width, slot.height, bytes);
+            }
+        }
+        else{
+            std::cerr << "Frame capture " << slot.path << " could not be read back" << std::endl;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+};
+
+#endif // FRAME_CAPTURE_H
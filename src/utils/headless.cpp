@@ -0,0 +1,363 @@
+#include "headless.h"
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include "../resourceManager.h"
+#include "../camera.h"
+#include "../imgui/imguiWrapper.h"
+#include "profiler.h"
+#include "frameCapture.h"
+#include "../shaderManager.h"
+
+bool HeadlessOptions::parse(int argc, char** argv, HeadlessOptions& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--headless")
+        {
+            options.enabled = true;
+        }
+        else if (arg == "--frames" && hasValue)
+        {
+            options.frames = std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--warmup" && hasValue)
+        {
+            options.warmupFrames = std::max(0, atoi(argv[++i]));
+        }
+        else if (arg == "--size" && hasValue)
+        {
+            if (sscanf(argv[++i], "%dx%d", &options.width, &options.height) != 2 || options.width <= 0 || options.height <= 0)
+            {
+                std::cerr << "Invalid --size, expected WxH" << std::endl;
+                return false;
+            }
+        }
+        else if (arg == "--dt" && hasValue)
+        {
+            options.deltaTime = (float)atof(argv[++i]);
+        }
+        else if (arg == "--gl" && hasValue)
+        {
+            std::string api = argv[++i];
+            if (api == "native")
+                options.context = HEADLESS_NATIVE;
+            else if (api == "egl")
+                options.context = HEADLESS_EGL;
+            else if (api == "osmesa")
+                options.context = HEADLESS_OSMESA;
+            else
+            {
+                std::cerr << "Unknown --gl " << api << ", expected native, egl or osmesa" << std::endl;
+                return false;
+            }
+        }
+        else if (arg == "--csv" && hasValue)
+        {
+            options.csvPath = argv[++i];
+        }
+        else if (arg == "--png-dir" && hasValue)
+        {
+            options.pngDir = argv[++i];
+            if (options.pngEvery == 0)
+                options.pngEvery = 1;
+        }
+        else if (arg == "--png-every" && hasValue)
+        {
+            options.pngEvery = std::max(0, atoi(argv[++i]));
+        }
+        else if (arg == "--camera-path" && hasValue)
+        {
+            options.cameraPath = argv[++i];
+        }
+        else if (arg == "--orbit-radius" && hasValue)
+        {
+            options.orbitRadius = (float)atof(argv[++i]);
+        }
+        else if (arg == "--trace" && hasValue)
+        {
+            options.tracePath = argv[++i];
+        }
+        else if (arg == "--deferred")
+        {
+            options.deferred = true;
+        }
+        else if (arg == "--uniform-tessellation")
+        {
+            options.uniformTessellation = true;
+        }
+        else if (arg == "--screen-space-outlines")
+        {
+            options.screenSpaceOutlines = true;
+        }
+        else if (arg == "--capture-depth")
+        {
+            options.captureDepth = true;
+        }
+        else if (arg == "--no-shader-cache")
+        {
+            options.shaderCache = false;
+        }
+        else
+        {
+            std::cerr << "Unknown argument " << arg << std::endl;
+            printUsage();
+            return false;
+        }
+    }
+    return true;
+}
+
+void HeadlessOptions::printUsage()
+{
+    std::cerr << "usage: graphics [--headless] [--frames N] [--warmup N] [--size WxH] [--dt seconds]" << std::endl
+              << "                [--gl native|egl|osmesa] [--csv file] [--png-dir dir] [--png-every N]" << std::endl
+              << "                [--camera-path file] [--orbit-radius r] [--trace file.json] [--deferred]" << std::endl
+              << "                [--uniform-tessellation] [--screen-space-outlines] [--capture-depth]" << std::endl
+              << "                [--no-shader-cache]" << std::endl;
+}
+
+HeadlessRunner::HeadlessRunner(const HeadlessOptions& options)
+{
+    created = std::chrono::steady_clock::now();
+    this->options = options;
+    positions.setCubic(true);
+    targets.setCubic(true);
+}
+
+int HeadlessRunner::run(GLFWwindow* window)
+{
+    double startup = std::chrono::duration<double>(std::chrono::steady_clock::now() - created).count();
+    Camera* camera = ResourceManager::getActiveCamera();
+    if (camera == nullptr)
+    {
+        std::cerr << "Headless: the scene has no active camera" << std::endl;
+        return 1;
+    }
+    if (!options.cameraPath.empty())
+    {
+        if (!loadCameraPath(options.cameraPath))
+            return 1;
+    }
+    else
+    {
+        buildOrbit(camera);
+    }
+
+    // the path drives the camera, FREE mode keeps it from snapping to a target
+    camera->setMode(FREE);
+    ResourceManager::setFixedDeltaTime(options.deltaTime);
+    ResourceManager::setDeferredEnabled(options.deferred);
+    ResourceManager::setAdaptiveTessellation(!options.uniformTessellation);
+    ResourceManager::setScreenSpaceOutlines(options.screenSpaceOutlines);
+    if (window != nullptr)
+        glfwSwapInterval(0);
+    if (!options.tracePath.empty())
+    {
+        Profiler::setEnabled(true);
+        Profiler::setGpuEnabled(true);
+    }
+
+    int total = options.warmupFrames + options.frames;
+    cpuTimes.reserve(options.frames);
+    frameTimes.reserve(options.frames);
+    primitives.reserve(options.frames);
+    drawCalls.reserve(options.frames);
+
+    // primitives out of the scene's geometry stages, read after the glFinish below
+    GLuint primitivesQuery;
+    glGenQueries(1, &primitivesQuery);
+
+    bool capture = options.pngEvery > 0 && !options.pngDir.empty();
+    for (int i = 0; i < total; i++)
+    {
+        int frame = i - options.warmupFrames;
+        float t = frame <= 0 ? 0.0f : (float)frame / std::max(1, options.frames - 1);
+
+        if (capture && frame == 0)
+        {
+            ResourceManager::getFrameCapture()->startSequence(options.pngDir + "/frame_%05d.png",
+                options.captureDepth ? options.pngDir + "/depth_%05d.exr" : "", options.pngEvery);
+        }
+
+        if (window != nullptr)
+            glfwPollEvents();
+        Profiler::beginFrame();
+        moveCamera(camera, t);
+
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        unsigned long long meshDraws = Mesh::drawCalls();
+        glBeginQuery(GL_PRIMITIVES_GENERATED, primitivesQuery);
+        ResourceManager::runGameLoop();
+        glEndQuery(GL_PRIMITIVES_GENERATED);
+        meshDraws = Mesh::drawCalls() - meshDraws;
+        if (window != nullptr)
+        {
+            ImGuiWrapper::update();
+            ImGuiWrapper::render();
+        }
+        std::chrono::high_resolution_clock::time_point submitted = std::chrono::high_resolution_clock::now();
+        glFinish();
+        std::chrono::high_resolution_clock::time_point finished = std::chrono::high_resolution_clock::now();
+
+        if (frame >= 0)
+        {
+            cpuTimes.push_back(std::chrono::duration<double, std::milli>(submitted - start).count());
+            frameTimes.push_back(std::chrono::duration<double, std::milli>(finished - start).count());
+            GLuint64 generated = 0;
+            glGetQueryObjectui64v(primitivesQuery, GL_QUERY_RESULT, &generated);
+            primitives.push_back(generated);
+            drawCalls.push_back(meshDraws);
+        }
+
+        if (window != nullptr)
+            glfwSwapBuffers(window);
+        Profiler::endFrame();
+    }
+
+    glDeleteQueries(1, &primitivesQuery);
+    if (capture)
+    {
+        FrameCapture* frameCapture = ResourceManager::getFrameCapture();
+        frameCapture->stopSequence();
+        frameCapture->flush();
+        printf("  captured %d images, %d failed, %d readback stalls\n", frameCapture->getEncoder().getWritten(),
+               frameCapture->getEncoder().getFailed(), frameCapture->getStalls());
+    }
+    ResourceManager::setFixedDeltaTime(0.0f);
+    if (!options.tracePath.empty() && !Profiler::exportChromeTrace(options.tracePath))
+    {
+        std::cerr << "Headless: could not write " << options.tracePath << std::endl;
+    }
+
+    std::cout << "Headless: " << options.frames << " frames at " << options.width << "x" << options.height << (options.deferred ? ", deferred" : ", forward")
+              << (options.uniformTessellation ? ", uniform tessellation" : ", adaptive tessellation")
+              << (options.screenSpaceOutlines ? ", screen space outlines" : ", hull outlines") << std::endl;
+    printf("  startup %.1f ms, shaders %.1f ms for %d programs, %d from the cache%s\n", startup * 1000.0,
+           ShaderManager::getBuildMilliseconds(), ShaderManager::getProgramCount(), ShaderManager::getCacheHits(),
+           ShaderManager::hasParallelCompile() ? ", parallel compile" : "");
+    printSummary("cpu", cpuTimes);
+    printSummary("frame", frameTimes);
+    unsigned long long totalPrimitives = 0;
+    for (int i = 0; i < primitives.size(); i++)
+        totalPrimitives += primitives[i];
+    printf("  primitives mean %llu per frame\n", totalPrimitives / std::max<size_t>(1, primitives.size()));
+    unsigned long long totalDrawCalls = 0;
+    for (int i = 0; i < drawCalls.size(); i++)
+        totalDrawCalls += drawCalls[i];
+    printf("  mesh draw calls mean %llu per frame\n", totalDrawCalls / std::max<size_t>(1, drawCalls.size()));
+    return writeTimes() ? 0 : 1;
+}
+
+bool HeadlessRunner::loadCameraPath(const std::string& filename)
+{
+    std::ifstream file(filename.c_str());
+    if (!file.is_open())
+    {
+        std::cerr << "Headless: could not open camera path " << filename << std::endl;
+        return false;
+    }
+
+    std::vector<glm::vec3> positionKeys;
+    std::vector<glm::vec3> targetKeys;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream stream(line);
+        glm::vec3 position, target;
+        if (!(stream >> position.x >> position.y >> position.z >> target.x >> target.y >> target.z))
+        {
+            std::cerr << "Headless: malformed camera path line: " << line << std::endl;
+            return false;
+        }
+        positionKeys.push_back(position);
+        targetKeys.push_back(target);
+    }
+    if (positionKeys.empty())
+    {
+        std::cerr << "Headless: camera path " << filename << " has no keys" << std::endl;
+        return false;
+    }
+
+    positions.setKeys(positionKeys);
+    targets.setKeys(targetKeys);
+    return true;
+}
+
+void HeadlessRunner::buildOrbit(Camera* camera)
+{
+    const int keyCount = 17;
+    glm::vec3 start = camera->getPosition();
+    glm::vec3 pivot = start + camera->getFront() * options.orbitRadius;
+    glm::vec3 offset = start - pivot;
+
+    std::vector<glm::vec3> positionKeys(keyCount);
+    std::vector<glm::vec3> targetKeys(keyCount, pivot);
+    for (int i = 0; i < keyCount; i++)
+    {
+        float angle = 2.0f * 3.14159265f * i / (keyCount - 1);
+        float c = std::cos(angle);
+        float s = std::sin(angle);
+        positionKeys[i] = pivot + glm::vec3(c * offset.x + s * offset.z, offset.y, -s * offset.x + c * offset.z);
+    }
+
+    positions.setKeys(positionKeys);
+    targets.setKeys(targetKeys);
+}
+
+void HeadlessRunner::moveCamera(Camera* camera, float t)
+{
+    float u = t * positions.getSegmentCount();
+    glm::vec3 position = positions.evaluate(u);
+    glm::vec3 target = targets.evaluate(u);
+
+    camera->setPosition(position);
+    if (glm::length(target - position) > 1e-5f)
+    {
+        camera->lookAt(target, glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+}
+
+bool HeadlessRunner::writeTimes()
+{
+    std::ofstream file(options.csvPath.c_str());
+    if (!file.is_open())
+    {
+        std::cerr << "Headless: could not write " << options.csvPath << std::endl;
+        return false;
+    }
+    file << "frame,cpu_ms,frame_ms,primitives,draw_calls\n";
+    for (int i = 0; i < cpuTimes.size(); i++)
+    {
+        file << i << "," << cpuTimes[i] << "," << frameTimes[i] << "," << primitives[i] << "," << drawCalls[i] << "\n";
+    }
+    return true;
+}
+
+void HeadlessRunner::printSummary(const char* name, std::vector<double> times)
+{
+    if (times.empty())
+        return;
+    double sum = 0.0;
+    for (int i = 0; i < times.size(); i++)
+        sum += times[i];
+    std::sort(times.begin(), times.end());
+    double median = times[times.size() / 2];
+    double p95 = times[std::min(times.size() - 1, (size_t)(times.size() * 0.95))];
+
+    printf("  %-6s mean %.3f ms  median %.3f ms  p95 %.3f ms  max %.3f ms\n", name, sum / times.size(), median, p95, times.back());
+}
@@ -0,0 +1,118 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <glm/glm.hpp>
+#include "../curve.h"
+
+class Camera;
+struct GLFWwindow;
+
+// Offscreen benchmark mode. The scene is rendered for a fixed number of frames
+// with a fixed time step while the active camera follows a scripted path.
+// Per-frame CPU times are written as CSV and frames can optionally be dumped
+// as PNG.
+//
+// With --gl egl (the default where CMake found EGL) or --gl osmesa there is no
+// window and no display connection: OffscreenContext creates the context
+// directly and the frames go into its framebuffer object, so it runs on
+// servers without X11, Wayland or a GPU (Mesa's llvmpipe). Those runs are
+// single sampled and have no ImGui. --gl native renders into a hidden GLFW
+// window instead, which needs a display, and on some platforms the read back
+// of a hidden window's pixels is undefined.
+//
+//   graphics --headless [--frames N] [--warmup N] [--size WxH] [--dt seconds]
+//            [--gl native|egl|osmesa] [--csv file] [--png-dir dir] [--png-every N]
+//            [--camera-path file] [--orbit-radius r] [--trace file.json] [--deferred]
+//            [--uniform-tessellation] [--screen-space-outlines] [--capture-depth]
+//            [--no-shader-cache]
+//
+// A camera path file holds one key per line: "px py pz tx ty tz" (position and
+// look-at target). Without one the camera orbits the point orbit-radius units
+// in front of where the demo placed it. --trace enables the profiler (with GPU
+// timers) and writes a Chrome trace of the run. --deferred renders the phong,
+// toon and PBR objects through the deferred path instead of forward.
+// --uniform-tessellation turns the adaptive tessellation levels off, for
+// comparing the primitives generated per frame (reported with the times).
+// --screen-space-outlines draws the toon outlines with one full screen edge
+// pass instead of inverted hulls; the mesh draw calls per frame are reported
+// with the times to compare the two.
+//
+// PNG frames are recorded through FrameCapture, read back asynchronously and
+// encoded off the render thread, so dumping them doesn't skew the times much.
+// --capture-depth adds each frame's linear view depth as depth_N.exr.
+//
+// The startup time (context, scene setup and shader builds) is reported with
+// the times. --no-shader-cache compiles every shader from source and leaves
+// the program binary cache alone: a run with it is a cold start, a second run
+// without it a warm one. Drivers keep a shader cache of their own, so a cold
+// run should empty that as well; on Mesa point MESA_SHADER_CACHE_DIR at an
+// empty directory (MESA_SHADER_CACHE_DISABLE also takes away the program
+// binary formats, so nothing is cached at all). Shader hot reload is off in
+// headless runs.
+
+enum HeadlessContext {
+    HEADLESS_NATIVE,
+    HEADLESS_EGL,
+    HEADLESS_OSMESA
+};
+
+struct HeadlessOptions {
+    bool enabled = false;
+#ifdef HAS_EGL
+    HeadlessContext context = HEADLESS_EGL;
+#else
+    HeadlessContext context = HEADLESS_NATIVE;
+#endif
+    int width = 1280;
+    int height = 720;
+    int frames = 300;
+    int warmupFrames = 10;
+    float deltaTime = 1.0f / 60.0f;
+    float orbitRadius = 10.0f;
+    int pngEvery = 0;
+    std::string csvPath = "frame_times.csv";
+    std::string pngDir;
+    std::string cameraPath;
+    std::string tracePath;
+    bool deferred = false;
+    bool uniformTessellation = false;
+    bool screenSpaceOutlines = false;
+    bool captureDepth = false;
+    bool shaderCache = true;
+
+    // returns false on malformed arguments, options stay disabled without --headless
+    static bool parse(int argc, char** argv, HeadlessOptions& options);
+    static void printUsage();
+
+};
+
+class HeadlessRunner {
+public:
+    // constructed before the context, the startup time is counted from here
+    HeadlessRunner(const HeadlessOptions& options);
+
+    // renders warmup + frames frames, writes the csv and returns the exit code;
+    // window is null when an offscreen context renders
+    int run(GLFWwindow* window);
+
+private:
+    HeadlessOptions options;
+    std::chrono::steady_clock::time_point created;
+    Curve<glm::vec3> positions;
+    Curve<glm::vec3> targets;
+    std::vector<double> cpuTimes;
+    std::vector<double> frameTimes;
+    std::vector<unsigned long long> primitives;
+    std::vector<unsigned long long> drawCalls;
+
+    bool loadCameraPath(const std::string& filename);
+    void buildOrbit(Camera* camera);
+    void moveCamera(Camera* camera, float t);
+    bool writeTimes();
+    void printSummary(const char* name, std::vector<double> times);
+};
+
+#endif // HEADLESS_H
@@ -0,0 +1,309 @@
+#ifndef IMAGE_ENCODER_H
+#define IMAGE_ENCODER_H
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+#include "stb_image_write.h"
+
+// Writes captured frames to disk on background threads, GL free so
+// graphics_bench can time it. FrameCapture hands it pixels it has read back;
+// the render thread only moves them into the queue.
+//
+// The queue holds at most maxPending images. submit() waits while it is full,
+// so a capture running faster than the disk slows the frame down instead of
+// growing without bound. PNG goes through stb_image_write. EXR is written
+// here, uncompressed 32 bit float scanlines, since stb has no writer for it.
+//
+// Depth arrives as window depth in [0, 1] and is linearized on the worker into
+// view distance with the camera's planes. As EXR it is a single Z channel in
+// scene units; as PNG it is mapped from near (black) to far (white), a preview
+// only.
+
+enum CapturedImage {
+    CAPTURED_COLOR,     // RGB8, rows bottom up as GL reads them
+    CAPTURED_DEPTH      // float window depth, rows bottom up
+};
+
+struct DepthProjection {
+    float nearPlane = 0.1f;
+    float farPlane = 100.0f;
+    bool perspective = true;
+};
+
+class ImageEncoder {
+public:
+    // numThreads 0 uses every core but the render thread's
+    ImageEncoder(int numThreads = 0, int maxPending = 0) {
+        if(numThreads <= 0){
+            numThreads = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+        }
+        this->maxPending = maxPending > 0 ? maxPending : 2 * numThreads;
+        for(int i = 0; i < numThreads; i++){
+            workers.push_back(std::thread(&ImageEncoder::work, this));
+        }
+    }
+
+    ~ImageEncoder() {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        jobReady.notify_all();
+        for(std::thread& worker : workers){
+            worker.join();
+        }
+    }
+
+    // the format follows the extension, .exr or .png; bytes or depths is moved from
+    void submitColor(const std::string& path, int width, int height, std::vector<unsigned char>& bytes) {
+        Job job;
+        job.type = CAPTURED_COLOR;
+        job.path = path;
+        job.width = width;
+        job.height = height;
+        job.bytes.swap(bytes);
+        submit(job);
+    }
+
+    void submitDepth(const std::string& path, int width, int height, std::vector<float>& depths, const DepthProjection& projection) {
+        Job job;
+        job.type = CAPTURED_DEPTH;
+        job.path = path;
+        job.width = width;
+        job.height = height;
+        job.depths.swap(depths);
+        job.projection = projection;
+        submit(job);
+    }
+
+    // blocks until every submitted image is written
+    void flush() {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this](){ return jobs.empty() && busy == 0; });
+    }
+
+    int getPending() {
+        std::unique_lock<std::mutex> lock(mutex);
+        return jobs.size() + busy;
+    }
+
+    int getWritten() const { return written; }
+    int getFailed() const { return failed; }
+    int getThreadCount() const { return workers.size(); }
+
+    // view distance from window depth, in place; depth 1 (nothing drawn) stays at the far plane
+    static void linearizeDepth(float* depths, size_t count, const DepthProjection& projection) {
+        float n = projection.nearPlane;
+        float f = projection.farPlane;
+        for(size_t i = 0; i < count; i++){
+            float ndc = 2.0f * depths[i] - 1.0f;
+            depths[i] = projection.perspective ? 2.0f * n * f / (f + n - ndc * (f - n))
+                                               : n + depths[i] * (f - n);
+        }
+    }
+
+    // channels 1 is written as Z, 3 as RGB; rows bottom up when flip
+    static bool writeEXR(const std::string& path, int width, int height, int channels, const float* pixels, bool flip) {
+        static const char* rgbNames[3] = { "B", "G", "R" };    // channels are stored sorted by name
+        static const int rgbOffsets[3] = { 2, 1, 0 };
+        const char* depthName = "Z";
+        const char** names = channels == 1 ? &depthName : rgbNames;
+
+        std::vector<unsigned char> header;
+        appendBytes(header, "\x76\x2f\x31\x01", 4);
+        appendInt(header, 2);   // version 2, single part scanline
+
+        std::vector<unsigned char> channelList;
+        for(int c = 0; c < channels; c++){
+            appendBytes(channelList, names[c], strlen(names[c]) + 1);
+            appendInt(channelList, 2);  // FLOAT
+            appendInt(channelList, 0);  // pLinear and reserved
+            appendInt(channelList, 1);  // x and y sampling
+            appendInt(channelList, 1);
+        }
+        channelList.push_back(0);
+        appendAttribute(header, "channels", "chlist", channelList);
+
+        std::vector<unsigned char> value;
+        value.push_back(0);     // NO_COMPRESSION
+        appendAttribute(header, "compression", "compression", value);
+        int window[4] = { 0, 0, width - 1, height - 1 };
+        value.clear();
+        for(int i = 0; i < 4; i++) appendInt(value, window[i]);
+        appendAttribute(header, "dataWindow", "box2i", value);
+        appendAttribute(header, "displayWindow", "box2i", value);
+        value.assign(1, 0);     // INCREASING_Y
+        appendAttribute(header, "lineOrder", "lineOrder", value);
+        value.clear();
+        appendFloat(value, 1.0f);
+        appendAttribute(header, "pixelAspectRatio", "float", value);
+        value.clear();
+        appendFloat(value, 0.0f);
+        appendFloat(value, 0.0f);
+        appendAttribute(header, "screenWindowCenter", "v2f", value);
+        value.clear();
+        appendFloat(value, 1.0f);
+        appendAttribute(header, "screenWindowWidth", "float", value);
+        header.push_back(0);
+
+        // one scanline per block: y, byte count, then each channel's row
+        size_t rowBytes = (size_t)width * channels * 4;
+        size_t blockBytes = 8 + rowBytes;
+        uint64_t offset = header.size() + (uint64_t)height * 8;
+        for(int y = 0; y < height; y++){
+            appendInt(header, (int)(offset & 0xFFFFFFFF));
+            appendInt(header, (int)(offset >> 32));
+            offset += blockBytes;
+        }
+
+        FILE* file = fopen(path.c_str(), "wb");
+        if(file == NULL){
+            return false;
+        }
+        bool ok = fwrite(header.data(), 1, header.size(), file) == header.size();
+        std::vector<unsigned char> block(blockBytes);
+        for(int y = 0; y < height && ok; y++){
+            const float* row = pixels + (size_t)(flip ? height - 1 - y : y) * width * channels;
+            int32_t size = (int32_t)rowBytes;
+            int32_t line = y;
+            memcpy(&block[0], &line, 4);
+            memcpy(&block[4], &size, 4);
+            float* out = (float*)&block[8];
+            for(int c = 0; c < channels; c++){
+                int source = channels == 1 ? 0 : rgbOffsets[c];
+                for(int x = 0; x < width; x++){
+                    *out++ = row[x * channels + source];
+                }
+            }
+            ok = fwrite(block.data(), 1, block.size(), file) == block.size();
+        }
+        return fclose(file) == 0 && ok;
+    }
+
+private:
+    struct Job {
+        CapturedImage type = CAPTURED_COLOR;
+        std::string path;
+        int width = 0;
+        int height = 0;
+        std::vector<unsigned char> bytes;
+        std::vector<float> depths;
+        DepthProjection projection;
+    };
+
+    std::vector<std::thread> workers;
+    std::deque<Job> jobs;
+    std::mutex mutex;
+    std::condition_variable jobReady;
+    std::condition_variable slotFree;
+    std::condition_variable idle;
+    int maxPending;
+    int busy = 0;
+    int written = 0;
+    int failed = 0;
+    bool stopping = false;
+
+    void submit(Job& job) {
+        std::unique_lock<std::mutex> lock(mutex);
+        slotFree.wait(lock, [this](){ return (int)jobs.size() + busy < maxPending; });
+        jobs.push_back(Job());
+        std::swap(jobs.back(), job);
+        jobReady.notify_one();
+    }
+
+    void work() {
+        while(true){
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobReady.wait(lock, [this](){ return stopping || !jobs.empty(); });
+                if(jobs.empty()){
+                    return;
+                }
+                std::swap(job, jobs.front());
+                jobs.pop_front();
+                busy++;
+            }
+            bool ok = encode(job);
+            if(!ok){
+                std::cerr << "Could not write capture " << job.path << std::endl;
+            }
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                busy--;
+                (ok ? written : failed)++;
+            }
+            slotFree.notify_one();
+            idle.notify_all();
+        }
+    }
+
+    static bool isExr(const std::string& path) {
+        return path.size() >= 4 && path.compare(path.size() - 4, 4, ".exr") == 0;
+    }
+
+    static bool encode(Job& job) {
+        if(job.type == CAPTURED_COLOR){
+            if(isExr(job.path)){
+                std::vector<float> linear(job.bytes.size());
+                for(size_t i = 0; i < linear.size(); i++){
+                    linear[i] = job.bytes[i] / 255.0f;
+                }
+                return writeEXR(job.path, job.width, job.height, 3, linear.data(), true);
+            }
+            // rows bottom up, written top down by a negative stride; stbi_flip_vertically_on_write
+            // is one flag for the whole process and not safe to set from a worker
+            int stride = job.width * 3;
+            return stbi_write_png(job.path.c_str(), job.width, job.height, 3,
+                                  job.bytes.data() + (size_t)(job.height - 1) * stride, -stride) != 0;
+        }
+
+        linearizeDepth(job.depths.data(), job.depths.size(), job.projection);
+        if(isExr(job.path)){
+            return writeEXR(job.path, job.width, job.height, 1, job.depths.data(), true);
+        }
+        float n = job.projection.nearPlane;
+        float f = job.projection.farPlane;
+        std::vector<unsigned char> preview(job.depths.size());
+        for(size_t i = 0; i < preview.size(); i++){
+            float t = std::min(std::max((job.depths[i] - n) / (f - n), 0.0f), 1.0f);
+            preview[i] = (unsigned char)(t * 255.0f + 0.5f);
+        }
+        return stbi_write_png(job.path.c_str(), job.width, job.height, 1,
+                              preview.data() + (size_t)(job.height - 1) * job.width, -job.width) != 0;
+    }
+
+    static void appendBytes(std::vector<unsigned char>& out, const void* data, size_t size) {
+        const unsigned char* bytes = (const unsigned char*)data;
+        out.insert(out.end(), bytes, bytes + size);
+    }
+
+    static void appendInt(std::vector<unsigned char>& out, int32_t value) {
+        unsigned char bytes[4] = { (unsigned char)value, (unsigned char)(value >> 8), (unsigned char)(value >> 16), (unsigned char)(value >> 24) };
+        appendBytes(out, bytes, 4);
+    }
+
+    static void appendFloat(std::vector<unsigned char>& out, float value) {
+        int32_t bits;
+        memcpy(&bits, &value, 4);
+        appendInt(out, bits);
+    }
+
+    static void appendAttribute(std::vector<unsigned char>& out, const char* name, const char* type, const std::vector<unsigned char>& value) {
+        appendBytes(out, name, strlen(name) + 1);
+        appendBytes(out, type, strlen(type) + 1);
+        appendInt(out, value.size());
+        out.insert(out.end(), value.begin(), value.end());
+    }
+};
+
+#endif // IMAGE_ENCODER_H
@@ -0,0 +1,304 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <glm/glm.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LIGHT_CLUSTERS_SSE
+#endif
+
+// Clustered light culling for the forward shaders. The view frustum is cut
+// into gridX * gridY screen tiles and gridZ depth slices (exponential, so
+// clusters stay roughly cubic), and every point light is assigned to the
+// clusters its sphere of influence touches. A fragment finds its cluster
+// from gl_FragCoord and its view depth and only shades that cluster's lights.
+//
+// GL free so it runs without a context; ResourceManager uploads the result
+// to texture buffers once per frame (see updateLightClusters).
+
+class LightClusters {
+public:
+    LightClusters(int gridX = 16, int gridY = 9, int gridZ = 24){
+        setGridSize(gridX, gridY, gridZ);
+    }
+
+    void setGridSize(int gridX, int gridY, int gridZ){
+        this->gridX = std::max(1, gridX);
+        this->gridY = std::max(1, gridY);
+        this->gridZ = std::max(1, gridZ);
+        this->projection = glm::mat4(0.0f);
+        boxes.clear();
+        grid.assign(2 * getClusterCount(), 0);
+        indices.clear();
+    }
+
+    // Rebuilds the cluster boxes (view space) when the projection changes.
+    // Works for any projection whose near/far planes are at positive depth.
+    void setProjection(const glm::mat4& projection){
+        if(projection == this->projection && !boxes.empty()){
+            return;
+        }
+        this->projection = projection;
+        inverseProjection = glm::inverse(projection);
+
+        glm::vec3 centreNear = unproject(glm::vec3(0.0f, 0.0f, -1.0f));
+        glm::vec3 centreFar = unproject(glm::vec3(0.0f, 0.0f, 1.0f));
+        nearPlane = std::max(-centreNear.z, 1e-4f);
+        farPlane = std::max(-centreFar.z, nearPlane * 1.001f);
+        sliceScale = gridZ / std::log(farPlane / nearPlane);
+        sliceBias = -std::log(nearPlane) * sliceScale;
+
+        // the line through each tile corner, as its near and far plane points
+        std::vector<glm::vec3> cornerNear((gridX + 1) * (gridY + 1));
+        std::vector<glm::vec3> cornerFar(cornerNear.size());
+        for(int y = 0; y <= gridY; y++){
+            for(int x = 0; x <= gridX; x++){
+                glm::vec2 ndc(-1.0f + 2.0f * x / gridX, -1.0f + 2.0f * y / gridY);
+                cornerNear[x + (gridX + 1) * y] = unproject(glm::vec3(ndc, -1.0f));
+                cornerFar[x + (gridX + 1) * y] = unproject(glm::vec3(ndc, 1.0f));
+            }
+        }
+
+        boxes.resize(getClusterCount());
+        for(int z = 0; z < gridZ; z++){
+            float depths[2] = { getSliceDepth(z), getSliceDepth(z + 1) };
+            for(int y = 0; y < gridY; y++){
+                for(int x = 0; x < gridX; x++){
+                    Box& box = boxes[getClusterIndex(x, y, z)];
+                    box.min = glm::vec3(FLT_MAX);
+                    box.max = glm::vec3(-FLT_MAX);
+                    for(int corner = 0; corner < 4; corner++){
+                        int c = (x + (corner & 1)) + (gridX + 1) * (y + (corner >> 1));
+                        for(int d = 0; d < 2; d++){
+                            glm::vec3 p = pointAtDepth(cornerNear[c], cornerFar[c], depths[d]);
+                            box.min = glm::min(box.min, p);
+                            box.max = glm::max(box.max, p);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // lights[i] is (view space position, radius). Afterwards cluster c owns
+    // getIndices()[grid[2c], grid[2c] + grid[2c + 1]), ascending light indices.
+    void assign(const std::vector<glm::vec4>& lights, int numThreads = 0){
+        if(boxes.empty()){
+            setProjection(glm::mat4(1.0f));
+        }
+        if(numThreads <= 0){
+            numThreads = std::thread::hardware_concurrency();
+        }
+        // a thread per couple of slices, and only when there is real work
+        const long long minTestsPerThread = 1 << 16;
+        long long tests = (long long)lights.size() * getClusterCount();
+        numThreads = std::max(1, std::min(numThreads, std::min(gridZ / 2, (int)(tests / minTestsPerThread))));
+
+        std::vector<std::vector<unsigned int> > threadIndices(numThreads);
+        std::vector<int> firstSlice(numThreads + 1);
+        for(int i = 0; i <= numThreads; i++){
+            firstSlice[i] = gridZ * i / numThreads;
+        }
+
+        if(numThreads == 1){
+            assignSlices(lights, 0, gridZ, threadIndices[0]);
+        } else {
+            std::vector<std::thread> workers;
+            for(int i = 0; i < numThreads; i++){
+                workers.push_back(std::thread(&LightClusters::assignSlices, this, std::cref(lights), firstSlice[i], firstSlice[i + 1], std::ref(threadIndices[i])));
+            }
+            for(int i = 0; i < workers.size(); i++){
+                workers[i].join();
+            }
+        }
+
+        // stitch the per thread lists together; offsets were thread local
+        size_t total = 0;
+        for(int i = 0; i < numThreads; i++){
+            total += threadIndices[i].size();
+        }
+        indices.resize(total);
+        unsigned int base = 0;
+        for(int i = 0; i < numThreads; i++){
+            std::copy(threadIndices[i].begin(), threadIndices[i].end(), indices.begin() + base);
+            int first = getClusterIndex(0, 0, firstSlice[i]);
+            int last = getClusterIndex(0, 0, firstSlice[i + 1]);
+            for(int c = first; c < last; c++){
+                grid[2 * c] += base;
+            }
+            base += threadIndices[i].size();
+        }
+    }
+
+    // Cluster of a view space position, the same way the shaders compute it
+    int findCluster(const glm::vec3& viewPosition) const {
+        glm::vec4 clip = projection * glm::vec4(viewPosition, 1.0f);
+        glm::vec2 ndc = glm::vec2(clip) / clip.w;
+        int x = glm::clamp((int)((ndc.x * 0.5f + 0.5f) * gridX), 0, gridX - 1);
+        int y = glm::clamp((int)((ndc.y * 0.5f + 0.5f) * gridY), 0, gridY - 1);
+        int z = getSlice(-viewPosition.z);
+        return getClusterIndex(x, y, z);
+    }
+
+    int getSlice(float depth) const {
+        int slice = (int)std::floor(std::log(std::max(depth, 1e-6f)) * sliceScale + sliceBias);
+        return glm::clamp(slice, 0, gridZ - 1);
+    }
+
+    float getSliceDepth(int slice) const {
+        return nearPlane * std::pow(farPlane / nearPlane, (float)slice / gridZ);
+    }
+
+    int getClusterIndex(int x, int y, int z) const {
+        return x + gridX * (y + gridY * z);
+    }
+
+    int getClusterCount() const {
+        return gridX * gridY * gridZ;
+    }
+
+    glm::ivec3 getGridSize() const {
+        return glm::ivec3(gridX, gridY, gridZ);
+    }
+
+    // slice = floor(log(view depth) * scale + bias)
+    float getSliceScale() const {
+        return sliceScale;
+    }
+
+    float getSliceBias() const {
+        return sliceBias;
+    }
+
+    float getNear() const {
+        return nearPlane;
+    }
+
+    float getFar() const {
+        return farPlane;
+    }
+
+    // (offset, count) per cluster
+    const std::vector<unsigned int>& getGrid() const {
+        return grid;
+    }
+
+    const std::vector<unsigned int>& getIndices() const {
+        return indices;
+    }
+
+    void getClusterBounds(int cluster, glm::vec3& min, glm::vec3& max) const {
+        min = boxes[cluster].min;
+        max = boxes[cluster].max;
+    }
+
+private:
+    struct Box {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    int gridX, gridY, gridZ;
+    float nearPlane = 0.1f, farPlane = 100.0f;
+    float sliceScale = 1.0f, sliceBias = 0.0f;
+    glm::mat4 projection;
+    glm::mat4 inverseProjection;
+    std::vector<Box> boxes;
+    std::vector<unsigned int> grid;
+    std::vector<unsigned int> indices;
+
+    glm::vec3 unproject(const glm::vec3& ndc) const {
+        glm::vec4 p = inverseProjection * glm::vec4(ndc, 1.0f);
+        return glm::vec3(p) / p.w;
+    }
+
+    // view space lines are straight in z, so interpolate on depth
+    static glm::vec3 pointAtDepth(const glm::vec3& a, const glm::vec3& b, float depth){
+        float t = (depth + a.z) / (a.z - b.z);
+        return a + (b - a) * t;
+    }
+
+    void assignSlices(const std::vector<glm::vec4>& lights, int firstSlice, int lastSlice, std::vector<unsigned int>& out){
+        // lights overlapping the slice, SoA and padded to a multiple of four
+        // with lights that never pass (negative squared radius)
+        std::vector<float> cx, cy, cz, cr2;
+        std::vector<unsigned int> candidates;
+        out.clear();
+
+        for(int z = firstSlice; z < lastSlice; z++){
+            float sliceNear = getSliceDepth(z);
+            float sliceFar = getSliceDepth(z + 1);
+            cx.clear(); cy.clear(); cz.clear(); cr2.clear();
+            candidates.clear();
+            for(int i = 0; i < lights.size(); i++){
+                const glm::vec4& light = lights[i];
+                float depth = -light.z;
+                if(light.w <= 0.0f || depth + light.w < sliceNear || depth - light.w > sliceFar){
+                    continue;
+                }
+                cx.push_back(light.x);
+                cy.push_back(light.y);
+                cz.push_back(light.z);
+                cr2.push_back(light.w * light.w);
+                candidates.push_back(i);
+            }
+            while(cx.size() % 4 != 0){
+                cx.push_back(0.0f);
+                cy.push_back(0.0f);
+                cz.push_back(0.0f);
+                cr2.push_back(-1.0f);
+                candidates.push_back(0);
+            }
+
+            for(int y = 0; y < gridY; y++){
+                for(int x = 0; x < gridX; x++){
+                    int cluster = getClusterIndex(x, y, z);
+                    const Box& box = boxes[cluster];
+                    grid[2 * cluster] = out.size();
+                    for(int i = 0; i < cx.size(); i += 4){
+                        int mask = sphereBoxMask(box, &cx[i], &cy[i], &cz[i], &cr2[i]);
+                        for(int lane = 0; mask != 0 && lane < 4; lane++){
+                            if(mask & (1 << lane)){
+                                out.push_back(candidates[i + lane]);
+                            }
+                        }
+                    }
+                    grid[2 * cluster + 1] = out.size() - grid[2 * cluster];
+                }
+            }
+        }
+    }
+
+    // squared distance from each of four sphere centres to the box against
+    // their squared radii; returns a bit mask of the spheres touching it
+    static int sphereBoxMask(const Box& box, const float* x, const float* y, const float* z, const float* r2){
+#ifdef LIGHT_CLUSTERS_SSE
+        const __m128 zero = _mm_setzero_ps();
+        __m128 px = _mm_loadu_ps(x), py = _mm_loadu_ps(y), pz = _mm_loadu_ps(z);
+        __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(box.min.x), px), _mm_sub_ps(px, _mm_set1_ps(box.max.x))), zero);
+        __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(box.min.y), py), _mm_sub_ps(py, _mm_set1_ps(box.max.y))), zero);
+        __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(box.min.z), pz), _mm_sub_ps(pz, _mm_set1_ps(box.max.z))), zero);
+        __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        return _mm_movemask_ps(_mm_cmple_ps(d2, _mm_loadu_ps(r2)));
+#else
+        int mask = 0;
+        for(int i = 0; i < 4; i++){
+            float dx = std::max(std::max(box.min.x - x[i], x[i] - box.max.x), 0.0f);
+            float dy = std::max(std::max(box.min.y - y[i], y[i] - box.max.y), 0.0f);
+            float dz = std::max(std::max(box.min.z - z[i], z[i] - box.max.z), 0.0f);
+            if(dx * dx + dy * dy + dz * dz <= r2[i]){
+                mask |= 1 << i;
+            }
+        }
+        return mask;
+#endif
+    }
+};
+
+#endif // LIGHT_CLUSTERS_H
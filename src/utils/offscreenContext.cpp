@@ -0,0 +1,233 @@
+#include "offscreenContext.h"
+
+#include <cstring>
+#include <iostream>
+#ifdef HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+#ifdef HAS_OSMESA
+#include <GL/osmesa.h>
+#endif
+
+HeadlessContext OffscreenContext::current = HEADLESS_NATIVE;
+
+#ifdef HAS_EGL
+// whole names only, one extension name can be the prefix of another
+static bool hasExtension(const char* extensions, const char* name)
+{
+    size_t length = strlen(name);
+    for (const char* found = extensions ? strstr(extensions, name) : nullptr; found; found = strstr(found + length, name))
+    {
+        bool start = found == extensions || found[-1] == ' ';
+        bool end = found[length] == ' ' || found[length] == '\0';
+        if (start && end)
+            return true;
+    }
+    return false;
+}
+#endif
+
+bool OffscreenContext::isSupported(HeadlessContext api)
+{
+    switch (api)
+    {
+#ifdef HAS_EGL
+    case HEADLESS_EGL:
+        return true;
+#endif
+#ifdef HAS_OSMESA
+    case HEADLESS_OSMESA:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+bool OffscreenContext::create(HeadlessContext api, int width, int height)
+{
+    this->api = api;
+    bool created = false;
+    if (api == HEADLESS_EGL)
+        created = createEGL();
+    else if (api == HEADLESS_OSMESA)
+        created = createOSMesa(width, height);
+    if (!created)
+    {
+        destroy();
+        return false;
+    }
+
+    current = api;
+    if (!gladLoadGLLoader((GLADloadproc)getProcAddress))
+    {
+        std::cerr << "Failed to initialize Glad" << std::endl;
+        destroy();
+        return false;
+    }
+    std::cout << "OpenGL Version: " << GLVersion.major << "." << GLVersion.minor << " (" << glGetString(GL_RENDERER) << ", offscreen)" << std::endl;
+
+    if (!createFramebuffer(width, height))
+    {
+        destroy();
+        return false;
+    }
+    return true;
+}
+
+bool OffscreenContext::createEGL()
+{
+#ifdef HAS_EGL
+    const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+    if (getPlatformDisplay != nullptr && hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless"))
+    {
+        eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (eglDisplay == EGL_NO_DISPLAY && getPlatformDisplay != nullptr && hasExtension(clientExtensions, "EGL_EXT_platform_device"))
+    {
+        PFNEGLQUERYDEVICESEXTPROC queryDevices = (PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT");
+        EGLDeviceEXT device;
+        EGLint count = 0;
+        if (queryDevices != nullptr && queryDevices(1, &device, &count) && count > 0)
+            eglDisplay = getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, device, nullptr);
+    }
+    if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, nullptr, nullptr))
+    {
+        std::cerr << "EGL: no surfaceless platform or device display" << std::endl;
+        return false;
+    }
+    display = eglDisplay;
+    if (!hasExtension(eglQueryString(eglDisplay, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context") || !eglBindAPI(EGL_OPENGL_API))
+    {
+        std::cerr << "EGL: the display has no surfaceless desktop GL contexts" << std::endl;
+        return false;
+    }
+
+    // no surface will ever use the config, any GL one does
+    const EGLint configAttributes[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+    EGLConfig config = nullptr;
+    EGLint configs = 0;
+    eglChooseConfig(eglDisplay, configAttributes, &config, 1, &configs);
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 1,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext eglContext = eglCreateContext(eglDisplay, configs > 0 ? config : nullptr, EGL_NO_CONTEXT, contextAttributes);
+    if (eglContext == EGL_NO_CONTEXT)
+    {
+        std::cerr << "EGL: could not create a 4.1 core context (error 0x" << std::hex << eglGetError() << std::dec << ")" << std::endl;
+        return false;
+    }
+    context = eglContext;
+    if (!eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext))
+    {
+        std::cerr << "EGL: could not make the context current" << std::endl;
+        return false;
+    }
+    return true;
+#else
+    std::cerr << "This build has no EGL support" << std::endl;
+    return false;
+#endif
+}
+
+bool OffscreenContext::createOSMesa(int width, int height)
+{
+#ifdef HAS_OSMESA
+    const int attributes[] = {
+        OSMESA_FORMAT, OSMESA_RGBA,
+        OSMESA_DEPTH_BITS, 24,
+        OSMESA_STENCIL_BITS, 8,
+        OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+        OSMESA_CONTEXT_MAJOR_VERSION, 4,
+        OSMESA_CONTEXT_MINOR_VERSION, 1,
+        0
+    };
+    OSMesaContext osmesaContext = OSMesaCreateContextAttribs(attributes, nullptr);
+    if (osmesaContext == nullptr)
+    {
+        std::cerr << "OSMesa: could not create a 4.1 core context" << std::endl;
+        return false;
+    }
+    context = osmesaContext;
+    pixels.resize((size_t)width * height * 4);
+    if (!OSMesaMakeCurrent(osmesaContext, pixels.data(), GL_UNSIGNED_BYTE, width, height))
+    {
+        std::cerr << "OSMesa: could not make the context current" << std::endl;
+        return false;
+    }
+    return true;
+#else
+    std::cerr << "This build has no OSMesa support" << std::endl;
+    return false;
+#endif
+}
+
+bool OffscreenContext::createFramebuffer(int width, int height)
+{
+    // the formats a default framebuffer gets: 8 bit RGBA, 24 bit depth and 8 bit stencil
+    glGenRenderbuffers(2, renderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cerr << "Offscreen framebuffer incomplete" << std::endl;
+        return false;
+    }
+    // a surfaceless context starts with an empty viewport
+    glViewport(0, 0, width, height);
+    return true;
+}
+
+void OffscreenContext::destroy()
+{
+    if (context != nullptr && framebuffer != 0)
+    {
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(2, renderbuffers);
+    }
+    framebuffer = 0;
+    renderbuffers[0] = renderbuffers[1] = 0;
+#ifdef HAS_EGL
+    if (api == HEADLESS_EGL && display != nullptr)
+    {
+        eglMakeCurrent((EGLDisplay)display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (context != nullptr)
+            eglDestroyContext((EGLDisplay)display, (EGLContext)context);
+        eglTerminate((EGLDisplay)display);
+    }
+#endif
+#ifdef HAS_OSMESA
+    if (api == HEADLESS_OSMESA && context != nullptr)
+        OSMesaDestroyContext((OSMesaContext)context);
+#endif
+    display = nullptr;
+    context = nullptr;
+    pixels.clear();
+}
+
+void* OffscreenContext::getProcAddress(const char* name)
+{
+#ifdef HAS_EGL
+    if (current == HEADLESS_EGL)
+        return (void*)eglGetProcAddress(name);
+#endif
+#ifdef HAS_OSMESA
+    if (current == HEADLESS_OSMESA)
+        return (void*)OSMesaGetProcAddress(name);
+#endif
+    return nullptr;
+}
@@ -0,0 +1,50 @@
+#ifndef OFFSCREEN_CONTEXT_H
+#define OFFSCREEN_CONTEXT_H
+
+#include <glad/glad.h>
+#include <vector>
+#include "headless.h"
+
+// A GL 4.1 core context with no window and no display connection, for
+// headless runs on servers. EGL comes from Mesa's surfaceless platform
+// (llvmpipe without a GPU) or, failing that, the first EGL device (how
+// NVIDIA's driver exposes its GPUs); OSMesa renders into client memory.
+// Neither gives a default framebuffer to draw into, so the context renders
+// into an FBO of the run's size that stands in for it
+// (ResourceManager::getBackBuffer). Unlike a hidden window's back buffer,
+// every pixel of it belongs to the run, so read backs are well defined. It
+// is single sampled, GL_MULTISAMPLE has nothing to act on.
+//
+// EGL needs HAS_EGL and OSMesa HAS_OSMESA, which CMakeLists.txt defines
+// when it finds the libraries (Linux only).
+
+class OffscreenContext {
+public:
+    static bool isSupported(HeadlessContext api);
+
+    // makes the context current, loads glad through it and binds the
+    // framebuffer; false with the reason on stderr
+    bool create(HeadlessContext api, int width, int height);
+    void destroy();
+
+    GLuint getFramebuffer() const { return framebuffer; }
+
+    // the GL entry point loader of the context created last
+    static void* getProcAddress(const char* name);
+
+private:
+    static HeadlessContext current;
+
+    HeadlessContext api = HEADLESS_NATIVE;
+    void* display = nullptr;    // EGLDisplay
+    void* context = nullptr;    // EGLContext or OSMesaContext
+    std::vector<unsigned char> pixels;  // OSMesa's own color buffer, never read
+    GLuint framebuffer = 0;
+    GLuint renderbuffers[2] = { 0, 0 };
+
+    bool createEGL();
+    bool createOSMesa(int width, int height);
+    bool createFramebuffer(int width, int height);
+};
+
+#endif // OFFSCREEN_CONTEXT_H
@@ -0,0 +1,424 @@
+#include "profiler.h"
+
+#include <glad/glad.h>
+#include <imgui.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#if defined(__GNUG__)
+#include <cxxabi.h>
+#endif
+
+std::atomic<bool> Profiler::enabled(false);
+std::atomic<uint32_t> Profiler::frame(0);
+bool Profiler::gpuEnabled = false;
+uint32_t Profiler::gpuDepth = 0;
+std::mutex Profiler::mutex;
+std::vector<ProfileBuffer*> Profiler::buffers;
+ProfileBuffer* Profiler::gpuBuffer = nullptr;
+Profiler::FrameRecord Profiler::frames[Profiler::frameHistory];
+Profiler::GpuFrame Profiler::gpuFrames[Profiler::gpuLatency];
+std::unordered_map<const std::type_info*, std::string> Profiler::typeNames;
+
+ProfileBuffer::ProfileBuffer(int lane, int capacity) : written(0)
+{
+    int size = 1;
+    while (size < capacity)
+        size <<= 1;
+    this->lane = lane;
+    events.resize(size);
+    mask = size - 1;
+}
+
+void ProfileBuffer::collect(uint32_t frame, std::vector<ProfileEvent>& out) const
+{
+    uint64_t end = written.load(std::memory_order_acquire);
+    uint64_t first = end > events.size() ? end - events.size() : 0;
+
+    // frames only grow along the ring, walk back to the first event of frame
+    uint64_t begin = end;
+    while (begin > first && events[(begin - 1) & mask].frame >= frame)
+        begin--;
+    for (uint64_t i = begin; i < end; i++)
+    {
+        const ProfileEvent& event = events[i & mask];
+        if (event.frame == frame)
+            out.push_back(event);
+    }
+}
+
+void ProfileBuffer::collectAll(std::vector<ProfileEvent>& out) const
+{
+    uint64_t end = written.load(std::memory_order_acquire);
+    uint64_t first = end > events.size() ? end - events.size() : 0;
+    for (uint64_t i = first; i < end; i++)
+        out.push_back(events[i & mask]);
+}
+
+// returns the buffer of a finished thread to the pool so the short lived
+// std::thread workers used across the engine share a handful of lanes
+struct ProfileBufferHandle {
+    ProfileBuffer* buffer = nullptr;
+    ~ProfileBufferHandle()
+    {
+        if (buffer)
+            Profiler::releaseBuffer(buffer);
+    }
+};
+
+void Profiler::setEnabled(bool enabled)
+{
+    Profiler::enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void Profiler::setGpuEnabled(bool enabled)
+{
+    if (!enabled)
+    {
+        for (int i = 0; i < gpuLatency; i++)
+            gpuFrames[i].pending = false;
+    }
+    gpuEnabled = enabled;
+}
+
+uint64_t Profiler::now()
+{
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+ProfileBuffer* Profiler::threadBuffer()
+{
+    static thread_local ProfileBufferHandle handle;
+    if (!handle.buffer)
+        handle.buffer = acquireBuffer();
+    return handle.buffer;
+}
+
+void Profiler::setThreadName(const std::string& name)
+{
+    ProfileBuffer* buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(mutex);
+    buffer->name = name;
+}
+
+ProfileBuffer* Profiler::acquireBuffer()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int i = 0; i < buffers.size(); i++)
+    {
+        if (!buffers[i]->inUse)
+        {
+            buffers[i]->inUse = true;
+            buffers[i]->depth = 0;
+            return buffers[i];
+        }
+    }
+    ProfileBuffer* buffer = new ProfileBuffer(buffers.size() + 1, eventsPerThread);
+    buffer->inUse = true;
+    buffer->name = "Worker " + std::to_string(buffers.size());
+    buffers.push_back(buffer);
+    return buffer;
+}
+
+void Profiler::releaseBuffer(ProfileBuffer* buffer)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    buffer->inUse = false;
+}
+
+const char* Profiler::typeName(const std::type_info& type)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unordered_map<const std::type_info*, std::string>::iterator it = typeNames.find(&type);
+    if (it != typeNames.end())
+        return it->second.c_str();
+
+    std::string name = type.name();
+#if defined(__GNUG__)
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+    if (status == 0 && demangled)
+        name = demangled;
+    free(demangled);
+#else
+    if (name.compare(0, 6, "class ") == 0)
+        name = name.substr(6);
+    else if (name.compare(0, 7, "struct ") == 0)
+        name = name.substr(7);
+#endif
+    return typeNames.insert(std::make_pair(&type, name)).first->second.c_str();
+}
+
+void Profiler::beginFrame()
+{
+    uint32_t current = frame.load(std::memory_order_relaxed) + 1;
+    frame.store(current, std::memory_order_relaxed);
+
+    FrameRecord& record = frames[current % frameHistory];
+    record.start = now();
+    record.end = 0;
+
+    ProfileBuffer* main = threadBuffer();
+    if (main->name.compare(0, 7, "Worker ") == 0)
+        setThreadName("Main");
+
+    if (!isGpuEnabled())
+        return;
+
+    GpuFrame& gpuFrame = gpuFrames[current % gpuLatency];
+    if (gpuFrame.pending)
+        resolveGpuFrame(gpuFrame);
+
+    gpuFrame.frame = current;
+    gpuFrame.cpuStart = record.start;
+    gpuFrame.usedQueries = 0;
+    gpuFrame.ranges.clear();
+    gpuFrame.startQuery = gpuQuery(gpuFrame);
+    glQueryCounter(gpuFrame.startQuery, GL_TIMESTAMP);
+    gpuFrame.pending = true;
+    gpuDepth = 0;
+}
+
+void Profiler::endFrame()
+{
+    frames[frame.load(std::memory_order_relaxed) % frameHistory].end = now();
+}
+
+unsigned int Profiler::gpuQuery(GpuFrame& gpuFrame)
+{
+    if (gpuFrame.usedQueries == gpuFrame.queries.size())
+    {
+        int grow = std::max(16, (int)gpuFrame.queries.size());
+        gpuFrame.queries.resize(gpuFrame.queries.size() + grow);
+        glGenQueries(grow, &gpuFrame.queries[gpuFrame.usedQueries]);
+    }
+    return gpuFrame.queries[gpuFrame.usedQueries++];
+}
+
+int Profiler::beginGpuRange(const char* name)
+{
+    uint32_t current = frame.load(std::memory_order_relaxed);
+    GpuFrame& gpuFrame = gpuFrames[current % gpuLatency];
+    if (!gpuFrame.pending || gpuFrame.frame != current)
+        return -1;
+
+    GpuRange range;
+    range.name = name;
+    range.beginQuery = gpuQuery(gpuFrame);
+    range.endQuery = 0;
+    range.depth = gpuDepth++;
+    glQueryCounter(range.beginQuery, GL_TIMESTAMP);
+    gpuFrame.ranges.push_back(range);
+    return gpuFrame.ranges.size() - 1;
+}
+
+void Profiler::endGpuRange(int range)
+{
+    GpuFrame& gpuFrame = gpuFrames[frame.load(std::memory_order_relaxed) % gpuLatency];
+    if (range >= gpuFrame.ranges.size())
+        return;
+    gpuFrame.ranges[range].endQuery = gpuQuery(gpuFrame);
+    glQueryCounter(gpuFrame.ranges[range].endQuery, GL_TIMESTAMP);
+    gpuDepth--;
+}
+
+void Profiler::resolveGpuFrame(GpuFrame& gpuFrame)
+{
+    gpuFrame.pending = false;
+    if (gpuFrame.usedQueries == 0)
+        return;
+
+    // gpuLatency frames later the results are normally in, drop the frame otherwise
+    GLint available = 0;
+    glGetQueryObjectiv(gpuFrame.queries[gpuFrame.usedQueries - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return;
+
+    if (!gpuBuffer)
+    {
+        gpuBuffer = new ProfileBuffer(0, eventsPerThread);
+        gpuBuffer->name = "GPU";
+    }
+
+    GLuint64 origin = 0;
+    glGetQueryObjectui64v(gpuFrame.startQuery, GL_QUERY_RESULT, &origin);
+    for (int i = 0; i < gpuFrame.ranges.size(); i++)
+    {
+        const GpuRange& range = gpuFrame.ranges[i];
+        if (range.endQuery == 0)
+            continue;
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(range.beginQuery, GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(range.endQuery, GL_QUERY_RESULT, &end);
+        gpuBuffer->push(range.name, gpuFrame.cpuStart + (begin - origin), gpuFrame.cpuStart + (end - origin), gpuFrame.frame, range.depth);
+    }
+}
+
+bool Profiler::exportChromeTrace(const std::string& filename)
+{
+    FILE* file = fopen(filename.c_str(), "w");
+    if (!file)
+        return false;
+
+    std::vector<ProfileBuffer*> lanes;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        lanes = buffers;
+    }
+    if (gpuBuffer)
+        lanes.push_back(gpuBuffer);
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    std::vector<ProfileEvent> events;
+    for (int i = 0; i < lanes.size(); i++)
+    {
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", lanes[i]->lane, lanes[i]->name.c_str());
+        first = false;
+
+        events.clear();
+        lanes[i]->collectAll(events);
+        for (int j = 0; j < events.size(); j++)
+        {
+            const ProfileEvent& event = events[j];
+            fprintf(file, ",\n{\"name\":\"");
+            for (const char* c = event.name; *c; c++)
+            {
+                if (*c == '"' || *c == '\\')
+                    fputc('\\', file);
+                fputc(*c, file);
+            }
+            fprintf(file, "\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%u}}",
+                    lanes[i]->lane, event.start / 1000.0, (event.end - event.start) / 1000.0, event.frame);
+        }
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    return true;
+}
+
+void Profiler::OnGui()
+{
+    bool isOn = isEnabled();
+    if (ImGui::Checkbox("Enabled", &isOn))
+        setEnabled(isOn);
+    ImGui::SameLine();
+    bool gpuOn = gpuEnabled;
+    if (ImGui::Checkbox("GPU timers", &gpuOn))
+        setGpuEnabled(gpuOn);
+    ImGui::SameLine();
+    static bool exported = false;
+    if (ImGui::Button("Export trace"))
+        exported = exportChromeTrace("profile.json");
+    if (exported)
+    {
+        ImGui::SameLine();
+        ImGui::Text("profile.json");
+    }
+
+    uint32_t current = frame.load(std::memory_order_relaxed);
+    float frameTimes[frameHistory];
+    int count = 0;
+    for (uint32_t i = current > frameHistory ? current - frameHistory + 1 : 1; i < current; i++)
+    {
+        const FrameRecord& record = frames[i % frameHistory];
+        frameTimes[count++] = record.end > record.start ? (record.end - record.start) / 1e6f : 0.0f;
+    }
+    if (count > 0)
+    {
+        char overlay[32];
+        snprintf(overlay, sizeof(overlay), "%.2f ms", frameTimes[count - 1]);
+        ImGui::PlotLines("Frame", frameTimes, count, 0, overlay, 0.0f, 50.0f, ImVec2(0.0f, 60.0f));
+    }
+
+    // GPU results arrive gpuLatency frames late, show a frame that has them
+    uint32_t latency = isGpuEnabled() ? gpuLatency : 1;
+    if (isOn && current > latency)
+        drawTimeline(current - latency);
+}
+
+static ImU32 scopeColor(const char* name)
+{
+    unsigned int hash = 2166136261u;
+    for (const char* c = name; *c; c++)
+        hash = (hash ^ (unsigned char)*c) * 16777619u;
+    return IM_COL32(80 + (hash & 0x7f), 80 + ((hash >> 8) & 0x7f), 80 + ((hash >> 16) & 0x7f), 255);
+}
+
+void Profiler::drawTimeline(uint32_t displayFrame)
+{
+    const FrameRecord& record = frames[displayFrame % frameHistory];
+    if (record.end <= record.start)
+        return;
+
+    std::vector<ProfileBuffer*> lanes;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        lanes = buffers;
+    }
+    if (gpuBuffer && isGpuEnabled())
+        lanes.push_back(gpuBuffer);
+
+    std::vector<std::vector<ProfileEvent> > laneEvents(lanes.size());
+    uint64_t end = record.end;
+    for (int i = 0; i < lanes.size(); i++)
+    {
+        lanes[i]->collect(displayFrame, laneEvents[i]);
+        for (int j = 0; j < laneEvents[i].size(); j++)
+            end = std::max(end, laneEvents[i][j].end);
+    }
+
+    ImGui::Text("Frame %u: %.3f ms", displayFrame, (record.end - record.start) / 1e6);
+
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    float width = std::max(100.0f, ImGui::GetContentRegionAvail().x);
+    float rowHeight = ImGui::GetTextLineHeightWithSpacing();
+    double scale = width / (double)(end - record.start);
+    ImVec2 mouse = ImGui::GetIO().MousePos;
+    float y = origin.y;
+
+    std::map<const char*, std::pair<double, int> > totals;
+    for (int i = 0; i < lanes.size(); i++)
+    {
+        if (laneEvents[i].empty())
+            continue;
+        drawList->AddText(ImVec2(origin.x, y), IM_COL32(255, 255, 255, 255), lanes[i]->name.c_str());
+        y += rowHeight;
+
+        uint32_t maxDepth = 0;
+        for (int j = 0; j < laneEvents[i].size(); j++)
+        {
+            const ProfileEvent& event = laneEvents[i][j];
+            float x0 = origin.x + (float)((double)(event.start - std::min(event.start, record.start)) * scale);
+            float x1 = std::max(x0 + 1.0f, origin.x + (float)((double)(event.end - record.start) * scale));
+            float y0 = y + event.depth * rowHeight;
+            float y1 = y0 + rowHeight - 1.0f;
+            double milliseconds = (event.end - event.start) / 1e6;
+            maxDepth = std::max(maxDepth, event.depth);
+
+            drawList->AddRectFilled(ImVec2(x0, y0), ImVec2(x1, y1), scopeColor(event.name));
+            if (x1 - x0 > ImGui::CalcTextSize(event.name).x + 4.0f)
+                drawList->AddText(ImVec2(x0 + 2.0f, y0), IM_COL32(0, 0, 0, 255), event.name);
+            if (mouse.x >= x0 && mouse.x < x1 && mouse.y >= y0 && mouse.y < y1)
+                ImGui::SetTooltip("%s\n%.3f ms", event.name, milliseconds);
+
+            std::pair<double, int>& total = totals[event.name];
+            total.first += milliseconds;
+            total.second++;
+        }
+        y += (maxDepth + 1) * rowHeight + 4.0f;
+    }
+    ImGui::Dummy(ImVec2(width, y - origin.y));
+
+    // inclusive time per scope name, most expensive first
+    std::vector<std::pair<double, std::pair<const char*, int> > > sorted;
+    for (std::map<const char*, std::pair<double, int> >::iterator it = totals.begin(); it != totals.end(); ++it)
+        sorted.push_back(std::make_pair(it->second.first, std::make_pair(it->first, it->second.second)));
+    std::sort(sorted.rbegin(), sorted.rend());
+    for (int i = 0; i < sorted.size() && i < 16; i++)
+        ImGui::Text("%8.3f ms %5d  %s", sorted[i].first, sorted[i].second.second, sorted[i].second.first);
+}
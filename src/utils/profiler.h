@@ -0,0 +1,206 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+// Hierarchical frame profiler.
+//
+// CPU scopes are recorded into a fixed size ring buffer per thread, so
+// recording never locks and never allocates; a scope costs two clock reads and
+// one store. GPU scopes place GL_TIMESTAMP queries around a pass; results are
+// collected a few frames later so reading them never stalls the pipeline.
+// Everything is off until setEnabled(true), a disabled scope is a single load.
+//
+//   PROFILE_SCOPE("TerrainPatch::tessellate");
+//   PROFILE_SCOPE_TYPE(*shader);          // named after the dynamic type, looked up
+//                                         // every time: cache it for per-frame scopes
+//   PROFILE_GPU_SCOPE("Shadow pass");     // GL context thread only
+//
+// Buffers are read (OnGui, exportChromeTrace) from the main thread between
+// frames, when the worker threads of the previous frame have been joined.
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
+#define PROFILE_SCOPE_TYPE(object) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(Profiler::isEnabled() ? Profiler::typeName(typeid(object)) : nullptr)
+#define PROFILE_GPU_SCOPE(name) GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__)(name)
+#define PROFILE_GPU_SCOPE_TYPE(object) GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__)(Profiler::isGpuEnabled() ? Profiler::typeName(typeid(object)) : nullptr)
+
+struct ProfileEvent {
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+    uint32_t frame;
+    uint32_t depth;
+};
+
+class ProfileBuffer {
+public:
+    ProfileBuffer(int lane, int capacity);
+
+    void push(const char* name, uint64_t start, uint64_t end, uint32_t frame, uint32_t depth){
+        uint64_t index = written.load(std::memory_order_relaxed);
+        ProfileEvent& event = events[index & mask];
+        event.name = name;
+        event.start = start;
+        event.end = end;
+        event.frame = frame;
+        event.depth = depth;
+        written.store(index + 1, std::memory_order_release);
+    }
+
+    // events of one frame, oldest first
+    void collect(uint32_t frame, std::vector<ProfileEvent>& out) const;
+    // every event still in the ring, oldest first
+    void collectAll(std::vector<ProfileEvent>& out) const;
+
+    int lane;
+    uint32_t depth = 0;
+    bool inUse = false;
+    std::string name;
+
+private:
+    std::vector<ProfileEvent> events;
+    uint64_t mask;
+    std::atomic<uint64_t> written;
+};
+
+class Profiler {
+public:
+    static bool isEnabled(){
+        return enabled.load(std::memory_order_relaxed);
+    }
+    static void setEnabled(bool enabled);
+    static bool isGpuEnabled(){
+        return gpuEnabled && isEnabled();
+    }
+    static void setGpuEnabled(bool enabled);
+
+    // frame boundaries, called once per frame on the GL thread
+    static void beginFrame();
+    static void endFrame();
+    static uint32_t getFrame(){
+        return frame.load(std::memory_order_relaxed);
+    }
+
+    // nanoseconds since the profiler was first used
+    static uint64_t now();
+
+    static ProfileBuffer* threadBuffer();
+    static void setThreadName(const std::string& name);
+
+    // stable, readable name of a dynamic type ("PhongShader", not "11PhongShader")
+    static const char* typeName(const std::type_info& type);
+
+    // GPU scopes, return a range index or -1
+    static int beginGpuRange(const char* name);
+    static void endGpuRange(int range);
+
+    static bool exportChromeTrace(const std::string& filename);
+    static void OnGui();
+
+private:
+    struct FrameRecord {
+        uint64_t start = 0;
+        uint64_t end = 0;
+    };
+
+    struct GpuRange {
+        const char* name;
+        unsigned int beginQuery;
+        unsigned int endQuery;
+        uint32_t depth;
+    };
+
+    struct GpuFrame {
+        uint32_t frame = 0;
+        uint64_t cpuStart = 0;
+        unsigned int startQuery = 0;
+        int usedQueries = 0;
+        bool pending = false;
+        std::vector<unsigned int> queries;
+        std::vector<GpuRange> ranges;
+    };
+
+    static const int frameHistory = 256;
+    static const int gpuLatency = 4;
+    static const int eventsPerThread = 1 << 15;
+
+    static std::atomic<bool> enabled;
+    static std::atomic<uint32_t> frame;
+    static bool gpuEnabled;
+    static uint32_t gpuDepth;
+    static std::mutex mutex;
+    static std::vector<ProfileBuffer*> buffers;
+    static ProfileBuffer* gpuBuffer;
+    static FrameRecord frames[frameHistory];
+    static GpuFrame gpuFrames[gpuLatency];
+    static std::unordered_map<const std::type_info*, std::string> typeNames;
+
+    static ProfileBuffer* acquireBuffer();
+    static void releaseBuffer(ProfileBuffer* buffer);
+    static unsigned int gpuQuery(GpuFrame& gpuFrame);
+    static void resolveGpuFrame(GpuFrame& gpuFrame);
+    static void drawTimeline(uint32_t frame);
+
+    friend struct ProfileBufferHandle;
+};
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name){
+        if(name == nullptr || !Profiler::isEnabled()){
+            buffer = nullptr;
+            return;
+        }
+        this->name = name;
+        buffer = Profiler::threadBuffer();
+        depth = buffer->depth++;
+        start = Profiler::now();
+    }
+
+    ~ProfileScope(){
+        if(buffer){
+            uint64_t end = Profiler::now();
+            buffer->depth--;
+            buffer->push(name, start, end, Profiler::getFrame(), depth);
+        }
+    }
+
+private:
+    ProfileBuffer* buffer;
+    const char* name;
+    uint64_t start;
+    uint32_t depth;
+
+    ProfileScope(const ProfileScope&);
+    ProfileScope& operator=(const ProfileScope&);
+};
+
+class GpuProfileScope {
+public:
+    explicit GpuProfileScope(const char* name){
+        range = name != nullptr && Profiler::isGpuEnabled() ? Profiler::beginGpuRange(name) : -1;
+    }
+
+    ~GpuProfileScope(){
+        if(range >= 0){
+            Profiler::endGpuRange(range);
+        }
+    }
+
+private:
+    int range;
+
+    GpuProfileScope(const GpuProfileScope&);
+    GpuProfileScope& operator=(const GpuProfileScope&);
+};
+
+#endif // PROFILER_H
@@ -0,0 +1,109 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+#include "fileHash.h"
+
+// Linked shader programs on disk, so a warm start skips compiling GLSL. GL
+// free so graphics_bench can check it; ShaderManager gets the binaries from
+// glGetProgramBinary and hands them back to glProgramBinary.
+//
+// A binary is only valid for the driver that produced it. The key hashes the
+// driver (GL_RENDERER and GL_VERSION) together with every stage's type and
+// source, and names the file, so a changed shader or a driver update looks
+// for a file that doesn't exist yet and the old ones are just never read
+// again. The key is stored in the file as well, a collision in the name is
+// caught on read. The driver may still reject a binary it wrote (after an
+// update that kept the version string); the caller then compiles from source.
+
+class ProgramCache {
+public:
+    static const uint32_t magic = 0x47525047;  // "GPRG"
+    static const uint32_t version = 1;
+    static const int stageCount = 5;
+
+    // sources in the order Shader::Compile takes them (vertex, fragment, geometry,
+    // tessellation control and evaluation), null for the stages not used
+    static uint64_t getKey(const std::string& driver, const char* const sources[stageCount]){
+        uint64_t hash = FileHash::seed;
+        FileHash::updateBytes(driver.c_str(), driver.size() + 1, hash);
+        for(int stage = 0; stage < stageCount; stage++){
+            // the stage index keeps moving a source to another stage from hashing the same
+            unsigned char present = sources[stage] != nullptr;
+            FileHash::updateBytes(&stage, sizeof(stage), hash);
+            FileHash::updateBytes(&present, 1, hash);
+            if(present){
+                FileHash::updateBytes(sources[stage], strlen(sources[stage]), hash);
+            }
+        }
+        return hash;
+    }
+
+    // <directory>/<key in hex>.bin
+    static std::string getPath(const std::string& directory, uint64_t key){
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+        return directory + "/" + name;
+    }
+
+    // true when it exists afterwards
+    static bool makeDirectory(const std::string& directory){
+        struct stat info;
+        if(stat(directory.c_str(), &info) == 0){
+            return (info.st_mode & S_IFDIR) != 0;
+        }
+#ifdef _WIN32
+        return _mkdir(directory.c_str()) == 0;
+#else
+        return mkdir(directory.c_str(), 0755) == 0;
+#endif
+    }
+
+    // written to a temporary file first, a crash halfway leaves no truncated binary behind
+    static bool write(const std::string& path, uint64_t key, uint32_t format, const std::vector<unsigned char>& binary){
+        std::string temporary = path + ".tmp";
+        FILE* fp = fopen(temporary.c_str(), "wb");
+        if(fp == NULL){
+            return false;
+        }
+        uint32_t header[4] = { magic, version, format, (uint32_t)binary.size() };
+        bool ok = fwrite(header, sizeof(header), 1, fp) == 1 && fwrite(&key, sizeof(key), 1, fp) == 1;
+        ok = ok && (binary.empty() || fwrite(binary.data(), binary.size(), 1, fp) == 1);
+        ok = fclose(fp) == 0 && ok;
+        remove(path.c_str());   // rename doesn't replace on Windows
+        ok = ok && rename(temporary.c_str(), path.c_str()) == 0;
+        if(!ok){
+            remove(temporary.c_str());
+        }
+        return ok;
+    }
+
+    // false when missing, written for another key or malformed
+    static bool read(const std::string& path, uint64_t key, uint32_t& format, std::vector<unsigned char>& binary){
+        FILE* fp = fopen(path.c_str(), "rb");
+        if(fp == NULL){
+            return false;
+        }
+        uint32_t header[4];
+        uint64_t storedKey;
+        bool ok = fread(header, sizeof(header), 1, fp) == 1 && fread(&storedKey, sizeof(storedKey), 1, fp) == 1;
+        ok = ok && header[0] == magic && header[1] == version && storedKey == key && header[3] > 0;
+        if(ok){
+            format = header[2];
+            binary.resize(header[3]);
+            ok = fread(binary.data(), binary.size(), 1, fp) == 1;
+        }
+        fclose(fp);
+        return ok;
+    }
+};
+
+#endif // PROGRAM_CACHE_H
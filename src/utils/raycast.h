@@ -0,0 +1,667 @@
+#ifndef RAYCAST_H
+#define RAYCAST_H
+
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <cfloat>
+#include <glm/glm.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RAYCAST_SSE
+#endif
+
+// CPU ray casting, independent of GL so it runs headless.
+//
+// TriangleBVH: per-mesh BVH in object space. Built top-down with binned SAH,
+// then collapsed into 4-wide nodes whose child boxes are stored SoA so one
+// SSE slab test covers all four children. A deforming mesh is refit: the
+// boxes are recomputed bottom up around the moved triangles, the topology is
+// kept, which stays fast as long as the deformation doesn't tear it apart
+// (blendshapes, skinning).
+// SceneBVH: top-level BVH over mesh instances (mesh + transform). Rays are
+// moved into object space with the instance's inverse transform; the direction
+// is not renormalised, so hit distances stay in world units.
+
+class Ray {
+public:
+    glm::vec3 origin;
+    glm::vec3 direction;
+
+    Ray() : origin(0.0f), direction(0.0f, 0.0f, -1.0f) {}
+    Ray(const glm::vec3& origin, const glm::vec3& direction) : origin(origin), direction(direction) {}
+
+    glm::vec3 at(float t) const {
+        return origin + direction * t;
+    }
+};
+
+struct RayHit {
+    int object = -1;            // SceneBVH instance id
+    int triangle = -1;          // index of the triangle in the mesh's index buffer / 3
+    glm::vec2 barycentrics = glm::vec2(0.0f);  // weights of vertices 1 and 2; vertex 0 gets 1 - u - v
+    float distance = FLT_MAX;   // ray parameter; world units when the ray direction is unit length
+
+    bool isHit() const {
+        return triangle != -1;
+    }
+};
+
+class TriangleBVH {
+public:
+    TriangleBVH() {}
+
+    TriangleBVH(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices){
+        build(positions, indices);
+    }
+
+    void build(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices){
+        this->indices = indices;
+        nodes.clear();
+        leaves.clear();
+        triangles.clear();
+        boundsMin = glm::vec3(FLT_MAX);
+        boundsMax = glm::vec3(-FLT_MAX);
+
+        int count = indices.size() / 3;
+        if(count == 0){
+            return;
+        }
+
+        std::vector<BuildPrimitive> primitives(count);
+        for(int i = 0; i < count; i++){
+            glm::vec3 a = positions[indices[3 * i]];
+            glm::vec3 b = positions[indices[3 * i + 1]];
+            glm::vec3 c = positions[indices[3 * i + 2]];
+            primitives[i].min = glm::min(a, glm::min(b, c));
+            primitives[i].max = glm::max(a, glm::max(b, c));
+            primitives[i].centroid = (primitives[i].min + primitives[i].max) * 0.5f;
+            primitives[i].index = i;
+            boundsMin = glm::min(boundsMin, primitives[i].min);
+            boundsMax = glm::max(boundsMax, primitives[i].max);
+        }
+
+        std::vector<BuildNode> buildNodes;
+        buildNodes.reserve(2 * count);
+        buildNodes.push_back(BuildNode());
+        buildRecursive(buildNodes, primitives, 0, 0, count, 0);
+
+        triangles.resize(count);
+        for(int i = 0; i < count; i++){
+            int t = primitives[i].index;
+            glm::vec3 a = positions[indices[3 * t]];
+            triangles[i].v0 = a;
+            triangles[i].e1 = positions[indices[3 * t + 1]] - a;
+            triangles[i].e2 = positions[indices[3 * t + 2]] - a;
+            triangles[i].index = t;
+        }
+
+        nodes.push_back(Node4());
+        collapse(buildNodes, 0, 0);
+    }
+
+    // positions as passed to build(), moved; same count and order
+    void refit(const std::vector<glm::vec3>& positions){
+        if(triangles.empty()){
+            return;
+        }
+        for(int i = 0; i < triangles.size(); i++){
+            int t = triangles[i].index;
+            glm::vec3 a = positions[indices[3 * t]];
+            triangles[i].v0 = a;
+            triangles[i].e1 = positions[indices[3 * t + 1]] - a;
+            triangles[i].e2 = positions[indices[3 * t + 2]] - a;
+        }
+        // collapse() appends children after their parent, so a reverse walk
+        // sees every child node before the lane that points at it
+        glm::vec3 min, max;
+        for(int n = nodes.size() - 1; n >= 0; n--){
+            Node4& node = nodes[n];
+            for(int i = 0; i < node.count; i++){
+                if(node.child[i] < 0){
+                    leafBounds(leaves[-node.child[i] - 1], positions, min, max);
+                } else {
+                    nodeBounds(nodes[node.child[i]], min, max);
+                }
+                node.minX[i] = min.x; node.minY[i] = min.y; node.minZ[i] = min.z;
+                node.maxX[i] = max.x; node.maxY[i] = max.y; node.maxZ[i] = max.z;
+            }
+        }
+        nodeBounds(nodes[0], boundsMin, boundsMax);
+    }
+
+    bool empty() const {
+        return triangles.empty();
+    }
+
+    int getTriangleCount() const {
+        return triangles.size();
+    }
+
+    glm::vec3 getBoundsMin() const {
+        return boundsMin;
+    }
+
+    glm::vec3 getBoundsMax() const {
+        return boundsMax;
+    }
+
+    // Closest hit with distance < hit.distance; fills triangle, barycentrics and
+    // distance and returns true if one was found. Triangles are double sided.
+    bool intersect(const Ray& ray, RayHit& hit) const {
+        if(triangles.empty()){
+            return false;
+        }
+        glm::vec3 invDir = glm::vec3(1.0f) / ray.direction;
+        bool found = false;
+        int stack[128];
+        int top = 0;
+        stack[top++] = 0;
+
+        while(top > 0){
+            int index = stack[--top];
+            if(index < 0){
+                const Leaf& leaf = leaves[-index - 1];
+                for(int i = leaf.first; i < leaf.first + leaf.count; i++){
+                    found |= intersectTriangle(triangles[i], ray, hit);
+                }
+                continue;
+            }
+
+            const Node4& node = nodes[index];
+            float entry[4];
+            int hitMask = intersectChildren(node, ray.origin, invDir, hit.distance, entry) & ((1 << node.count) - 1);
+            if(hitMask == 0){
+                continue;
+            }
+
+            // push farthest first so the nearest child is popped next
+            int order[4];
+            int n = 0;
+            for(int i = 0; i < 4; i++){
+                if(hitMask & (1 << i)){
+                    int j = n++;
+                    while(j > 0 && entry[order[j - 1]] < entry[i]){
+                        order[j] = order[j - 1];
+                        j--;
+                    }
+                    order[j] = i;
+                }
+            }
+            for(int i = 0; i < n; i++){
+                stack[top++] = node.child[order[i]];
+            }
+        }
+        return found;
+    }
+
+private:
+    struct Triangle {
+        glm::vec3 v0, e1, e2;
+        int index;
+    };
+
+    // child boxes in SoA layout; child[i] >= 0 is a node, < 0 is leaf -child-1.
+    // Only the first count slots are used.
+    struct Node4 {
+        float minX[4], minY[4], minZ[4];
+        float maxX[4], maxY[4], maxZ[4];
+        int child[4];
+        int count;
+    };
+
+    struct Leaf {
+        int first;
+        int count;
+    };
+
+    struct BuildPrimitive {
+        glm::vec3 min, max, centroid;
+        int index;
+    };
+
+    struct BuildNode {
+        glm::vec3 min, max;
+        int left = -1, right = -1;
+        int first = 0, count = 0;
+    };
+
+    std::vector<Node4> nodes;
+    std::vector<Leaf> leaves;
+    std::vector<Triangle> triangles;
+    std::vector<unsigned int> indices;  // the index buffer built from, for refit()
+    glm::vec3 boundsMin, boundsMax;
+
+    static const int maxLeafSize = 4;
+    static const int binCount = 12;
+
+    void leafBounds(const Leaf& leaf, const std::vector<glm::vec3>& positions, glm::vec3& min, glm::vec3& max) const {
+        min = glm::vec3(FLT_MAX);
+        max = glm::vec3(-FLT_MAX);
+        for(int i = leaf.first; i < leaf.first + leaf.count; i++){
+            const unsigned int* corners = &indices[3 * triangles[i].index];
+            for(int c = 0; c < 3; c++){
+                min = glm::min(min, positions[corners[c]]);
+                max = glm::max(max, positions[corners[c]]);
+            }
+        }
+    }
+
+    static void nodeBounds(const Node4& node, glm::vec3& min, glm::vec3& max){
+        min = glm::vec3(FLT_MAX);
+        max = glm::vec3(-FLT_MAX);
+        for(int i = 0; i < node.count; i++){
+            min = glm::min(min, glm::vec3(node.minX[i], node.minY[i], node.minZ[i]));
+            max = glm::max(max, glm::vec3(node.maxX[i], node.maxY[i], node.maxZ[i]));
+        }
+    }
+
+    static float area(const glm::vec3& min, const glm::vec3& max){
+        glm::vec3 e = glm::max(max - min, glm::vec3(0.0f));
+        return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+    }
+
+    void buildRecursive(std::vector<BuildNode>& buildNodes, std::vector<BuildPrimitive>& primitives, int nodeIndex, int first, int last, int depth){
+        glm::vec3 min(FLT_MAX), max(-FLT_MAX), cmin(FLT_MAX), cmax(-FLT_MAX);
+        for(int i = first; i < last; i++){
+            min = glm::min(min, primitives[i].min);
+            max = glm::max(max, primitives[i].max);
+            cmin = glm::min(cmin, primitives[i].centroid);
+            cmax = glm::max(cmax, primitives[i].centroid);
+        }
+        buildNodes[nodeIndex].min = min;
+        buildNodes[nodeIndex].max = max;
+
+        int count = last - first;
+        // the depth cap keeps the 4-wide tree well inside the traversal stack
+        if(count <= maxLeafSize || depth >= 40){
+            buildNodes[nodeIndex].first = first;
+            buildNodes[nodeIndex].count = count;
+            return;
+        }
+
+        // binned SAH over the longest centroid axis
+        glm::vec3 extent = cmax - cmin;
+        int axis = 0;
+        if(extent.y > extent[axis]) axis = 1;
+        if(extent.z > extent[axis]) axis = 2;
+
+        // stays at first unless the SAH finds a split worth making, so the
+        // median split below partitions the primitives in every other case
+        int mid = first;
+        if(extent[axis] > 0.0f){
+            glm::vec3 binMin[binCount], binMax[binCount];
+            int binPrimitives[binCount];
+            for(int b = 0; b < binCount; b++){
+                binMin[b] = glm::vec3(FLT_MAX);
+                binMax[b] = glm::vec3(-FLT_MAX);
+                binPrimitives[b] = 0;
+            }
+            float scale = binCount / extent[axis];
+            for(int i = first; i < last; i++){
+                int b = std::min(binCount - 1, (int)((primitives[i].centroid[axis] - cmin[axis]) * scale));
+                binMin[b] = glm::min(binMin[b], primitives[i].min);
+                binMax[b] = glm::max(binMax[b], primitives[i].max);
+                binPrimitives[b]++;
+            }
+
+            // sweep from the right to get suffix areas, then from the left
+            float rightArea[binCount];
+            int rightCount[binCount];
+            glm::vec3 rmin(FLT_MAX), rmax(-FLT_MAX);
+            int rc = 0;
+            for(int b = binCount - 1; b > 0; b--){
+                rmin = glm::min(rmin, binMin[b]);
+                rmax = glm::max(rmax, binMax[b]);
+                rc += binPrimitives[b];
+                rightArea[b] = area(rmin, rmax);
+                rightCount[b] = rc;
+            }
+
+            float bestCost = FLT_MAX;
+            int bestSplit = -1;
+            glm::vec3 lmin(FLT_MAX), lmax(-FLT_MAX);
+            int lc = 0;
+            for(int b = 0; b < binCount - 1; b++){
+                lmin = glm::min(lmin, binMin[b]);
+                lmax = glm::max(lmax, binMax[b]);
+                lc += binPrimitives[b];
+                if(lc == 0 || rightCount[b + 1] == 0){
+                    continue;
+                }
+                float cost = lc * area(lmin, lmax) + rightCount[b + 1] * rightArea[b + 1];
+                if(cost < bestCost){
+                    bestCost = cost;
+                    bestSplit = b;
+                }
+            }
+
+            float leafCost = count * area(min, max);
+            if(bestSplit != -1 && bestCost < leafCost){
+                float splitPosition = cmin[axis] + (bestSplit + 1) / scale;
+                BuildPrimitive* split = std::partition(&primitives[first], &primitives[0] + last,
+                    [axis, splitPosition](const BuildPrimitive& p){ return p.centroid[axis] < splitPosition; });
+                mid = split - &primitives[0];
+            }
+        }
+
+        if(mid == first || mid == last){
+            mid = first + count / 2;
+            std::nth_element(primitives.begin() + first, primitives.begin() + mid, primitives.begin() + last,
+                [axis](const BuildPrimitive& a, const BuildPrimitive& b){ return a.centroid[axis] < b.centroid[axis]; });
+        }
+
+        int left = buildNodes.size();
+        buildNodes[nodeIndex].left = left;
+        buildNodes[nodeIndex].right = left + 1;
+        buildNodes.push_back(BuildNode());
+        buildNodes.push_back(BuildNode());
+        buildRecursive(buildNodes, primitives, left, first, mid, depth + 1);
+        buildRecursive(buildNodes, primitives, left + 1, mid, last, depth + 1);
+    }
+
+    // Pulls grandchildren up until a node has up to four children, largest
+    // surface area first.
+    void collapse(const std::vector<BuildNode>& buildNodes, int buildIndex, int nodeIndex){
+        int children[4];
+        int count = 0;
+        const BuildNode& root = buildNodes[buildIndex];
+        if(root.left == -1){
+            children[count++] = buildIndex;
+        } else {
+            children[count++] = root.left;
+            children[count++] = root.right;
+        }
+
+        while(count < 4){
+            int best = -1;
+            float bestArea = -1.0f;
+            for(int i = 0; i < count; i++){
+                const BuildNode& b = buildNodes[children[i]];
+                if(b.left != -1 && area(b.min, b.max) > bestArea){
+                    bestArea = area(b.min, b.max);
+                    best = i;
+                }
+            }
+            if(best == -1){
+                break;
+            }
+            int expanded = children[best];
+            children[best] = buildNodes[expanded].left;
+            children[count++] = buildNodes[expanded].right;
+        }
+
+        nodes[nodeIndex].count = count;
+        for(int i = 0; i < 4; i++){
+            Node4& node = nodes[nodeIndex];
+            if(i >= count){
+                // keep unused lanes finite, they are masked off by count
+                node.minX[i] = node.minY[i] = node.minZ[i] = 0.0f;
+                node.maxX[i] = node.maxY[i] = node.maxZ[i] = 0.0f;
+                node.child[i] = 0;
+                continue;
+            }
+            const BuildNode& b = buildNodes[children[i]];
+            node.minX[i] = b.min.x; node.minY[i] = b.min.y; node.minZ[i] = b.min.z;
+            node.maxX[i] = b.max.x; node.maxY[i] = b.max.y; node.maxZ[i] = b.max.z;
+
+            if(b.left == -1){
+                Leaf leaf = { b.first, b.count };
+                leaves.push_back(leaf);
+                node.child[i] = -(int)leaves.size();
+            } else {
+                int childIndex = nodes.size();
+                nodes[nodeIndex].child[i] = childIndex;
+                nodes.push_back(Node4());
+                collapse(buildNodes, children[i], childIndex);
+            }
+        }
+    }
+
+    // slab test of the ray against the four child boxes; returns a bit mask of
+    // hits and their entry distances
+    static int intersectChildren(const Node4& node, const glm::vec3& origin, const glm::vec3& invDir, float tMax, float* entry){
+#ifdef RAYCAST_SSE
+        const __m128 ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y), oz = _mm_set1_ps(origin.z);
+        const __m128 ix = _mm_set1_ps(invDir.x), iy = _mm_set1_ps(invDir.y), iz = _mm_set1_ps(invDir.z);
+
+        __m128 t0x = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minX), ox), ix);
+        __m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxX), ox), ix);
+        __m128 t0y = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minY), oy), iy);
+        __m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxY), oy), iy);
+        __m128 t0z = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minZ), oz), iz);
+        __m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxZ), oz), iz);
+
+        __m128 tNear = _mm_max_ps(_mm_max_ps(_mm_min_ps(t0x, t1x), _mm_min_ps(t0y, t1y)), _mm_max_ps(_mm_min_ps(t0z, t1z), _mm_setzero_ps()));
+        __m128 tFar = _mm_min_ps(_mm_min_ps(_mm_max_ps(t0x, t1x), _mm_max_ps(t0y, t1y)), _mm_min_ps(_mm_max_ps(t0z, t1z), _mm_set1_ps(tMax)));
+
+        _mm_storeu_ps(entry, tNear);
+        return _mm_movemask_ps(_mm_cmple_ps(tNear, tFar));
+#else
+        int mask = 0;
+        for(int i = 0; i < 4; i++){
+            float t0x = (node.minX[i] - origin.x) * invDir.x, t1x = (node.maxX[i] - origin.x) * invDir.x;
+            float t0y = (node.minY[i] - origin.y) * invDir.y, t1y = (node.maxY[i] - origin.y) * invDir.y;
+            float t0z = (node.minZ[i] - origin.z) * invDir.z, t1z = (node.maxZ[i] - origin.z) * invDir.z;
+            float tNear = std::max(std::max(std::min(t0x, t1x), std::min(t0y, t1y)), std::max(std::min(t0z, t1z), 0.0f));
+            float tFar = std::min(std::min(std::max(t0x, t1x), std::max(t0y, t1y)), std::min(std::max(t0z, t1z), tMax));
+            entry[i] = tNear;
+            if(tNear <= tFar){
+                mask |= 1 << i;
+            }
+        }
+        return mask;
+#endif
+    }
+
+    // Moller-Trumbore
+    static bool intersectTriangle(const Triangle& tri, const Ray& ray, RayHit& hit){
+        glm::vec3 p = glm::cross(ray.direction, tri.e2);
+        float det = glm::dot(tri.e1, p);
+        if(std::fabs(det) < 1e-12f){
+            return false;
+        }
+        float invDet = 1.0f / det;
+        glm::vec3 s = ray.origin - tri.v0;
+        float u = glm::dot(s, p) * invDet;
+        if(u < 0.0f || u > 1.0f){
+            return false;
+        }
+        glm::vec3 q = glm::cross(s, tri.e1);
+        float v = glm::dot(ray.direction, q) * invDet;
+        if(v < 0.0f || u + v > 1.0f){
+            return false;
+        }
+        float t = glm::dot(tri.e2, q) * invDet;
+        if(t < 0.0f || t >= hit.distance){
+            return false;
+        }
+        hit.distance = t;
+        hit.triangle = tri.index;
+        hit.barycentrics = glm::vec2(u, v);
+        return true;
+    }
+};
+
+// Top-level BVH over mesh instances. Rebuild (or refit by calling build again)
+// when instance transforms change; it only holds one box per instance.
+class SceneBVH {
+public:
+    void clear(){
+        instances.clear();
+        nodes.clear();
+    }
+
+    void add(const TriangleBVH* mesh, const glm::mat4& transform, int id){
+        if(mesh == nullptr || mesh->empty()){
+            return;
+        }
+        Instance instance;
+        instance.mesh = mesh;
+        instance.transform = transform;
+        instance.inverse = glm::inverse(transform);
+        instance.id = id;
+
+        // world box from the eight transformed corners of the mesh box
+        glm::vec3 lo = mesh->getBoundsMin();
+        glm::vec3 hi = mesh->getBoundsMax();
+        instance.min = glm::vec3(FLT_MAX);
+        instance.max = glm::vec3(-FLT_MAX);
+        for(int i = 0; i < 8; i++){
+            glm::vec3 corner((i & 1) ? hi.x : lo.x, (i & 2) ? hi.y : lo.y, (i & 4) ? hi.z : lo.z);
+            glm::vec3 world = glm::vec3(transform * glm::vec4(corner, 1.0f));
+            instance.min = glm::min(instance.min, world);
+            instance.max = glm::max(instance.max, world);
+        }
+        instances.push_back(instance);
+    }
+
+    void build(){
+        nodes.clear();
+        order.resize(instances.size());
+        for(int i = 0; i < order.size(); i++){
+            order[i] = i;
+        }
+        if(instances.empty()){
+            return;
+        }
+        nodes.push_back(Node());
+        buildRecursive(0, 0, instances.size());
+    }
+
+    int size() const {
+        return instances.size();
+    }
+
+    bool intersect(const Ray& ray, RayHit& hit) const {
+        if(nodes.empty()){
+            return false;
+        }
+        glm::vec3 invDir = glm::vec3(1.0f) / ray.direction;
+        bool found = false;
+        int stack[64];
+        int top = 0;
+        stack[top++] = 0;
+
+        while(top > 0){
+            const Node& node = nodes[stack[--top]];
+            if(!hitsBox(node.min, node.max, ray.origin, invDir, hit.distance)){
+                continue;
+            }
+            if(node.count > 0){
+                for(int i = node.first; i < node.first + node.count; i++){
+                    const Instance& instance = instances[order[i]];
+                    Ray local(glm::vec3(instance.inverse * glm::vec4(ray.origin, 1.0f)), glm::vec3(instance.inverse * glm::vec4(ray.direction, 0.0f)));
+                    if(instance.mesh->intersect(local, hit)){
+                        hit.object = instance.id;
+                        found = true;
+                    }
+                }
+                continue;
+            }
+            stack[top++] = node.first;
+            stack[top++] = node.first + 1;
+        }
+        return found;
+    }
+
+    // hits[i] receives the closest hit of rays[i]
+    void intersect(const std::vector<Ray>& rays, std::vector<RayHit>& hits, int numThreads = 0) const {
+        hits.assign(rays.size(), RayHit());
+        int count = rays.size();
+        if(numThreads <= 0){
+            numThreads = std::thread::hardware_concurrency();
+        }
+        const int minRaysPerThread = 256;
+        numThreads = std::max(1, std::min(numThreads, count / minRaysPerThread));
+
+        if(numThreads == 1){
+            intersectRange(rays, hits, 0, count);
+            return;
+        }
+        std::vector<std::thread> workers;
+        int perThread = (count + numThreads - 1) / numThreads;
+        for(int i = 0; i < numThreads; i++){
+            int first = i * perThread;
+            int last = std::min(first + perThread, count);
+            if(first >= last){
+                break;
+            }
+            workers.push_back(std::thread(&SceneBVH::intersectRange, this, std::cref(rays), std::ref(hits), first, last));
+        }
+        for(int i = 0; i < workers.size(); i++){
+            workers[i].join();
+        }
+    }
+
+private:
+    struct Instance {
+        const TriangleBVH* mesh;
+        glm::mat4 transform;
+        glm::mat4 inverse;
+        glm::vec3 min, max;
+        int id;
+    };
+
+    struct Node {
+        glm::vec3 min, max;
+        int first;  // leaf: first entry in order, inner: left child (right is first + 1)
+        int count;  // 0 for inner nodes
+    };
+
+    std::vector<Instance> instances;
+    std::vector<int> order;
+    std::vector<Node> nodes;
+
+    void buildRecursive(int nodeIndex, int first, int last){
+        glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+        for(int i = first; i < last; i++){
+            min = glm::min(min, instances[order[i]].min);
+            max = glm::max(max, instances[order[i]].max);
+        }
+        nodes[nodeIndex].min = min;
+        nodes[nodeIndex].max = max;
+
+        if(last - first <= 2){
+            nodes[nodeIndex].first = first;
+            nodes[nodeIndex].count = last - first;
+            return;
+        }
+
+        glm::vec3 extent = max - min;
+        int axis = 0;
+        if(extent.y > extent[axis]) axis = 1;
+        if(extent.z > extent[axis]) axis = 2;
+        int mid = (first + last) / 2;
+        const std::vector<Instance>& all = instances;
+        std::nth_element(order.begin() + first, order.begin() + mid, order.begin() + last,
+            [&all, axis](int a, int b){ return all[a].min[axis] + all[a].max[axis] < all[b].min[axis] + all[b].max[axis]; });
+
+        int left = nodes.size();
+        nodes[nodeIndex].first = left;
+        nodes[nodeIndex].count = 0;
+        nodes.push_back(Node());
+        nodes.push_back(Node());
+        buildRecursive(left, first, mid);
+        buildRecursive(left + 1, mid, last);
+    }
+
+    static bool hitsBox(const glm::vec3& min, const glm::vec3& max, const glm::vec3& origin, const glm::vec3& invDir, float tMax){
+        glm::vec3 t0 = (min - origin) * invDir;
+        glm::vec3 t1 = (max - origin) * invDir;
+        glm::vec3 tmin = glm::min(t0, t1);
+        glm::vec3 tmax = glm::max(t0, t1);
+        float tNear = std::max(std::max(tmin.x, tmin.y), std::max(tmin.z, 0.0f));
+        float tFar = std::min(std::min(tmax.x, tmax.y), std::min(tmax.z, tMax));
+        return tNear <= tFar;
+    }
+
+    void intersectRange(const std::vector<Ray>& rays, std::vector<RayHit>& hits, int first, int last) const {
+        for(int i = first; i < last; i++){
+            intersect(rays[i], hits[i]);
+        }
+    }
+};
+
+#endif // RAYCAST_H
@@ -0,0 +1,379 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include <vector>
+#include <queue>
+#include <functional>
+#include <algorithm>
+
+// The frame as a graph of passes over render targets. GL free: compile() only
+// decides what runs, in which order, on which physical target and after which
+// barrier, so graphics_bench can check and time it. RenderGraphExecutor
+// (shaders/renderGraph/renderGraphExecutor.h) runs the result on the GPU.
+//
+// Passes declare what they read and write. Accesses are ordered as the passes
+// were added: a read depends on the last write before it, a write on the
+// last write and every read since (so a later pass never overwrites what an
+// earlier one still needs). addDependency() adds edges the resources don't
+// express, in any direction, and compile() fails on a cycle.
+//
+// compile():
+//   culling     a pass runs when it has a side effect, writes an imported
+//               resource (the backbuffer, the shadow map) or writes what a
+//               running pass reads or writes after it; everything else is
+//               skipped
+//   order       Kahn's sort of the running passes, the earliest added first
+//               among those ready, so a graph without extra dependencies runs
+//               in the order it was built
+//   aliasing    transient targets live from their first to their last use in
+//               that order; one whose lifetime starts after another's ended
+//               reuses its physical target when the descriptions match. The
+//               content of a reused target is undefined, passes clear what
+//               they write first
+//   barriers    the first pass to use a resource a certain way after another
+//               pass wrote it gets a barrier, with the usages on both sides
+//
+// Imported resources belong to someone else: they are never aliased and their
+// passes bind them themselves.
+
+enum RenderGraphUsage {
+    USAGE_COLOR_ATTACHMENT,
+    USAGE_DEPTH_ATTACHMENT,
+    USAGE_SAMPLED,          // read as a texture
+    USAGE_STORAGE           // image load/store or a buffer written by a shader
+};
+
+// format is the GL internal format, only compared here
+struct RenderTargetDesc {
+    int width = 0;
+    int height = 0;
+    unsigned int format = 0;
+
+    RenderTargetDesc() {}
+    RenderTargetDesc(int width, int height, unsigned int format) : width(width), height(height), format(format) {}
+
+    bool operator==(const RenderTargetDesc& other) const {
+        return width == other.width && height == other.height && format == other.format;
+    }
+};
+
+struct RenderGraphAccess {
+    int resource;
+    RenderGraphUsage usage;
+    bool write;
+};
+
+struct RenderGraphBarrier {
+    int resource;
+    RenderGraphUsage before; // how the last pass to write it used it
+    RenderGraphUsage after;
+};
+
+class RenderGraph {
+public:
+    typedef std::function<void()> Execute;
+
+    // for the next frame's graph, the arrays keep their capacity
+    void reset(){
+        passes.clear();
+        resources.clear();
+        order.clear();
+        physicalTargets.clear();
+        compiled = false;
+    }
+
+    int importResource(const char* name){
+        Resource resource;
+        resource.name = name;
+        resource.imported = true;
+        resources.push_back(resource);
+        return resources.size() - 1;
+    }
+
+    int createTarget(const char* name, const RenderTargetDesc& desc){
+        Resource resource;
+        resource.name = name;
+        resource.desc = desc;
+        resources.push_back(resource);
+        return resources.size() - 1;
+    }
+
+    int addPass(const char* name, Execute execute = Execute()){
+        passes.push_back(Pass());
+        passes.back().name = name;
+        passes.back().execute = execute;
+        return passes.size() - 1;
+    }
+
+    void read(int pass, int resource, RenderGraphUsage usage = USAGE_SAMPLED){
+        RenderGraphAccess access = { resource, usage, false };
+        passes[pass].accesses.push_back(access);
+    }
+
+    void write(int pass, int resource, RenderGraphUsage usage = USAGE_COLOR_ATTACHMENT){
+        RenderGraphAccess access = { resource, usage, true };
+        passes[pass].accesses.push_back(access);
+    }
+
+    // before runs ahead of after, whatever they access
+    void addDependency(int before, int after){
+        passes[before].successors.push_back(after);
+    }
+
+    // kept even when nothing reads what it writes (readbacks, queries)
+    void setSideEffect(int pass){
+        passes[pass].sideEffect = true;
+    }
+
+    // false on a dependency cycle, nothing runs then
+    bool compile(){
+        compiled = false;
+        order.clear();
+        physicalTargets.clear();
+        for(Resource& resource : resources){
+            resource.physical = -1;
+            resource.firstUse = -1;
+            resource.lastUse = -1;
+        }
+        addResourceDependencies();
+        cull();
+        if(!sort()){
+            order.clear();
+            return false;
+        }
+        assignTargets();
+        placeBarriers();
+        compiled = true;
+        return true;
+    }
+
+    bool isCompiled() const { return compiled; }
+    const std::vector<int>& getOrder() const { return order; }
+    int getPassCount() const { return passes.size(); }
+    int getResourceCount() const { return resources.size(); }
+    const char* getPassName(int pass) const { return passes[pass].name; }
+    const char* getResourceName(int resource) const { return resources[resource].name; }
+    bool isCulled(int pass) const { return !passes[pass].needed; }
+    bool isImported(int resource) const { return resources[resource].imported; }
+    const RenderTargetDesc& getDesc(int resource) const { return resources[resource].desc; }
+    const std::vector<RenderGraphAccess>& getAccesses(int pass) const { return passes[pass].accesses; }
+    const std::vector<RenderGraphBarrier>& getBarriers(int pass) const { return passes[pass].barriers; }
+    const Execute& getExecute(int pass) const { return passes[pass].execute; }
+
+    // the physical target of a transient resource, -1 when imported or unused
+    int getPhysical(int resource) const { return resources[resource].physical; }
+    const std::vector<RenderTargetDesc>& getPhysicalTargets() const { return physicalTargets; }
+
+    // transient resources some running pass uses
+    int getUsedTargetCount() const {
+        int count = 0;
+        for(const Resource& resource : resources){
+            count += resource.physical >= 0;
+        }
+        return count;
+    }
+
+private:
+    struct Pass {
+        const char* name = "";
+        Execute execute;
+        std::vector<RenderGraphAccess> accesses;
+        std::vector<int> successors;    // addDependency() edges
+        std::vector<int> dependencies;  // resource edges, passes this one waits for
+        std::vector<int> producers;     // the ones of those that wrote what it uses
+        std::vector<RenderGraphBarrier> barriers;
+        bool sideEffect = false;
+        bool needed = false;
+    };
+
+    struct Resource {
+        const char* name = "";
+        RenderTargetDesc desc;
+        bool imported = false;
+        int physical = -1;
+        int firstUse = -1;  // positions in order
+        int lastUse = -1;
+        // while building the edges
+        int lastWriter = -1;
+        std::vector<int> readers;
+    };
+
+    std::vector<Pass> passes;
+    std::vector<Resource> resources;
+    std::vector<int> order;
+    std::vector<RenderTargetDesc> physicalTargets;
+    bool compiled = false;
+
+    void addResourceDependencies(){
+        for(Resource& resource : resources){
+            resource.lastWriter = -1;
+            resource.readers.clear();
+        }
+        for(int p = 0; p < (int)passes.size(); p++){
+            Pass& pass = passes[p];
+            pass.dependencies.clear();
+            pass.producers.clear();
+            for(const RenderGraphAccess& access : pass.accesses){
+                Resource& resource = resources[access.resource];
+                if(resource.lastWriter >= 0 && resource.lastWriter != p){
+                    pass.dependencies.push_back(resource.lastWriter);
+                    pass.producers.push_back(resource.lastWriter);
+                }
+                if(!access.write){
+                    resource.readers.push_back(p);
+                    continue;
+                }
+                for(int reader : resource.readers){
+                    if(reader != p){
+                        pass.dependencies.push_back(reader);
+                    }
+                }
+                resource.readers.clear();
+                resource.lastWriter = p;
+            }
+        }
+    }
+
+    // a pass is needed by its side effects or by a needed pass using what it wrote,
+    // reads it only has to wait for don't count
+    void cull(){
+        std::vector<int> stack;
+        for(int p = 0; p < (int)passes.size(); p++){
+            Pass& pass = passes[p];
+            pass.needed = pass.sideEffect;
+            for(const RenderGraphAccess& access : pass.accesses){
+                pass.needed = pass.needed || (access.write && resources[access.resource].imported);
+            }
+            if(pass.needed){
+                stack.push_back(p);
+            }
+        }
+        // explicit edges point forward, walk them backwards too
+        std::vector<std::vector<int> > predecessors(passes.size());
+        for(int p = 0; p < (int)passes.size(); p++){
+            for(int successor : passes[p].successors){
+                predecessors[successor].push_back(p);
+            }
+        }
+        while(!stack.empty()){
+            int p = stack.back();
+            stack.pop_back();
+            const std::vector<int>* lists[2] = { &passes[p].producers, &predecessors[p] };
+            for(int l = 0; l < 2; l++){
+                for(int dependency : *lists[l]){
+                    if(!passes[dependency].needed){
+                        passes[dependency].needed = true;
+                        stack.push_back(dependency);
+                    }
+                }
+            }
+        }
+    }
+
+    bool sort(){
+        std::vector<std::vector<int> > successors(passes.size());
+        std::vector<int> waiting(passes.size(), 0);
+        for(int p = 0; p < (int)passes.size(); p++){
+            if(!passes[p].needed){
+                continue;
+            }
+            for(int dependency : passes[p].dependencies){
+                successors[dependency].push_back(p);
+                waiting[p]++;
+            }
+            for(int successor : passes[p].successors){
+                if(passes[successor].needed){
+                    successors[p].push_back(successor);
+                    waiting[successor]++;
+                }
+            }
+        }
+        std::priority_queue<int, std::vector<int>, std::greater<int> > ready;
+        int needed = 0;
+        for(int p = 0; p < (int)passes.size(); p++){
+            if(passes[p].needed){
+                needed++;
+                if(waiting[p] == 0){
+                    ready.push(p);
+                }
+            }
+        }
+        while(!ready.empty()){
+            int p = ready.top();
+            ready.pop();
+            order.push_back(p);
+            for(int successor : successors[p]){
+                if(--waiting[successor] == 0){
+                    ready.push(successor);
+                }
+            }
+        }
+        return (int)order.size() == needed;
+    }
+
+    void assignTargets(){
+        for(int i = 0; i < (int)order.size(); i++){
+            for(const RenderGraphAccess& access : passes[order[i]].accesses){
+                Resource& resource = resources[access.resource];
+                if(resource.firstUse < 0){
+                    resource.firstUse = i;
+                }
+                resource.lastUse = i;
+            }
+        }
+
+        std::vector<int> transient;
+        for(int r = 0; r < (int)resources.size(); r++){
+            if(!resources[r].imported && resources[r].firstUse >= 0){
+                transient.push_back(r);
+            }
+        }
+        std::stable_sort(transient.begin(), transient.end(), [this](int a, int b){
+            return resources[a].firstUse < resources[b].firstUse;
+        });
+
+        // the position after which each physical target is free again
+        std::vector<int> freeAfter;
+        for(int r : transient){
+            Resource& resource = resources[r];
+            for(int t = 0; t < (int)physicalTargets.size(); t++){
+                if(freeAfter[t] < resource.firstUse && physicalTargets[t] == resource.desc){
+                    resource.physical = t;
+                    break;
+                }
+            }
+            if(resource.physical < 0){
+                resource.physical = physicalTargets.size();
+                physicalTargets.push_back(resource.desc);
+                freeAfter.push_back(-1);
+            }
+            freeAfter[resource.physical] = resource.lastUse;
+        }
+    }
+
+    void placeBarriers(){
+        std::vector<int> lastWrite(resources.size(), -1);   // usage of the last write
+        std::vector<unsigned int> synced(resources.size(), 0); // usages with a barrier since
+        for(int p : order){
+            Pass& pass = passes[p];
+            pass.barriers.clear();
+            for(const RenderGraphAccess& access : pass.accesses){
+                unsigned int bit = 1u << access.usage;
+                if(lastWrite[access.resource] >= 0 && !(synced[access.resource] & bit)){
+                    RenderGraphBarrier barrier = { access.resource, (RenderGraphUsage)lastWrite[access.resource], access.usage };
+                    pass.barriers.push_back(barrier);
+                    synced[access.resource] |= bit;
+                }
+            }
+            // within a pass its own writes need no barrier
+            for(const RenderGraphAccess& access : pass.accesses){
+                if(access.write){
+                    lastWrite[access.resource] = access.usage;
+                    synced[access.resource] = 0;
+                }
+            }
+        }
+    }
+};
+
+#endif // RENDER_GRAPH_H
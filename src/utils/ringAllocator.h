@@ -0,0 +1,181 @@
+#ifndef RING_ALLOCATOR_H
+#define RING_ALLOCATOR_H
+
+#include <deque>
+#include <cstddef>
+#include <iostream>
+
+// Per frame vertex data (terrain tessellations, blend shape and skinning
+// results) written by the CPU straight into GPU visible memory, GL free so
+// graphics_bench can drive it with a fake backend.
+//
+// Allocations are carved one after the other out of a ring of capacity bytes.
+// endFrame() fences what the frame allocated; a later allocation that would
+// reach into a fenced range still in use by the GPU waits for that fence.
+// Sized for three frames of data that wait never happens, the GPU is at most
+// two frames behind. Positions are kept as ever growing virtual offsets, the
+// physical offset is their remainder, so "still in use" is one comparison
+// against the oldest fenced range. An allocation that doesn't fit before the
+// end of the ring skips the rest of it.
+//
+// A backend that can orphan (re-specify the storage, the driver keeps the old
+// one alive for the draws using it) does that instead of waiting. Allocations
+// are only valid in the frame they were made in: the ring reuses them.
+
+typedef unsigned long long RingFence;
+
+class RingBackend {
+public:
+    virtual ~RingBackend() {}
+
+    // the storage, returns its persistently mapped memory or nullptr when
+    // ranges are mapped one write at a time
+    virtual unsigned char* create(size_t size) = 0;
+    // only without persistent memory; one range is mapped at a time
+    virtual unsigned char* mapRange(size_t offset, size_t size) = 0;
+    virtual void unmapRange() = 0;
+
+    virtual RingFence insertFence() = 0;
+    // true once the GPU passed the fence, waiting for it when block
+    virtual bool waitFence(RingFence fence, bool block) = 0;
+    virtual void deleteFence(RingFence fence) = 0;
+
+    virtual bool canOrphan() const { return false; }
+    virtual void orphan() {}
+};
+
+struct RingAllocation {
+    unsigned char* data = nullptr;  // null when the allocation failed
+    size_t offset = 0;              // into the backend's buffer
+    size_t size = 0;
+};
+
+class RingAllocator {
+public:
+    // takes ownership of backend
+    RingAllocator(RingBackend* backend, size_t capacity, size_t alignment = 64) {
+        this->backend = backend;
+        this->capacity = capacity;
+        this->alignment = alignment;
+        memory = backend->create(capacity);
+    }
+
+    ~RingAllocator() {
+        for(const Region& region : regions){
+            backend->deleteFence(region.fence);
+        }
+        delete backend;
+    }
+
+    // write size bytes to data, then commit() them before drawing
+    RingAllocation allocate(size_t size) {
+        RingAllocation allocation;
+        if(size == 0 || size > capacity){
+            std::cerr << "Ring allocation of " << size << " bytes does not fit a " << capacity << " byte ring" << std::endl;
+            return allocation;
+        }
+        unsigned long long position = skipEnd(align(head), size);
+        while(position + size > getTail() + capacity){
+            // done without waiting, most of the time
+            if(!regions.empty() && backend->waitFence(regions.front().fence, false)){
+                retire();
+                continue;
+            }
+            if(backend->canOrphan()){
+                backend->orphan();
+                orphans++;
+                while(!regions.empty()){
+                    backend->deleteFence(regions.front().fence);
+                    regions.pop_front();
+                }
+                // this frame's earlier allocations stay in the old storage
+                position = skipEnd(position, capacity);
+                frameBegin = position;
+                break;
+            }
+            if(regions.empty()){
+                std::cerr << "One frame allocated more than the " << capacity << " byte ring" << std::endl;
+                return allocation;
+            }
+            backend->waitFence(regions.front().fence, true);
+            waits++;
+            retire();
+        }
+
+        allocation.offset = (size_t)(position % capacity);
+        allocation.size = size;
+        allocation.data = memory != nullptr ? memory + allocation.offset : backend->mapRange(allocation.offset, size);
+        head = position + size;
+        frameBytes += size;
+        return allocation;
+    }
+
+    void commit(const RingAllocation& allocation) {
+        if(memory == nullptr && allocation.data != nullptr){
+            backend->unmapRange();
+        }
+    }
+
+    // fences this frame's allocations and drops the fences already passed
+    void endFrame() {
+        while(!regions.empty() && backend->waitFence(regions.front().fence, false)){
+            retire();
+        }
+        if(head > frameBegin){
+            Region region = { backend->insertFence(), frameBegin, head };
+            regions.push_back(region);
+            frameBegin = head;
+        }
+        lastFrameBytes = frameBytes;
+        frameBytes = 0;
+    }
+
+    bool isPersistent() const { return memory != nullptr; }
+    size_t getCapacity() const { return capacity; }
+    size_t getLastFrameBytes() const { return lastFrameBytes; }
+    int getFencesInFlight() const { return regions.size(); }
+    unsigned long long getWaits() const { return waits; }
+    unsigned long long getOrphans() const { return orphans; }
+    RingBackend* getBackend() { return backend; }
+
+private:
+    struct Region {
+        RingFence fence;
+        unsigned long long begin;   // virtual offsets
+        unsigned long long end;
+    };
+
+    RingBackend* backend;
+    unsigned char* memory;
+    size_t capacity;
+    size_t alignment;
+    std::deque<Region> regions;
+    unsigned long long head = 0;
+    unsigned long long frameBegin = 0;
+    size_t frameBytes = 0;
+    size_t lastFrameBytes = 0;
+    unsigned long long waits = 0;
+    unsigned long long orphans = 0;
+
+    unsigned long long align(unsigned long long position) const {
+        return (position + alignment - 1) / alignment * alignment;
+    }
+
+    // the next ring start when size bytes at position would cross it
+    unsigned long long skipEnd(unsigned long long position, size_t size) const {
+        size_t physical = (size_t)(position % capacity);
+        return physical + size > capacity ? position + capacity - physical : position;
+    }
+
+    // the oldest byte the GPU may still read
+    unsigned long long getTail() const {
+        return regions.empty() ? frameBegin : regions.front().begin;
+    }
+
+    void retire() {
+        backend->deleteFence(regions.front().fence);
+        regions.pop_front();
+    }
+};
+
+#endif // RING_ALLOCATOR_H
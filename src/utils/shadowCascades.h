@@ -0,0 +1,204 @@
+#ifndef SHADOW_CASCADES_H
+#define SHADOW_CASCADES_H
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+// Cascade fitting for directional light shadow maps. The camera frustum up to
+// the shadow distance is split into cascades (practical split scheme: a blend
+// of logarithmic and uniform splits), and each cascade gets an orthographic
+// light projection around the bounding sphere of its frustum slice.
+//
+// The sphere keeps the projection size constant while the camera turns, and
+// its centre is snapped to whole shadow map texels so the rasterised shadow
+// edges don't crawl when the camera moves. The depth range is extended
+// towards the light to the scene bounds, so casters outside the slice still
+// land in the map. GL free; CascadedShadowMap renders with the result.
+
+struct ShadowCascade {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    float splitNear = 0.0f;   // camera view depth range covered
+    float splitFar = 0.0f;
+    float texelSize = 0.0f;   // world units per shadow map texel
+    glm::vec3 boxMin = glm::vec3(0.0f);  // light view space box rendered
+    glm::vec3 boxMax = glm::vec3(0.0f);
+};
+
+class ShadowCascades {
+public:
+    ShadowCascades(int cascadeCount = 4, int resolution = 1024, float splitLambda = 0.75f){
+        setCascadeCount(cascadeCount);
+        setResolution(resolution);
+        setSplitLambda(splitLambda);
+    }
+
+    void setCascadeCount(int cascadeCount){
+        cascades.resize(glm::clamp(cascadeCount, 1, maxCascades));
+    }
+
+    int getCascadeCount() const {
+        return cascades.size();
+    }
+
+    void setResolution(int resolution){
+        this->resolution = std::max(1, resolution);
+    }
+
+    int getResolution() const {
+        return resolution;
+    }
+
+    // 0 gives uniform splits, 1 logarithmic
+    void setSplitLambda(float splitLambda){
+        this->splitLambda = glm::clamp(splitLambda, 0.0f, 1.0f);
+    }
+
+    float getSplitLambda() const {
+        return splitLambda;
+    }
+
+    // shadows end here (or at the camera far plane when closer)
+    void setShadowDistance(float shadowDistance){
+        this->shadowDistance = std::max(shadowDistance, 0.0f);
+    }
+
+    float getShadowDistance() const {
+        return shadowDistance;
+    }
+
+    const ShadowCascade& getCascade(int index) const {
+        return cascades[index];
+    }
+
+    // count + 1 depths from near to far
+    static void computeSplits(float near, float far, int count, float lambda, std::vector<float>& splits){
+        splits.resize(count + 1);
+        for(int i = 0; i <= count; i++){
+            float p = (float)i / count;
+            float logarithmic = near * std::pow(far / near, p);
+            float uniform = near + (far - near) * p;
+            splits[i] = lambda * logarithmic + (1.0f - lambda) * uniform;
+        }
+        splits[0] = near;
+        splits[count] = far;
+    }
+
+    // cameraView maps world to view space; fov in degrees like Camera.
+    // lightDirection is the direction the light travels in.
+    void fit(const glm::mat4& cameraView, float fov, float aspect, float near, float far, const glm::vec3& lightDirection, const glm::vec3& sceneMin, const glm::vec3& sceneMax){
+        int count = cascades.size();
+        std::vector<float> splits;
+        computeSplits(near, std::max(std::min(far, shadowDistance), near * 1.001f), count, splitLambda, splits);
+
+        glm::mat4 cameraWorld = glm::inverse(cameraView);
+        glm::vec3 direction = glm::normalize(lightDirection);
+        glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        // one light orientation for every cascade, looking along the light
+        glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), direction, up);
+
+        // nearest and furthest scene depth along the light (light view looks down -z)
+        bool hasScene = sceneMin.x <= sceneMax.x && sceneMin.y <= sceneMax.y && sceneMin.z <= sceneMax.z;
+        float sceneTop = -FLT_MAX;
+        if(hasScene){
+            for(int corner = 0; corner < 8; corner++){
+                glm::vec3 p((corner & 1) ? sceneMax.x : sceneMin.x, (corner & 2) ? sceneMax.y : sceneMin.y, (corner & 4) ? sceneMax.z : sceneMin.z);
+                sceneTop = std::max(sceneTop, (lightView * glm::vec4(p, 1.0f)).z);
+            }
+        }
+
+        float tanY = std::tan(glm::radians(fov) * 0.5f);
+        float tanX = tanY * aspect;
+        for(int i = 0; i < count; i++){
+            ShadowCascade& cascade = cascades[i];
+            cascade.splitNear = splits[i];
+            cascade.splitFar = splits[i + 1];
+
+            // bounding sphere of the slice, in world space
+            glm::vec3 corners[8];
+            glm::vec3 centre(0.0f);
+            for(int c = 0; c < 8; c++){
+                float depth = (c & 4) ? cascade.splitFar : cascade.splitNear;
+                glm::vec3 view((c & 1) ? depth * tanX : -depth * tanX, (c & 2) ? depth * tanY : -depth * tanY, -depth);
+                corners[c] = glm::vec3(cameraWorld * glm::vec4(view, 1.0f));
+                centre += corners[c] * 0.125f;
+            }
+            float radius = 0.0f;
+            for(int c = 0; c < 8; c++){
+                radius = std::max(radius, glm::length(corners[c] - centre));
+            }
+            // rounded up so float noise doesn't change the texel size frame to frame
+            radius = std::ceil(radius * 16.0f) / 16.0f;
+
+            cascade.texelSize = 2.0f * radius / resolution;
+            glm::vec3 lightCentre = glm::vec3(lightView * glm::vec4(centre, 1.0f));
+            lightCentre.x = std::floor(lightCentre.x / cascade.texelSize) * cascade.texelSize;
+            lightCentre.y = std::floor(lightCentre.y / cascade.texelSize) * cascade.texelSize;
+
+            cascade.boxMin = lightCentre - glm::vec3(radius);
+            cascade.boxMax = lightCentre + glm::vec3(radius);
+            if(hasScene){
+                cascade.boxMax.z = std::max(cascade.boxMax.z, sceneTop);
+            }
+
+            cascade.view = lightView;
+            cascade.projection = glm::ortho(cascade.boxMin.x, cascade.boxMax.x, cascade.boxMin.y, cascade.boxMax.y, -cascade.boxMax.z, -cascade.boxMin.z);
+            cascade.viewProjection = cascade.projection * cascade.view;
+        }
+    }
+
+    // world space box overlapping the cascade's light space box
+    bool intersects(int index, const glm::vec3& min, const glm::vec3& max) const {
+        const ShadowCascade& cascade = cascades[index];
+        glm::vec3 centre = (min + max) * 0.5f;
+        glm::vec3 extent = (max - min) * 0.5f;
+        glm::vec3 lightCentre = glm::vec3(cascade.view * glm::vec4(centre, 1.0f));
+        glm::mat3 rotation = glm::mat3(cascade.view);
+        glm::vec3 lightExtent(0.0f);
+        for(int column = 0; column < 3; column++){
+            lightExtent += glm::abs(rotation[column]) * extent[column];
+        }
+        return glm::all(glm::lessThanEqual(lightCentre - lightExtent, cascade.boxMax)) &&
+               glm::all(glm::greaterThanEqual(lightCentre + lightExtent, cascade.boxMin));
+    }
+
+    // visible[c] lists the casters (indices into mins/maxs) cascade c has to draw
+    void cullCasters(const std::vector<glm::vec3>& mins, const std::vector<glm::vec3>& maxs, std::vector<std::vector<int> >& visible) const {
+        visible.resize(cascades.size());
+        for(int c = 0; c < cascades.size(); c++){
+            visible[c].clear();
+            for(int i = 0; i < mins.size(); i++){
+                if(intersects(c, mins[i], maxs[i])){
+                    visible[c].push_back(i);
+                }
+            }
+        }
+    }
+
+    // world space bounding box of a transformed object space box
+    static void transformBounds(const glm::mat4& transform, const glm::vec3& min, const glm::vec3& max, glm::vec3& outMin, glm::vec3& outMax){
+        glm::vec3 centre = glm::vec3(transform * glm::vec4((min + max) * 0.5f, 1.0f));
+        glm::vec3 extent = (max - min) * 0.5f;
+        glm::vec3 worldExtent(0.0f);
+        for(int column = 0; column < 3; column++){
+            worldExtent += glm::abs(glm::vec3(transform[column])) * extent[column];
+        }
+        outMin = centre - worldExtent;
+        outMax = centre + worldExtent;
+    }
+
+    static const int maxCascades = 4;
+
+private:
+    std::vector<ShadowCascade> cascades;
+    int resolution = 1024;
+    float splitLambda = 0.75f;
+    float shadowDistance = 150.0f;
+};
+
+#endif // SHADOW_CASCADES_H
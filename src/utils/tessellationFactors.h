@@ -0,0 +1,105 @@
+#ifndef TESSELLATION_FACTORS_H
+#define TESSELLATION_FACTORS_H
+
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+
+// Adaptive tessellation levels for triangle patches, the CPU reference of
+// tessShader.tesc (keep the two in step). GL free, so graphics_bench can check
+// and time it.
+//
+// Each edge is levelled by its size on screen: the sphere around the edge,
+// grown by the largest height map displacement of its two vertices, is
+// projected at its centre and the level is the diameter in pixels over the
+// target edge length. The level only depends on the edge's two vertices, so
+// the patches on both sides of an edge agree and no cracks open. A patch is
+// culled (every level 0) when its displaced bounding sphere is outside a
+// frustum plane, or when all three vertex normals face away from the camera.
+//
+// Normals go to world space with mat3(model), which assumes uniform scaling.
+
+struct TessellationSettings {
+    glm::mat4 model = glm::mat4(1.0f);
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 projection = glm::mat4(1.0f);
+    glm::vec3 viewPos = glm::vec3(0.0f);
+    float viewportHeight = 720.0f;
+    float edgeLength = 8.0f;        // pixels per tessellated edge segment
+    float maxLevel = 64.0f;
+    float heightScale = 0.0f;       // displacement is height * heightScale along the normal, height in [0, 1]
+    float backfaceTolerance = 0.2f; // cosine past which a normal counts as facing away
+};
+
+struct PatchLevels {
+    float outer[3];  // outer[i] is the edge opposite vertex i, as gl_TessLevelOuter
+    float inner;
+    bool culled;
+};
+
+class TessellationFactors {
+public:
+    // a and b in world space, displacement the world space displacement bound of the edge
+    static float getEdgeLevel(const glm::vec3& a, const glm::vec3& b, float displacement, const TessellationSettings& settings){
+        glm::vec4 centre = settings.projection * settings.view * glm::vec4(0.5f * (a + b), 1.0f);
+        float radius = 0.5f * glm::length(a - b) + displacement;
+        // clip w is the view depth for perspective and 1 for orthographic projections
+        float pixels = radius * settings.projection[1][1] * settings.viewportHeight / std::max(centre.w, 1e-4f);
+        return glm::clamp(pixels / settings.edgeLength, 1.0f, settings.maxLevel);
+    }
+
+    static bool isPatchCulled(const glm::vec3 positions[3], const glm::vec3 normals[3], const float displacements[3], const TessellationSettings& settings){
+        bool backFacing = true;
+        for(int i = 0; i < 3 && backFacing; i++){
+            backFacing = glm::dot(normals[i], glm::normalize(positions[i] - settings.viewPos)) > settings.backfaceTolerance;
+        }
+        if(backFacing){
+            return true;
+        }
+
+        glm::vec3 centre = (positions[0] + positions[1] + positions[2]) / 3.0f;
+        float radius = 0.0f;
+        for(int i = 0; i < 3; i++){
+            radius = std::max(radius, glm::length(positions[i] - centre) + displacements[i]);
+        }
+        // frustum planes from the rows of the view projection
+        glm::mat4 viewProjection = settings.projection * settings.view;
+        for(int i = 0; i < 6; i++){
+            glm::vec4 plane = glm::vec4(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+            glm::vec4 row = glm::vec4(viewProjection[0][i / 2], viewProjection[1][i / 2], viewProjection[2][i / 2], viewProjection[3][i / 2]);
+            plane += (i % 2 == 0) ? row : -row;
+            if(glm::dot(glm::vec3(plane), centre) + plane.w < -radius * glm::length(glm::vec3(plane))){
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // positions and normals in model space, as the patch reaches the control shader
+    static void computePatch(const glm::vec3 positions[3], const glm::vec3 normals[3], const TessellationSettings& settings, PatchLevels& levels){
+        glm::mat3 normalMatrix = glm::mat3(settings.model);
+        glm::vec3 worldPositions[3];
+        glm::vec3 worldNormals[3];
+        float displacements[3];
+        for(int i = 0; i < 3; i++){
+            worldPositions[i] = glm::vec3(settings.model * glm::vec4(positions[i], 1.0f));
+            glm::vec3 normal = normalMatrix * normals[i];
+            displacements[i] = std::abs(settings.heightScale) * glm::length(normal);
+            worldNormals[i] = glm::normalize(normal);
+        }
+
+        levels.culled = isPatchCulled(worldPositions, worldNormals, displacements, settings);
+        if(levels.culled){
+            levels.outer[0] = levels.outer[1] = levels.outer[2] = levels.inner = 0.0f;
+            return;
+        }
+        for(int i = 0; i < 3; i++){
+            int a = (i + 1) % 3;
+            int b = (i + 2) % 3;
+            levels.outer[i] = getEdgeLevel(worldPositions[a], worldPositions[b], std::max(displacements[a], displacements[b]), settings);
+        }
+        levels.inner = (levels.outer[0] + levels.outer[1] + levels.outer[2]) / 3.0f;
+    }
+};
+
+#endif // TESSELLATION_FACTORS_H
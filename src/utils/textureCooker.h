@@ -0,0 +1,880 @@
+#ifndef TEXTURE_COOKER_H
+#define TEXTURE_COOKER_H
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <functional>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cfloat>
+#include <stdint.h>
+
+// Offline texture cooking. A source image is turned into a full mip chain
+// (box filtered, renormalised for normal maps) and every level is block
+// compressed on the CPU:
+//
+//   BC1  RGB,  4 bpp  - opaque colour
+//   BC3  RGBA, 8 bpp  - colour with alpha (BC1 colour + BC4 alpha)
+//   BC5  RG,   8 bpp  - normal maps, z is rebuilt in the shader
+//   BC7  RGBA, 8 bpp  - high quality colour; mode 6 only (one subset, 4 bit
+//                       indices), which is far simpler than a full mode search
+//
+// The result is stored in a small container (.gtex, written next to the source
+// as <source>.gtex) that Texture reads with a single fread and uploads level by
+// level with glCompressedTexImage2D. GL free, so tools/textureCooker.cpp and
+// graphics_bench use it without a context. Decoders are included so encoder
+// quality can be measured (psnr) offline.
+//
+// Cube maps (cookFaces with six faces) keep every face of a level together:
+// the mips go level by level, +X -X +Y -Y +Z -Z within a level.
+//
+// Container layout, little endian:
+//   "GTEX", version, format, width, height, channels, faces, mip count   (uint32 each)
+//   per mip: width, height (uint32), offset, size (uint64, from the data start)
+//   data
+
+enum CookedFormat {
+    COOKED_RGBA8,
+    COOKED_BC1,
+    COOKED_BC3,
+    COOKED_BC5,
+    COOKED_BC7
+};
+
+struct CookedMip {
+    int width = 0;
+    int height = 0;
+    size_t offset = 0; // into CookedTexture::data
+    size_t size = 0;
+};
+
+struct CookedTexture {
+    CookedFormat format = COOKED_RGBA8;
+    int width = 0;
+    int height = 0;
+    int channels = 4; // of the source image
+    int faces = 1;    // 6 for cube maps
+    std::vector<CookedMip> mips;  // levels * faces, see the layout above
+    std::vector<unsigned char> data;
+
+    int getLevelCount() const {
+        return mips.size() / faces;
+    }
+
+    const CookedMip& getMip(int level, int face = 0) const {
+        return mips[level * faces + face];
+    }
+
+    const unsigned char* getLevel(int level, int face = 0) const {
+        return data.data() + getMip(level, face).offset;
+    }
+
+    // bytes of every level, what the texture costs in video memory
+    size_t getSize() const {
+        size_t size = 0;
+        for(const CookedMip& mip : mips){
+            size += mip.size;
+        }
+        return size;
+    }
+};
+
+class TextureCooker {
+public:
+    static const char* getFormatName(CookedFormat format){
+        switch(format){
+            case COOKED_BC1: return "BC1";
+            case COOKED_BC3: return "BC3";
+            case COOKED_BC5: return "BC5";
+            case COOKED_BC7: return "BC7";
+            default: return "RGBA8";
+        }
+    }
+
+    // bytes per 4x4 block, 0 for uncompressed
+    static int getBlockSize(CookedFormat format){
+        return format == COOKED_RGBA8 ? 0 : format == COOKED_BC1 ? 8 : 16;
+    }
+
+    static size_t getLevelSize(CookedFormat format, int width, int height){
+        if(format == COOKED_RGBA8){
+            return (size_t)width * height * 4;
+        }
+        return (size_t)((width + 3) / 4) * ((height + 3) / 4) * getBlockSize(format);
+    }
+
+    static int getMipCount(int width, int height){
+        int count = 1;
+        while(width > 1 || height > 1){
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+            count++;
+        }
+        return count;
+    }
+
+    static std::string getCookedPath(const std::string& sourcePath){
+        return sourcePath + ".gtex";
+    }
+
+    // Box filtered mip chain of an RGBA8 image, levels[0] is a copy of the image.
+    // Normal maps are filtered as vectors and renormalised.
+    static void generateMips(const unsigned char* rgba, int width, int height, bool isNormalMap, std::vector<std::vector<unsigned char> >& levels){
+        levels.resize(getMipCount(width, height));
+        levels[0].assign(rgba, rgba + (size_t)width * height * 4);
+        for(int level = 1; level < levels.size(); level++){
+            int srcWidth = width, srcHeight = height;
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+            const unsigned char* src = levels[level - 1].data();
+            std::vector<unsigned char>& dst = levels[level];
+            dst.resize((size_t)width * height * 4);
+            for(int y = 0; y < height; y++){
+                for(int x = 0; x < width; x++){
+                    // odd sizes: the last source row / column is reused
+                    const unsigned char* taps[4] = {
+                        src + 4 * (std::min(2 * x, srcWidth - 1) + srcWidth * std::min(2 * y, srcHeight - 1)),
+                        src + 4 * (std::min(2 * x + 1, srcWidth - 1) + srcWidth * std::min(2 * y, srcHeight - 1)),
+                        src + 4 * (std::min(2 * x, srcWidth - 1) + srcWidth * std::min(2 * y + 1, srcHeight - 1)),
+                        src + 4 * (std::min(2 * x + 1, srcWidth - 1) + srcWidth * std::min(2 * y + 1, srcHeight - 1))
+                    };
+                    unsigned char* out = &dst[4 * (x + (size_t)width * y)];
+                    if(isNormalMap){
+                        float n[3] = {0.0f, 0.0f, 0.0f};
+                        for(int t = 0; t < 4; t++){
+                            for(int c = 0; c < 3; c++){
+                                n[c] += taps[t][c] / 127.5f - 1.0f;
+                            }
+                        }
+                        float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                        for(int c = 0; c < 3; c++){
+                            float v = length > 1e-6f ? n[c] / length : (c == 2 ? 1.0f : 0.0f);
+                            out[c] = (unsigned char)std::min(255.0f, std::max(0.0f, (v + 1.0f) * 127.5f + 0.5f));
+                        }
+                        out[3] = (taps[0][3] + taps[1][3] + taps[2][3] + taps[3][3] + 2) / 4;
+                    }
+                    else{
+                        for(int c = 0; c < 4; c++){
+                            out[c] = (taps[0][c] + taps[1][c] + taps[2][c] + taps[3][c] + 2) / 4;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Mips (optional) and block compression of an RGBA8 image. Block rows of
+    // every level are split over numThreads threads, 0 uses every core.
+    static void cook(const unsigned char* rgba, int width, int height, CookedFormat format, bool isNormalMap, CookedTexture& texture, bool mipmaps = true, int numThreads = 0){
+        cookFaces(&rgba, 1, width, height, format, isNormalMap, texture, mipmaps, numThreads);
+    }
+
+    // cook for several images of one size, the six faces of a cube map
+    static void cookFaces(const unsigned char* const* faces, int faceCount, int width, int height, CookedFormat format, bool isNormalMap, CookedTexture& texture, bool mipmaps = true, int numThreads = 0){
+        std::vector<std::vector<std::vector<unsigned char> > > faceLevels(faceCount);
+        for(int face = 0; face < faceCount; face++){
+            if(mipmaps){
+                generateMips(faces[face], width, height, isNormalMap, faceLevels[face]);
+            }
+            else{
+                faceLevels[face].resize(1);
+                faceLevels[face][0].assign(faces[face], faces[face] + (size_t)width * height * 4);
+            }
+        }
+        // in mip order, level by level
+        std::vector<std::vector<unsigned char> > levels;
+        for(int level = 0; level < faceLevels[0].size(); level++){
+            for(int face = 0; face < faceCount; face++){
+                levels.push_back(std::vector<unsigned char>());
+                levels.back().swap(faceLevels[face][level]);
+            }
+        }
+
+        texture.format = format;
+        texture.width = width;
+        texture.height = height;
+        texture.faces = faceCount;
+        texture.mips.resize(levels.size());
+        size_t offset = 0;
+        for(int i = 0; i < levels.size(); i++){
+            CookedMip& mip = texture.mips[i];
+            int level = i / faceCount;
+            mip.width = std::max(1, width >> level);
+            mip.height = std::max(1, height >> level);
+            mip.offset = offset;
+            mip.size = getLevelSize(format, mip.width, mip.height);
+            offset += mip.size;
+        }
+        texture.data.resize(offset);
+
+        if(format == COOKED_RGBA8){
+            for(int level = 0; level < levels.size(); level++){
+                memcpy(&texture.data[texture.mips[level].offset], levels[level].data(), levels[level].size());
+            }
+            return;
+        }
+
+        // one job per block row of every level
+        std::vector<std::pair<int, int> > rows;
+        for(int level = 0; level < levels.size(); level++){
+            for(int y = 0; y < (texture.mips[level].height + 3) / 4; y++){
+                rows.push_back(std::make_pair(level, y));
+            }
+        }
+
+        if(numThreads <= 0){
+            numThreads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        // a few rows per thread at least, small textures aren't worth the threads
+        numThreads = std::max(1, std::min(numThreads, (int)rows.size() / 8));
+        if(numThreads == 1){
+            encodeRows(levels, texture, rows, 0, rows.size());
+            return;
+        }
+        std::vector<std::thread> threads;
+        int chunk = (rows.size() + numThreads - 1) / numThreads;
+        for(int t = 0; t < numThreads; t++){
+            int begin = t * chunk;
+            int end = std::min((int)rows.size(), begin + chunk);
+            if(begin < end){
+                threads.push_back(std::thread(&TextureCooker::encodeRows, std::cref(levels), std::ref(texture), std::cref(rows), begin, end));
+            }
+        }
+        for(std::thread& thread : threads){
+            thread.join();
+        }
+    }
+
+    // RGBA8 pixels of one level, for checking the encoders
+    static void decode(const CookedTexture& texture, int level, std::vector<unsigned char>& rgba, int face = 0){
+        const CookedMip& mip = texture.getMip(level, face);
+        rgba.assign((size_t)mip.width * mip.height * 4, 0);
+        const unsigned char* data = texture.getLevel(level, face);
+        if(texture.format == COOKED_RGBA8){
+            memcpy(rgba.data(), data, rgba.size());
+            return;
+        }
+        int blocksX = (mip.width + 3) / 4;
+        int blocksY = (mip.height + 3) / 4;
+        int blockSize = getBlockSize(texture.format);
+        unsigned char block[64];
+        for(int by = 0; by < blocksY; by++){
+            for(int bx = 0; bx < blocksX; bx++){
+                const unsigned char* in = data + (size_t)(bx + blocksX * by) * blockSize;
+                decodeBlock(texture.format, in, block);
+                for(int y = 0; y < 4 && 4 * by + y < mip.height; y++){
+                    for(int x = 0; x < 4 && 4 * bx + x < mip.width; x++){
+                        memcpy(&rgba[4 * (4 * bx + x + (size_t)mip.width * (4 * by + y))], &block[4 * (x + 4 * y)], 4);
+                    }
+                }
+            }
+        }
+    }
+
+    // Peak signal to noise ratio in dB over the first channels of each pixel;
+    // infinity for identical images
+    static double psnr(const unsigned char* a, const unsigned char* b, size_t pixelCount, int channels = 4){
+        double error = 0.0;
+        for(size_t i = 0; i < pixelCount; i++){
+            for(int c = 0; c < channels; c++){
+                double d = (double)a[4 * i + c] - b[4 * i + c];
+                error += d * d;
+            }
+        }
+        if(error == 0.0){
+            return std::numeric_limits<double>::infinity();
+        }
+        double mse = error / ((double)pixelCount * channels);
+        return 10.0 * std::log10(255.0 * 255.0 / mse);
+    }
+
+    // the channels a format keeps, what psnr should compare
+    static int getChannelCount(CookedFormat format){
+        return format == COOKED_BC1 ? 3 : format == COOKED_BC5 ? 2 : 4;
+    }
+
+    static bool write(const std::string& path, const CookedTexture& texture){
+        FILE* fp = fopen(path.c_str(), "wb");
+        if(fp == NULL){
+            return false;
+        }
+        uint32_t header[8] = { magic, version, (uint32_t)texture.format, (uint32_t)texture.width, (uint32_t)texture.height, (uint32_t)texture.channels, (uint32_t)texture.faces, (uint32_t)texture.mips.size() };
+        bool ok = fwrite(header, sizeof(header), 1, fp) == 1;
+        for(const CookedMip& mip : texture.mips){
+            uint32_t size[2] = { (uint32_t)mip.width, (uint32_t)mip.height };
+            uint64_t range[2] = { (uint64_t)mip.offset, (uint64_t)mip.size };
+            ok = ok && fwrite(size, sizeof(size), 1, fp) == 1 && fwrite(range, sizeof(range), 1, fp) == 1;
+        }
+        ok = ok && (texture.data.empty() || fwrite(texture.data.data(), texture.data.size(), 1, fp) == 1);
+        fclose(fp);
+        return ok;
+    }
+
+    // The whole file in one read; data keeps the header in front of the
+    // levels, so the mip offsets are moved past it.
+    static bool read(const std::string& path, CookedTexture& texture){
+        FILE* fp = fopen(path.c_str(), "rb");
+        if(fp == NULL){
+            return false;
+        }
+        fseek(fp, 0L, SEEK_END);
+        long size = ftell(fp);
+        fseek(fp, 0L, SEEK_SET);
+        texture.data.resize(size > 0 ? size : 0);
+        bool ok = size > 0 && fread(texture.data.data(), size, 1, fp) == 1;
+        fclose(fp);
+        if(!ok || texture.data.size() < 8 * sizeof(uint32_t)){
+            return false;
+        }
+
+        uint32_t header[8];
+        memcpy(header, texture.data.data(), sizeof(header));
+        if(header[0] != magic || header[1] != version || header[2] > COOKED_BC7 || header[6] == 0 || header[7] % header[6] != 0){
+            return false;
+        }
+        texture.format = (CookedFormat)header[2];
+        texture.width = header[3];
+        texture.height = header[4];
+        texture.channels = header[5];
+        texture.faces = header[6];
+        size_t headerSize = sizeof(header) + (size_t)header[7] * 24;
+        if(headerSize > texture.data.size()){
+            return false;
+        }
+        texture.mips.resize(header[7]);
+        for(int level = 0; level < texture.mips.size(); level++){
+            uint32_t mipSize[2];
+            uint64_t range[2];
+            memcpy(mipSize, &texture.data[sizeof(header) + level * 24], sizeof(mipSize));
+            memcpy(range, &texture.data[sizeof(header) + level * 24 + 8], sizeof(range));
+            CookedMip& mip = texture.mips[level];
+            mip.width = mipSize[0];
+            mip.height = mipSize[1];
+            mip.offset = headerSize + range[0];
+            mip.size = range[1];
+            if(mip.offset + mip.size > texture.data.size() || mip.size != getLevelSize(texture.format, mip.width, mip.height)){
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // ------------------------------------------------------------------
+    // Block encoders, 16 RGBA8 pixels in row order in
+
+    // 4 colour mode only, BC3 decodes the colour block that way regardless
+    static void encodeBC1(const unsigned char* block, unsigned char* out){
+        float colors[16][3];
+        for(int i = 0; i < 16; i++){
+            for(int c = 0; c < 3; c++){
+                colors[i][c] = block[4 * i + c];
+            }
+        }
+        float endpoints[2][3];
+        principalEndpoints<3>(colors, endpoints);
+
+        // inset a little, the extremes are rarely worth an exact palette entry
+        for(int c = 0; c < 3; c++){
+            float inset = (endpoints[1][c] - endpoints[0][c]) / 16.0f;
+            endpoints[0][c] += inset;
+            endpoints[1][c] -= inset;
+        }
+        uint16_t best[2] = { packRGB565(endpoints[1]), packRGB565(endpoints[0]) };
+        unsigned char indices[16];
+        float bestError = bc1Indices(colors, best, indices);
+
+        // one least squares pass for the endpoints of those indices
+        static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+        float refined[2][3];
+        if(leastSquares<3>(colors, indices, weights, refined)){
+            uint16_t candidate[2] = { packRGB565(refined[0]), packRGB565(refined[1]) };
+            unsigned char candidateIndices[16];
+            float error = bc1Indices(colors, candidate, candidateIndices);
+            if(error < bestError){
+                best[0] = candidate[0];
+                best[1] = candidate[1];
+                memcpy(indices, candidateIndices, 16);
+            }
+        }
+
+        // color0 > color1 selects 4 colour mode; equal endpoints only need index 0
+        if(best[0] < best[1]){
+            std::swap(best[0], best[1]);
+            for(int i = 0; i < 16; i++){
+                indices[i] ^= 1;
+            }
+        }
+        if(best[0] == best[1]){
+            memset(indices, 0, 16);
+        }
+
+        uint32_t bits = 0;
+        for(int i = 0; i < 16; i++){
+            bits |= (uint32_t)indices[i] << (2 * i);
+        }
+        out[0] = best[0] & 0xFF;
+        out[1] = best[0] >> 8;
+        out[2] = best[1] & 0xFF;
+        out[3] = best[1] >> 8;
+        for(int i = 0; i < 4; i++){
+            out[4 + i] = (bits >> (8 * i)) & 0xFF;
+        }
+    }
+
+    // one channel, stride apart: the BC3 alpha block and each half of BC5
+    static void encodeBC4(const unsigned char* values, int stride, unsigned char* out){
+        int low = 255, high = 0;
+        for(int i = 0; i < 16; i++){
+            low = std::min(low, (int)values[stride * i]);
+            high = std::max(high, (int)values[stride * i]);
+        }
+        // 8 value mode: endpoint 0 the larger, index 0 = high, 1 = low, 2..7 between
+        out[0] = high;
+        out[1] = low;
+        uint64_t bits = 0;
+        if(high > low){
+            for(int i = 0; i < 16; i++){
+                int step = (int)std::floor((high - values[stride * i]) * 7.0f / (high - low) + 0.5f);
+                uint64_t index = step == 0 ? 0 : step == 7 ? 1 : step + 1;
+                bits |= index << (3 * i);
+            }
+        }
+        for(int i = 0; i < 6; i++){
+            out[2 + i] = (bits >> (8 * i)) & 0xFF;
+        }
+    }
+
+    static void encodeBC3(const unsigned char* block, unsigned char* out){
+        encodeBC4(block + 3, 4, out);
+        encodeBC1(block, out + 8);
+    }
+
+    static void encodeBC5(const unsigned char* block, unsigned char* out){
+        encodeBC4(block, 4, out);
+        encodeBC4(block + 1, 4, out + 8);
+    }
+
+    // mode 6: RGBA endpoints of 7 bits plus a shared low bit each, 16 weights
+    static void encodeBC7(const unsigned char* block, unsigned char* out){
+        float colors[16][4];
+        for(int i = 0; i < 16; i++){
+            for(int c = 0; c < 4; c++){
+                colors[i][c] = block[4 * i + c];
+            }
+        }
+        float endpoints[2][4];
+        principalEndpoints<4>(colors, endpoints);
+
+        unsigned char best[2][4];
+        quantizeBC7(endpoints[0], best[0]);
+        quantizeBC7(endpoints[1], best[1]);
+        unsigned char indices[16];
+        float bestError = bc7Indices(colors, best, indices);
+
+        float weights[16];
+        for(int i = 0; i < 16; i++){
+            weights[i] = 1.0f - getBC7Weight(i) / 64.0f;
+        }
+        float refined[2][4];
+        if(leastSquares<4>(colors, indices, weights, refined)){
+            unsigned char candidate[2][4];
+            quantizeBC7(refined[0], candidate[0]);
+            quantizeBC7(refined[1], candidate[1]);
+            unsigned char candidateIndices[16];
+            float error = bc7Indices(colors, candidate, candidateIndices);
+            if(error < bestError){
+                memcpy(best, candidate, sizeof(best));
+                memcpy(indices, candidateIndices, 16);
+            }
+        }
+
+        // the first pixel's index is stored without its top bit, so it must be below 8
+        if(indices[0] >= 8){
+            for(int c = 0; c < 4; c++){
+                std::swap(best[0][c], best[1][c]);
+            }
+            for(int i = 0; i < 16; i++){
+                indices[i] = 15 - indices[i];
+            }
+        }
+
+        // quantizeBC7 keeps the low bit the same for all four channels
+        BitWriter writer(out);
+        writer.write(1 << 6, 7);
+        for(int c = 0; c < 4; c++){
+            writer.write(best[0][c] >> 1, 7);
+            writer.write(best[1][c] >> 1, 7);
+        }
+        writer.write(best[0][0] & 1, 1);
+        writer.write(best[1][0] & 1, 1);
+        writer.write(indices[0], 3);
+        for(int i = 1; i < 16; i++){
+            writer.write(indices[i], 4);
+        }
+    }
+
+    // ------------------------------------------------------------------
+    // Block decoders, 16 RGBA8 pixels out
+
+    static void decodeBC1(const unsigned char* in, unsigned char* out, bool fourColor = false){
+        uint16_t c0 = in[0] | (in[1] << 8);
+        uint16_t c1 = in[2] | (in[3] << 8);
+        unsigned char palette[4][4];
+        unpackRGB565(c0, palette[0]);
+        unpackRGB565(c1, palette[1]);
+        for(int c = 0; c < 3; c++){
+            if(c0 > c1 || fourColor){
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+            else{
+                palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+                palette[3][c] = 0;
+            }
+        }
+        palette[0][3] = palette[1][3] = palette[2][3] = 255;
+        palette[3][3] = (c0 > c1 || fourColor) ? 255 : 0;
+        uint32_t bits = in[4] | (in[5] << 8) | (in[6] << 16) | ((uint32_t)in[7] << 24);
+        for(int i = 0; i < 16; i++){
+            memcpy(out + 4 * i, palette[(bits >> (2 * i)) & 3], 4);
+        }
+    }
+
+    static void decodeBC4(const unsigned char* in, unsigned char* out, int stride){
+        int e0 = in[0], e1 = in[1];
+        unsigned char palette[8];
+        palette[0] = e0;
+        palette[1] = e1;
+        for(int i = 2; i < 8; i++){
+            if(e0 > e1){
+                palette[i] = ((8 - i) * e0 + (i - 1) * e1) / 7;
+            }
+            else{
+                palette[i] = i < 6 ? ((6 - i) * e0 + (i - 1) * e1) / 5 : (i == 6 ? 0 : 255);
+            }
+        }
+        uint64_t bits = 0;
+        for(int i = 0; i < 6; i++){
+            bits |= (uint64_t)in[2 + i] << (8 * i);
+        }
+        for(int i = 0; i < 16; i++){
+            out[stride * i] = palette[(bits >> (3 * i)) & 7];
+        }
+    }
+
+    // mode 6 blocks only, anything else decodes to black
+    static void decodeBC7(const unsigned char* in, unsigned char* out){
+        BitReader reader(in);
+        if(reader.read(7) != (1 << 6)){
+            memset(out, 0, 64);
+            return;
+        }
+        unsigned char endpoints[2][4];
+        for(int c = 0; c < 4; c++){
+            endpoints[0][c] = reader.read(7) << 1;
+            endpoints[1][c] = reader.read(7) << 1;
+        }
+        int p0 = reader.read(1), p1 = reader.read(1);
+        for(int c = 0; c < 4; c++){
+            endpoints[0][c] |= p0;
+            endpoints[1][c] |= p1;
+        }
+        for(int i = 0; i < 16; i++){
+            int index = reader.read(i == 0 ? 3 : 4);
+            for(int c = 0; c < 4; c++){
+                out[4 * i + c] = bc7Interpolate(endpoints[0][c], endpoints[1][c], index);
+            }
+        }
+    }
+
+    static void decodeBlock(CookedFormat format, const unsigned char* in, unsigned char* out){
+        switch(format){
+            case COOKED_BC1:
+                decodeBC1(in, out);
+                break;
+            case COOKED_BC3:
+                decodeBC1(in + 8, out, true);
+                decodeBC4(in, out + 3, 4);
+                break;
+            case COOKED_BC5:
+                for(int i = 0; i < 16; i++){
+                    out[4 * i + 2] = 0;
+                    out[4 * i + 3] = 255;
+                }
+                decodeBC4(in, out, 4);
+                decodeBC4(in + 8, out + 1, 4);
+                break;
+            case COOKED_BC7:
+                decodeBC7(in, out);
+                break;
+            default:
+                break;
+        }
+    }
+
+    static void encodeBlock(CookedFormat format, const unsigned char* block, unsigned char* out){
+        switch(format){
+            case COOKED_BC1: encodeBC1(block, out); break;
+            case COOKED_BC3: encodeBC3(block, out); break;
+            case COOKED_BC5: encodeBC5(block, out); break;
+            case COOKED_BC7: encodeBC7(block, out); break;
+            default: break;
+        }
+    }
+
+private:
+    static const uint32_t magic = 0x58455447; // "GTEX"
+    static const uint32_t version = 2;
+
+    // weight of endpoint 1 in 64ths for each 4 bit index
+    static int getBC7Weight(int index){
+        static const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+        return weights[index];
+    }
+
+    struct BitWriter {
+        unsigned char* out;
+        int position = 0;
+        BitWriter(unsigned char* out) : out(out) {
+            memset(out, 0, 16);
+        }
+        void write(uint32_t value, int count){
+            for(int i = 0; i < count; i++, position++){
+                out[position >> 3] |= ((value >> i) & 1) << (position & 7);
+            }
+        }
+    };
+
+    struct BitReader {
+        const unsigned char* in;
+        int position = 0;
+        BitReader(const unsigned char* in) : in(in) {}
+        uint32_t read(int count){
+            uint32_t value = 0;
+            for(int i = 0; i < count; i++, position++){
+                value |= ((in[position >> 3] >> (position & 7)) & 1) << i;
+            }
+            return value;
+        }
+    };
+
+    static void encodeRows(const std::vector<std::vector<unsigned char> >& levels, CookedTexture& texture, const std::vector<std::pair<int, int> >& rows, int begin, int end){
+        int blockSize = getBlockSize(texture.format);
+        unsigned char block[64];
+        for(int r = begin; r < end; r++){
+            int level = rows[r].first;
+            int by = rows[r].second;
+            const CookedMip& mip = texture.mips[level];
+            const unsigned char* src = levels[level].data();
+            int blocksX = (mip.width + 3) / 4;
+            unsigned char* out = &texture.data[mip.offset + (size_t)by * blocksX * blockSize];
+            for(int bx = 0; bx < blocksX; bx++){
+                // edge blocks repeat the last row / column
+                for(int y = 0; y < 4; y++){
+                    int sy = std::min(4 * by + y, mip.height - 1);
+                    for(int x = 0; x < 4; x++){
+                        int sx = std::min(4 * bx + x, mip.width - 1);
+                        memcpy(&block[4 * (x + 4 * y)], &src[4 * (sx + (size_t)mip.width * sy)], 4);
+                    }
+                }
+                encodeBlock(texture.format, block, out + bx * blockSize);
+            }
+        }
+    }
+
+    // ends of the pixels' extent along their principal axis, endpoints[0] at the low end
+    template<int N>
+    static void principalEndpoints(const float colors[16][N], float endpoints[2][N]){
+        float mean[N] = {};
+        for(int i = 0; i < 16; i++){
+            for(int c = 0; c < N; c++){
+                mean[c] += colors[i][c] / 16.0f;
+            }
+        }
+        float covariance[N][N] = {};
+        for(int i = 0; i < 16; i++){
+            for(int a = 0; a < N; a++){
+                for(int b = 0; b < N; b++){
+                    covariance[a][b] += (colors[i][a] - mean[a]) * (colors[i][b] - mean[b]);
+                }
+            }
+        }
+        // power iteration from the widest channel
+        float axis[N];
+        int widest = 0;
+        for(int c = 0; c < N; c++){
+            widest = covariance[c][c] > covariance[widest][widest] ? c : widest;
+        }
+        for(int c = 0; c < N; c++){
+            axis[c] = c == widest ? 1.0f : 0.0f;
+        }
+        for(int iteration = 0; iteration < 8; iteration++){
+            float next[N] = {};
+            float length = 0.0f;
+            for(int a = 0; a < N; a++){
+                for(int b = 0; b < N; b++){
+                    next[a] += covariance[a][b] * axis[b];
+                }
+                length = std::max(length, std::abs(next[a]));
+            }
+            if(length < 1e-12f){
+                break;
+            }
+            for(int c = 0; c < N; c++){
+                axis[c] = next[c] / length;
+            }
+        }
+        float length = 0.0f;
+        for(int c = 0; c < N; c++){
+            length += axis[c] * axis[c];
+        }
+        length = std::sqrt(length);
+        for(int c = 0; c < N; c++){
+            axis[c] = length > 0.0f ? axis[c] / length : 0.0f;
+        }
+
+        float low = FLT_MAX, high = -FLT_MAX;
+        for(int i = 0; i < 16; i++){
+            float t = 0.0f;
+            for(int c = 0; c < N; c++){
+                t += (colors[i][c] - mean[c]) * axis[c];
+            }
+            low = std::min(low, t);
+            high = std::max(high, t);
+        }
+        for(int c = 0; c < N; c++){
+            endpoints[0][c] = clamp255(mean[c] + axis[c] * low);
+            endpoints[1][c] = clamp255(mean[c] + axis[c] * high);
+        }
+    }
+
+    // endpoints minimising the squared error for fixed indices; weights[i] is
+    // the share of endpoint 0 in palette entry i
+    template<int N>
+    static bool leastSquares(const float colors[16][N], const unsigned char* indices, const float* weights, float endpoints[2][N]){
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        float ax[N] = {}, bx[N] = {};
+        for(int i = 0; i < 16; i++){
+            float a = weights[indices[i]];
+            float b = 1.0f - a;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            for(int c = 0; c < N; c++){
+                ax[c] += a * colors[i][c];
+                bx[c] += b * colors[i][c];
+            }
+        }
+        float determinant = aa * bb - ab * ab;
+        if(std::abs(determinant) < 1e-6f){
+            return false;
+        }
+        for(int c = 0; c < N; c++){
+            endpoints[0][c] = clamp255((bb * ax[c] - ab * bx[c]) / determinant);
+            endpoints[1][c] = clamp255((aa * bx[c] - ab * ax[c]) / determinant);
+        }
+        return true;
+    }
+
+    static float clamp255(float value){
+        return std::min(255.0f, std::max(0.0f, value));
+    }
+
+    static uint16_t packRGB565(const float* color){
+        int r = (int)(color[0] * 31.0f / 255.0f + 0.5f);
+        int g = (int)(color[1] * 63.0f / 255.0f + 0.5f);
+        int b = (int)(color[2] * 31.0f / 255.0f + 0.5f);
+        return (uint16_t)((r << 11) | (g << 5) | b);
+    }
+
+    static void unpackRGB565(uint16_t color, unsigned char* out){
+        int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+        out[0] = (r << 3) | (r >> 2);
+        out[1] = (g << 2) | (g >> 4);
+        out[2] = (b << 3) | (b >> 2);
+        out[3] = 255;
+    }
+
+    // nearest 4 colour mode palette entry per pixel, returns the squared error
+    static float bc1Indices(const float colors[16][3], const uint16_t* endpoints, unsigned char* indices){
+        unsigned char palette[4][4];
+        unpackRGB565(endpoints[0], palette[0]);
+        unpackRGB565(endpoints[1], palette[1]);
+        for(int c = 0; c < 3; c++){
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        float total = 0.0f;
+        for(int i = 0; i < 16; i++){
+            float best = FLT_MAX;
+            for(int p = 0; p < 4; p++){
+                float error = 0.0f;
+                for(int c = 0; c < 3; c++){
+                    float d = colors[i][c] - palette[p][c];
+                    error += d * d;
+                }
+                if(error < best){
+                    best = error;
+                    indices[i] = p;
+                }
+            }
+            total += best;
+        }
+        return total;
+    }
+
+    // 7 bit channels plus one low bit shared by the endpoint, whichever is closer
+    static void quantizeBC7(const float* color, unsigned char* out){
+        float bestError = FLT_MAX;
+        for(int p = 0; p < 2; p++){
+            unsigned char candidate[4];
+            float error = 0.0f;
+            for(int c = 0; c < 4; c++){
+                int q = std::min(127, std::max(0, (int)std::floor((color[c] - p) / 2.0f + 0.5f)));
+                candidate[c] = (q << 1) | p;
+                float d = candidate[c] - color[c];
+                error += d * d;
+            }
+            if(error < bestError){
+                bestError = error;
+                memcpy(out, candidate, 4);
+            }
+        }
+    }
+
+    static unsigned char bc7Interpolate(int e0, int e1, int index){
+        return (unsigned char)(((64 - getBC7Weight(index)) * e0 + getBC7Weight(index) * e1 + 32) >> 6);
+    }
+
+    static float bc7Indices(const float colors[16][4], const unsigned char endpoints[2][4], unsigned char* indices){
+        unsigned char palette[16][4];
+        for(int p = 0; p < 16; p++){
+            for(int c = 0; c < 4; c++){
+                palette[p][c] = bc7Interpolate(endpoints[0][c], endpoints[1][c], p);
+            }
+        }
+        float total = 0.0f;
+        for(int i = 0; i < 16; i++){
+            float best = FLT_MAX;
+            for(int p = 0; p < 16; p++){
+                float error = 0.0f;
+                for(int c = 0; c < 4; c++){
+                    float d = colors[i][c] - palette[p][c];
+                    error += d * d;
+                }
+                if(error < best){
+                    best = error;
+                    indices[i] = p;
+                }
+            }
+            total += best;
+        }
+        return total;
+    }
+};
+
+#endif // TEXTURE_COOKER_H
@@ -0,0 +1,295 @@
+#ifndef VERTEX_BVH_H
+#define VERTEX_BVH_H
+
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <cfloat>
+#include <glm/glm.hpp>
+
+// Bounding volume hierarchy over a point cloud (the object-space vertex
+// positions of a pickable mesh). Built once; queries walk the tree nearest
+// child first and prune every box that cannot beat the best candidate so far.
+//
+// Positions are stored reordered so each leaf is a contiguous run; queries
+// return the original vertex index. A deformed mesh is refit rather than
+// rebuilt: the tree keeps its shape and only the boxes follow the vertices.
+
+class VertexBVH {
+public:
+    VertexBVH() {}
+
+    VertexBVH(const std::vector<glm::vec3>& positions, int leafSize = 8){
+        build(positions, leafSize);
+    }
+
+    void build(const std::vector<glm::vec3>& positions, int leafSize = 8){
+        this->leafSize = std::max(1, leafSize);
+        nodes.clear();
+        indices.resize(positions.size());
+        for(int i = 0; i < indices.size(); i++){
+            indices[i] = i;
+        }
+        if(positions.empty()){
+            points.clear();
+            return;
+        }
+        nodes.reserve(2 * positions.size() / this->leafSize + 1);
+        nodes.push_back(Node());
+        buildNode(0, 0, positions.size(), positions);
+
+        points.resize(positions.size());
+        for(int i = 0; i < indices.size(); i++){
+            points[i] = positions[indices[i]];
+        }
+    }
+
+    // same vertex count and order as the positions the tree was built from
+    void refit(const std::vector<glm::vec3>& positions){
+        for(int i = 0; i < indices.size(); i++){
+            points[i] = positions[indices[i]];
+        }
+        // children always come after their parent
+        for(int n = nodes.size() - 1; n >= 0; n--){
+            Node& node = nodes[n];
+            if(node.count > 0){
+                node.min = glm::vec3(FLT_MAX);
+                node.max = glm::vec3(-FLT_MAX);
+                for(int i = node.first; i < node.first + node.count; i++){
+                    node.min = glm::min(node.min, points[i]);
+                    node.max = glm::max(node.max, points[i]);
+                }
+            } else {
+                node.min = glm::min(nodes[node.first].min, nodes[node.first + 1].min);
+                node.max = glm::max(nodes[node.first].max, nodes[node.first + 1].max);
+            }
+        }
+    }
+
+    int size() const {
+        return points.size();
+    }
+
+    bool empty() const {
+        return points.empty();
+    }
+
+    // Vertex closest to point within maxDistance; returns the original vertex
+    // index or -1. distance and position receive the vertex found.
+    int nearestToPoint(const glm::vec3& point, float maxDistance, float* distance = NULL, glm::vec3* position = NULL) const {
+        if(nodes.empty()){
+            return -1;
+        }
+        float best = maxDistance * maxDistance;
+        int bestIndex = -1;
+        int stack[64];
+        int top = 0;
+        stack[top++] = 0;
+
+        while(top > 0){
+            const Node& node = nodes[stack[--top]];
+            if(boxDistance2(node, point) > best){
+                continue;
+            }
+            if(node.count > 0){
+                for(int i = node.first; i < node.first + node.count; i++){
+                    glm::vec3 d = points[i] - point;
+                    float d2 = glm::dot(d, d);
+                    if(d2 < best){
+                        best = d2;
+                        bestIndex = i;
+                    }
+                }
+                continue;
+            }
+            // push the farther child first so the nearer one is searched first
+            int left = node.first;
+            int right = node.first + 1;
+            float dl = boxDistance2(nodes[left], point);
+            float dr = boxDistance2(nodes[right], point);
+            if(dl < dr){
+                if(dr <= best) stack[top++] = right;
+                if(dl <= best) stack[top++] = left;
+            } else {
+                if(dl <= best) stack[top++] = left;
+                if(dr <= best) stack[top++] = right;
+            }
+        }
+
+        return result(bestIndex, best, distance, position);
+    }
+
+    // Vertex closest to the ray origin + t * direction, 0 <= t <= maxT, within
+    // maxDistance of it. Equal distances prefer the vertex nearer the origin.
+    // t is measured along the normalised direction.
+    int nearestToRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float maxT = FLT_MAX, float* distance = NULL, glm::vec3* position = NULL) const {
+        if(nodes.empty()){
+            return -1;
+        }
+        glm::vec3 dir = glm::normalize(direction);
+        glm::vec3 invDir = glm::vec3(1.0f) / dir;
+        float best = maxDistance * maxDistance;
+        float bestT = FLT_MAX;
+        int bestIndex = -1;
+        int stack[64];
+        int top = 0;
+        stack[top++] = 0;
+
+        while(top > 0){
+            const Node& node = nodes[stack[--top]];
+            float radius = std::sqrt(best);
+            float entry;
+            if(!rayHitsBox(node, origin, invDir, radius, entry) || entry > maxT + radius){
+                continue;
+            }
+            if(node.count > 0){
+                for(int i = node.first; i < node.first + node.count; i++){
+                    glm::vec3 d = points[i] - origin;
+                    float t = glm::dot(d, dir);
+                    if(t > maxT){
+                        continue;
+                    }
+                    t = std::max(0.0f, t);
+                    glm::vec3 offset = d - dir * t;
+                    float d2 = glm::dot(offset, offset);
+                    if(d2 < best || (d2 == best && t < bestT)){
+                        best = d2;
+                        bestT = t;
+                        bestIndex = i;
+                    }
+                }
+                continue;
+            }
+            int left = node.first;
+            int right = node.first + 1;
+            float el, er;
+            bool hl = rayHitsBox(nodes[left], origin, invDir, radius, el) && el <= maxT + radius;
+            bool hr = rayHitsBox(nodes[right], origin, invDir, radius, er) && er <= maxT + radius;
+            if(hl && hr){
+                stack[top++] = el < er ? right : left;
+                stack[top++] = el < er ? left : right;
+            } else if(hl){
+                stack[top++] = left;
+            } else if(hr){
+                stack[top++] = right;
+            }
+        }
+
+        return result(bestIndex, best, distance, position);
+    }
+
+    // nearestToPoint for many points; results[i] is the vertex index or -1
+    void nearestToPoints(const std::vector<glm::vec3>& queries, float maxDistance, std::vector<int>& results, int numThreads = 0) const {
+        results.resize(queries.size());
+        int count = queries.size();
+        if(numThreads <= 0){
+            numThreads = std::thread::hardware_concurrency();
+        }
+        const int minQueriesPerThread = 256;
+        numThreads = std::max(1, std::min(numThreads, count / minQueriesPerThread));
+
+        if(numThreads == 1){
+            nearestToPointsRange(queries, maxDistance, results, 0, count);
+            return;
+        }
+        std::vector<std::thread> workers;
+        int perThread = (count + numThreads - 1) / numThreads;
+        for(int i = 0; i < numThreads; i++){
+            int first = i * perThread;
+            int last = std::min(first + perThread, count);
+            if(first >= last){
+                break;
+            }
+            workers.push_back(std::thread(&VertexBVH::nearestToPointsRange, this, std::cref(queries), maxDistance, std::ref(results), first, last));
+        }
+        for(int i = 0; i < workers.size(); i++){
+            workers[i].join();
+        }
+    }
+
+private:
+    // Leaves have count > 0 and own points[first, first + count). Interior
+    // nodes have count == 0 and their children at nodes[first] and nodes[first + 1].
+    struct Node {
+        glm::vec3 min;
+        glm::vec3 max;
+        int first;
+        int count;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<glm::vec3> points;
+    std::vector<int> indices;
+    int leafSize = 8;
+
+    void buildNode(int nodeIndex, int first, int last, const std::vector<glm::vec3>& positions, int depth = 0){
+        glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+        for(int i = first; i < last; i++){
+            min = glm::min(min, positions[indices[i]]);
+            max = glm::max(max, positions[indices[i]]);
+        }
+        nodes[nodeIndex].min = min;
+        nodes[nodeIndex].max = max;
+
+        // depth cap keeps the fixed traversal stacks safe on degenerate input
+        if(last - first <= leafSize || depth >= 48){
+            nodes[nodeIndex].first = first;
+            nodes[nodeIndex].count = last - first;
+            return;
+        }
+
+        glm::vec3 extent = max - min;
+        int axis = 0;
+        if(extent.y > extent[axis]) axis = 1;
+        if(extent.z > extent[axis]) axis = 2;
+
+        int mid = (first + last) / 2;
+        std::nth_element(indices.begin() + first, indices.begin() + mid, indices.begin() + last,
+            [&positions, axis](int a, int b){ return positions[a][axis] < positions[b][axis]; });
+
+        int children = nodes.size();
+        nodes[nodeIndex].first = children;
+        nodes[nodeIndex].count = 0;
+        nodes.push_back(Node());
+        nodes.push_back(Node());
+        buildNode(children, first, mid, positions, depth + 1);
+        buildNode(children + 1, mid, last, positions, depth + 1);
+    }
+
+    int result(int slot, float distance2, float* distance, glm::vec3* position) const {
+        if(slot == -1){
+            return -1;
+        }
+        if(distance){
+            *distance = std::sqrt(distance2);
+        }
+        if(position){
+            *position = points[slot];
+        }
+        return indices[slot];
+    }
+
+    static float boxDistance2(const Node& node, const glm::vec3& point){
+        glm::vec3 d = glm::max(glm::vec3(0.0f), glm::max(node.min - point, point - node.max));
+        return glm::dot(d, d);
+    }
+
+    // slab test against the box grown by radius, for t >= 0
+    static bool rayHitsBox(const Node& node, const glm::vec3& origin, const glm::vec3& invDir, float radius, float& entry){
+        glm::vec3 t0 = (node.min - glm::vec3(radius) - origin) * invDir;
+        glm::vec3 t1 = (node.max + glm::vec3(radius) - origin) * invDir;
+        glm::vec3 tmin = glm::min(t0, t1);
+        glm::vec3 tmax = glm::max(t0, t1);
+        entry = std::max(std::max(tmin.x, tmin.y), std::max(tmin.z, 0.0f));
+        float exit = std::min(std::min(tmax.x, tmax.y), tmax.z);
+        return entry <= exit;
+    }
+
+    void nearestToPointsRange(const std::vector<glm::vec3>& queries, float maxDistance, std::vector<int>& results, int first, int last) const {
+        for(int i = first; i < last; i++){
+            results[i] = nearestToPoint(queries[i], maxDistance);
+        }
+    }
+};
+
+#endif // VERTEX_BVH_H
@@ -0,0 +1,384 @@
+#pragma once
+#ifndef WEIGHT_CURVE_H
+#define WEIGHT_CURVE_H
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define WEIGHT_CURVE_SSE
+#endif
+
+// Binary weight-curve format (.wcrv)
+//
+// One shared timeline for all channels, stored frame-major:
+//
+//   [WeightCurveHeader, 64 bytes]
+//   [frame 0: frameStride floats][frame 1] ... [frame frameCount-1]
+//
+// frameStride is channelCount rounded up to a multiple of 4 (padding is zero),
+// so every frame starts 16-byte aligned and a sampled frame is a straight SIMD
+// blend of 2 or 4 consecutive rows. The layout has no pointers or variable
+// sized blocks, so the file can be mapped as-is; WeightCurveStream reads it in
+// fixed-size chunks so long capture takes never have to be resident in full.
+
+#define WEIGHT_CURVE_MAGIC "WCRV"
+#define WEIGHT_CURVE_VERSION 1
+
+struct WeightCurveHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t channelCount;
+    uint32_t frameCount;
+    uint32_t frameStride;   // floats per frame, channelCount padded to 4
+    float frameRate;        // capture rate, informational
+    uint32_t dataOffset;    // byte offset of frame 0
+    uint32_t reserved[9];
+};
+
+static_assert(sizeof(WeightCurveHeader) == 64, "WeightCurveHeader must stay 64 bytes");
+
+inline uint32_t weightCurveStride(uint32_t channelCount){
+    return (channelCount + 3) & ~3u;
+}
+
+// Appends frames to a .wcrv file; frameCount is patched in on close so takes can
+// be written while they are being recorded.
+class WeightCurveWriter {
+public:
+    WeightCurveWriter() {}
+
+    ~WeightCurveWriter(){
+        close();
+    }
+
+    bool open(const std::string& filename, int channelCount, float frameRate = 30.0f){
+        close();
+        file = fopen(filename.c_str(), "wb");
+        if(!file){
+            std::cerr << "Error opening file: " << filename << std::endl;
+            return false;
+        }
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, WEIGHT_CURVE_MAGIC, 4);
+        header.version = WEIGHT_CURVE_VERSION;
+        header.channelCount = channelCount;
+        header.frameStride = weightCurveStride(channelCount);
+        header.frameRate = frameRate;
+        header.dataOffset = sizeof(WeightCurveHeader);
+        fwrite(&header, sizeof(header), 1, file);
+        padded.assign(header.frameStride, 0.0f);
+        return true;
+    }
+
+    // frame holds channelCount floats
+    void appendFrame(const float* frame){
+        std::copy(frame, frame + header.channelCount, padded.begin());
+        fwrite(&padded[0], sizeof(float), header.frameStride, file);
+        header.frameCount++;
+    }
+
+    void close(){
+        if(!file){
+            return;
+        }
+        fseek(file, 0, SEEK_SET);
+        fwrite(&header, sizeof(header), 1, file);
+        fclose(file);
+        file = NULL;
+    }
+
+    // frames[frame][channel]
+    static bool write(const std::string& filename, const std::vector<std::vector<float>>& frames, float frameRate = 30.0f){
+        if(frames.empty()){
+            return false;
+        }
+        WeightCurveWriter writer;
+        if(!writer.open(filename, frames[0].size(), frameRate)){
+            return false;
+        }
+        std::vector<float> frame(frames[0].size(), 0.0f);
+        for(int i = 0; i < frames.size(); i++){
+            std::fill(frame.begin(), frame.end(), 0.0f);
+            std::copy(frames[i].begin(), frames[i].begin() + std::min(frames[i].size(), frame.size()), frame.begin());
+            writer.appendFrame(&frame[0]);
+        }
+        writer.close();
+        return true;
+    }
+
+private:
+    FILE* file = NULL;
+    WeightCurveHeader header;
+    std::vector<float> padded;
+};
+
+// Frame source for WeightCurvePlayer. Either holds a whole take in memory or
+// keeps a sliding window of chunkFrames frames from a .wcrv file.
+class WeightCurveStream {
+public:
+    WeightCurveStream() {
+        memset(&header, 0, sizeof(header));
+    }
+
+    ~WeightCurveStream(){
+        close();
+    }
+
+    bool open(const std::string& filename, int chunkFrames = 256){
+        close();
+        file = fopen(filename.c_str(), "rb");
+        if(!file){
+            std::cerr << "Error opening file: " << filename << std::endl;
+            return false;
+        }
+        if(fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, WEIGHT_CURVE_MAGIC, 4) != 0 || header.version != WEIGHT_CURVE_VERSION){
+            std::cerr << "Not a weight curve file: " << filename << std::endl;
+            fclose(file);
+            file = NULL;
+            return false;
+        }
+        // cubic sampling reads 4 consecutive frames, the window must hold them
+        this->chunkFrames = std::max(chunkFrames, 4);
+        windowStart = 0;
+        windowCount = 0;
+        return true;
+    }
+
+    void close(){
+        if(file){
+            fclose(file);
+            file = NULL;
+        }
+    }
+
+    // frames[frame][channel], e.g. straight from AnimatorParser::parseFrame
+    void loadFrames(const std::vector<std::vector<float>>& frames, float frameRate = 30.0f){
+        // a file left open would refill the window from the old take
+        close();
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, WEIGHT_CURVE_MAGIC, 4);
+        header.version = WEIGHT_CURVE_VERSION;
+        header.channelCount = frames.empty() ? 0 : frames[0].size();
+        header.frameCount = frames.size();
+        header.frameStride = weightCurveStride(header.channelCount);
+        header.frameRate = frameRate;
+        header.dataOffset = sizeof(WeightCurveHeader);
+
+        window.assign(header.frameCount * header.frameStride, 0.0f);
+        for(int i = 0; i < frames.size(); i++){
+            int count = std::min(frames[i].size(), (size_t)header.channelCount);
+            std::copy(frames[i].begin(), frames[i].begin() + count, window.begin() + i * header.frameStride);
+        }
+        windowStart = 0;
+        windowCount = header.frameCount;
+    }
+
+    int getChannelCount() const {
+        return header.channelCount;
+    }
+
+    int getFrameCount() const {
+        return header.frameCount;
+    }
+
+    int getFrameStride() const {
+        return header.frameStride;
+    }
+
+    float getFrameRate() const {
+        return header.frameRate;
+    }
+
+    // Returns frame `first`; frames first+1 .. first+count-1 follow at
+    // getFrameStride() floats each. Valid until the next call.
+    const float* getFrames(int first, int count){
+        if(first < windowStart || first + count > windowStart + windowCount){
+            loadWindow(first);
+        }
+        return &window[(first - windowStart) * header.frameStride];
+    }
+
+private:
+    WeightCurveHeader header;
+    FILE* file = NULL;
+    int chunkFrames = 0;
+    int windowStart = 0;
+    int windowCount = 0;
+    std::vector<float> window;
+
+    void loadWindow(int first){
+        if(!file){
+            return;
+        }
+        windowStart = first;
+        windowCount = std::min(chunkFrames, (int)header.frameCount - first);
+        window.resize(chunkFrames * header.frameStride);
+        fseek(file, header.dataOffset + (long)first * header.frameStride * sizeof(float), SEEK_SET);
+        size_t read = fread(&window[0], sizeof(float) * header.frameStride, windowCount, file);
+        if(read != windowCount){
+            std::fill(window.begin() + read * header.frameStride, window.end(), 0.0f);
+        }
+    }
+};
+
+// Shared timeline over every channel of a WeightCurveStream. Time advances once
+// per update and all channels are sampled in one pass over the frame rows.
+class WeightCurvePlayer {
+public:
+    WeightCurvePlayer(WeightCurveStream* stream = NULL){
+        setStream(stream);
+    }
+
+    void setStream(WeightCurveStream* stream){
+        this->stream = stream;
+        weights.assign(stream ? stream->getFrameStride() : 0, 0.0f);
+    }
+
+    // Advances the timeline by deltaTime seconds (speed is in frames per second).
+    // Returns true if getWeights() was resampled.
+    bool update(float deltaTime){
+        if(!stream || stream->getFrameCount() == 0){
+            return false;
+        }
+        int lastFrame = stream->getFrameCount() - 1;
+
+        if(isPlaying){
+            currentFrame += deltaTime * speed;
+            if(currentFrame > lastFrame){
+                currentFrame = isLoop ? 0.0f : (float)lastFrame;
+            }
+            sample(currentFrame);
+            return true;
+        } else if(currentFrame != 0.0f){
+            currentFrame = 0.0f;
+            sample(currentFrame);
+            return true;
+        }
+        return false;
+    }
+
+    // samples every channel at a (fractional) frame into getWeights()
+    void sample(float frame){
+        int frameCount = stream->getFrameCount();
+        int stride = stream->getFrameStride();
+        int index = std::max(0, std::min((int)frame, frameCount - 1));
+        float t = frame - index;
+
+        if(frameCount == 1 || t == 0.0f){
+            const float* row = stream->getFrames(index, 1);
+            std::copy(row, row + stride, weights.begin());
+            return;
+        }
+
+        if(!isCubic || frameCount == 2){
+            int next = std::min(index + 1, frameCount - 1);
+            const float* rows = stream->getFrames(index, next - index + 1);
+            blend2(rows, rows + (next - index) * stride, t, stride);
+            return;
+        }
+
+        // Catmull-Rom with clamped end points; all four rows are consecutive
+        int first = std::max(0, index - 1);
+        int last = std::min(frameCount - 1, index + 2);
+        const float* rows = stream->getFrames(first, last - first + 1);
+        const float* pb = rows + (index - first) * stride;
+        const float* pa = rows;
+        const float* pc = rows + (std::min(frameCount - 1, index + 1) - first) * stride;
+        const float* pd = rows + (last - first) * stride;
+
+        float t2 = t * t;
+        float t3 = t2 * t;
+        float wa = 0.5f * (-t + 2.0f * t2 - t3);
+        float wb = 0.5f * (2.0f - 5.0f * t2 + 3.0f * t3);
+        float wc = 0.5f * (t + 4.0f * t2 - 3.0f * t3);
+        float wd = 0.5f * (-t2 + t3);
+        blend4(pa, pb, pc, pd, wa, wb, wc, wd, stride);
+    }
+
+    const std::vector<float>& getWeights() const {
+        return weights;
+    }
+
+    int getChannelCount() const {
+        return stream ? stream->getChannelCount() : 0;
+    }
+
+    int getFrameCount() const {
+        return stream ? stream->getFrameCount() : 0;
+    }
+
+    void setSpeed(float speed){
+        this->speed = speed;
+    }
+
+    void setLoop(bool isLoop){
+        this->isLoop = isLoop;
+    }
+
+    void setCubic(bool isCubic){
+        this->isCubic = isCubic;
+    }
+
+    void setPlaying(bool isPlaying){
+        this->isPlaying = isPlaying;
+    }
+
+    void setCurrentFrame(float currentFrame){
+        this->currentFrame = currentFrame;
+    }
+
+    float getCurrentFrame() const {
+        return currentFrame;
+    }
+
+private:
+    WeightCurveStream* stream;
+    std::vector<float> weights;
+    bool isPlaying = false;
+    bool isLoop = true;
+    bool isCubic = false;
+    float speed = 1.0f;
+    float currentFrame = 0.0f;
+
+    void blend2(const float* a, const float* b, float t, int stride){
+        float* out = &weights[0];
+#ifdef WEIGHT_CURVE_SSE
+        __m128 vt = _mm_set1_ps(t);
+        for(int i = 0; i < stride; i += 4){
+            __m128 va = _mm_loadu_ps(a + i);
+            __m128 vb = _mm_loadu_ps(b + i);
+            _mm_storeu_ps(out + i, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), vt)));
+        }
+#else
+        for(int i = 0; i < stride; i++){
+            out[i] = a[i] + (b[i] - a[i]) * t;
+        }
+#endif
+    }
+
+    void blend4(const float* a, const float* b, const float* c, const float* d, float wa, float wb, float wc, float wd, int stride){
+        float* out = &weights[0];
+#ifdef WEIGHT_CURVE_SSE
+        __m128 va = _mm_set1_ps(wa), vb = _mm_set1_ps(wb), vc = _mm_set1_ps(wc), vd = _mm_set1_ps(wd);
+        for(int i = 0; i < stride; i += 4){
+            __m128 r = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a + i), va), _mm_mul_ps(_mm_loadu_ps(b + i), vb));
+            r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(c + i), vc));
+            r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(d + i), vd));
+            _mm_storeu_ps(out + i, r);
+        }
+#else
+        for(int i = 0; i < stride; i++){
+            out[i] = a[i] * wa + b[i] * wb + c[i] * wc + d[i] * wd;
+        }
+#endif
+    }
+};
+
+#endif // WEIGHT_CURVE_H
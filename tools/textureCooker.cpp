@@ -0,0 +1,254 @@
+#include "../src/utils/textureCooker.h"
+#include "../src/utils/cubemapLoader.h"
+#include "../src/utils/coneStepMap.h"
+#include "../src/utils/fileHash.h"
+#include "../src/utils/stb_image.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <iostream>
+
+// texture_cooker [--format auto|bc1|bc3|bc5|bc7|rgba8] [--threads N] [--no-mips]
+//                [--normal] [--cube] [--cone] image...
+//
+// Writes <image>.gtex next to every image, which Texture then loads instead of
+// decoding the image (see src/utils/textureCooker.h). With --cube the images
+// are taken six at a time as the faces of a cube map (+X -X +Y -Y +Z -Z, as
+// Cubemap names them) and one six face <first face>.gtex is written for Cubemap. --format auto picks BC5
+// for normal maps (--normal, or "normal" in the file name), BC3 for images
+// with alpha and BC1 otherwise. BC5 normal maps keep x and y only, for shaders
+// that rebuild z (texturedShader.frag). BC7 needs GL 4.2, Texture falls back
+// to the image where the driver can't take it.
+//
+// Per image and in total it prints the video memory of the uncompressed
+// texture against the cooked one, the image decode time against the cooked
+// read time, and the PSNR of the top level after compression.
+//
+// --cone takes height images instead and writes <image>.cone, the relaxed
+// cone step map Texture loads for parallax (src/utils/coneStepMap.h). The
+// maps take seconds each to build, so the engine only reads them; a height
+// image without a current one is marched linearly.
+
+struct CookerOptions {
+    std::string format = "auto";
+    int numThreads = 0;
+    bool mipmaps = true;
+    bool normal = false;
+    bool cube = false;
+    bool cone = false;
+    std::vector<std::string> files;
+};
+
+static bool parseOptions(int argc, char** argv, CookerOptions& options){
+    for(int i = 1; i < argc; i++){
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if(arg == "--format" && hasValue){
+            options.format = argv[++i];
+        }
+        else if(arg == "--threads" && hasValue){
+            options.numThreads = std::max(0, atoi(argv[++i]));
+        }
+        else if(arg == "--no-mips"){
+            options.mipmaps = false;
+        }
+        else if(arg == "--normal"){
+            options.normal = true;
+        }
+        else if(arg == "--cube"){
+            options.cube = true;
+        }
+        else if(arg == "--cone"){
+            options.cone = true;
+        }
+        else if(arg.size() > 1 && arg[0] == '-'){
+            std::cerr << "Unknown argument " << arg << std::endl;
+            return false;
+        }
+        else{
+            options.files.push_back(arg);
+        }
+    }
+    return !options.files.empty() && (!options.cube || options.files.size() % 6 == 0) && !(options.cube && options.cone);
+}
+
+static bool isNormalMap(const CookerOptions& options, const std::string& path){
+    std::string name = path;
+    for(char& c : name){
+        c = tolower(c);
+    }
+    return options.normal || name.find("normal") != std::string::npos;
+}
+
+static bool pickFormat(const std::string& name, bool normalMap, const unsigned char* rgba, size_t pixelCount, CookedFormat& format){
+    if(name == "auto"){
+        bool hasAlpha = false;
+        for(size_t i = 0; i < pixelCount && !hasAlpha; i++){
+            hasAlpha = rgba[4 * i + 3] != 255;
+        }
+        format = normalMap ? COOKED_BC5 : hasAlpha ? COOKED_BC3 : COOKED_BC1;
+    }
+    else if(name == "bc1") format = COOKED_BC1;
+    else if(name == "bc3") format = COOKED_BC3;
+    else if(name == "bc5") format = COOKED_BC5;
+    else if(name == "bc7") format = COOKED_BC7;
+    else if(name == "rgba8") format = COOKED_RGBA8;
+    else return false;
+    return true;
+}
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start){
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct CookerTotals {
+    size_t source = 0;
+    size_t cooked = 0;
+    double decode = 0.0;
+    double read = 0.0;
+    int failures = 0;
+};
+
+// One image, or the six faces of a cube (contiguous, as CubemapLoader decodes
+// them), to <path>.gtex. False for an unknown --format.
+static bool cookImages(const CookerOptions& options, const std::string& path, const unsigned char* const* faces, int faceCount, int width, int height, int channels, double decodeTime, CookerTotals& totals){
+    bool normalMap = isNormalMap(options, path);
+    CookedFormat format;
+    if(!pickFormat(options.format, normalMap, faces[0], (size_t)width * height * faceCount, format)){
+        std::cerr << "Unknown --format " << options.format << std::endl;
+        return false;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    CookedTexture texture;
+    TextureCooker::cookFaces(faces, faceCount, width, height, format, normalMap, texture, options.mipmaps, options.numThreads);
+    texture.channels = channels;
+    double cookTime = millisecondsSince(start);
+
+    std::vector<unsigned char> source, decoded, face;
+    for(int f = 0; f < faceCount; f++){
+        TextureCooker::decode(texture, 0, face, f);
+        decoded.insert(decoded.end(), face.begin(), face.end());
+        source.insert(source.end(), faces[f], faces[f] + (size_t)width * height * 4);
+    }
+    double psnr = TextureCooker::psnr(source.data(), decoded.data(), (size_t)width * height * faceCount, TextureCooker::getChannelCount(format));
+
+    std::string cookedPath = TextureCooker::getCookedPath(path);
+    if(!TextureCooker::write(cookedPath, texture)){
+        std::cerr << cookedPath << ": could not be written" << std::endl;
+        totals.failures++;
+        return true;
+    }
+    start = std::chrono::steady_clock::now();
+    CookedTexture check;
+    bool readBack = TextureCooker::read(cookedPath, check);
+    double readTime = millisecondsSince(start);
+    if(!readBack){
+        std::cerr << cookedPath << ": could not be read back" << std::endl;
+        totals.failures++;
+        return true;
+    }
+
+    // what Texture and Cubemap upload for the images: their own channels plus a third for mips
+    size_t sourceSize = (size_t)width * height * channels * faceCount;
+    if(options.mipmaps){
+        sourceSize = sourceSize * 4 / 3;
+    }
+    totals.source += sourceSize;
+    totals.cooked += texture.getSize();
+    totals.decode += decodeTime;
+    totals.read += readTime;
+    printf("%s: %s%dx%d %s, %d mips, %.0f KB -> %.0f KB, decode %.1f ms -> read %.1f ms, cooked in %.1f ms, PSNR %.2f dB\n",
+           path.c_str(), faceCount == 6 ? "cube " : "", width, height, TextureCooker::getFormatName(format), texture.getLevelCount(),
+           sourceSize / 1024.0, texture.getSize() / 1024.0, decodeTime, readTime, cookTime, psnr);
+    return true;
+}
+
+// The cone step map of one height image to <path>.cone, keyed by the image's hash.
+static bool cookConeStep(const CookerOptions& options, const std::string& path){
+    uint64_t hash;
+    int width, height, channels;
+    unsigned char* data = FileHash::hashFile(path, hash) ? stbi_load(path.c_str(), &width, &height, &channels, 0) : NULL;
+    if(data == NULL){
+        std::cerr << path << ": could not be loaded" << std::endl;
+        return false;
+    }
+    // the shaders read the height from the red channel, so build from it
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<unsigned char> cones;
+    ConeStepMap::build(data, width, height, channels, cones, options.numThreads);
+    double buildTime = millisecondsSince(start);
+    stbi_image_free(data);
+
+    std::string conePath = ConeStepMap::getCachePath(path);
+    if(!ConeStepMap::write(conePath, hash, width, height, cones)){
+        std::cerr << conePath << ": could not be written" << std::endl;
+        return false;
+    }
+    printf("%s: %dx%d cone step map, %.0f KB, built in %.1f ms\n", path.c_str(), width, height, cones.size() / 1024.0, buildTime);
+    return true;
+}
+
+int main(int argc, char** argv){
+    CookerOptions options;
+    if(!parseOptions(argc, argv, options)){
+        std::cerr << "usage: texture_cooker [--format auto|bc1|bc3|bc5|bc7|rgba8] [--threads N] [--no-mips] [--normal] [--cube] [--cone] image..." << std::endl;
+        std::cerr << "       --cube takes the images six at a time, --cone height images" << std::endl;
+        return 1;
+    }
+
+    if(options.cone){
+        int failures = 0;
+        for(const std::string& path : options.files){
+            failures += cookConeStep(options, path) ? 0 : 1;
+        }
+        return failures == 0 ? 0 : 1;
+    }
+
+    CookerTotals totals;
+    size_t step = options.cube ? 6 : 1;
+    for(size_t i = 0; i < options.files.size(); i += step){
+        const std::string& path = options.files[i];
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if(options.cube){
+            CubemapImage image;
+            bool loaded = CubemapLoader::decodeFaces(&options.files[i], image, options.numThreads);
+            double decodeTime = millisecondsSince(start);
+            if(!loaded){
+                std::cerr << path << ": the six faces could not be loaded as square images of one size" << std::endl;
+                totals.failures++;
+                continue;
+            }
+            const unsigned char* faces[6];
+            for(int face = 0; face < 6; face++){
+                faces[face] = image.getFace(face);
+            }
+            if(!cookImages(options, path, faces, 6, image.size, image.size, image.channels, decodeTime, totals)){
+                return 1;
+            }
+            continue;
+        }
+
+        int width, height, channels;
+        unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, 4);
+        double decodeTime = millisecondsSince(start);
+        if(data == NULL){
+            std::cerr << path << ": could not be loaded" << std::endl;
+            totals.failures++;
+            continue;
+        }
+        bool known = cookImages(options, path, &data, 1, width, height, channels, decodeTime, totals);
+        stbi_image_free(data);
+        if(!known){
+            return 1;
+        }
+    }
+
+    if(totals.source > 0){
+        printf("total: %.1f MB -> %.1f MB video memory (%.1fx), load %.1f ms -> %.1f ms\n",
+               totals.source / 1048576.0, totals.cooked / 1048576.0, (double)totals.source / totals.cooked, totals.decode, totals.read);
+    }
+    return totals.failures == 0 ? 0 : 1;
+}